@@ -46,7 +46,7 @@ int main()
     MPALayer +      // layer != 0
     SyncTrie::any + // protection
     SyncTrie(0xff, 8) + // Sync
-    SyncTrie("xxxxxxxx") +
+    SyncTrie(8) +       // mode, etc
     MPABitrate +    // bitrate != 0xf
     MPARate;        // rate != 0x3
 
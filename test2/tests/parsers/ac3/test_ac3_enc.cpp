@@ -0,0 +1,325 @@
+/*
+  AC3Enc test
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "parsers/ac3/ac3_bitalloc.h"
+#include "parsers/ac3/ac3_enc.h"
+#include "parsers/ac3/ac3_parser.h"
+#include "filters/filter_graph.h"
+#include "rng.h"
+#include "source/generator.h"
+#include "../../../suite.h"
+
+static const int seed = 9823475;
+static const size_t noise_size = 256 * 1024;
+
+BOOST_AUTO_TEST_SUITE(ac3_enc)
+
+BOOST_AUTO_TEST_CASE(constructor)
+{
+  AC3Enc enc;
+  BOOST_CHECK_EQUAL(enc.get_threads(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(set_threads)
+{
+  AC3Enc enc;
+
+  enc.set_threads(1);
+  BOOST_CHECK_EQUAL(enc.get_threads(), 0);
+
+  enc.set_threads(4);
+  BOOST_CHECK_EQUAL(enc.get_threads(), 4);
+
+  enc.set_threads(0);
+  BOOST_CHECK_EQUAL(enc.get_threads(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(multithreaded)
+{
+  // Multithreaded encoder must produce the same output
+  // as single-threaded encoder
+
+  static const int modes[] = { MODE_MONO, MODE_STEREO, MODE_2_1_LFE, MODE_5_1 };
+  static const int threads[] = { 2, 3, 8 };
+
+  for (int i = 0; i < array_size(modes); i++)
+    for (int j = 0; j < array_size(threads); j++)
+    {
+      Speakers spk(FORMAT_LINEAR, modes[i], 48000);
+      NoiseGen src_noise(spk, seed, noise_size);
+      NoiseGen ref_noise(spk, seed, noise_size);
+
+      AC3Enc enc;
+      AC3Enc ref_enc;
+      enc.set_threads(threads[j]);
+
+      BOOST_MESSAGE("Mode: " << spk.print() << " threads: " << threads[j]);
+      compare(&src_noise, &enc, &ref_noise, &ref_enc);
+
+      // Encoder must restart correctly after reset
+      src_noise.reset();
+      ref_noise.reset();
+      enc.reset();
+      ref_enc.reset();
+      compare(&src_noise, &enc, &ref_noise, &ref_enc);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(fixed_point)
+{
+  // Fixed-point MDCT is the default
+  AC3Enc enc;
+  BOOST_CHECK(enc.get_fixed_point());
+
+  enc.set_fixed_point(false);
+  BOOST_CHECK(!enc.get_fixed_point());
+
+  enc.set_fixed_point(true);
+  BOOST_CHECK(enc.get_fixed_point());
+}
+
+BOOST_AUTO_TEST_CASE(float_mdct)
+{
+  // Floating-point and fixed-point encoders must produce
+  // nearly the same decoded output. Use a tone because noise
+  // is limited by the encoder bandwidth. Fixed-point encoder
+  // overflows at full scale, so use -6dB tone.
+
+  static const int modes[] = { MODE_MONO, MODE_STEREO, MODE_5_1 };
+
+  for (int i = 0; i < array_size(modes); i++)
+  {
+    Speakers spk(FORMAT_LINEAR, modes[i], 48000, 2.0);
+    ToneGen src_tone(spk, 1000, 0, noise_size);
+    ToneGen ref_tone(spk, 1000, 0, noise_size);
+
+    AC3Enc enc;
+    AC3Parser dec;
+    FilterChain chain(&enc, &dec);
+    enc.set_fixed_point(false);
+
+    AC3Enc ref_enc;
+    AC3Parser ref_dec;
+    FilterChain ref_chain(&ref_enc, &ref_dec);
+
+    double rms = calc_rms(&ref_tone, &ref_chain);
+    ref_tone.reset();
+    double diff = calc_rms_diff(&src_tone, &chain, &ref_tone, &ref_chain);
+    BOOST_MESSAGE("Mode: " << spk.print() << " rms: " << value2db(rms) << " diff: " << value2db(diff));
+    BOOST_CHECK_LE(diff, rms * 0.01);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bap_bits_count)
+{
+  // bap_bits() must count the same number of bits as BAP_BitCount
+
+  RNG rng(seed);
+  int8_t bap[256];
+
+  for (int i = 0; i < 1000; i++)
+  {
+    int end = rng.get_range(256);
+    int start = rng.get_range(end);
+    int max_bap = rng.get_range(15);
+    for (int j = 0; j < 256; j++)
+      bap[j] = (int8_t)rng.get_range(max_bap);
+
+    BAP_BitCount counter;
+    counter.add_bap(bap, start, end);
+    BOOST_CHECK_EQUAL(bap_bits(bap, start, end), counter.bits);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(bit_alloc_split)
+{
+  // Cached masking curve must give the same baps as bit_alloc()
+  // for any snr offset
+
+  RNG rng(seed);
+  int8_t exp[256];
+  int8_t ref_bap[256];
+  int8_t bap[256];
+  int mask[50];
+
+  for (int i = 0; i < 100; i++)
+  {
+    int end = rng.get_range(252) + 1;
+    for (int j = 0; j < 256; j++)
+      exp[j] = (int8_t)rng.get_range(24);
+
+    bit_alloc_mask(mask, exp, 2, 0, 0, end, 0, 0, 
+      0x0f, 0x53, 0x540, 0x80, 0, 0, 0);
+
+    for (int snroffset = -960; snroffset <= 2108; snroffset += 64)
+    {
+      bit_alloc(ref_bap, exp, 2, 0, 0, end, 0, 0, 
+        0x0f, 0x53, 0x540, 0x80, 0, 0x2f0, 0, 0, snroffset);
+      bit_alloc_bap(bap, exp, mask, 0, end, 0x2f0, snroffset);
+      BOOST_CHECK(memcmp(bap, ref_bap, end) == 0);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Vector kernels
+// SSE2 kernels must give exactly the same result as scalar ones for random
+// data and edge cases, at any length and alignment.
+
+#ifdef VALIB_SSE2
+
+static const int kernel_runs = 1000;
+static const int kernel_size = AC3_BLOCK_SAMPLES + 4; // + misalignment
+
+// Length and offset of a test run: short and odd lengths first (tails),
+// random after.
+static void kernel_range(RNG &rng, int run, int &offset, int &n)
+{
+  offset = run % 4;
+  if (run < 64)
+    n = run / 2;
+  else if (run < 72)
+    n = AC3_BLOCK_SAMPLES - (run - 64);
+  else
+    n = rng.get_range(AC3_BLOCK_SAMPLES);
+}
+
+BOOST_AUTO_TEST_CASE(kernel_fixed_exp)
+{
+  static const int32_t edge[] =
+  {
+    0, 1, -1, 2, -2, 0x7fff, -0x8000, 0x8000,
+    (1 << 23), -(1 << 23), (1 << 24) - 1, -(1 << 24) + 1, (1 << 24), -(1 << 24),
+    0x7fffffff, -0x7fffffff
+  };
+
+  RNG rng(seed);
+  int32_t mant_c[kernel_size], mant_sse2[kernel_size];
+  int8_t  exp_c[kernel_size], exp_sse2[kernel_size];
+
+  for (int run = 0; run < kernel_runs; run++)
+  {
+    int offset, n;
+    kernel_range(rng, run, offset, n);
+    int exp_norm = run < array_size(edge)? 24: rng.get_range(24);
+
+    for (int s = 0; s < kernel_size; s++)
+      if (rng.get_range(3) == 0)
+        mant_c[s] = edge[rng.get_range(array_size(edge) - 1)];
+      else
+      {
+        mant_c[s] = int32_t(rng.next() >> rng.get_range(30));
+        if (rng.get_bool()) mant_c[s] = -mant_c[s];
+      }
+    memcpy(mant_sse2, mant_c, sizeof(mant_c));
+    memset(exp_c, 0, sizeof(exp_c));
+    memset(exp_sse2, 0, sizeof(exp_sse2));
+
+    fixed_exp_c(exp_c + offset, mant_c + offset, exp_norm, n);
+    fixed_exp_sse2(exp_sse2 + offset, mant_sse2 + offset, exp_norm, n);
+    BOOST_CHECK(memcmp(exp_c, exp_sse2, sizeof(exp_c)) == 0);
+    BOOST_CHECK(memcmp(mant_c, mant_sse2, sizeof(mant_c)) == 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(kernel_float_exp)
+{
+  static const sample_t edge[] =
+  {
+    0.0, -0.0, 0.5, -0.5, -1.0, 0.99999, -0.99999,
+    ldexp(1.0, -24), -ldexp(1.0, -24), ldexp(0.99999, -24), ldexp(1.0, -25),
+    ldexp(1.0, -100), ldexp(1.0, -1070)
+  };
+
+  RNG rng(seed);
+  sample_t coef[kernel_size];
+  int8_t exp_c[kernel_size], exp_sse2[kernel_size];
+
+  for (int run = 0; run < kernel_runs; run++)
+  {
+    int offset, n;
+    kernel_range(rng, run, offset, n);
+
+    for (int s = 0; s < kernel_size; s++)
+      if (rng.get_range(3) == 0)
+        coef[s] = edge[rng.get_range(array_size(edge) - 1)];
+      else
+        coef[s] = ldexp(rng.get_double(), -int(rng.get_range(30)));
+    memset(exp_c, 0, sizeof(exp_c));
+    memset(exp_sse2, 0, sizeof(exp_sse2));
+
+    float_exp_c(exp_c + offset, coef + offset, n);
+    float_exp_sse2(exp_sse2 + offset, coef + offset, n);
+    BOOST_CHECK(memcmp(exp_c, exp_sse2, sizeof(exp_c)) == 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(kernel_exp_diff_min)
+{
+  RNG rng(seed);
+  int8_t exp1[kernel_size], exp2[kernel_size];
+  int8_t min_c[kernel_size], min_sse2[kernel_size];
+
+  for (int run = 0; run < kernel_runs; run++)
+  {
+    int offset, n;
+    kernel_range(rng, run, offset, n);
+
+    // Max exponent difference first
+    for (int s = 0; s < kernel_size; s++)
+    {
+      exp1[s] = run < 8? 24: (int8_t)rng.get_range(24);
+      exp2[s] = run < 8?  0: (int8_t)rng.get_range(24);
+    }
+
+    BOOST_CHECK_EQUAL(
+      exp_diff_c(exp1 + offset, exp2 + offset, n),
+      exp_diff_sse2(exp1 + offset, exp2 + offset, n));
+
+    memcpy(min_c, exp1, sizeof(exp1));
+    memcpy(min_sse2, exp1, sizeof(exp1));
+    exp_min_c(min_c + offset, exp2 + offset, n);
+    exp_min_sse2(min_sse2 + offset, exp2 + offset, n);
+    BOOST_CHECK(memcmp(min_c, min_sse2, sizeof(min_c)) == 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(kernel_quant_mant)
+{
+  static const int32_t edge[] = { 0, 1, -1, 0x7fff, -0x8000, 0x4000, -0x4000 };
+
+  RNG rng(seed);
+  int32_t mant[kernel_size];
+  int8_t  bap[kernel_size];
+  uint16_t q_c[kernel_size], q_sse2[kernel_size];
+
+  for (int run = 0; run < kernel_runs; run++)
+  {
+    int offset, n;
+    kernel_range(rng, run, offset, n);
+
+    // Zero mantissas with all baps first
+    for (int s = 0; s < kernel_size; s++)
+    {
+      bap[s] = (int8_t)rng.get_range(15);
+      if (run < 8)
+        mant[s] = 0;
+      else if (rng.get_range(3) == 0)
+        mant[s] = edge[rng.get_range(array_size(edge) - 1)];
+      else
+        mant[s] = int32_t(rng.get_range(0xffff)) - 0x8000;
+    }
+    memset(q_c, 0, sizeof(q_c));
+    memset(q_sse2, 0, sizeof(q_sse2));
+
+    quant_mant_c(q_c + offset, mant + offset, bap + offset, n);
+    quant_mant_sse2(q_sse2 + offset, mant + offset, bap + offset, n);
+    BOOST_CHECK(memcmp(q_c, q_sse2, sizeof(q_c)) == 0);
+  }
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -69,6 +69,36 @@ static void test_streams_frames(const char *filename, int streams, int frames)
   check_streams_chunks(&f, &parser, streams, frames);
 }
 
+// Output of the wrapper as contiguous data
+static void wrap_file(const char *filename, SPDIFWrapper &spdifer, std::vector<uint8_t> &data, int &segmented)
+{
+  FileParser f;
+  SpdifableFrameParser frame_parser;
+  f.open_probe(filename, &frame_parser);
+  BOOST_REQUIRE(f.is_open());
+  BOOST_REQUIRE(spdifer.open(f.get_output()));
+
+  Chunk chunk, out;
+  while (f.get_chunk(chunk))
+  {
+    if (f.new_stream())
+      BOOST_REQUIRE(spdifer.open(f.get_output()));
+
+    while (spdifer.process(chunk, out))
+    {
+      size_t pos = data.size();
+      data.resize(pos + out.size);
+      if (out.segments)
+      {
+        BOOST_REQUIRE_EQUAL(out.gather(&data[pos]), out.size);
+        segmented++;
+      }
+      else if (out.size)
+        memcpy(&data[pos], out.rawdata, out.size);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE(spdif_wrapper)
 
 BOOST_AUTO_TEST_CASE(constructor)
@@ -113,6 +143,42 @@ BOOST_AUTO_TEST_CASE(streams_frames)
   test_streams_frames("a.mad.mix.mad", 7, 4375);
 }
 
+BOOST_AUTO_TEST_CASE(gather)
+{
+  struct {
+    const char *filename;
+    int dts_mode;
+    int dts_conv;
+  } tests[] = {
+    { "a.mp2.005.mp2", DTS_MODE_AUTO, DTS_CONV_NONE },
+    { "a.ac3.03f.ac3", DTS_MODE_AUTO, DTS_CONV_NONE },
+    { "a.dts.03f.dts", DTS_MODE_AUTO, DTS_CONV_NONE },
+    { "a.dts.03f.dts", DTS_MODE_PADDED, DTS_CONV_14BIT },
+    { "a.dts.03f.dts14", DTS_MODE_AUTO, DTS_CONV_NONE },
+    { "a.dts.03f.dts14", DTS_MODE_PADDED, DTS_CONV_NONE },
+    { "a.mad.mix.mad", DTS_MODE_AUTO, DTS_CONV_NONE },
+  };
+
+  for (int i = 0; i < array_size(tests); i++)
+  {
+    BOOST_MESSAGE("Gather " << tests[i].filename << " dts_mode: " << dts_mode_text(tests[i].dts_mode) << " dts_conv: " << dts_conv_text(tests[i].dts_conv));
+
+    std::vector<uint8_t> data, ref;
+    int segmented = 0, ref_segmented = 0;
+
+    SPDIFWrapper spdifer(tests[i].dts_mode, tests[i].dts_conv);
+    spdifer.gather = true;
+    wrap_file(tests[i].filename, spdifer, data, segmented);
+
+    SPDIFWrapper ref_spdifer(tests[i].dts_mode, tests[i].dts_conv);
+    wrap_file(tests[i].filename, ref_spdifer, ref, ref_segmented);
+
+    BOOST_CHECK(segmented > 0);
+    BOOST_CHECK_EQUAL(ref_segmented, 0);
+    BOOST_CHECK(data == ref);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(dts_options)
 {
   enum mode_t { mode_wrap, mode_pad, mode_pass };
@@ -0,0 +1,92 @@
+/*
+  FfmpegDecoder test
+  Zero-copy and copying output must be the same. Decoder must not read input
+  past the end of the packet.
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "filters/filter_graph.h"
+#include "parsers/aac/aac_parser.h"
+#include "parsers/aac/aac_adts_parser.h"
+#include "parsers/aac/aac_adts_header.h"
+#include "source/file_parser.h"
+#include "../../suite.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Copy each chunk to a buffer of exactly the chunk size, so each packet ends
+// at the end of the memory allocated.
+
+class BoundarySource : public SourceWrapper
+{
+protected:
+  Rawdata buf;
+
+public:
+  BoundarySource(Source *source): SourceWrapper(source)
+  {}
+
+  virtual bool get_chunk(Chunk &out)
+  {
+    if (!SourceWrapper::get_chunk(out))
+      return false;
+
+    if (out.rawdata && out.size)
+    {
+      buf.free();
+      buf.allocate(out.size);
+      memcpy(buf, out.rawdata, out.size);
+      out.set_rawdata(buf, out.size, out.sync, out.time);
+    }
+    return true;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE(ffmpeg_decoder)
+
+BOOST_AUTO_TEST_CASE(set_zero_copy)
+{
+  AACParser aac;
+  BOOST_CHECK(aac.get_zero_copy());
+
+  aac.set_zero_copy(false);
+  BOOST_CHECK(!aac.get_zero_copy());
+
+  aac.set_zero_copy(true);
+  BOOST_CHECK(aac.get_zero_copy());
+}
+
+BOOST_AUTO_TEST_CASE(zero_copy)
+{
+  // Test chain:
+  // FileParser -> BoundarySource -> ParserFilter(ADTS) -> AACParser (zero-copy)
+  //
+  // Reference chain:
+  // FileParser -> ParserFilter(ADTS) -> AACParser (copying)
+
+  ADTSFrameParser frame_parser;
+  ADTSFrameParser ref_frame_parser;
+
+  FileParser f;
+  f.open("a.aac.03f.adts", &frame_parser);
+  BOOST_REQUIRE(f.is_open());
+  BoundarySource src(&f);
+
+  FileParser ref;
+  ref.open("a.aac.03f.adts", &ref_frame_parser);
+  BOOST_REQUIRE(ref.is_open());
+
+  ADTSParser adts;
+  AACParser aac;
+  FilterChain chain(&adts, &aac);
+
+  ADTSParser ref_adts;
+  AACParser ref_aac;
+  FilterChain ref_chain(&ref_adts, &ref_aac);
+  ref_aac.set_zero_copy(false);
+
+  compare(&src, &chain, &ref, &ref_chain);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,7 +7,9 @@
 #include "parsers/ac3/ac3_header.h"
 #include "parsers/dts/dts_header.h"
 #include "parsers/mpa/mpa_header.h"
+#include "parsers/uni/uni_frame_parser.h"
 #include "auto_file.h"
+#include "../../noise_buf.h"
 
 
 static AC3FrameParser ac3;
@@ -238,4 +240,54 @@ BOOST_AUTO_TEST_CASE(sync_info2)
   }
 }
 
+BOOST_AUTO_TEST_CASE(parse_header_noise)
+{
+  // Only parsers matching the sync are called. Result must be the same as
+  // when we call all parsers in order.
+  static const uint32_t sync_words[] =
+  {
+    0x0b770b77, 0x770b770b, 0x7ffe8001, 0xfe7f0180,
+    0x1fffe800, 0xff1f00e8, 0xfffbfffb, 0xfbfffbff,
+    0x72f81f4e, 0x00000000, 0xfff1fff1
+  };
+
+  UniFrameParser uni;
+  MultiFrameParser::list_t list = uni.get_parsers();
+
+  const size_t buf_size = 65536;
+  RawNoise buf(buf_size, 4958734);
+  for (int i = 0; i < 4000; i++)
+  {
+    uint32_t sync = sync_words[buf.rng.get_range(array_size(sync_words))];
+    size_t pos = buf.rng.get_range(buf_size - 4);
+    buf[pos+0] = (uint8_t)(sync >> 24);
+    buf[pos+1] = (uint8_t)(sync >> 16);
+    buf[pos+2] = (uint8_t)(sync >> 8);
+    buf[pos+3] = (uint8_t)(sync);
+  }
+
+  int headers = 0;
+  for (size_t pos = 0; pos + uni.header_size() <= buf_size; pos++)
+  {
+    FrameInfo finfo1, finfo2;
+    bool result1 = uni.parse_header(buf + pos, &finfo1);
+    bool result2 = false;
+    for (size_t i = 0; i < list.size(); i++)
+      if (list[i]->parse_header(buf + pos, &finfo2))
+      {
+        result2 = true;
+        break;
+      }
+
+    BOOST_REQUIRE_EQUAL(result1, result2);
+    if (result1)
+    {
+      BOOST_REQUIRE(finfo1.spk == finfo2.spk);
+      BOOST_REQUIRE_EQUAL(finfo1.frame_size, finfo2.frame_size);
+      headers++;
+    }
+  }
+  BOOST_CHECK(headers > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,72 @@
+/*
+  TSFrameParser test
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "parsers/ts/ts_frame_parser.h"
+
+static const uint8_t good[][4] =
+{
+  { 0x47, 0x41, 0x00, 0x10 }, // Payload only, payload start
+  { 0x47, 0x01, 0x00, 0x3f }, // Adaptation field and payload
+  { 0x47, 0x1f, 0xff, 0x10 }, // Null packet
+};
+
+static const uint8_t bad[][4] =
+{
+  { 0x00, 0x00, 0x00, 0x00 }, // null header
+  { 0x47, 0x41, 0x00, 0x00 }, // reserved adaptation_field_control
+};
+
+BOOST_AUTO_TEST_SUITE(ts_frame_parser)
+
+BOOST_AUTO_TEST_CASE(can_parse)
+{
+  TSFrameParser parser;
+  BOOST_CHECK(parser.can_parse(FORMAT_MPEGTS));
+}
+
+BOOST_AUTO_TEST_CASE(sync_info)
+{
+  SyncInfo sinfo = TSFrameParser().sync_info();
+
+  for (int i = 0; i < array_size(good); i++)
+    BOOST_CHECK(sinfo.sync_trie.is_sync(good[i]));
+}
+
+BOOST_AUTO_TEST_CASE(parse_header)
+{
+  FrameInfo finfo;
+  TSFrameParser parser;
+
+  for (int i = 0; i < array_size(good); i++)
+  {
+    BOOST_CHECK_MESSAGE(parser.parse_header(good[i], &finfo), "good header N" << i);
+    BOOST_CHECK(finfo.spk == Speakers(FORMAT_MPEGTS, 0, 0));
+  }
+
+  for (int i = 0; i < array_size(bad); i++)
+    BOOST_CHECK_MESSAGE(!parser.parse_header(bad[i]), "bad header N" << i);
+}
+
+BOOST_AUTO_TEST_CASE(packet_size)
+{
+  // Only 188, 192 and 204 byte packets are allowed
+  uint8_t packet[256];
+  memset(packet, 0, sizeof(packet));
+  memcpy(packet, good[0], 4);
+
+  TSFrameParser parser;
+  BOOST_CHECK(parser.first_frame(packet, 188));
+  BOOST_CHECK_EQUAL(parser.sync_info2().min_frame_size, 188);
+  BOOST_CHECK_EQUAL(parser.sync_info2().max_frame_size, 188);
+  BOOST_CHECK(parser.next_frame(packet, 188));
+  BOOST_CHECK(!parser.next_frame(packet, 192));
+
+  BOOST_CHECK(parser.first_frame(packet, 192));
+  BOOST_CHECK(parser.first_frame(packet, 204));
+  BOOST_CHECK(!parser.first_frame(packet, 190));
+  BOOST_CHECK(!parser.first_frame(packet, 256));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,159 @@
+/*
+  TSParser test
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "parsers/pes/pes_frame_parser.h"
+#include "parsers/ts/ts_frame_parser.h"
+#include "parsers/ts/ts_header.h"
+#include "parsers/ts/ts_parser.h"
+#include "source/file_parser.h"
+#include "source/raw_source.h"
+#include "../../../suite.h"
+
+static const char *temp_file = "temp.ts";
+static const int test_pid = 0x100;
+static const int other_pid = 0x200;
+
+static void write_packet(AutoFile &f, size_t packet_size, int pid, int &continuity, bool start, const uint8_t *payload, size_t payload_size)
+{
+  uint8_t buf[204];
+  memset(buf, 0, sizeof(buf));
+
+  // BDAV timecode before the packet
+  uint8_t *packet = buf;
+  if (packet_size == 192)
+    packet += 4;
+
+  packet[0] = 0x47;
+  packet[1] = uint8_t((start? 0x40: 0) | (pid >> 8));
+  packet[2] = uint8_t(pid & 0xff);
+  packet[3] = uint8_t(0x10 | continuity);
+  continuity = (continuity + 1) & 15;
+
+  // Adaptation field stuffing
+  size_t pos = 4;
+  if (payload_size < 184)
+  {
+    size_t adaptation_size = 184 - payload_size;
+    packet[3] |= 0x20;
+    packet[4] = uint8_t(adaptation_size - 1);
+    if (adaptation_size > 1)
+      memset(packet + 6, 0xff, adaptation_size - 2);
+    pos += adaptation_size;
+  }
+
+  memcpy(packet + pos, payload, payload_size);
+  f.write(buf, packet_size);
+}
+
+// Wrap PES stream into the transport stream of the given packet size.
+// Each PES packet is split into the packets of test_pid, followed by a null
+// packet and a packet of other_pid. With 'unbounded' set PES packet length is
+// zeroed.
+static void make_ts(const char *pes_filename, size_t packet_size, bool unbounded = false)
+{
+  FileParser f;
+  PESFrameParser frame_parser;
+  BOOST_REQUIRE(f.open(pes_filename, &frame_parser));
+
+  AutoFile ts(temp_file, "wb");
+  BOOST_REQUIRE(ts.is_open());
+
+  uint8_t filler[184];
+  memset(filler, 0x47, sizeof(filler));
+
+  int continuity = 0;
+  int other_continuity = 0;
+  int null_continuity = 0;
+  Rawdata pes(65536 + 6);
+
+  Chunk chunk;
+  while (f.get_chunk(chunk))
+  {
+    // Skip pack and system headers
+    if (chunk.rawdata[3] == 0xba || chunk.rawdata[3] == 0xbb)
+      continue;
+
+    memcpy(pes, chunk.rawdata, chunk.size);
+    if (unbounded)
+      pes[4] = pes[5] = 0;
+
+    for (size_t pos = 0; pos < chunk.size; pos += 184)
+      write_packet(ts, packet_size, test_pid, continuity, pos == 0, pes + pos, MIN(chunk.size - pos, size_t(184)));
+
+    write_packet(ts, packet_size, TS_NULL_PID, null_continuity, false, filler, 184);
+    write_packet(ts, packet_size, other_pid, other_continuity, false, filler, 184);
+  }
+}
+
+static void compare_file(const char *pes_filename, const char *raw_filename, size_t packet_size, bool unbounded = false)
+{
+  BOOST_MESSAGE("Transform " << pes_filename << " -> TS" << packet_size << " -> " << raw_filename);
+  make_ts(pes_filename, packet_size, unbounded);
+
+  FileParser f_test;
+  TSFrameParser test_frame_parser;
+  f_test.open_probe(temp_file, &test_frame_parser);
+  BOOST_REQUIRE(f_test.is_open());
+
+  RAWSource f_raw(Speakers(FORMAT_RAWDATA, 0, 0), raw_filename);
+  BOOST_REQUIRE(f_raw.is_open());
+
+  TSParser test_parser;
+  compare(&f_test, &test_parser, &f_raw, 0);
+  BOOST_CHECK_EQUAL(test_parser.get_stream_pid(), test_pid);
+}
+
+BOOST_AUTO_TEST_SUITE(ts_parser)
+
+BOOST_AUTO_TEST_CASE(constructor)
+{
+  TSParser ts;
+  BOOST_CHECK_EQUAL(ts.get_pid(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(parse)
+{
+  compare_file("a.mp2.005.pes", "a.mp2.005.mp2", 188);
+  compare_file("a.mp2.mix.pes", "a.mp2.mix.mp2", 188);
+  compare_file("a.ac3.03f.pes", "a.ac3.03f.ac3", 188);
+  compare_file("a.ac3.03f.pes", "a.ac3.03f.ac3", 192);
+  compare_file("a.ac3.03f.pes", "a.ac3.03f.ac3", 204);
+  compare_file("a.ac3.03f.pes", "a.ac3.03f.ac3", 188, true);
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(select_pid)
+{
+  make_ts("a.ac3.03f.pes", 188);
+
+  FileParser f;
+  TSFrameParser frame_parser;
+  BOOST_REQUIRE(f.open_probe(temp_file, &frame_parser));
+
+  TSParser parser(other_pid);
+  BOOST_REQUIRE(parser.open(f.get_output()));
+
+  // Stream at other_pid is not a PES stream, so nothing is demuxed
+  Chunk chunk, out;
+  while (f.get_chunk(chunk))
+    BOOST_CHECK(!parser.process(chunk, out));
+
+  // Selecting test_pid demuxes the stream
+  int frames = 0;
+  parser.set_pid(test_pid);
+  f.seek(0);
+  while (f.get_chunk(chunk))
+    while (parser.process(chunk, out))
+      frames++;
+
+  BOOST_CHECK(frames > 0);
+  BOOST_CHECK_EQUAL(parser.get_stream_pid(), test_pid);
+  BOOST_CHECK(parser.get_output().format == FORMAT_AC3);
+
+  f.close();
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,137 @@
+/*
+  MeasureSink class test
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "source/generator.h"
+#include "sink/sink_measure.h"
+
+static const Speakers spk_linear(FORMAT_LINEAR, MODE_STEREO, 48000);
+static const Speakers spk_pcm(FORMAT_PCM16, MODE_STEREO, 48000);
+
+BOOST_AUTO_TEST_SUITE(measure_sink)
+
+BOOST_AUTO_TEST_CASE(size_class)
+{
+  BOOST_CHECK_EQUAL(MeasureSink::get_size_class(0), 0);
+  BOOST_CHECK_EQUAL(MeasureSink::get_size_class(1), 1);
+  BOOST_CHECK_EQUAL(MeasureSink::get_size_class(2), 2);
+  BOOST_CHECK_EQUAL(MeasureSink::get_size_class(3), 2);
+  BOOST_CHECK_EQUAL(MeasureSink::get_size_class(1024), 11);
+  BOOST_CHECK_EQUAL(MeasureSink::get_size_class(2047), 11);
+
+  // Large sizes (64-bit) go to the last class
+  BOOST_CHECK_EQUAL(MeasureSink::get_size_class(~size_t(0)), MeasureSink::size_classes - 1);
+}
+
+BOOST_AUTO_TEST_CASE(amount)
+{
+  uint8_t buf[4096];
+  samples_t samples;
+
+  MeasureSink sink;
+  BOOST_CHECK_EQUAL(sink.get_chunks(), 0);
+
+  // Linear: samples only
+  sink.open_throw(spk_linear);
+  sink.process(Chunk(samples, 480));
+  sink.process(Chunk(samples, 1000));
+  sink.process(Chunk());
+  BOOST_CHECK_EQUAL(sink.get_chunks(), 3);
+  BOOST_CHECK_EQUAL(sink.get_bytes(), 0);
+  BOOST_CHECK_EQUAL(sink.get_samples(), 1480);
+  BOOST_CHECK_EQUAL(sink.get_size_hist(0), 1);
+  BOOST_CHECK_EQUAL(sink.get_size_hist(9), 1);
+  BOOST_CHECK_EQUAL(sink.get_size_hist(10), 1);
+  BOOST_CHECK_EQUAL(sink.get_min_chunk(), 0);
+  BOOST_CHECK_EQUAL(sink.get_max_chunk(), 1000);
+
+  // PCM: bytes and samples
+  sink.open_throw(spk_pcm);
+  sink.process(Chunk(buf, 4096));
+  BOOST_CHECK_EQUAL(sink.get_bytes(), 4096);
+  BOOST_CHECK_EQUAL(sink.get_samples(), 1480 + 1024);
+  BOOST_CHECK_CLOSE(sink.get_duration(), 2504.0 / 48000, 1e-6);
+
+  // Rawdata: bytes only
+  sink.open_throw(Speakers(FORMAT_AC3, MODE_STEREO, 48000));
+  sink.process(Chunk(buf, 100));
+  BOOST_CHECK_EQUAL(sink.get_bytes(), 4196);
+  BOOST_CHECK_EQUAL(sink.get_samples(), 1480 + 1024);
+  BOOST_CHECK_EQUAL(sink.get_chunks(), 5);
+
+  sink.reset_stats();
+  BOOST_CHECK_EQUAL(sink.get_chunks(), 0);
+  BOOST_CHECK_EQUAL(sink.get_bytes(), 0);
+  BOOST_CHECK_EQUAL(sink.get_samples(), 0);
+  BOOST_CHECK_EQUAL(sink.get_size_hist(0), 0);
+}
+
+BOOST_AUTO_TEST_CASE(continuity)
+{
+  samples_t samples;
+  MeasureSink sink;
+  sink.open_throw(spk_linear);
+
+  // 10ms chunks
+  sink.process(Chunk(samples, 480, true, 0));
+  sink.process(Chunk(samples, 480, true, 0.01));
+  BOOST_CHECK_EQUAL(sink.get_gaps(), 0);
+  BOOST_CHECK_EQUAL(sink.get_overlaps(), 0);
+
+  // Chunk without timestamp
+  sink.process(Chunk(samples, 480));
+
+  // 10ms gap
+  sink.process(Chunk(samples, 480, true, 0.04));
+  BOOST_CHECK_EQUAL(sink.get_gaps(), 1);
+  BOOST_CHECK_CLOSE(sink.get_gap_time(), 0.01, 1e-6);
+
+  // 5ms overlap
+  sink.process(Chunk(samples, 480, true, 0.045));
+  BOOST_CHECK_EQUAL(sink.get_overlaps(), 1);
+  BOOST_CHECK_CLOSE(sink.get_overlap_time(), 0.005, 1e-6);
+
+  // Jitter within the tolerance
+  sink.process(Chunk(samples, 480, true, 0.0555));
+  BOOST_CHECK_EQUAL(sink.get_gaps(), 1);
+  BOOST_CHECK_EQUAL(sink.get_overlaps(), 1);
+  BOOST_CHECK_EQUAL(sink.get_timestamps(), 5);
+  BOOST_CHECK_CLOSE(sink.get_max_jitter(), 0.01, 1e-6);
+  BOOST_CHECK(sink.get_jitter() > 0.005 && sink.get_jitter() < 0.01);
+
+  // Reset starts a new reference
+  sink.reset();
+  sink.process(Chunk(samples, 480, true, 10));
+  BOOST_CHECK_EQUAL(sink.get_gaps(), 1);
+  BOOST_CHECK_EQUAL(sink.get_overlaps(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(latency)
+{
+  NoiseGen gen(spk_pcm, 4796, 48000 * 4, 4096);
+  StampSource src(&gen);
+
+  MeasureSink sink;
+  sink.set_latency(true);
+  sink.open_throw(src.get_output());
+
+  Chunk chunk;
+  while (src.get_chunk(chunk))
+    sink.process(chunk);
+
+  BOOST_CHECK_EQUAL(sink.get_bytes(), 48000 * 4);
+  BOOST_CHECK_EQUAL(sink.get_samples(), 48000);
+  BOOST_CHECK_EQUAL(sink.get_latency_count(), sink.get_chunks());
+  BOOST_CHECK(sink.get_min_latency() >= 0);
+  BOOST_CHECK(sink.get_max_latency() < 0.1);
+  BOOST_CHECK_EQUAL(sink.get_gaps(), 0);
+  BOOST_CHECK_EQUAL(sink.get_overlaps(), 0);
+  BOOST_CHECK(sink.get_elapsed() >= 0);
+
+  string report = sink.report();
+  BOOST_CHECK(report.find("Latency:") != string::npos);
+  BOOST_CHECK(report.find("Samples: 48000") != string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
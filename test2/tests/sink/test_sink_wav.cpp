@@ -134,4 +134,44 @@ BOOST_AUTO_TEST_CASE(process)
   BOOST_CHECK(memcmp(f, file_data, f.size()) == 0);
 }
 
+BOOST_AUTO_TEST_CASE(process_segments)
+{
+  // Sample 1 and zero padding instead of sample 2
+  ChunkSegment segments[] = { { data, 4 }, { 0, 4 } };
+  Chunk chunk;
+  chunk.set_segments(segments, array_size(segments));
+  BOOST_CHECK_EQUAL(chunk.size, array_size(data));
+
+  TempFilename tmp;
+  WAVSink sink(tmp.c_str());
+  sink.open(spk1);
+  sink.process(chunk);
+  sink.close_file();
+
+  uint8_t ref[array_size(file_data)];
+  memcpy(ref, file_data, sizeof(ref));
+  memset(ref + sizeof(ref) - 4, 0, 4);
+
+  MemFile f(tmp.c_str());
+  BOOST_REQUIRE_EQUAL(f.size(), array_size(file_data));
+  BOOST_CHECK(memcmp(f, ref, f.size()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(write_behind)
+{
+  // Tiny buffers to force the header rewrite after many buffers written
+  TempFilename tmp;
+  WAVSink sink;
+  sink.set_write_behind(2, 3);
+  BOOST_CHECK_EQUAL(sink.get_write_behind(), 2);
+  BOOST_REQUIRE(sink.open_file(tmp.c_str()));
+  sink.open(spk1);
+  sink.process(Chunk(data, array_size(data)));
+  sink.close_file();
+
+  MemFile f(tmp.c_str());
+  BOOST_REQUIRE_EQUAL(f.size(), array_size(file_data));
+  BOOST_CHECK(memcmp(f, file_data, f.size()) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -2,13 +2,50 @@
   FileParser class test
 */
 
+#include <vector>
 #include <boost/test/unit_test.hpp>
 #include "parsers/ac3/ac3_header.h"
 #include "parsers/dts/dts_header.h"
 #include "source/file_parser.h"
 #include "source/raw_source.h"
+#include "rng.h"
+#include "win32/thread.h"
+#include "../../noise_buf.h"
 #include "../../suite.h"
 
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Copies a file into a pipe
+class PipeWriter : public Thread
+{
+public:
+  string filename;
+  string pipename;
+
+  PipeWriter(const string &filename_, const string &pipename_):
+  filename(filename_), pipename(pipename_)
+  {}
+
+protected:
+  virtual DWORD process()
+  {
+    AutoFile in(filename.c_str());
+    AutoFile out(pipename.c_str(), "wb");
+    if (!in.is_open() || !out.is_open())
+      return 1;
+
+    uint8_t buf[4096];
+    while (size_t size = in.read(buf, sizeof(buf)))
+      if (out.write(buf, size) != size)
+        return 1;
+    return 0;
+  }
+};
+#endif
+
 BOOST_AUTO_TEST_SUITE(file_parser)
 
 BOOST_AUTO_TEST_CASE(constructor)
@@ -260,6 +297,244 @@ BOOST_AUTO_TEST_CASE(open_probe_passthrough)
   compare(&f, &raw);
 }
 
+// Read frames with read-ahead and compare with raw file
+BOOST_AUTO_TEST_CASE(read_ahead_passthrough)
+{
+  bool result;
+  const string filename = "a.ac3.03f.ac3";
+  AC3FrameParser frame_parser;
+  const struct { int depth; size_t buf_size; } read_ahead[] = {
+    { 2, 1000 }, { 3, 4096 }, { 8, 65536 }
+  };
+
+  for (size_t i = 0; i < array_size(read_ahead); i++)
+  {
+    FileParser f;
+    RAWSource raw;
+
+    f.set_read_ahead(read_ahead[i].depth, read_ahead[i].buf_size);
+    BOOST_CHECK_EQUAL(f.get_read_ahead(), read_ahead[i].depth);
+
+    result = f.open(filename, &frame_parser);
+    BOOST_REQUIRE(result);
+
+    result = raw.open(Speakers(FORMAT_RAWDATA, 0, 0), filename.c_str());
+    BOOST_REQUIRE(result);
+
+    compare(&f, &raw);
+    BOOST_CHECK(f.eof());
+
+    // Seek cancels the read-ahead and restarts at the new position
+    f.seek(0.5, FileParser::relative);
+    BOOST_CHECK_EQUAL(f.get_pos(), f.get_size() / 2);
+    BOOST_CHECK(f.probe());
+    BOOST_CHECK(f.get_pos() > f.get_size() / 2);
+
+    f.seek(0);
+    raw.seek(0);
+    compare(&f, &raw);
+  }
+
+  // Depth less than 2 disables the read-ahead
+  FileParser f;
+  f.set_read_ahead(1);
+  BOOST_CHECK_EQUAL(f.get_read_ahead(), 0);
+}
+
+// Files that cannot be mapped (pipes, devices) are read through a buffer
+BOOST_AUTO_TEST_CASE(not_mapped)
+{
+#ifdef _WIN32
+  const char *device = "NUL";
+#else
+  const char *device = "/dev/null";
+#endif
+  AC3FrameParser frame_parser;
+  FileParser f;
+
+  BOOST_CHECK(f.open(device, &frame_parser));
+  BOOST_CHECK(f.is_open());
+  BOOST_CHECK(!f.probe());
+  BOOST_CHECK(f.eof());
+  f.close();
+  BOOST_CHECK(!f.is_open());
+
+#ifndef _WIN32
+  // Read frames from a pipe and compare with raw file
+  const string filename = "a.ac3.03f.ac3";
+  const string pipename = "file_parser.fifo";
+  RAWSource raw;
+
+  unlink(pipename.c_str());
+  BOOST_REQUIRE(mkfifo(pipename.c_str(), 0600) == 0);
+
+  PipeWriter writer(filename, pipename);
+  BOOST_REQUIRE(writer.create(false));
+
+  BOOST_CHECK(f.open(pipename, &frame_parser));
+  BOOST_CHECK(raw.open(Speakers(FORMAT_RAWDATA, 0, 0), filename.c_str()));
+  if (f.is_open() && raw.is_open())
+  {
+    compare(&f, &raw);
+    BOOST_CHECK(f.eof());
+  }
+  f.close();
+
+  writer.terminate(10000);
+  unlink(pipename.c_str());
+#endif
+}
+
+// Build the index, seek exactly to frames and timestamps
+BOOST_AUTO_TEST_CASE(index)
+{
+  bool result;
+  Chunk chunk;
+  const string filename = "a.ac3.03f.ac3";
+  const char *index_filename = "temp.tmp";
+  const int interval = 7;
+  AC3FrameParser frame_parser;
+
+  FileParser f;
+  result = f.open(filename, &frame_parser);
+  BOOST_REQUIRE(result);
+
+  // Reference frame positions and timestamps
+  std::vector<FileParser::fsize_t> frame_pos;
+  std::vector<vtime_t> frame_time;
+  vtime_t time = 0;
+  while (f.get_chunk(chunk))
+  {
+    frame_pos.push_back(f.get_frame_pos());
+    frame_time.push_back(time);
+    time += vtime_t(f.frame_info().nsamples) / f.get_output().sample_rate;
+  }
+  BOOST_REQUIRE(frame_pos.size() > 0);
+
+  // Build the index. Position does not change.
+  f.seek(1000);
+  result = f.build_index(interval);
+  BOOST_REQUIRE(result);
+  BOOST_CHECK_EQUAL(f.get_pos(), 1000);
+
+  const FrameIndex &index = f.get_index();
+  BOOST_CHECK_EQUAL(index.get_frames(), frame_pos.size());
+  BOOST_CHECK_CLOSE(index.get_duration(), time, 1e-6);
+  BOOST_CHECK_EQUAL(index.get_file_size(), f.get_size());
+  for (size_t i = 0; i < index.size(); i++)
+  {
+    BOOST_CHECK_EQUAL(index[i].pos, frame_pos[i * interval]);
+    BOOST_CHECK_CLOSE(index[i].time, frame_time[i * interval], 1e-6);
+  }
+
+  // Exact seek
+  RNG rng(2987534);
+  for (int i = 0; i < 100; i++)
+  {
+    size_t frame = rng.get_range((uint32_t)frame_pos.size() - 1);
+    f.seek(double(frame), FileParser::frames);
+    BOOST_REQUIRE(f.get_chunk(chunk));
+    BOOST_CHECK(f.new_stream());
+    BOOST_CHECK_EQUAL(f.get_frame_pos(), frame_pos[frame]);
+
+    f.seek(frame_time[frame] + 0.001, FileParser::time);
+    BOOST_REQUIRE(f.get_chunk(chunk));
+    BOOST_CHECK_EQUAL(f.get_frame_pos(), frame_pos[frame]);
+  }
+
+  // Seek after the end
+  f.seek(double(frame_pos.size()), FileParser::frames);
+  BOOST_CHECK(!f.get_chunk(chunk));
+
+  // Save and load the index
+  result = f.save_index(index_filename);
+  BOOST_REQUIRE(result);
+
+  FileParser f2;
+  result = f2.open(filename, &frame_parser);
+  BOOST_REQUIRE(result);
+  result = f2.load_index(index_filename);
+  BOOST_REQUIRE(result);
+  BOOST_CHECK_EQUAL(f2.get_index().size(), index.size());
+  BOOST_CHECK_EQUAL(f2.get_size(FileParser::frames), double(frame_pos.size()));
+
+  f2.seek(10, FileParser::frames);
+  BOOST_REQUIRE(f2.get_chunk(chunk));
+  BOOST_CHECK_EQUAL(f2.get_frame_pos(), frame_pos[10]);
+
+  // Index of another file is not loaded
+  f2.close();
+  result = f2.open("a.mad.mix.mad", &frame_parser);
+  BOOST_REQUIRE(result);
+  result = f2.load_index(index_filename);
+  BOOST_CHECK(!result);
+  BOOST_CHECK(f2.get_index().is_empty());
+
+  AutoFile::remove(index_filename);
+}
+
+// Header walk finds the same frames as get_chunk(), with and without
+// read-ahead. Junk in the middle of the file is passed with the sync search.
+BOOST_AUTO_TEST_CASE(scan_frame)
+{
+  bool result;
+  Chunk chunk;
+  const char *temp_filename = "temp.tmp";
+  const size_t junk_size = 1000;
+  AC3FrameParser frame_parser;
+
+  MemFile ac3("a.ac3.03f.ac3");
+  BOOST_REQUIRE(ac3);
+  RawNoise junk(junk_size, 93845);
+  {
+    AutoFile temp(temp_filename, "wb");
+    BOOST_REQUIRE(temp.is_open());
+    temp.write(ac3, ac3.size() / 2);
+    temp.write(junk, junk.size());
+    temp.write(ac3 + ac3.size() / 2, ac3.size() - ac3.size() / 2);
+  }
+
+  const int read_ahead[] = { 0, 4 };
+  for (int i = 0; i < array_size(read_ahead); i++)
+  {
+    FileParser f;
+    f.set_read_ahead(read_ahead[i], 4096);
+    result = f.open(temp_filename, &frame_parser);
+    BOOST_REQUIRE(result);
+
+    std::vector<FileParser::fsize_t> frame_pos;
+    std::vector<FrameInfo> frame_info;
+    while (f.get_chunk(chunk))
+    {
+      frame_pos.push_back(f.get_frame_pos());
+      frame_info.push_back(f.frame_info());
+    }
+    BOOST_REQUIRE(frame_pos.size() > 0);
+
+    f.seek(0);
+    size_t n = 0;
+    FrameInfo finfo;
+    FileParser::fsize_t pos;
+    while (f.scan_frame(finfo, pos))
+    {
+      BOOST_REQUIRE(n < frame_pos.size());
+      BOOST_CHECK_EQUAL(pos, frame_pos[n]);
+      BOOST_CHECK(finfo.spk == frame_info[n].spk);
+      BOOST_CHECK_EQUAL(finfo.nsamples, frame_info[n].nsamples);
+      BOOST_CHECK_EQUAL(finfo.bitrate(), frame_info[n].bitrate());
+      n++;
+    }
+    BOOST_CHECK_EQUAL(n, frame_pos.size());
+
+    // Frames after the scan
+    f.seek(0);
+    BOOST_CHECK(f.get_chunk(chunk));
+    BOOST_CHECK_EQUAL(f.get_frame_pos(), frame_pos[0]);
+  }
+
+  AutoFile::remove(temp_filename);
+}
+
 BOOST_AUTO_TEST_CASE(format_change)
 {
   bool result;
@@ -0,0 +1,113 @@
+/*
+  FileScanner class test
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "parsers/ac3/ac3_header.h"
+#include "parsers/uni/uni_frame_parser.h"
+#include "source/file_scan.h"
+
+static void check_equal(const ScanInfo &info, const ScanInfo &ref)
+{
+  BOOST_CHECK_EQUAL(info.ok, ref.ok);
+  BOOST_CHECK_EQUAL(info.file_size, ref.file_size);
+  BOOST_CHECK_EQUAL(info.frames, ref.frames);
+  BOOST_CHECK_EQUAL(info.duration, ref.duration);
+  BOOST_CHECK_EQUAL(info.frame_bytes, ref.frame_bytes);
+  BOOST_CHECK_EQUAL(info.min_bitrate, ref.min_bitrate);
+  BOOST_CHECK_EQUAL(info.max_bitrate, ref.max_bitrate);
+  BOOST_CHECK_EQUAL(info.streams.size(), ref.streams.size());
+}
+
+BOOST_AUTO_TEST_SUITE(file_scan)
+
+BOOST_AUTO_TEST_CASE(scan_file)
+{
+  const string filename = "a.ac3.03f.ac3";
+  AC3FrameParser frame_parser;
+  ScanInfo info;
+
+  BOOST_CHECK(!FileScanner::scan_file("no-such-file", &frame_parser, info));
+  BOOST_CHECK(!info.ok);
+  BOOST_CHECK(info.streams.empty());
+
+  // Reference: walk all frames
+  FileParser f;
+  BOOST_REQUIRE(f.open(filename, &frame_parser));
+
+  Chunk chunk;
+  int64_t frames = 0;
+  uint64_t frame_bytes = 0;
+  vtime_t duration = 0;
+  while (f.get_chunk(chunk))
+  {
+    frames++;
+    frame_bytes += chunk.size;
+    duration += vtime_t(f.frame_info().nsamples) / f.get_output().sample_rate;
+  }
+  f.close();
+
+  BOOST_REQUIRE(FileScanner::scan_file(filename, &frame_parser, info));
+  BOOST_CHECK(info.ok);
+  BOOST_CHECK_EQUAL(info.frames, frames);
+  BOOST_CHECK_EQUAL(info.frame_bytes, frame_bytes);
+  BOOST_CHECK_CLOSE(info.duration, duration, 1e-6);
+  BOOST_CHECK(info.min_bitrate > 0);
+  BOOST_CHECK(info.min_bitrate <= info.avg_bitrate() + 1);
+  BOOST_CHECK(info.max_bitrate + 1 >= info.avg_bitrate());
+
+  BOOST_REQUIRE_EQUAL(info.streams.size(), 1);
+  BOOST_CHECK_EQUAL(info.streams[0].pos, 0);
+  BOOST_CHECK_EQUAL(info.streams[0].frames, frames);
+}
+
+BOOST_AUTO_TEST_CASE(format_change)
+{
+  AC3FrameParser frame_parser;
+  struct {
+    Speakers spk;
+    int64_t frames;
+  } streams[] = {
+    { Speakers(FORMAT_AC3, MODE_5_1, 48000), 750 },
+    { Speakers(FORMAT_AC3, MODE_STEREO, 48000), 375 },
+    { Speakers(FORMAT_AC3, MODE_5_1, 48000), 375 },
+  };
+
+  ScanInfo info;
+  BOOST_REQUIRE(FileScanner::scan_file("a.ac3.mix.ac3", &frame_parser, info));
+  BOOST_REQUIRE_EQUAL(info.streams.size(), array_size(streams));
+  for (size_t i = 0; i < array_size(streams); i++)
+  {
+    BOOST_CHECK(info.streams[i].spk == streams[i].spk);
+    BOOST_CHECK_EQUAL(info.streams[i].frames, streams[i].frames);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(scan_files)
+{
+  const int nparsers = 3;
+  UniFrameParser parser[nparsers];
+  FrameParser *parsers[nparsers] = { parser, parser + 1, parser + 2 };
+
+  std::vector<string> files;
+  files.push_back("a.ac3.03f.ac3");
+  files.push_back("a.ac3.mix.ac3");
+  files.push_back("no-such-file");
+  files.push_back("a.mad.mix.mad");
+  files.push_back("a.mad.mix.spdif");
+
+  std::vector<ScanInfo> ref(files.size());
+  for (size_t i = 0; i < files.size(); i++)
+    FileScanner::scan_file(files[i], parser, ref[i]);
+
+  for (int n = 1; n <= nparsers; n++)
+  {
+    std::vector<ScanInfo> info;
+    FileScanner::scan_files(files, parsers, n, info);
+    BOOST_REQUIRE_EQUAL(info.size(), files.size());
+    for (size_t i = 0; i < files.size(); i++)
+      check_equal(info[i], ref[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,105 @@
+/*
+  FrameIndex class test
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "source/frame_index.h"
+
+static const char *temp_file = "temp.tmp";
+
+// Index with 'frames' frames of 100 bytes and 0.5 sec each
+static void make_index(FrameIndex &index, int interval, int frames)
+{
+  index.init(interval, frames * 100);
+  for (int i = 0; i < frames; i++)
+    index.add_frame(i * 100, 0.5);
+}
+
+BOOST_AUTO_TEST_SUITE(frame_index)
+
+BOOST_AUTO_TEST_CASE(constructor)
+{
+  FrameIndex index;
+  BOOST_CHECK(index.is_empty());
+  BOOST_CHECK_EQUAL(index.size(), 0);
+  BOOST_CHECK_EQUAL(index.get_frames(), 0);
+  BOOST_CHECK_EQUAL(index.get_duration(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(build)
+{
+  FrameIndex index;
+  make_index(index, 4, 10);
+
+  BOOST_CHECK_EQUAL(index.size(), 3);
+  BOOST_CHECK_EQUAL(index.get_interval(), 4);
+  BOOST_CHECK_EQUAL(index.get_frames(), 10);
+  BOOST_CHECK_EQUAL(index.get_duration(), 5.0);
+  BOOST_CHECK_EQUAL(index.get_file_size(), 1000);
+
+  for (size_t i = 0; i < index.size(); i++)
+  {
+    BOOST_CHECK_EQUAL(index.entry_frame(i), int64_t(i * 4));
+    BOOST_CHECK_EQUAL(index[i].pos, int64_t(i * 400));
+    BOOST_CHECK_EQUAL(index[i].time, i * 2.0);
+  }
+
+  index.clear();
+  BOOST_CHECK(index.is_empty());
+  BOOST_CHECK_EQUAL(index.get_frames(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(find)
+{
+  FrameIndex index;
+  make_index(index, 4, 10);
+
+  BOOST_CHECK_EQUAL(index.find_frame(-1), 0);
+  BOOST_CHECK_EQUAL(index.find_frame(0), 0);
+  BOOST_CHECK_EQUAL(index.find_frame(3), 0);
+  BOOST_CHECK_EQUAL(index.find_frame(4), 1);
+  BOOST_CHECK_EQUAL(index.find_frame(9), 2);
+  BOOST_CHECK_EQUAL(index.find_frame(100), 2);
+
+  BOOST_CHECK_EQUAL(index.find_time(-1.0), 0);
+  BOOST_CHECK_EQUAL(index.find_time(0.0), 0);
+  BOOST_CHECK_EQUAL(index.find_time(1.9), 0);
+  BOOST_CHECK_EQUAL(index.find_time(2.0), 1);
+  BOOST_CHECK_EQUAL(index.find_time(3.9), 1);
+  BOOST_CHECK_EQUAL(index.find_time(100.0), 2);
+}
+
+BOOST_AUTO_TEST_CASE(save_load)
+{
+  FrameIndex index, loaded;
+  make_index(index, 3, 100);
+
+  BOOST_REQUIRE(index.save(temp_file));
+  BOOST_REQUIRE(loaded.load(temp_file));
+
+  BOOST_CHECK_EQUAL(loaded.size(), index.size());
+  BOOST_CHECK_EQUAL(loaded.get_interval(), index.get_interval());
+  BOOST_CHECK_EQUAL(loaded.get_frames(), index.get_frames());
+  BOOST_CHECK_EQUAL(loaded.get_duration(), index.get_duration());
+  BOOST_CHECK_EQUAL(loaded.get_file_size(), index.get_file_size());
+  for (size_t i = 0; i < index.size(); i++)
+  {
+    BOOST_CHECK_EQUAL(loaded[i].pos, index[i].pos);
+    BOOST_CHECK_EQUAL(loaded[i].time, index[i].time);
+  }
+
+  // Truncated index file
+  {
+    AutoFile f(temp_file, "wb");
+    f.write("VIDX", 4);
+  }
+  BOOST_CHECK(!loaded.load(temp_file));
+  BOOST_CHECK(loaded.is_empty());
+
+  // No index file
+  AutoFile::remove(temp_file);
+  BOOST_CHECK(!loaded.load(temp_file));
+  BOOST_CHECK(loaded.is_empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
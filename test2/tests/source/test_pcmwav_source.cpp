@@ -6,6 +6,8 @@
 #include "filters/gain.h"
 #include "source/pcmwav_source.h"
 #include "source/generator.h"
+#include "source/raw_source.h"
+#include "source/wav_source.h"
 #include "sink/sink_pcmwav.h"
 #include "../../suite.h"
 #include "../../temp_filename.h"
@@ -132,4 +134,59 @@ BOOST_AUTO_TEST_CASE(get_data)
   read_write_test(FORMAT_PCMDOUBLE);
 }
 
+BOOST_AUTO_TEST_CASE(exact_time)
+{
+  // Sources time stamp the first chunk after open and seek with the sample
+  // count. PcmWavSource passes the time stamp through the converter.
+  const Speakers noise_spk(FORMAT_LINEAR, MODE_STEREO, 48000, 32767.5);
+  const size_t block = 4; // PCM16 stereo sample
+  const size_t seek_samples = 1000;
+
+  TempFilename temp;
+  NoiseGen noise(noise_spk, seed, noise_samples);
+  PcmWavSink sink(temp.c_str(), FORMAT_PCM16);
+  sink.open(noise_spk);
+  BOOST_REQUIRE(sink.is_open());
+  Chunk chunk;
+  while (noise.get_chunk(chunk))
+    sink.process(chunk);
+  sink.flush();
+  sink.close_file();
+
+  WAVSource wav(temp.c_str(), 512);
+  BOOST_REQUIRE(wav.is_open());
+  BOOST_REQUIRE(wav.get_chunk(chunk));
+  BOOST_CHECK(chunk.sync);
+  BOOST_CHECK(chunk.exact_time == ExactTime(0, 48000));
+  BOOST_REQUIRE(wav.get_chunk(chunk));
+  BOOST_CHECK(!chunk.sync);
+
+  BOOST_CHECK_EQUAL(wav.seek(seek_samples * block), 0);
+  BOOST_REQUIRE(wav.get_chunk(chunk));
+  BOOST_CHECK(chunk.sync);
+  BOOST_CHECK(chunk.exact_time == ExactTime(seek_samples, 48000));
+
+  wav.reset();
+  BOOST_REQUIRE(wav.get_chunk(chunk));
+  BOOST_CHECK(chunk.exact_time == ExactTime(0, 48000));
+
+  // Raw source counts samples from the start of the file
+  RAWSource raw(Speakers(FORMAT_PCM16, MODE_STEREO, 48000), temp.c_str(), 512);
+  BOOST_REQUIRE(raw.is_open());
+  BOOST_REQUIRE(raw.get_chunk(chunk));
+  BOOST_CHECK(chunk.exact_time == ExactTime(0, 48000));
+  BOOST_CHECK_EQUAL(raw.seek(seek_samples * block), 0);
+  BOOST_REQUIRE(raw.get_chunk(chunk));
+  BOOST_CHECK(chunk.sync);
+  BOOST_CHECK(chunk.exact_time == ExactTime(seek_samples, 48000));
+  BOOST_REQUIRE(raw.get_chunk(chunk));
+  BOOST_CHECK(!chunk.sync);
+  raw.close();
+
+  PcmWavSource source(temp.c_str());
+  BOOST_REQUIRE(source.get_chunk(chunk));
+  BOOST_CHECK(chunk.sync);
+  BOOST_CHECK(chunk.exact_time == ExactTime(0, 48000));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
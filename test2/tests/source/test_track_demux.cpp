@@ -0,0 +1,280 @@
+/*
+  TrackDemux class test
+*/
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include "filters/decoder_graph.h"
+#include "source/raw_source.h"
+#include "source/source_filter.h"
+#include "source/track_demux.h"
+
+static const char *temp_file = "temp.vob";
+
+static void load_file(const char *filename, std::vector<uint8_t> &data)
+{
+  AutoFile f(filename);
+  BOOST_REQUIRE(f.is_open());
+  data.resize((size_t)f.size());
+  BOOST_REQUIRE_EQUAL(f.read(&data[0], data.size()), data.size());
+}
+
+// Size of the PES packet or pack header at the position given
+static size_t packet_size(const std::vector<uint8_t> &data, size_t pos)
+{
+  const uint8_t *hdr = &data[pos];
+  if (hdr[3] == 0xba)
+    return (hdr[4] & 0xc0) == 0x40? 14 + (hdr[13] & 7): 12;
+  return ((hdr[4] << 8) | hdr[5]) + 6;
+}
+
+// Write AC3 data as PES packets with PTS. The file may be truncated in the
+// middle of the last packet. Returns the number of packets.
+static const int64_t pts_start = 0x1f0000000LL; // test 33-bit timestamps
+static const int64_t pts_step = 3600;
+static const size_t pes_payload = 2000;
+
+static size_t make_ac3_pes(const std::vector<uint8_t> &ac3, size_t truncate = 0)
+{
+  std::vector<uint8_t> pes;
+  size_t packets = 0;
+  for (size_t pos = 0; pos < ac3.size(); pos += pes_payload, packets++)
+  {
+    size_t size = MIN(pes_payload, ac3.size() - pos);
+    size_t len = 3 + 5 + 4 + size; // flags, PTS, substream header, payload
+    int64_t pts = pts_start + packets * pts_step;
+    uint8_t hdr[] =
+    {
+      0, 0, 1, 0xbd, uint8_t(len >> 8), uint8_t(len),
+      0x80, 0x80, 5, // MPEG2 flags with PTS
+      uint8_t(0x21 | ((pts >> 29) & 0x0e)), uint8_t(pts >> 22),
+      uint8_t(0x01 | ((pts >> 14) & 0xfe)), uint8_t(pts >> 7),
+      uint8_t(0x01 | ((pts << 1) & 0xfe)),
+      0x80, 1, 0, 1  // AC3 substream
+    };
+    pes.insert(pes.end(), hdr, hdr + sizeof(hdr));
+    pes.insert(pes.end(), ac3.begin() + pos, ac3.begin() + pos + size);
+  }
+
+  AutoFile f(temp_file, "wb");
+  BOOST_REQUIRE(f.is_open());
+  f.write(&pes[0], pes.size() - truncate);
+  return packets;
+}
+
+// Interleave packets of PES files
+static void make_vob(const char *pes1, const char *pes2)
+{
+  std::vector<uint8_t> data1, data2;
+  load_file(pes1, data1);
+  load_file(pes2, data2);
+
+  AutoFile f(temp_file, "wb");
+  BOOST_REQUIRE(f.is_open());
+
+  size_t pos1 = 0, pos2 = 0;
+  while (pos1 < data1.size() || pos2 < data2.size())
+  {
+    if (pos1 < data1.size())
+    {
+      size_t size = packet_size(data1, pos1);
+      f.write(&data1[pos1], size);
+      pos1 += size;
+    }
+    if (pos2 < data2.size())
+    {
+      size_t size = packet_size(data2, pos2);
+      f.write(&data2[pos2], size);
+      pos2 += size;
+    }
+  }
+}
+
+class MemSink : public SimpleSink
+{
+public:
+  std::vector<uint8_t> data;
+  std::vector<vtime_t> times;
+  size_t samples;
+
+  MemSink(): samples(0)
+  {}
+
+  virtual bool can_open(Speakers spk) const
+  { return true; }
+
+  virtual void process(const Chunk &chunk)
+  {
+    if (chunk.sync)
+      times.push_back(chunk.time);
+    if (chunk.rawdata)
+      data.insert(data.end(), chunk.rawdata, chunk.rawdata + chunk.size);
+    else
+      samples += chunk.size;
+  }
+};
+
+class TestDemux : public TrackDemux
+{
+public:
+  MemSink sinks[2];
+  int skip;
+  int closed;
+
+  TestDemux(): skip(-1), closed(0)
+  {}
+
+protected:
+  virtual Sink *open_track(const TrackInfo &track)
+  {
+    if (track.index >= array_size(sinks) || track.index == skip)
+      return 0;
+    return sinks + track.index;
+  }
+
+  virtual void close_track(const TrackInfo &track)
+  {
+    closed++;
+  }
+};
+
+static size_t decode_samples(Speakers spk, const char *filename)
+{
+  RAWSource raw(spk, filename);
+  DecoderGraph dec;
+  SourceFilter src(&raw, &dec);
+
+  size_t samples = 0;
+  Chunk chunk;
+  while (src.get_chunk(chunk))
+    samples += chunk.size;
+  return samples;
+}
+
+BOOST_AUTO_TEST_SUITE(track_demux)
+
+BOOST_AUTO_TEST_CASE(demux)
+{
+  std::vector<uint8_t> ac3, mp2;
+  load_file("a.ac3.03f.ac3", ac3);
+  load_file("a.mp2.005.mp2", mp2);
+  make_vob("a.ac3.03f.pes", "a.mp2.005.pes");
+
+  for (int threads = 0; threads <= 1; threads++)
+  {
+    TestDemux demux;
+    demux.set_threads(threads != 0);
+    BOOST_REQUIRE(demux.demux(temp_file));
+
+    BOOST_REQUIRE_EQUAL(demux.get_tracks(), 2);
+    BOOST_CHECK_EQUAL(demux.closed, 2);
+
+    const TrackInfo &ac3_track = demux.get_track(0);
+    BOOST_CHECK_EQUAL(ac3_track.stream, 0xbd);
+    BOOST_CHECK_EQUAL(ac3_track.substream, 0x80);
+    BOOST_CHECK_EQUAL(ac3_track.spk.format, FORMAT_AC3);
+    BOOST_CHECK_EQUAL(ac3_track.size, ac3.size());
+    BOOST_CHECK(!ac3_track.error);
+    BOOST_CHECK(demux.sinks[0].data == ac3);
+
+    const TrackInfo &mp2_track = demux.get_track(1);
+    BOOST_CHECK_EQUAL(mp2_track.stream, 0xc0);
+    BOOST_CHECK_EQUAL(mp2_track.substream, 0);
+    BOOST_CHECK_EQUAL(mp2_track.spk.format, FORMAT_MPA);
+    BOOST_CHECK_EQUAL(mp2_track.size, mp2.size());
+    BOOST_CHECK(!mp2_track.error);
+    BOOST_CHECK(demux.sinks[1].data == mp2);
+  }
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(skip_track)
+{
+  std::vector<uint8_t> mp2;
+  load_file("a.mp2.005.mp2", mp2);
+  make_vob("a.ac3.03f.pes", "a.mp2.005.pes");
+
+  TestDemux demux;
+  demux.skip = 0;
+  BOOST_REQUIRE(demux.demux(temp_file));
+
+  BOOST_REQUIRE_EQUAL(demux.get_tracks(), 2);
+  BOOST_CHECK_EQUAL(demux.closed, 1);
+  BOOST_CHECK_EQUAL(demux.get_track(0).packets, 0);
+  BOOST_CHECK(demux.sinks[0].data.empty());
+  BOOST_CHECK(demux.sinks[1].data == mp2);
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(timestamps)
+{
+  // PTS of each packet is the timestamp of the packet payload
+  std::vector<uint8_t> ac3;
+  load_file("a.ac3.03f.ac3", ac3);
+  size_t packets = make_ac3_pes(ac3);
+
+  for (int threads = 0; threads <= 1; threads++)
+  {
+    TestDemux demux;
+    demux.set_threads(threads != 0);
+    BOOST_REQUIRE(demux.demux(temp_file));
+
+    BOOST_REQUIRE_EQUAL(demux.get_tracks(), 1);
+    BOOST_CHECK(demux.sinks[0].data == ac3);
+    BOOST_REQUIRE_EQUAL(demux.sinks[0].times.size(), packets);
+    for (size_t i = 0; i < packets; i++)
+      BOOST_CHECK_EQUAL(demux.sinks[0].times[i], vtime_t(pts_start + i * pts_step) / 90000);
+  }
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(truncated)
+{
+  // Data of the packet truncated at the end of the file is passed
+  const size_t truncate = 10;
+  std::vector<uint8_t> ac3;
+  load_file("a.ac3.03f.ac3", ac3);
+  size_t packets = make_ac3_pes(ac3, truncate);
+
+  for (int threads = 0; threads <= 1; threads++)
+  {
+    TestDemux demux;
+    demux.set_threads(threads != 0);
+    BOOST_REQUIRE(demux.demux(temp_file));
+
+    BOOST_REQUIRE_EQUAL(demux.get_tracks(), 1);
+    const TrackInfo &track = demux.get_track(0);
+    BOOST_CHECK_EQUAL(track.packets, packets);
+    BOOST_CHECK_EQUAL(track.size, ac3.size() - truncate);
+    BOOST_REQUIRE_EQUAL(demux.sinks[0].data.size(), ac3.size() - truncate);
+    BOOST_CHECK(std::equal(ac3.begin(), ac3.end() - truncate, demux.sinks[0].data.begin()));
+  }
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(decode)
+{
+  size_t ac3_samples = decode_samples(Speakers(FORMAT_AC3, 0, 0), "a.ac3.03f.ac3");
+  size_t mp2_samples = decode_samples(Speakers(FORMAT_MPA, 0, 0), "a.mp2.005.mp2");
+  make_vob("a.ac3.03f.pes", "a.mp2.005.pes");
+
+  for (int threads = 0; threads <= 1; threads++)
+  {
+    TestDemux demux;
+    demux.set_decode(true);
+    demux.set_threads(threads != 0);
+    BOOST_REQUIRE(demux.demux(temp_file));
+
+    BOOST_REQUIRE_EQUAL(demux.get_tracks(), 2);
+    BOOST_CHECK_EQUAL(demux.sinks[0].samples, ac3_samples);
+    BOOST_CHECK_EQUAL(demux.sinks[1].samples, mp2_samples);
+  }
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -223,6 +223,76 @@ BOOST_AUTO_TEST_CASE(get_signed)
   }
 }
 
+///////////////////////////////////////////////////////////
+// ReadBS::peek() and ReadBS::skip()
+// Random mix of get(), peek() and skip() along the stream
+// compared to the bit-by-bit reference. Stream start and
+// size are not aligned, so cache refills near the end of
+// the stream are tested too. Reader does not touch bytes
+// after the end, so these bytes are read as zeros.
+
+static uint32_t get_bits(const uint8_t *buf, size_t start_bit, unsigned num_bits, size_t end_bit)
+{
+  uint32_t result = 0;
+  for (unsigned i = 0; i < num_bits; i++)
+  {
+    size_t bit = start_bit + i;
+    unsigned b = bit < end_bit? (buf[bit / 8] >> (7 - bit % 8)) & 1: 0;
+    result = (result << 1) | b;
+  }
+  return result;
+}
+
+BOOST_AUTO_TEST_CASE(peek_skip)
+{
+  RNG rng(seed);
+  RawNoise buf(1024, seed);
+
+  for (size_t start_bit = 0; start_bit < 16; start_bit++)
+  {
+    const size_t size_bits = buf.size() * 8 - 16 - rng.get_range(64);
+    const size_t end_bit = (start_bit + size_bits + 7) & ~7;
+    ReadBS bs(buf, start_bit, size_bits);
+
+    size_t pos_bits = 0;
+    while (pos_bits < size_bits)
+    {
+      unsigned num_bits = rng.get_range(32);
+      uint32_t peek_value = bs.peek(num_bits);
+      if (peek_value != get_bits(buf, start_bit + pos_bits, num_bits, end_bit))
+        BOOST_FAIL("peek() fails at start_bit = " << start_bit << " pos_bits = " << pos_bits);
+
+      if (pos_bits + num_bits > size_bits)
+        num_bits = unsigned(size_bits - pos_bits);
+
+      switch (rng.get_range(2))
+      {
+        case 0:
+          if (bs.get(num_bits) != get_bits(buf, start_bit + pos_bits, num_bits, end_bit))
+            BOOST_FAIL("get() fails at start_bit = " << start_bit << " pos_bits = " << pos_bits);
+          break;
+
+        case 1:
+          bs.skip(num_bits);
+          break;
+
+        case 2:
+          // Long skip
+          num_bits = (unsigned)MIN(size_t(rng.get_range(200)), size_bits - pos_bits);
+          bs.skip(num_bits);
+          break;
+      }
+
+      pos_bits += num_bits;
+      if (bs.get_pos_bits() != pos_bits)
+        BOOST_FAIL("get_pos_bits() fails at start_bit = " << start_bit << " pos_bits = " << pos_bits);
+    }
+
+    // Bytes after the end of the stream are zeros
+    BOOST_CHECK_EQUAL(bs.peek(32), get_bits(buf, start_bit + size_bits, 32, end_bit));
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
@@ -545,6 +615,52 @@ BOOST_AUTO_TEST_CASE(bs_convert_3step)
         }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Small sizes test
+// * in-place conversion gives the same result as copy conversion
+// * 16le <-> 14bit conversion is the same as conversion through byte stream
+
+BOOST_AUTO_TEST_CASE(bs_convert_sizes)
+{
+  static const size_t max_size = 100;
+  RawNoise noise(max_size, seed);
+  Rawdata buf1(max_size * 2), buf2(max_size * 2), buf3(max_size * 2);
+
+  for (int i = 0; i < array_size(bs_types); i++)
+    for (int j = 0; j < array_size(bs_types); j++)
+    {
+      int bs_from = bs_types[i];
+      int bs_to = bs_types[j];
+      bs_conv_t conv = bs_conversion(bs_from, bs_to);
+      BOOST_REQUIRE(conv != 0);
+
+      for (size_t size = 0; size < max_size; size++)
+      {
+        // 14bit stream must have even size
+        if (is_14bit(bs_from) && (size & 1))
+          continue;
+
+        buf1.zero();
+        size_t size1 = conv(noise, size, buf1);
+
+        memcpy(buf2, noise, size);
+        size_t size2 = conv(buf2, size, buf2);
+
+        if (size1 != size2 || memcmp(buf1, buf2, size1))
+          BOOST_FAIL("In-place conversion " << bs_name(bs_from) << "-" << bs_name(bs_to) << " fails at size = " << size);
+
+        if (bs_from == BITSTREAM_16LE && is_14bit(bs_to) ||
+            is_14bit(bs_from) && bs_to == BITSTREAM_16LE)
+        {
+          size_t size3 = bs_convert(noise, size, bs_from, buf3, BITSTREAM_8);
+          size3 = bs_convert(buf3, size3, BITSTREAM_8, buf2, bs_to);
+          if (size1 != size3 || memcmp(buf1, buf2, size1))
+            BOOST_FAIL("Conversion " << bs_name(bs_from) << "-" << bs_name(bs_to) << " fails at size = " << size);
+        }
+      }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -83,6 +83,66 @@ void bitstream_test(int poly, int power, const char *poly_name)
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Test long messages against bit-by-bit reference
+// * slicing-by-8 tables and carry-less multiply versions
+// * test different message lengths and shifts
+
+class TestCRC : public CRC
+{
+public:
+  TestCRC(uint32_t poly_, unsigned power_, bool use_clmul):
+  CRC(poly_, power_)
+  { clmul = clmul && use_clmul; }
+
+  bool has_clmul() const { return clmul; }
+};
+
+static uint32_t ref_crc(uint32_t poly, unsigned power, uint32_t crc, const uint8_t *data, size_t start_bit, size_t bits)
+{
+  uint32_t top = 1u << (power - 1);
+  uint32_t mask = 0xffffffff >> (32 - power);
+  for (size_t i = start_bit; i < start_bit + bits; i++)
+  {
+    uint32_t bit = (data[i >> 3] >> (7 - (i & 7))) & 1;
+    bool carry = ((crc & top) != 0) != (bit != 0);
+    crc = (crc << 1) & mask;
+    if (carry) crc ^= poly;
+  }
+  return crc;
+}
+
+static void long_message_test(uint32_t poly, unsigned power, bool use_clmul)
+{
+  static const size_t max_size = 1100;
+  static const size_t max_shift = 16;
+  static const size_t sizes[] = { 0, 1, 7, 8, 15, 16, 63, 64, 127, 128, 129, 191, 255, 256, 257, 511, 512, 1000, 1024, 1099 };
+
+  TestCRC crc(poly, power, use_clmul);
+  if (use_clmul && !crc.has_clmul())
+    return;
+
+  BOOST_MESSAGE("Long message test with polinomial 0x" << std::hex << poly << std::dec <<
+    " power " << power << (use_clmul? " (clmul)": ""));
+
+  RawNoise buf(max_size + max_shift + 1, seed);
+  uint32_t init = 0x5a5a5a5a & (0xffffffff >> (32 - power));
+
+  for (size_t i = 0; i < array_size(sizes); i++)
+    for (size_t shift = 0; shift < max_shift; shift++)
+    {
+      size_t size = sizes[i];
+      uint32_t ref = ref_crc(poly, power, init, buf, shift * 8, size * 8);
+      if (crc.calc(init, buf + shift, size) != ref)
+        BOOST_FAIL("Fail at size = " << size << " shift = " << shift);
+
+      // bit-unaligned message
+      ref = ref_crc(poly, power, init, buf, shift + 3, size * 8 + shift);
+      if (crc.calc(init, buf, shift + 3, size * 8 + shift) != ref)
+        BOOST_FAIL("Bit fail at size = " << size << " shift = " << shift);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 BOOST_AUTO_TEST_SUITE(crc)
@@ -110,4 +170,15 @@ BOOST_AUTO_TEST_CASE(bitstream)
   bitstream_test(POLY_CRC32, 32, "CRC32");
 }
 
+BOOST_AUTO_TEST_CASE(long_message)
+{
+  for (int use_clmul = 0; use_clmul <= 1; use_clmul++)
+  {
+    long_message_test(POLY_CRC16, 16, use_clmul != 0);
+    long_message_test(POLY_CRC32, 32, use_clmul != 0);
+    long_message_test(0x07, 8, use_clmul != 0);        // CRC8
+    long_message_test(0x864cfb, 24, use_clmul != 0);   // CRC24
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,306 @@
+/*
+  ExactTime class test
+  Exact timestamps through SyncHelper and Dejitter over long streams
+*/
+
+#include <math.h>
+#include <boost/test/unit_test.hpp>
+#include "filters/dejitter.h"
+#include "exact_time.h"
+#include "sync.h"
+#include "win32/cpu.h"
+
+static const vtime_t time_per_test = 0.5; // for speed tests
+
+// 24 hours at 48kHz
+static const int sample_rate = 48000;
+static const int64_t day_samples = int64_t(24 * 3600) * sample_rate;
+
+// Odd chunk size, so chunk duration is not a whole number of milliseconds
+static const size_t chunk_size = 1001;
+
+BOOST_AUTO_TEST_SUITE(exact_time)
+
+BOOST_AUTO_TEST_CASE(constructor)
+{
+  ExactTime t;
+  BOOST_CHECK(!t.is_set());
+  BOOST_CHECK_EQUAL(t.seconds(), 0);
+
+  ExactTime t1(90000, 90000);
+  BOOST_CHECK(t1.is_set());
+  BOOST_CHECK_EQUAL(t1.seconds(), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(conversion)
+{
+  // From seconds: nearest tick
+  BOOST_CHECK_EQUAL(ExactTime::from_seconds(1.0, 90000).ticks, 90000);
+  BOOST_CHECK_EQUAL(ExactTime::from_seconds(1.00001, 90000).ticks, 90001);
+  BOOST_CHECK_EQUAL(ExactTime::from_seconds(-1.00001, 90000).ticks, -90001);
+
+  // Exact conversion
+  ExactTime t(900, 90000); // 10ms
+  BOOST_CHECK(t.is_exact_at(48000));
+  BOOST_CHECK_EQUAL(t.to_rate(48000).ticks, 480);
+  BOOST_CHECK_EQUAL(t.to_rate(48000).rate, 48000);
+  BOOST_CHECK(t.to_rate(48000) == t);
+
+  // Rounding to the nearest tick
+  ExactTime s(1, 48000);
+  BOOST_CHECK(!s.is_exact_at(90000));
+  BOOST_CHECK_EQUAL(s.to_rate(90000).ticks, 2);   // 1.875 ticks
+  BOOST_CHECK_EQUAL(ExactTime(-1, 48000).to_rate(90000).ticks, -2);
+  BOOST_CHECK_EQUAL(ExactTime(1, 3).to_rate(2).ticks, 1); // 0.667 ticks
+
+  // Large times do not overflow
+  ExactTime day(day_samples, sample_rate);
+  BOOST_CHECK_EQUAL(day.to_rate(10000000).ticks, int64_t(24 * 3600) * 10000000);
+  BOOST_CHECK_EQUAL(day.to_rate(44100).ticks, int64_t(24 * 3600) * 44100);
+}
+
+BOOST_AUTO_TEST_CASE(add)
+{
+  // Same rate
+  ExactTime t = ExactTime(100, 48000).add(28, 48000);
+  BOOST_CHECK_EQUAL(t.ticks, 128);
+  BOOST_CHECK_EQUAL(t.rate, 48000);
+
+  // Result is representable at the original rate
+  t = ExactTime(900, 90000).add(480, 48000);
+  BOOST_CHECK_EQUAL(t.ticks, 1800);
+  BOOST_CHECK_EQUAL(t.rate, 90000);
+
+  // Common rate
+  t = ExactTime(900, 90000).add(1, 48000);
+  BOOST_CHECK_EQUAL(t.rate, 720000);
+  BOOST_CHECK_EQUAL(t.ticks, 900 * 8 + 15);
+
+  t = t.add(-1, 48000);
+  BOOST_CHECK(t == ExactTime(900, 90000));
+
+  // Not set
+  BOOST_CHECK(!ExactTime().add(1, 48000).is_set());
+}
+
+BOOST_AUTO_TEST_CASE(compare)
+{
+  BOOST_CHECK(ExactTime(900, 90000) == ExactTime(480, 48000));
+  BOOST_CHECK(ExactTime(900, 90000) != ExactTime(481, 48000));
+  BOOST_CHECK(ExactTime(900, 90000) <  ExactTime(481, 48000));
+  BOOST_CHECK(ExactTime(441, 44100) >  ExactTime(479, 48000));
+  BOOST_CHECK(ExactTime(441, 44100) <= ExactTime(480, 48000));
+  BOOST_CHECK(ExactTime(441, 44100) >= ExactTime(480, 48000));
+}
+
+BOOST_AUTO_TEST_CASE(chunk)
+{
+  Chunk chunk;
+  BOOST_CHECK(!chunk.exact_time.is_set());
+
+  chunk.set_sync(true, ExactTime(900, 90000));
+  BOOST_CHECK(chunk.sync);
+  BOOST_CHECK_EQUAL(chunk.time, 0.01);
+  BOOST_CHECK(chunk.exact_time == ExactTime(900, 90000));
+
+  // vtime_t timestamp drops the exact time
+  chunk.set_sync(true, 0.02);
+  BOOST_CHECK(!chunk.exact_time.is_set());
+
+  chunk.set_sync(true, ExactTime(900, 90000));
+  chunk.clear();
+  BOOST_CHECK(!chunk.exact_time.is_set());
+}
+
+BOOST_AUTO_TEST_CASE(sync_helper)
+{
+  // Timestamp at the middle of the buffered data is shifted exactly
+  SyncHelper sync;
+  samples_t samples;
+
+  Chunk in(samples, 100, false);
+  sync.receive_sync(in);
+  sync.put(in.size);
+
+  in.set_linear(samples, 100);
+  in.set_sync(true, ExactTime(90001, 90000));
+  sync.receive_sync(in);
+  BOOST_CHECK(!in.sync);
+  sync.put(in.size);
+
+  Chunk out(samples, 150);
+  sync.send_sync_linear(out, sample_rate);
+  BOOST_CHECK(!out.sync);
+
+  out.set_linear(samples, 50);
+  sync.send_sync_linear(out, sample_rate);
+  BOOST_CHECK(out.sync);
+  BOOST_CHECK(out.exact_time == ExactTime(90001, 90000).add(50, sample_rate));
+  BOOST_CHECK_EQUAL(out.time, out.exact_time.seconds());
+
+  // Frame sync passes the exact time unchanged
+  in.set_rawdata(0, 100);
+  in.set_sync(true, ExactTime(123, 90000));
+  sync.reset();
+  sync.receive_sync(in);
+  out.set_rawdata(0, 100);
+  sync.send_frame_sync(out);
+  BOOST_CHECK(out.exact_time == ExactTime(123, 90000));
+}
+
+BOOST_AUTO_TEST_CASE(drift_24h)
+{
+  // Time calculated as a sum of chunk durations may drift, but the exact
+  // time does not.
+  vtime_t time = 0;
+  ExactTime exact(0, 90000);
+  int64_t samples = 0;
+  while (samples + (int64_t)chunk_size <= day_samples)
+  {
+    time += vtime_t(chunk_size) / sample_rate;
+    exact = exact.add(chunk_size, sample_rate);
+    samples += chunk_size;
+  }
+
+  ExactTime expected(samples, sample_rate);
+  BOOST_CHECK(exact == expected);
+  BOOST_CHECK_EQUAL(exact.seconds(), expected.seconds());
+
+  // The accumulated time may drift, but less than a sample
+  vtime_t drift = time - expected.seconds();
+  BOOST_MESSAGE("Drift of the accumulated time over 24h: " << drift * 1e6 << "us");
+  BOOST_CHECK(fabs(drift) < 1.0 / sample_rate);
+}
+
+BOOST_AUTO_TEST_CASE(sync_helper_24h)
+{
+  // Exact timestamps at each input chunk are moved to 1024-sample output
+  // blocks. Each output timestamp must be exact.
+  const size_t block_size = 1024;
+  SyncHelper sync;
+  samples_t samples;
+
+  int64_t in_pos = 0;
+  int64_t out_pos = 0;
+  size_t buffered = 0;
+  int errors = 0;
+  int stamps = 0;
+  while (in_pos + (int64_t)chunk_size <= day_samples)
+  {
+    Chunk in(samples, chunk_size);
+    in.set_sync(true, ExactTime(in_pos, sample_rate).to_rate(90000));
+    sync.receive_sync(in);
+    sync.put(chunk_size);
+    in_pos += chunk_size;
+    buffered += chunk_size;
+
+    while (buffered >= block_size)
+    {
+      Chunk out(samples, block_size);
+      sync.send_sync_linear(out, sample_rate);
+      if (out.sync)
+      {
+        // Input timestamps are rounded to 90kHz ticks
+        ExactTime expected = ExactTime(out_pos, sample_rate);
+        if (!out.exact_time.is_set() || fabs((out.exact_time.seconds() - expected.seconds()) * 90000) > 0.5001)
+          errors++;
+        stamps++;
+      }
+      out_pos += block_size;
+      buffered -= block_size;
+    }
+  }
+
+  BOOST_CHECK_EQUAL(errors, 0);
+  BOOST_CHECK(stamps > 0);
+}
+
+BOOST_AUTO_TEST_CASE(dejitter_24h)
+{
+  // Single timestamp at the start, continuous timestamps after. The last
+  // timestamp must match the sample count.
+  Speakers spk(FORMAT_LINEAR, MODE_STEREO, sample_rate);
+  samples_t samples;
+
+  for (int exact = 0; exact <= 1; exact++)
+  {
+    Dejitter dejitter;
+    BOOST_REQUIRE(dejitter.open(spk));
+
+    int64_t pos = 0;
+    Chunk in, out;
+    while (pos + (int64_t)chunk_size <= day_samples)
+    {
+      in.set_linear(samples, chunk_size);
+      if (pos == 0)
+      {
+        if (exact)
+          in.set_sync(true, ExactTime(0, 90000));
+        else
+          in.set_sync(true, 0);
+      }
+      BOOST_REQUIRE(dejitter.process(in, out));
+      pos += chunk_size;
+    }
+
+    vtime_t expected = vtime_t(pos - chunk_size) / sample_rate;
+    BOOST_CHECK(out.sync);
+    BOOST_CHECK(fabs(out.time - expected) < 1e-9);
+    if (exact)
+      BOOST_CHECK(out.exact_time == ExactTime(pos - chunk_size, sample_rate));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(speed)
+{
+  // Cost of the exact timestamps at SyncHelper compared to vtime_t
+  // Output timestamps must be correct, and exact timestamps must be cheap
+  // compared to the real time (10000x real time at 48kHz).
+  const size_t block_size = 1024;
+  samples_t samples;
+  CPUMeter cpu;
+  double speed[2];
+
+  for (int exact = 0; exact <= 1; exact++)
+  {
+    SyncHelper sync;
+    int64_t pos = 0;
+    int runs = 0;
+    int errors = 0;
+
+    cpu.reset();
+    cpu.start();
+    while (cpu.get_thread_time() < time_per_test)
+    {
+      for (int i = 0; i < 10000; i++)
+      {
+        Chunk in(samples, block_size);
+        if (exact)
+          in.set_sync(true, ExactTime(pos, 90000));
+        else
+          in.set_sync(true, vtime_t(pos) / 90000);
+        sync.receive_sync(in);
+        sync.put(block_size);
+
+        // Block duration is 1920 ticks, so each block gets the timestamp
+        Chunk out(samples, block_size);
+        sync.send_sync_linear(out, sample_rate);
+        if (!out.sync || fabs(out.time - vtime_t(pos) / 90000) > 1e-9 ||
+            out.exact_time.is_set() != (exact != 0) ||
+            (exact && out.exact_time != ExactTime(pos, 90000)))
+          errors++;
+        pos += 1920;
+      }
+      runs++;
+    }
+    cpu.stop();
+
+    speed[exact] = runs * 10000 / cpu.get_thread_time();
+    BOOST_CHECK_EQUAL(errors, 0);
+    BOOST_MESSAGE("SyncHelper with " << (exact? "exact": "vtime_t") << " timestamps: "
+      << int(speed[exact] / 1000) << "K chunks/s");
+  }
+  BOOST_CHECK_GT(speed[1], 10000.0 * sample_rate / block_size);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
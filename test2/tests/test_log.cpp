@@ -4,6 +4,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include "log.h"
+#include "win32/thread.h"
 
 using std::string;
 BOOST_TEST_DONT_PRINT_LOG_VALUE(LogEntry);
@@ -20,6 +21,45 @@ public:
   { last_entry = entry; }
 };
 
+// Sink blocked until the event is set
+class LogBlocked : public LogSink
+{
+public:
+  Event unblock;
+  int received;
+
+  LogBlocked(LogDispatcher *source): LogSink(source), received(0)
+  {}
+
+  virtual void receive(const LogEntry &entry)
+  {
+    unblock.wait();
+    received++;
+  }
+};
+
+class LogThread : public Thread
+{
+public:
+  LogDispatcher *source;
+  int index;
+  int messages;
+  Event done;
+
+  LogThread(LogDispatcher *source_, int index_, int messages_):
+  source(source_), index(index_), messages(messages_)
+  {}
+
+protected:
+  virtual DWORD process()
+  {
+    for (int i = 0; i < messages; i++)
+      source->log(log_event, "thread", "%i %i", index, i);
+    done.set();
+    return 0;
+  }
+};
+
 static const LogEntry entry1(1, 1, "module1", "test1");
 static const LogEntry entry2(2, 2, "module2", "test2");
 static const char *log_test_file = "log_test_file.log";
@@ -137,19 +177,53 @@ BOOST_AUTO_TEST_CASE(valib_log)
 {
   LogTest sink(&valib_log_dispatcher);
 
-  ::valib_log(entry1.level, entry1.module, entry1.message);
+  valib_log(entry1.level, entry1.module, entry1.message);
   BOOST_CHECK(local_time() - sink.last_entry.timestamp < 1);
   BOOST_CHECK_EQUAL(sink.last_entry.level, entry1.level);
   BOOST_CHECK_EQUAL(sink.last_entry.module, entry1.module);
   BOOST_CHECK_EQUAL(sink.last_entry.message, entry1.message);
 
-  ::valib_log(entry2.level, entry2.module, entry2.message.c_str());
+  valib_log(entry2.level, entry2.module, entry2.message.c_str());
   BOOST_CHECK(local_time() - sink.last_entry.timestamp < 1);
   BOOST_CHECK_EQUAL(sink.last_entry.level, entry2.level);
   BOOST_CHECK_EQUAL(sink.last_entry.module, entry2.module);
   BOOST_CHECK_EQUAL(sink.last_entry.message, entry2.message);
 }
 
+static int log_args = 0;
+static const char *log_arg()
+{
+  log_args++;
+  return "arg";
+}
+
+BOOST_AUTO_TEST_CASE(valib_log_level)
+{
+  // Arguments of a call above the log level are not evaluated
+  LogTest sink(&valib_log_dispatcher);
+  log_args = 0;
+
+  valib_log(log_error, log_arg(), "%s", log_arg());
+  BOOST_CHECK_EQUAL(log_args, 2);
+  BOOST_CHECK_EQUAL(sink.last_entry.message, string("arg"));
+
+  // Dispatcher level
+  int old_level = valib_log_dispatcher.get_max_log_level();
+  valib_log_dispatcher.set_max_log_level(log_warning);
+  valib_log(log_event, log_arg(), "%s", log_arg());
+  valib_log_dispatcher.set_max_log_level(old_level);
+  BOOST_CHECK_EQUAL(log_args, 2);
+
+  // Compile-time level
+#undef VALIB_MAX_LOG_LEVEL
+#define VALIB_MAX_LOG_LEVEL log_event
+  valib_log(log_trace, log_arg(), "%s", log_arg());
+  valib_log(log_trace, log_arg(), string(log_arg()));
+  BOOST_CHECK_EQUAL(log_args, 2);
+#undef VALIB_MAX_LOG_LEVEL
+#define VALIB_MAX_LOG_LEVEL log_all
+}
+
 BOOST_AUTO_TEST_CASE(log_mem)
 {
   const string endl("\n");
@@ -209,4 +283,98 @@ BOOST_AUTO_TEST_CASE(log_file)
   remove(log_test_file);
 }
 
+BOOST_AUTO_TEST_CASE(async_log)
+{
+  LogDispatcher source;
+  LogMem sink(10, &source);
+
+  BOOST_CHECK(!source.is_async());
+  BOOST_REQUIRE(source.start_async(16));
+  BOOST_CHECK(source.is_async());
+
+  source.log(entry1);
+  source.log(entry2.level, entry2.module, "%s", entry2.message.c_str());
+  source.flush();
+
+  BOOST_REQUIRE_EQUAL(sink.size(), 2);
+  BOOST_CHECK_EQUAL(sink[0], entry1);
+  BOOST_CHECK_EQUAL(sink[1].level, entry2.level);
+  BOOST_CHECK_EQUAL(sink[1].module, entry2.module);
+  BOOST_CHECK_EQUAL(sink[1].message, entry2.message);
+
+  // Long message is truncated
+  string s = string("L") + string(8192, 'o') + string("ngcat");
+  source.log(entry1.level, entry1.module, "%s", s.c_str());
+  source.flush();
+  BOOST_REQUIRE_EQUAL(sink.size(), 3);
+  BOOST_CHECK(sink[2].message.size() > 0);
+  BOOST_CHECK(s.compare(0, sink[2].message.size(), sink[2].message) == 0);
+
+  // Queued messages are passed to sinks on stop
+  source.log(entry2);
+  source.stop_async();
+  BOOST_CHECK(!source.is_async());
+  BOOST_REQUIRE_EQUAL(sink.size(), 4);
+  BOOST_CHECK_EQUAL(sink[3], entry2);
+  BOOST_CHECK_EQUAL(source.get_dropped(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(async_dropped)
+{
+  const int messages = 10;
+  const int queue_size = 2;
+
+  LogDispatcher source;
+  LogBlocked sink(&source);
+  BOOST_REQUIRE(source.start_async(queue_size));
+
+  // One message is at the sink, others wait at the queue or dropped
+  for (int i = 0; i < messages; i++)
+    source.log(entry1);
+  BOOST_CHECK(source.get_dropped() >= messages - queue_size - 1);
+
+  sink.unblock.set();
+  source.flush();
+  BOOST_CHECK_EQUAL(sink.received + source.get_dropped(), messages);
+
+  source.reset_dropped();
+  BOOST_CHECK_EQUAL(source.get_dropped(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(async_threads)
+{
+  const int threads = 4;
+  const int messages = 1000;
+
+  LogDispatcher source;
+  LogMem sink(threads * messages, &source);
+  BOOST_REQUIRE(source.start_async(threads * messages));
+
+  std::vector<LogThread *> log_threads;
+  for (int i = 0; i < threads; i++)
+    log_threads.push_back(new LogThread(&source, i, messages));
+  for (int i = 0; i < threads; i++)
+    log_threads[i]->create(false);
+  for (int i = 0; i < threads; i++)
+  {
+    log_threads[i]->done.wait();
+    log_threads[i]->terminate();
+    delete log_threads[i];
+  }
+  source.flush();
+
+  // Messages of each thread are in order
+  BOOST_CHECK_EQUAL(source.get_dropped(), 0);
+  BOOST_REQUIRE_EQUAL(sink.size(), threads * messages);
+  int next[threads] = { 0 };
+  for (size_t i = 0; i < sink.size(); i++)
+  {
+    int index = -1, n = -1;
+    sscanf(sink[i].message.c_str(), "%i %i", &index, &n);
+    BOOST_REQUIRE(index >= 0 && index < threads);
+    BOOST_REQUIRE_EQUAL(n, next[index]);
+    next[index]++;
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
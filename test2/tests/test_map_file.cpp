@@ -0,0 +1,176 @@
+/*
+  MapFile class test
+*/
+
+#include "map_file.h"
+#include "../noise_buf.h"
+#include <boost/test/unit_test.hpp>
+
+static const int seed = 375639;
+
+static const char *bad_file = "it-is-no-such-file";
+static const char *temp_file = "temp.tmp";
+static const size_t temp_file_size = 1000000;
+
+static void write_file(const char *filename, const uint8_t *data, size_t size)
+{
+  AutoFile f(filename, "wb");
+  BOOST_REQUIRE(f.is_open());
+  BOOST_REQUIRE_EQUAL(f.write(data, size), size);
+}
+
+static void test_closed(MapFile &f)
+{
+  BOOST_CHECK( !f.is_open() );
+  BOOST_CHECK( f.eof() );
+  BOOST_CHECK( f.size() == 0 );
+  BOOST_CHECK( f.pos() == 0 );
+}
+
+BOOST_AUTO_TEST_SUITE(map_file)
+
+BOOST_AUTO_TEST_CASE(default_constructor)
+{
+  MapFile f;
+  test_closed(f);
+}
+
+BOOST_AUTO_TEST_CASE(open_fail)
+{
+  MapFile f;
+  BOOST_CHECK( !f.open(bad_file) );
+  test_closed(f);
+
+  uint8_t *data = 0;
+  BOOST_CHECK_EQUAL(f.map(&data, 100), 0);
+  BOOST_CHECK(f.seek(0) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(empty_file)
+{
+  write_file(temp_file, 0, 0);
+
+  MapFile f;
+  BOOST_CHECK( f.open(temp_file) );
+  BOOST_CHECK( f.is_open() );
+  BOOST_CHECK( f.eof() );
+  BOOST_CHECK( f.size() == 0 );
+
+  uint8_t *data = 0;
+  BOOST_CHECK_EQUAL(f.map(&data, 100), 0);
+
+  f.close();
+  test_closed(f);
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(map)
+{
+  RawNoise ref(temp_file_size, seed);
+  write_file(temp_file, ref, ref.size());
+
+  // Map the whole file with different block sizes
+  const size_t block_size[] = { 1, 1000, 4095, 4096, 65537, temp_file_size, 2 * temp_file_size };
+  for (size_t i = 0; i < array_size(block_size); i++)
+  {
+    MapFile f(temp_file);
+    BOOST_REQUIRE( f.is_open() );
+    BOOST_CHECK( f.size() == temp_file_size );
+
+    size_t pos = 0;
+    uint8_t *data;
+    while (size_t data_size = f.map(&data, block_size[i]))
+    {
+      BOOST_REQUIRE(data_size <= block_size[i]);
+      BOOST_REQUIRE(pos + data_size <= temp_file_size);
+      BOOST_REQUIRE(memcmp(data, ref + pos, data_size) == 0);
+      pos += data_size;
+      BOOST_REQUIRE(f.pos() == pos);
+    }
+    BOOST_CHECK_EQUAL(pos, temp_file_size);
+    BOOST_CHECK(f.eof());
+  }
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(map_blocks)
+{
+  // 6-byte blocks (16bit stereo samples): data ends at the block boundary,
+  // the last partial block is returned at the end of the file.
+  const size_t block = 6;
+  RawNoise ref(temp_file_size, seed);
+  write_file(temp_file, ref, ref.size());
+
+  MapFile f(temp_file);
+  BOOST_REQUIRE( f.is_open() );
+
+  size_t pos = 0;
+  uint8_t *data;
+  while (size_t data_size = f.map(&data, 1000, block))
+  {
+    if (pos + data_size < temp_file_size)
+      BOOST_REQUIRE_EQUAL(data_size % block, 0);
+    BOOST_REQUIRE(memcmp(data, ref + pos, data_size) == 0);
+    pos += data_size;
+  }
+  BOOST_CHECK_EQUAL(pos, temp_file_size);
+  BOOST_CHECK(f.eof());
+
+  f.close();
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(copy_on_write)
+{
+  RawNoise ref(temp_file_size, seed);
+  write_file(temp_file, ref, ref.size());
+
+  // Modification of the mapped data does not change the file
+  {
+    MapFile f(temp_file);
+    uint8_t *data;
+    while (size_t data_size = f.map(&data, temp_file_size))
+      memset(data, 0, data_size);
+  }
+
+  MemFile file(temp_file);
+  BOOST_REQUIRE_EQUAL(file.size(), temp_file_size);
+  BOOST_CHECK(memcmp(file, ref, temp_file_size) == 0);
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(seek_read)
+{
+  RawNoise ref(temp_file_size, seed);
+  write_file(temp_file, ref, ref.size());
+
+  MapFile f(temp_file);
+  BOOST_REQUIRE( f.is_open() );
+
+  RNG rng(seed);
+  Rawdata buf(temp_file_size);
+  for (int i = 0; i < 100; i++)
+  {
+    size_t pos = rng.get_range(temp_file_size);
+    size_t size = rng.get_range(temp_file_size);
+    BOOST_REQUIRE_EQUAL(f.seek(pos), 0);
+    BOOST_REQUIRE(f.pos() == pos);
+
+    size_t read_size = f.read(buf, size);
+    BOOST_REQUIRE_EQUAL(read_size, MIN(size, temp_file_size - pos));
+    BOOST_REQUIRE(memcmp(buf, ref + pos, read_size) == 0);
+    BOOST_REQUIRE(f.pos() == pos + read_size);
+  }
+
+  // Seek beyond the end of the file
+  BOOST_CHECK_EQUAL(f.seek(temp_file_size + 1), 0);
+  BOOST_CHECK(f.eof());
+  BOOST_CHECK_EQUAL(f.read(buf, 1), 0);
+
+  f.close();
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
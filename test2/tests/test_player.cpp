@@ -0,0 +1,294 @@
+/*
+  Player class test
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "player.h"
+#include "sink/sink_null.h"
+#include "source/generator.h"
+#include "vtime.h"
+
+static const int seed = 472834;
+static const Speakers spk_pcm(FORMAT_PCM16, MODE_STEREO, 48000);
+static const Speakers spk_linear(FORMAT_LINEAR, MODE_STEREO, 48000);
+static const size_t byte_rate = 4 * 48000;
+
+class MemSink : public SimpleSink
+{
+public:
+  std::vector<uint8_t> data;
+  int opens;
+
+  MemSink(): opens(0)
+  {}
+
+  virtual bool can_open(Speakers spk) const
+  { return spk.is_pcm(); }
+
+  virtual bool init()
+  { opens++; return true; }
+
+  virtual void process(const Chunk &chunk)
+  { data.insert(data.end(), chunk.rawdata, chunk.rawdata + chunk.size); }
+
+  virtual void reset()
+  { data.clear(); }
+};
+
+// Generator with the delay at each chunk
+class SlowGen : public NoiseGen
+{
+public:
+  int delay_ms;
+
+  SlowGen(Speakers spk, int seed, uint64_t stream_len, size_t chunk_size, int delay_ms_):
+  NoiseGen(spk, seed, stream_len, chunk_size), delay_ms(delay_ms_)
+  {}
+
+  virtual bool get_chunk(Chunk &out)
+  {
+    Sleep(delay_ms);
+    return NoiseGen::get_chunk(out);
+  }
+};
+
+// Two generators one after another (format change between)
+class FormatChangeGen : public Source
+{
+public:
+  Generator *gen1, *gen2;
+  bool second;
+
+  FormatChangeGen(Generator *gen1_, Generator *gen2_):
+  gen1(gen1_), gen2(gen2_), second(false)
+  {}
+
+  virtual void reset()
+  {
+    gen1->reset();
+    gen2->reset();
+    second = false;
+  }
+
+  virtual bool get_chunk(Chunk &out)
+  {
+    if (!second && gen1->get_chunk(out))
+      return true;
+    second = true;
+    return gen2->get_chunk(out);
+  }
+
+  virtual bool new_stream() const
+  { return false; }
+
+  virtual Speakers get_output() const
+  { return second? gen2->get_output(): gen1->get_output(); }
+};
+
+// Seeks the generator to the start
+class SeekPlayer : public Player
+{
+public:
+  Generator *gen;
+  SeekPlayer(Generator *gen_): gen(gen_)
+  {}
+
+protected:
+  virtual bool seek_source(vtime_t time)
+  {
+    if (time != 0)
+      return false;
+    gen->reset();
+    return true;
+  }
+};
+
+static void gen_data(Speakers spk, size_t size, size_t chunk_size, std::vector<uint8_t> &data)
+{
+  NoiseGen gen(spk, seed, size, chunk_size);
+  Chunk chunk;
+  data.clear();
+  while (gen.get_chunk(chunk))
+    data.insert(data.end(), chunk.rawdata, chunk.rawdata + chunk.size);
+}
+
+// Producer fills the buffer asynchronously, so wait for it with a timeout.
+// Buffer size is known only after the producer gets the format.
+static bool wait_data_size(const Player &player, size_t size, int timeout_ms = 10000)
+{
+  vtime_t timeout = local_time() + timeout_ms / 1000.0;
+  while (player.get_data_size() < size)
+  {
+    if (local_time() > timeout)
+      return false;
+    Sleep(1);
+  }
+  return true;
+}
+
+static bool wait_buffer_full(const Player &player, int timeout_ms = 10000)
+{
+  vtime_t timeout = local_time() + timeout_ms / 1000.0;
+  while (player.get_data_size() < player.get_buffer_size())
+  {
+    if (local_time() > timeout)
+      return false;
+    Sleep(1);
+  }
+  return true;
+}
+
+BOOST_AUTO_TEST_SUITE(player)
+
+BOOST_AUTO_TEST_CASE(constructor)
+{
+  Player player;
+  BOOST_CHECK(!player.is_open());
+  BOOST_CHECK(!player.is_running());
+  BOOST_CHECK(!player.start());
+}
+
+BOOST_AUTO_TEST_CASE(transcode)
+{
+  const size_t size = byte_rate * 3;
+  std::vector<uint8_t> ref;
+  gen_data(spk_pcm, size, 1000, ref);
+
+  // Chunk sizes are not aligned to the ring size
+  NoiseGen gen(spk_pcm, seed, size, 1000);
+  MemSink sink;
+  Player player;
+  BOOST_REQUIRE(player.open(&gen, 0, &sink, 0, 100));
+  BOOST_REQUIRE(player.start());
+  BOOST_REQUIRE(player.wait(10000));
+
+  BOOST_CHECK(player.is_finished());
+  BOOST_CHECK(!player.is_error());
+  BOOST_CHECK_EQUAL(sink.opens, 1);
+  BOOST_CHECK_EQUAL(player.get_buffer_size(), byte_rate / 10);
+  BOOST_CHECK(sink.data == ref);
+}
+
+BOOST_AUTO_TEST_CASE(playback)
+{
+  // 2 sec of audio at 5x speed
+  const size_t size = byte_rate * 2;
+  const double speed = 5;
+
+  NoiseGen gen(spk_pcm, seed, size);
+  NullRenderer renderer(250, speed);
+  Player player;
+  BOOST_REQUIRE(player.open(&gen, 0, &renderer, &renderer, 500));
+
+  vtime_t start = utc_time();
+  BOOST_REQUIRE(player.start());
+  BOOST_REQUIRE(player.wait(10000));
+  vtime_t elapsed = utc_time() - start;
+
+  BOOST_CHECK(!player.is_error());
+  BOOST_CHECK_EQUAL(renderer.get_underruns(), 0);
+  BOOST_CHECK_EQUAL(player.get_underruns(), 0);
+  BOOST_CHECK(player.get_overruns() > 0);
+  BOOST_CHECK(elapsed > 2.0 / speed * 0.9);
+  BOOST_CHECK(fabs(player.get_playback_time() - 2.0) < 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(underrun)
+{
+  // Source is slower than real time (10ms chunks each 50ms)
+  SlowGen gen(spk_pcm, seed, byte_rate, byte_rate / 100, 50);
+  NullRenderer renderer(20);
+  Player player;
+  BOOST_REQUIRE(player.open(&gen, 0, &renderer, &renderer, 40));
+  BOOST_REQUIRE(player.start());
+  BOOST_REQUIRE(player.wait(20000));
+
+  BOOST_CHECK(!player.is_error());
+  BOOST_CHECK(player.get_underruns() > 0);
+  BOOST_CHECK(renderer.get_underruns() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(pause_seek)
+{
+  const size_t size = byte_rate;
+  std::vector<uint8_t> ref;
+  gen_data(spk_pcm, size, 1000, ref);
+
+  NoiseGen gen(spk_pcm, seed, size, 1000);
+  MemSink sink;
+  SeekPlayer player(&gen);
+  BOOST_REQUIRE(player.open(&gen, 0, &sink, 0, 100));
+
+  // Paused player fills the buffer only
+  player.pause();
+  BOOST_REQUIRE(player.start());
+  BOOST_CHECK(wait_buffer_full(player));
+  BOOST_CHECK_EQUAL(player.get_data_size(), player.get_buffer_size());
+  BOOST_CHECK(player.is_paused());
+  BOOST_CHECK(sink.data.empty());
+
+  // Seek drops the data and restarts the source
+  BOOST_CHECK(!player.seek(1.0));
+  BOOST_CHECK(player.seek(0));
+  BOOST_CHECK(player.is_running());
+  player.unpause();
+  BOOST_REQUIRE(player.wait(10000));
+  BOOST_CHECK(sink.data == ref);
+
+  // Play again after the end
+  BOOST_CHECK(!player.start());
+  BOOST_CHECK(player.seek(0));
+  BOOST_REQUIRE(player.start());
+  BOOST_REQUIRE(player.wait(10000));
+  BOOST_CHECK(sink.data == ref);
+}
+
+BOOST_AUTO_TEST_CASE(stop_format_change)
+{
+  // Stop while the producer waits for the format change. No data is lost
+  // and the format is changed once on restart.
+  const Speakers spk2(FORMAT_PCM16, MODE_MONO, 44100);
+  const size_t size = byte_rate / 10;
+  std::vector<uint8_t> ref, ref2;
+  gen_data(spk_pcm, size, 1000, ref);
+  gen_data(spk2, size, 1000, ref2);
+  ref.insert(ref.end(), ref2.begin(), ref2.end());
+
+  NoiseGen gen1(spk_pcm, seed, size, 1000);
+  NoiseGen gen2(spk2, seed, size, 1000);
+  FormatChangeGen gen(&gen1, &gen2);
+  MemSink sink;
+  Player player;
+  BOOST_REQUIRE(player.open(&gen, 0, &sink, 0, 500));
+
+  // Paused consumer does not reach the format marker
+  player.pause();
+  BOOST_REQUIRE(player.start());
+  BOOST_CHECK(wait_data_size(player, size));
+  BOOST_CHECK_EQUAL(player.get_data_size(), size);
+  for (int i = 0; i < 3; i++)
+  {
+    player.stop();
+    BOOST_REQUIRE(player.start());
+    Sleep(20);
+  }
+
+  player.unpause();
+  BOOST_REQUIRE(player.wait(10000));
+  BOOST_CHECK(!player.is_error());
+  BOOST_CHECK_EQUAL(sink.opens, 2);
+  BOOST_CHECK(sink.data == ref);
+}
+
+BOOST_AUTO_TEST_CASE(linear_format)
+{
+  NoiseGen gen(spk_linear, seed, 48000);
+  NullSink sink;
+  Player player;
+  BOOST_REQUIRE(player.open(&gen, 0, &sink));
+  BOOST_REQUIRE(player.start());
+  BOOST_REQUIRE(player.wait(10000));
+  BOOST_CHECK(player.is_error());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+/*
+  ReadAheadFile class test
+*/
+
+#include "read_ahead.h"
+#include "../noise_buf.h"
+#include <boost/test/unit_test.hpp>
+
+static const int seed = 947263;
+
+static const char *bad_file = "it-is-no-such-file";
+static const char *temp_file = "temp.tmp";
+static const size_t temp_file_size = 1000000;
+
+static void write_file(const char *filename, const uint8_t *data, size_t size)
+{
+  AutoFile f(filename, "wb");
+  BOOST_REQUIRE(f.is_open());
+  BOOST_REQUIRE_EQUAL(f.write(data, size), size);
+}
+
+BOOST_AUTO_TEST_SUITE(read_ahead)
+
+BOOST_AUTO_TEST_CASE(default_constructor)
+{
+  ReadAheadFile f;
+  BOOST_CHECK( !f.is_open() );
+  BOOST_CHECK( f.eof() );
+  BOOST_CHECK( f.size() == 0 );
+  BOOST_CHECK( f.pos() == 0 );
+}
+
+BOOST_AUTO_TEST_CASE(open_fail)
+{
+  RawNoise ref(temp_file_size, seed);
+  write_file(temp_file, ref, ref.size());
+
+  ReadAheadFile f;
+  BOOST_CHECK( !f.open(bad_file, 1000, 2) );
+  BOOST_CHECK( !f.is_open() );
+
+  // Bad parameters
+  BOOST_CHECK( !f.open(temp_file, 1000, 1) );
+  BOOST_CHECK( !f.open(temp_file, 0, 2) );
+  BOOST_CHECK( !f.is_open() );
+
+  uint8_t *data = 0;
+  BOOST_CHECK_EQUAL(f.map(&data, 100), 0);
+  BOOST_CHECK(f.seek(0) != 0);
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(map)
+{
+  RawNoise ref(temp_file_size, seed);
+  write_file(temp_file, ref, ref.size());
+
+  const struct { size_t buf_size; int depth; size_t block_size; } params[] = {
+    { 1, 2, 1 },
+    { 1000, 2, 100 },
+    { 1000, 2, 4096 },
+    { 4096, 4, 1000 },
+    { 65536, 8, 65536 },
+    { temp_file_size, 2, temp_file_size },
+    { 2 * temp_file_size, 3, temp_file_size },
+  };
+
+  for (size_t i = 0; i < array_size(params); i++)
+  {
+    ReadAheadFile f;
+    BOOST_REQUIRE( f.open(temp_file, params[i].buf_size, params[i].depth) );
+    BOOST_CHECK( f.size() == temp_file_size );
+
+    size_t pos = 0;
+    uint8_t *data;
+    while (size_t data_size = f.map(&data, params[i].block_size))
+    {
+      BOOST_REQUIRE(data_size <= params[i].block_size);
+      BOOST_REQUIRE(pos + data_size <= temp_file_size);
+      BOOST_REQUIRE(memcmp(data, ref + pos, data_size) == 0);
+      pos += data_size;
+      BOOST_REQUIRE(f.pos() == pos);
+    }
+    BOOST_CHECK_EQUAL(pos, temp_file_size);
+    BOOST_CHECK(f.eof());
+    BOOST_CHECK(f.get_buffers() > 0);
+    // The last stall may be the wait for the end of the file
+    BOOST_CHECK(f.get_stalls() <= f.get_buffers() + 1);
+  }
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(seek)
+{
+  RawNoise ref(temp_file_size, seed);
+  write_file(temp_file, ref, ref.size());
+
+  ReadAheadFile f;
+  BOOST_REQUIRE( f.open(temp_file, 4096, 4) );
+
+  // Seek while the reader is busy, compare the data after the seek
+  RNG rng(seed);
+  for (int i = 0; i < 1000; i++)
+  {
+    size_t pos = rng.get_range(temp_file_size);
+    size_t size = rng.get_range(10000);
+    BOOST_REQUIRE_EQUAL(f.seek(pos), 0);
+    BOOST_REQUIRE(f.pos() == pos);
+
+    uint8_t *data;
+    while (size_t data_size = f.map(&data, size))
+    {
+      BOOST_REQUIRE(memcmp(data, ref + pos, data_size) == 0);
+      pos += data_size;
+      size -= data_size;
+    }
+    BOOST_REQUIRE(f.pos() == pos);
+  }
+
+  // Seek beyond the end of the file
+  uint8_t *data;
+  BOOST_CHECK_EQUAL(f.seek(temp_file_size + 1), 0);
+  BOOST_CHECK(f.eof());
+  BOOST_CHECK_EQUAL(f.map(&data, 1), 0);
+
+  f.close();
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
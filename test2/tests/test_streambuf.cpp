@@ -258,6 +258,85 @@ static void passthrough_test(FrameParser *parser, uint8_t *buf, size_t buf_size,
   if (file_frames)  BOOST_CHECK_EQUAL(frames, file_frames);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Zero-copy test
+// Load the stream in chunks of size chunk_size and record the output.
+// Output must be the same with and without zero-copy mode, and zero-copy
+// frames must point to the input buffer. The buffer is zapped after the
+// frame is loaded (in-place processing), so each pass uses its own copy.
+
+struct LoadState
+{
+  bool in_sync;
+  bool new_stream;
+  std::string debris;
+  std::string frame;
+
+  bool operator ==(const LoadState &other) const
+  {
+    return in_sync == other.in_sync && new_stream == other.new_stream &&
+           debris == other.debris && frame == other.frame;
+  }
+};
+
+static int zero_copy_load(FrameParser *parser, bool zero_copy, const uint8_t *data, size_t data_size, size_t chunk_size, std::vector<LoadState> &result)
+{
+  Rawdata buf(data_size);
+  memcpy(buf, data, data_size);
+
+  StreamBuffer streambuf(parser);
+  streambuf.set_zero_copy(zero_copy);
+
+  int ext_frames = 0;
+  uint8_t *ptr = buf;
+  while (ptr < buf.end() || streambuf.need_flushing())
+  {
+    uint8_t *end = ptr + MIN(chunk_size, size_t(buf.end() - ptr));
+    bool loaded;
+    if (ptr < buf.end())
+      loaded = streambuf.load(&ptr, end);
+    else
+      loaded = streambuf.flush();
+
+    if (!loaded)
+      continue;
+
+    LoadState state;
+    state.in_sync = streambuf.is_in_sync();
+    state.new_stream = streambuf.is_new_stream();
+    state.debris.assign((const char *)streambuf.get_debris(), streambuf.get_debris_size());
+    state.frame.assign((const char *)streambuf.get_frame(), streambuf.get_frame_size());
+    result.push_back(state);
+
+    if (streambuf.has_frame() && streambuf.get_frame() >= buf.begin() && streambuf.get_frame() < buf.end())
+      ext_frames++;
+
+    memset(streambuf.get_frame(), 0, streambuf.get_frame_size());
+  }
+  return ext_frames;
+}
+
+static void zero_copy_test(FrameParser *parser, const uint8_t *data, size_t data_size, size_t chunk_size)
+{
+  std::vector<LoadState> ref, test;
+  int ref_ext = zero_copy_load(parser, false, data, data_size, chunk_size, ref);
+  int test_ext = zero_copy_load(parser, true, data, data_size, chunk_size, test);
+
+  BOOST_CHECK_EQUAL(ref_ext, 0);
+  BOOST_REQUIRE_EQUAL(ref.size(), test.size());
+  for (size_t i = 0; i < ref.size(); i++)
+    if (!(ref[i] == test[i]))
+      BOOST_FAIL("Output differs at load " << i);
+
+  // Some frames must not be copied when the chunk contains several frames
+  size_t frames = 0;
+  for (size_t i = 0; i < test.size(); i++)
+    if (test[i].frame.size())
+      frames++;
+  if (frames > 3 && chunk_size > 65536)
+    BOOST_CHECK(test_ext > 0);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 BOOST_AUTO_TEST_SUITE(stream_buffer)
@@ -481,6 +560,46 @@ BOOST_AUTO_TEST_CASE(noise_passthrough)
   passthrough_test(&uni,       noise, noise.size(), 0, 0);
 }
 
+BOOST_AUTO_TEST_CASE(zero_copy)
+{
+  ConstFrameSize   const_frame_size;
+  HeaderFrameSize  header_frame_size;
+  UnknownFrameSize unknown_frame_size;
+  UniFrameParser   uni;
+
+  struct {
+    const char *filename;
+    const char *parser_name;
+    FrameParser *parser;
+  } parsers[] = {
+    { "a.mp2.mix.mp2",   "ConstFrameSize",   &const_frame_size   },
+    { "a.mp2.mix.mp2",   "HeaderFrameSize",  &header_frame_size  },
+    { "a.mp2.mix.mp2",   "UnknownFrameSize", &unknown_frame_size },
+    { "a.mad.mix.mad",   "UniFrameParser",   &uni                },
+    { "a.mad.mix.spdif", "UniFrameParser",   &uni                },
+  };
+
+  // Chunk sizes: smaller than a frame, a few frames, the whole file
+  static const size_t chunk_size[] = { 1000, 4096, 100000, 0 };
+
+  for (size_t iparser = 0; iparser < array_size(parsers); iparser++)
+  {
+    BOOST_MESSAGE("Zero-copy test " << parsers[iparser].parser_name << " " << parsers[iparser].filename);
+
+    MemFile f(parsers[iparser].filename);
+    BOOST_REQUIRE(f);
+    for (size_t ichunk = 0; ichunk < array_size(chunk_size); ichunk++)
+      zero_copy_test(parsers[iparser].parser, f, f.size(),
+        chunk_size[ichunk]? chunk_size[ichunk]: f.size());
+  }
+
+  // Noise
+  RawNoise noise(noise_size, seed);
+  for (size_t ichunk = 0; ichunk < array_size(chunk_size); ichunk++)
+    zero_copy_test(&uni, noise, noise.size(),
+      chunk_size[ichunk]? chunk_size[ichunk]: noise.size());
+}
+
 BOOST_AUTO_TEST_CASE(bad_parser)
 {
   // Endless loop was possible when frame parser return frame size > max frame size.
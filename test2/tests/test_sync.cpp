@@ -0,0 +1,243 @@
+/*
+  SyncHelper class test
+  Filters must not allocate memory at process()
+*/
+
+#include <boost/test/unit_test.hpp>
+#include "filters/agc.h"
+#include "filters/bass_redir.h"
+#include "filters/convolver.h"
+#include "filters/delay.h"
+#include "filters/drc.h"
+#include "filters/gain.h"
+#include "filters/mixer.h"
+#include "filters/resample.h"
+#include "fir/param_fir.h"
+#include "source/generator.h"
+#include "sync.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocation counter
+// Counts heap allocations made between AllocCounter construction and stop()
+// call with the allocation hook of the debug CRT. The hook is installed only
+// while the counter runs. Allocation tests are skipped in other builds.
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#define HAS_ALLOC_COUNTER
+
+static int allocs = 0;
+
+static int __cdecl alloc_hook(int type, void *, size_t, int block_use, long, const unsigned char *, int)
+{
+  if (type != _HOOK_FREE && block_use != _CRT_BLOCK)
+    allocs++;
+  return 1; // allow the allocation
+}
+
+class AllocCounter
+{
+protected:
+  _CRT_ALLOC_HOOK old_hook;
+  bool running;
+
+public:
+  AllocCounter(): running(true)
+  {
+    allocs = 0;
+    old_hook = _CrtSetAllocHook(alloc_hook);
+  }
+
+  ~AllocCounter()
+  { stop(); }
+
+  int stop()
+  {
+    if (running)
+    {
+      _CrtSetAllocHook(old_hook);
+      running = false;
+    }
+    return allocs;
+  }
+};
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const int seed = 497287;
+static const Speakers spk(FORMAT_LINEAR, MODE_STEREO, 48000);
+
+#ifdef HAS_ALLOC_COUNTER
+// Process stamped chunks of different sizes through the filter and count
+// allocations after the warm-up.
+static int filter_allocs(Filter &f, Speakers spk)
+{
+  const size_t max_chunk = 4096;
+  const size_t warmup_chunks = 200;
+  const size_t test_chunks = 1000;
+
+  NoiseGen gen(spk, seed, max_chunk, max_chunk);
+  Chunk data, in, out;
+  gen.get_chunk(data);
+  f.open_throw(spk);
+
+  vtime_t time = 0;
+  int counted = 0;
+  for (size_t i = 0; i < warmup_chunks + test_chunks; i++)
+  {
+    size_t size = (i * 1237) % max_chunk + 1;
+    in.set_linear(data.samples, size, true, time);
+    time += vtime_t(size) / spk.sample_rate;
+
+    AllocCounter counter;
+    while (f.process(in, out))
+      ;
+    if (i >= warmup_chunks)
+      counted += counter.stop();
+  }
+  return counted;
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE(sync_helper)
+
+BOOST_AUTO_TEST_CASE(send_sync)
+{
+  SyncHelper sync;
+  samples_t samples;
+
+  // Data of the first chunk has no timestamp
+  Chunk in(samples, 100);
+  sync.receive_sync(in);
+  sync.put(100);
+
+  in.set_linear(samples, 100, true, 10.0);
+  sync.receive_sync(in);
+  BOOST_CHECK(!in.sync);
+  sync.put(100);
+
+  Chunk out(samples, 150);
+  sync.send_sync_linear(out, 100);
+  BOOST_CHECK(!out.sync);
+
+  out.set_linear(samples, 50);
+  sync.send_sync_linear(out, 100);
+  BOOST_CHECK(out.sync);
+  BOOST_CHECK_EQUAL(out.time, 10.5);
+
+  // Nothing queued
+  out.set_linear(samples, 10);
+  sync.send_sync_linear(out, 100);
+  BOOST_CHECK(!out.sync);
+}
+
+BOOST_AUTO_TEST_CASE(overflow)
+{
+  // Queue more timestamps than the ring can hold. Timestamps sent must stay
+  // correct.
+  const int n = SyncHelper::max_timestamps * 3;
+  SyncHelper sync;
+  samples_t samples;
+  Chunk in, out;
+
+  for (int i = 0; i < n; i++)
+  {
+    in.set_linear(samples, 10, true, i * 10);
+    sync.receive_sync(in);
+    sync.put(10);
+  }
+
+  // First timestamp is kept
+  out.set_linear(samples, 10);
+  sync.send_sync_linear(out, 1);
+  BOOST_CHECK(out.sync);
+  BOOST_CHECK_EQUAL(out.time, 0);
+
+  // Each timestamp sent matches the data position
+  int stamps = 1;
+  for (int i = 1; i < n; i++)
+  {
+    out.set_linear(samples, 10);
+    sync.send_sync_linear(out, 1);
+    if (out.sync)
+    {
+      BOOST_CHECK_EQUAL(out.time, i * 10);
+      stamps++;
+    }
+  }
+  BOOST_CHECK(stamps >= SyncHelper::max_timestamps - 1);
+  BOOST_CHECK(stamps < n);
+
+  // Overflow when the first timestamp is behind the buffer start
+  sync.reset();
+  for (int i = 0; i < n; i++)
+  {
+    in.set_linear(samples, 10, true, i * 10);
+    sync.receive_sync(in);
+    sync.put(10);
+    if (i == 0)
+      sync.drop(5);
+  }
+  out.set_linear(samples, 10);
+  sync.send_sync_linear(out, 1);
+  BOOST_CHECK(out.sync);
+  BOOST_CHECK_EQUAL(out.time, 5);
+}
+
+#ifdef HAS_ALLOC_COUNTER
+
+BOOST_AUTO_TEST_CASE(alloc_counter)
+{
+  AllocCounter counter;
+  delete new int;
+  delete[] new int[10];
+  BOOST_CHECK_EQUAL(counter.stop(), 2);
+
+  // Stopped counter does not count
+  delete new int;
+  BOOST_CHECK_EQUAL(counter.stop(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(no_alloc)
+{
+  // Steady state processing must not allocate memory
+
+  ParamFIR low_pass(ParamFIR::low_pass, 0.2, 0, 0.01, 100, true);
+  Convolver convolver(&low_pass);
+  BOOST_CHECK_EQUAL(filter_allocs(convolver, spk), 0);
+
+  AGC agc;
+  BOOST_CHECK_EQUAL(filter_allocs(agc, spk), 0);
+
+  DRC drc;
+  BOOST_CHECK_EQUAL(filter_allocs(drc, spk), 0);
+
+  Delay delay;
+  BOOST_CHECK_EQUAL(filter_allocs(delay, spk), 0);
+
+  Gain gain(0.5);
+  BOOST_CHECK_EQUAL(filter_allocs(gain, spk), 0);
+
+  BassRedir bass_redir;
+  bass_redir.set_enabled(true);
+  BOOST_CHECK_EQUAL(filter_allocs(bass_redir, spk), 0);
+
+  Mixer mixer(1024);
+  mixer.set_output(Speakers(FORMAT_LINEAR, MODE_5_1, 48000));
+  BOOST_CHECK_EQUAL(filter_allocs(mixer, spk), 0);
+
+  Resample resample(44100);
+  BOOST_CHECK_EQUAL(filter_allocs(resample, spk), 0);
+}
+
+#else
+
+BOOST_AUTO_TEST_CASE(no_alloc)
+{
+  BOOST_MESSAGE("Allocation counter requires the debug CRT, test skipped");
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
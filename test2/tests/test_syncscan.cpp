@@ -5,11 +5,14 @@
 #include <boost/test/unit_test.hpp>
 #include "../noise_buf.h"
 #include "syncscan.h"
+#include "parsers/uni/uni_frame_parser.h"
+#include "win32/cpu.h"
 
 using std::string;
 
 static const int seed = 98374592;
 static const size_t noise_size = 1024; // for sync scan test
+static const vtime_t time_per_test = 0.5; // for speed tests
 
 // Test trie that contains all node types
 static const string test_trie("oix*R*OIL*AD");
@@ -546,4 +549,273 @@ BOOST_AUTO_TEST_CASE(scan_pos)
     }
 }
 
+BOOST_AUTO_TEST_CASE(scan_pos_formats)
+{
+  // Scanner must find exactly the same syncpoints as is_sync() at each
+  // position. Check tries of real formats with many sync words in the
+  // buffer (including byte-swapped and 14bit DTS).
+  static const uint32_t sync_words[] =
+  {
+    0x0b770b77, 0x770b770b, 0x7ffe8001, 0xfe7f0180,
+    0x1fffe800, 0xff1f00e8, 0xfffbfffb, 0xfbfffbff,
+    0x72f81f4e, 0x00000000, 0xfff1fff1
+  };
+
+  UniFrameParser uni;
+  SyncTrie tries[] =
+  {
+    uni.sync_info().sync_trie,
+    uni.ac3.sync_info().sync_trie,
+    uni.dts.sync_info().sync_trie,
+    uni.mpa.sync_info().sync_trie,
+    uni.spdif.sync_info().sync_trie,
+    uni.adts.sync_info().sync_trie,
+    uni.mlp.sync_info().sync_trie,
+  };
+
+  const size_t buf_size = 65536;
+  RawNoise buf(buf_size, seed);
+  for (int i = 0; i < 1000; i++)
+  {
+    uint32_t sync = sync_words[buf.rng.get_range(array_size(sync_words))];
+    size_t pos = buf.rng.get_range(buf_size - 4);
+    buf[pos+0] = (uint8_t)(sync >> 24);
+    buf[pos+1] = (uint8_t)(sync >> 16);
+    buf[pos+2] = (uint8_t)(sync >> 8);
+    buf[pos+3] = (uint8_t)(sync);
+  }
+
+  for (size_t i = 0; i < array_size(tries); i++)
+  {
+    SyncScan s(tries[i]);
+
+    // Check different buffer ends to test the tail processing
+    for (size_t size = buf_size - 40; size <= buf_size; size++)
+    {
+      size_t pos = 0;
+      size_t expected = 0;
+      while (true)
+      {
+        while (expected + s.sync_size() <= size && !s.is_sync(buf + expected))
+          expected++;
+
+        bool result = s.scan_pos(buf, size, pos);
+        if (expected + s.sync_size() > size)
+        {
+          BOOST_REQUIRE(!result);
+          BOOST_REQUIRE_EQUAL(pos, size - s.sync_size() + 1);
+          break;
+        }
+
+        BOOST_REQUIRE(result);
+        BOOST_REQUIRE_EQUAL(pos, expected);
+        pos++;
+        expected++;
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(is_sync)
+{
+  // DFA must give the same result as the trie
+  SyncTrie tries[] =
+  {
+    SyncTrie(test_trie),
+    SyncTrie(0xff, 8) + SyncTrie(4) + SyncTrie(0x5, 3),
+    UniFrameParser().sync_info().sync_trie,
+    MlpFrameParser().sync_info().sync_trie,
+  };
+
+  RawNoise buf(noise_size * 64, seed);
+  for (size_t i = 0; i < array_size(tries); i++)
+  {
+    SyncScan s(tries[i]);
+    for (size_t pos = 0; pos + s.sync_size() <= buf.size(); pos++)
+      BOOST_REQUIRE_EQUAL(s.is_sync(buf + pos), tries[i].is_sync(buf + pos));
+  }
+
+  // Each byte for the test trie
+  SyncScan s((SyncTrie(test_trie)));
+  for (int i = 0; i < 256; i++)
+  {
+    uint8_t byte = (uint8_t)i;
+    BOOST_CHECK_EQUAL(s.is_sync(&byte), test_sync[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(speed)
+{
+  // Throughput of the scanner and of the syncpoint check.
+  // Syncpoint check is compared for the trie and the DFA.
+  struct {
+    const char *name;
+    SyncTrie trie;
+  } tries[] = {
+    { "uni",   UniFrameParser().sync_info().sync_trie },
+    { "ac3",   AC3FrameParser().sync_info().sync_trie },
+    { "dts",   DTSFrameParser().sync_info().sync_trie },
+    { "mpa",   MPAFrameParser().sync_info().sync_trie },
+    { "spdif", SPDIFFrameParser().sync_info().sync_trie },
+    { "mlp",   MlpFrameParser().sync_info().sync_trie },
+  };
+
+  // Buffer full of sync words to make the check expensive
+  const size_t buf_size = 1024 * 1024;
+  RawNoise buf(buf_size, seed);
+  for (size_t i = 0; i + 4 <= buf_size; i += 4)
+  {
+    buf[i+0] = 0x7f; buf[i+1] = 0xfe;
+    buf[i+2] = 0x80; buf[i+3] = 0x01;
+  }
+
+  for (size_t i = 0; i < array_size(tries); i++)
+  {
+    SyncScan s(tries[i].trie);
+    const SyncTrie &t = s.get_trie();
+    const size_t check_size = buf_size - s.sync_size() + 1;
+    CPUMeter cpu;
+    int runs;
+
+    // Scan random noise
+    RawNoise noise(buf_size, seed);
+    runs = 0;
+    cpu.reset();
+    cpu.start();
+    while (cpu.get_thread_time() < time_per_test)
+    {
+      size_t pos = 0;
+      while (s.scan_pos(noise, buf_size, pos))
+        pos++;
+      runs++;
+    }
+    cpu.stop();
+    double scan_speed = double(buf_size) * runs / cpu.get_thread_time() / 1000000;
+
+    // Check each position with the trie
+    size_t trie_count = 0;
+    runs = 0;
+    cpu.reset();
+    cpu.start();
+    while (cpu.get_thread_time() < time_per_test)
+    {
+      trie_count = 0;
+      for (size_t pos = 0; pos < check_size; pos++)
+        if (t.is_sync(buf + pos))
+          trie_count++;
+      runs++;
+    }
+    cpu.stop();
+    double trie_speed = double(check_size) * runs / cpu.get_thread_time() / 1000000;
+
+    // Check each position with the DFA
+    size_t dfa_count = 0;
+    runs = 0;
+    cpu.reset();
+    cpu.start();
+    while (cpu.get_thread_time() < time_per_test)
+    {
+      dfa_count = 0;
+      for (size_t pos = 0; pos < check_size; pos++)
+        if (s.is_sync(buf + pos))
+          dfa_count++;
+      runs++;
+    }
+    cpu.stop();
+    double dfa_speed = double(check_size) * runs / cpu.get_thread_time() / 1000000;
+
+    BOOST_CHECK_EQUAL(trie_count, dfa_count);
+    BOOST_MESSAGE("Sync " << tries[i].name << ": scan " << int(scan_speed) << "MB/s, "
+      "check trie " << int(trie_speed) << "M/s, dfa " << int(dfa_speed) << "M/s");
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+///////////////////////////////////////////////////////////////////////////////
+// MultiSyncScan test
+///////////////////////////////////////////////////////////////////////////////
+
+BOOST_AUTO_TEST_SUITE(multi_sync_scan)
+
+BOOST_AUTO_TEST_CASE(constructor)
+{
+  MultiSyncScan s;
+  BOOST_CHECK(s.is_empty());
+  BOOST_CHECK_EQUAL(s.sync_size(), 0);
+
+  uint8_t buf[4] = { 0, 0, 0, 0 };
+  BOOST_CHECK_EQUAL(s.find_sync(buf), 0);
+}
+
+BOOST_AUTO_TEST_CASE(set_tries)
+{
+  UniFrameParser uni;
+  MultiSyncScan s;
+
+  // Too many tries
+  std::vector<SyncTrie> tries(MultiSyncScan::max_tries + 1, SyncTrie(0x0b77, 16));
+  BOOST_CHECK(!s.set_tries(&tries[0], tries.size()));
+  BOOST_CHECK(s.is_empty());
+
+  tries.resize(MultiSyncScan::max_tries);
+  BOOST_CHECK(s.set_tries(&tries[0], tries.size()));
+  BOOST_CHECK_EQUAL(s.sync_size(), 2);
+
+  uint8_t ac3[2] = { 0x0b, 0x77 };
+  BOOST_CHECK_EQUAL(s.find_sync(ac3), (1u << MultiSyncScan::max_tries) - 1);
+
+  s.clear();
+  BOOST_CHECK(s.is_empty());
+}
+
+BOOST_AUTO_TEST_CASE(find_sync)
+{
+  // Set of tries matched must be the same as matched by each trie
+  UniFrameParser uni;
+  SyncTrie tries[] =
+  {
+    uni.adts.sync_info().sync_trie,
+    uni.ac3.sync_info().sync_trie,
+    uni.dts.sync_info().sync_trie,
+    uni.eac3.sync_info().sync_trie,
+    uni.mpa.sync_info().sync_trie,
+    uni.mlp.sync_info().sync_trie,
+    uni.truehd.sync_info().sync_trie,
+    uni.spdif.sync_info().sync_trie,
+    SyncTrie(test_trie),
+  };
+
+  MultiSyncScan s;
+  BOOST_REQUIRE(s.set_tries(tries, array_size(tries)));
+
+  static const uint32_t sync_words[] =
+  {
+    0x0b770b77, 0x770b770b, 0x7ffe8001, 0xfe7f0180,
+    0x1fffe800, 0xff1f00e8, 0xfffbfffb, 0xfbfffbff,
+    0x72f81f4e, 0x00000000, 0xfff1fff1, 0xf8726fba
+  };
+
+  const size_t buf_size = 65536;
+  RawNoise buf(buf_size, seed);
+  for (int i = 0; i < 4000; i++)
+  {
+    uint32_t sync = sync_words[buf.rng.get_range(array_size(sync_words))];
+    size_t pos = buf.rng.get_range(buf_size - 4);
+    buf[pos+0] = (uint8_t)(sync >> 24);
+    buf[pos+1] = (uint8_t)(sync >> 16);
+    buf[pos+2] = (uint8_t)(sync >> 8);
+    buf[pos+3] = (uint8_t)(sync);
+  }
+
+  for (size_t pos = 0; pos + s.sync_size() <= buf_size; pos++)
+  {
+    uint32_t set = 0;
+    for (size_t i = 0; i < array_size(tries); i++)
+      if (tries[i].is_sync(buf + pos))
+        set |= 1 << i;
+    BOOST_REQUIRE_EQUAL(s.find_sync(buf + pos), set);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
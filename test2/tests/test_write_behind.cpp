@@ -0,0 +1,128 @@
+/*
+  WriteBehindFile class test
+*/
+
+#include "write_behind.h"
+#include "../noise_buf.h"
+#include <boost/test/unit_test.hpp>
+
+static const int seed = 583921;
+
+static const char *temp_file = "temp.tmp";
+static const size_t temp_file_size = 1000000;
+
+static bool check_file(const char *filename, const uint8_t *data, size_t size)
+{
+  AutoFile f(filename);
+  if (!f.is_open() || f.size() != size)
+    return false;
+
+  Rawdata buf(size);
+  return f.read(buf, size) == size && memcmp(buf, data, size) == 0;
+}
+
+BOOST_AUTO_TEST_SUITE(write_behind)
+
+BOOST_AUTO_TEST_CASE(default_constructor)
+{
+  WriteBehindFile f;
+  BOOST_CHECK( !f.is_open() );
+  BOOST_CHECK( !f.is_error() );
+  BOOST_CHECK( f.pos() == 0 );
+}
+
+BOOST_AUTO_TEST_CASE(open_fail)
+{
+  AutoFile closed;
+  AutoFile file(temp_file, "wb");
+  BOOST_REQUIRE(file.is_open());
+
+  WriteBehindFile f;
+  BOOST_CHECK( !f.open(0, 1000, 2) );
+  BOOST_CHECK( !f.open(&closed, 1000, 2) );
+
+  // Bad parameters
+  BOOST_CHECK( !f.open(&file, 1000, 1) );
+  BOOST_CHECK( !f.open(&file, 0, 2) );
+  BOOST_CHECK( !f.is_open() );
+
+  BOOST_CHECK_EQUAL(f.write("x", 1), 0);
+  BOOST_CHECK(f.flush() != 0);
+  BOOST_CHECK(f.seek(0) != 0);
+
+  file.close();
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(write)
+{
+  RawNoise ref(temp_file_size, seed);
+
+  const struct { size_t buf_size; int depth; size_t block_size; int flags; } params[] = {
+    { 1, 2, 1, 0 },
+    { 1000, 2, 100, 0 },
+    { 1000, 2, 4096, 0 },
+    { 4096, 4, 1000, WRITE_BEHIND_DIRECT },
+    { 65536, 8, 65536, 0 },
+    { 65536, 2, 10000, WRITE_BEHIND_SYNC },
+    { temp_file_size, 2, temp_file_size, 0 },
+  };
+
+  for (size_t i = 0; i < array_size(params); i++)
+  {
+    AutoFile file(temp_file, "wb");
+    BOOST_REQUIRE(file.is_open());
+
+    WriteBehindFile f;
+    BOOST_REQUIRE( f.open(&file, params[i].buf_size, params[i].depth, params[i].flags) );
+
+    size_t pos = 0;
+    while (pos < temp_file_size)
+    {
+      size_t size = MIN(params[i].block_size, temp_file_size - pos);
+      BOOST_REQUIRE_EQUAL(f.write(ref + pos, size), size);
+      pos += size;
+      BOOST_REQUIRE(f.pos() == pos);
+    }
+    BOOST_CHECK_EQUAL(f.flush(), 0);
+    BOOST_CHECK(!f.is_error());
+    BOOST_CHECK(f.get_buffers() >= int(temp_file_size / params[i].buf_size));
+    BOOST_CHECK(f.get_stalls() <= f.get_buffers());
+
+    f.close();
+    file.close();
+    BOOST_CHECK(check_file(temp_file, ref, temp_file_size));
+  }
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_CASE(zeros_and_seek)
+{
+  RawNoise ref(temp_file_size, seed);
+  memset(ref + 1000, 0, 5000);
+
+  AutoFile file(temp_file, "wb");
+  BOOST_REQUIRE(file.is_open());
+
+  // Leave a hole for the header, fill it after the data is written
+  WriteBehindFile f;
+  BOOST_REQUIRE( f.open(&file, 4096, 3) );
+  BOOST_REQUIRE_EQUAL(f.write_zeros(100), 100);
+  BOOST_REQUIRE_EQUAL(f.write(ref + 100, 900), 900);
+  BOOST_REQUIRE_EQUAL(f.write_zeros(5000), 5000);
+  BOOST_REQUIRE_EQUAL(f.write(ref + 6000, temp_file_size - 6000), temp_file_size - 6000);
+  BOOST_CHECK(f.pos() == temp_file_size);
+
+  BOOST_REQUIRE_EQUAL(f.seek(0), 0);
+  BOOST_REQUIRE_EQUAL(f.write(ref, 100), 100);
+  BOOST_CHECK(f.pos() == 100);
+
+  f.close();
+  file.close();
+  BOOST_CHECK(check_file(temp_file, ref, temp_file_size));
+
+  AutoFile::remove(temp_file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
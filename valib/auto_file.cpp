@@ -129,6 +129,22 @@ AutoFile::close()
   filesize = 0;
 }
 
+size_t
+AutoFile::write_zeros(size_t size)
+{
+  static const uint8_t zeros[4096] = { 0 };
+  size_t written = 0;
+  while (written < size)
+  {
+    size_t chunk_size = MIN(size - written, sizeof(zeros));
+    size_t result = write(zeros, chunk_size);
+    written += result;
+    if (result < chunk_size)
+      break;
+  }
+  return written;
+}
+
 int
 AutoFile::seek(fsize_t _pos)
 {
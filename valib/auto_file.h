@@ -88,6 +88,10 @@
   \fn void AutoFile::close()
     Close the file.
 
+  \fn bool AutoFile::is_own() const
+    Returns true when the file was opened by the object or its ownership was
+    taken, i.e. the file is closed by the object.
+
   \fn size_t AutoFile::read(void *buf, size_t size)
     \param buf  Buffer to read to.
     \param size Size fo data to read.
@@ -107,6 +111,12 @@
 
     Returns number of bytes it actually wrote.
 
+  \fn size_t AutoFile::write_zeros(size_t size)
+    \param size Number of zero bytes to write.
+    \return     Number of actually written bytes.
+
+    Write 'size' zero bytes (padding) without allocating a buffer.
+
   \fn bool AutoFile::is_open() const
     \return Returns true when file is open and false otherwise.
 
@@ -187,9 +197,11 @@ public:
 
   inline size_t  read(void *buf, size_t size)        { return fread(buf, 1, size, f);  }
   inline size_t  write(const void *buf, size_t size) { return fwrite(buf, 1, size, f); }
-  inline int     flush()                             { fflush(f);                      }
+  size_t write_zeros(size_t size);
+  inline int     flush()                             { return fflush(f);               }
 
   inline bool    is_open()  const { return f != 0;                }
+  inline bool    is_own()   const { return f != 0 && own_file;    }
   inline bool    eof()      const { return f? feof(f) != 0: true; }
   inline fsize_t size()     const { return filesize;              }
   inline bool    is_large() const { return is_large(filesize);    }
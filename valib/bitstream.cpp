@@ -1,16 +1,20 @@
 #include <memory.h>
 #include "bitstream.h"
 
+#ifdef VALIB_SSE2
+#include <emmintrin.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 
 ReadBS::ReadBS(): 
   start(0), start_bit(0), size_bits(0),
-  pos(0), current_word(0), bits_left(0)
+  pos(0), end(0), cache(0), bits_left(cache_bits)
 {}
 
 ReadBS::ReadBS(const uint8_t *buf_, size_t start_bit_, size_t size_bits_): 
   start(0), start_bit(0), size_bits(0),
-  pos(0), current_word(0), bits_left(0)
+  pos(0), end(0), cache(0), bits_left(cache_bits)
 {
   set(buf_, start_bit_, size_bits_);
 }
@@ -18,10 +22,10 @@ ReadBS::ReadBS(const uint8_t *buf_, size_t start_bit_, size_t size_bits_):
 void 
 ReadBS::set(const uint8_t *buf_, size_t start_bit_, size_t size_bits_)
 {
-  size_t align = align32(buf_);
-  start = (const uint32_t *)(buf_ - align);
-  start_bit = start_bit_ + align * 8;
+  start = buf_;
+  start_bit = start_bit_;
   size_bits = size_bits_;
+  end = (start_bit + size_bits + 7) / 8;
 
   set_pos_bits(0);
 }
@@ -31,61 +35,60 @@ ReadBS::set_pos_bits(size_t pos_bits)
 {
   assert(pos_bits <= size_bits);
 
-  pos = start + (start_bit + pos_bits) / 32;
-  bits_left = 32 - ((start_bit + pos_bits) & 0x1f);
-  current_word = be2uint32(*pos);
-  pos++;
+  pos = (start_bit + pos_bits) / 8;
+  bits_left = cache_bits - ((start_bit + pos_bits) & 7);
+  load();
 }
 
-uint32_t
-ReadBS::get_next(unsigned num_bits)
+void
+ReadBS::load_tail()
 {
-  uint32_t result;
-  result = (current_word << (32 - bits_left)) >> (32 - bits_left);
-  num_bits -= bits_left;
-
-  current_word = be2uint32(*pos);
-  bits_left = 32;
-  pos++;
-
-  if (num_bits != 0)
-    result = (result << num_bits) | (current_word >> (32 - num_bits));
-
-  bits_left -= num_bits;
-
-  return result;
+  // Load byte by byte, pad with zeros after the end
+  cache = 0;
+  for (size_t i = pos; i < pos + sizeof(cache_t); i++)
+  {
+    cache <<= 8;
+    if (i < end)
+      cache |= start[i];
+  }
 }
 
-int32_t
-ReadBS::get_next_signed(unsigned num_bits)
+uint32_t
+ReadBS::get_long(unsigned num_bits)
 {
-  int32_t result;
-
-  result = int32_t(current_word << (32 - bits_left)) >> (32 - bits_left);
-  num_bits -= bits_left;
-
-  current_word = be2uint32(*pos);
-  bits_left = 32;
-  pos++;
-
-  if (num_bits != 0)
-    result = (result << num_bits) | (current_word >> (32 - num_bits));
-        
-  bits_left -= num_bits;
+  // Only 32-bit cache may have not enough bits after the refill
+  uint32_t high = get(num_bits - 16);
+  return (high << 16) | get(16);
+}
 
-  return result;
+uint32_t
+ReadBS::peek_long(unsigned num_bits)
+{
+  // May look after the end of the stream, so get() cannot be used
+  size_t old_pos = pos;
+  cache_t old_cache = cache;
+  unsigned old_bits_left = bits_left;
+
+  uint32_t high = peek(num_bits - 16);
+  bits_left -= num_bits - 16;
+  uint32_t low = peek(16);
+
+  pos = old_pos;
+  cache = old_cache;
+  bits_left = old_bits_left;
+  return (high << 16) | low;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 WriteBS::WriteBS(): 
   start(0), start_bit(0), size_bits(0),
-  pos(0), current_word(0), bits_left(0)
+  pos(0), cache(0), bits_left(64)
 {}
 
 WriteBS::WriteBS(uint8_t *buf_, size_t start_bit_, size_t size_bits_): 
   start(0), start_bit(0), size_bits(0),
-  pos(0), current_word(0), bits_left(0)
+  pos(0), cache(0), bits_left(64)
 {
   set(buf_, start_bit_, size_bits_);
 }
@@ -93,9 +96,8 @@ WriteBS::WriteBS(uint8_t *buf_, size_t start_bit_, size_t size_bits_):
 void 
 WriteBS::set(uint8_t *buf_, size_t start_bit_, size_t size_bits_)
 {
-  size_t align = align32(buf_);
-  start = (uint32_t *)(buf_ - align);
-  start_bit = start_bit_ + align * 8;
+  start = buf_;
+  start_bit = start_bit_;
   size_bits = size_bits_;
 
   move(0);
@@ -106,12 +108,13 @@ WriteBS::move(size_t pos_bits)
 {
   assert(pos_bits <= size_bits);
 
-  pos = start + (start_bit + pos_bits) / 32;
-  current_word = 0;
-  bits_left = 32 - ((start_bit + pos_bits) & 0x1f);
+  // Keep the bits before the position at the first byte
+  pos = (start_bit + pos_bits) / 8;
+  bits_left = 64 - ((start_bit + pos_bits) & 7);
+  cache = 0;
 
-  if (bits_left < 32)
-    current_word = (be2uint32(*pos) >> bits_left) << bits_left;
+  if (bits_left < 64)
+    cache = uint64_t(start[pos] >> (bits_left - 56)) << bits_left;
 }
 
 void 
@@ -124,27 +127,40 @@ WriteBS::set_pos_bits(size_t pos_bits)
 void
 WriteBS::put_next(unsigned num_bits, uint32_t value)
 {
+  // Store the full cache and keep the rest of the value
   num_bits -= bits_left;
-  current_word = current_word | (value >> num_bits);
-
-  *pos = uint2be32(current_word);
-  pos++;
+  cache |= uint64_t(value) >> num_bits;
 
-  current_word = 0;
-  bits_left = 32 - num_bits;
+  uint32_t w[2];
+  w[0] = uint2be32(uint32_t(cache >> 32));
+  w[1] = uint2be32(uint32_t(cache));
+  memcpy(start + pos, w, sizeof(w));
+  pos += 8;
 
-  if (num_bits != 0)
-    current_word = value << bits_left;
+  // Double shift works for num_bits = 0
+  bits_left = 64 - num_bits;
+  cache = (uint64_t(value) << 32) << (bits_left - 32);
 }
 
 void
 WriteBS::flush()
 {
-  if (bits_left < 32)
+  // Whole bytes
+  uint64_t data = cache;
+  size_t i = pos;
+  unsigned bits = 64 - bits_left;
+  while (bits >= 8)
+  {
+    start[i++] = uint8_t(data >> 56);
+    data <<= 8;
+    bits -= 8;
+  }
+
+  // Partial byte, keep the bits after the position
+  if (bits)
   {
-    uint32_t temp = be2uint32(*pos);
-    temp = current_word | ((temp << (32 - bits_left)) >> (32 - bits_left));
-    *pos = uint2be32(temp);
+    uint8_t mask = uint8_t(0xff >> bits);
+    start[i] = uint8_t(data >> 56) | (start[i] & mask);
   }
 }
 
@@ -223,21 +239,40 @@ size_t bs_conv_swab16(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
   uint16_t *in16 = (uint16_t *)in_buf;
   uint16_t *out16 = (uint16_t *)out_buf;
   size_t i = size >> 1;
+  size_t n = 0;
 
   if (size & 1)
     out16[i] = swab_u16(in_buf[size-1]);
 
-  while (i--)
+#ifdef VALIB_SSE2
+  for (n = 0; n + 8 <= i; n += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i *)(in16 + n));
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    _mm_storeu_si128((__m128i *)(out16 + n), x);
+  }
+#endif
+
+  while (i-- > n)
     out16[i] = swab_u16(in16[i]);
 
   return size;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-//                               byte <-> 14be
+//                          14bit stream conversions
 ///////////////////////////////////////////////////////////////////////////////
-
-size_t bs_conv_8_14be(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+// 14le stream is a byte-swapped 14be stream, so all conversions are built
+// from packing (byte -> 14bit) and unpacking (14bit -> byte) with optional
+// byte swaps. Swaps are done on the fly, so 16le <-> 14bit conversions pass
+// the data only once.
+//
+// SSE2 version converts the main part of the stream by pairs of groups
+// (14 bytes <-> 16 bytes). The rest of the stream (including the partial
+// group at the end) is converted with the generic code.
+
+template <bool le>
+static size_t pack_14(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
 {
   // We expand the buffer size so output buffer size MUST BE LARGER than
   // input size specified.
@@ -263,15 +298,22 @@ size_t bs_conv_8_14be(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
   if (r)
   {
     // copy frame's tail and zero the rest
+    // (temporary buffer is required because dst and src may overlap)
+    uint8_t tail[8];
     size_t i = 0;
-    for (; i < r; i++) dst[i] = src[i];
-    for (; i < 7; i++) dst[i] = 0;
+    for (; i < r; i++) tail[i] = src[i];
+    for (; i < 8; i++) tail[i] = 0;
 
     // convert frame's tail
-    uint32_t w1 = be2int32(*(uint32_t *)(dst + 0));
-    uint32_t w2 = be2int32(*(uint32_t *)(dst + 3));
+    uint32_t w1 = be2int32(*(uint32_t *)(tail + 0));
+    uint32_t w2 = be2int32(*(uint32_t *)(tail + 3));
     w1 = ((w1 >> 2) & 0x3fff0000) | ((w1 >> 4) & 0x00003fff);
     w2 = ((w2 << 2) & 0x3fff0000) | (w2 & 0x00003fff);
+    if (le)
+    {
+      w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
+      w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
+    }
     (*(uint32_t *)(dst + 0)) = int2be32(w1);
     (*(uint32_t *)(dst + 4)) = int2be32(w2);
   }
@@ -284,6 +326,11 @@ size_t bs_conv_8_14be(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
     uint32_t w2 = be2int32(*(uint32_t *)(src + 3));
     w1 = ((w1 >> 2) & 0x3fff0000) | ((w1 >> 4) & 0x00003fff);
     w2 = ((w2 << 2) & 0x3fff0000) | (w2 & 0x00003fff);
+    if (le)
+    {
+      w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
+      w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
+    }
     (*(uint32_t *)(dst + 0)) = int2be32(w1);
     (*(uint32_t *)(dst + 4)) = int2be32(w2);
 
@@ -294,7 +341,8 @@ size_t bs_conv_8_14be(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
   return size;
 }
 
-size_t bs_conv_14be_8(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+template <bool le>
+static size_t unpack_14(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
 {
   // Input frame size MUST BE EVEN!!!
   assert((size & 1) == 0);
@@ -315,6 +363,11 @@ size_t bs_conv_14be_8(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
   {
     uint32_t w1 = be2int32(*(uint32_t *)(src + 0));
     uint32_t w2 = be2int32(*(uint32_t *)(src + 4));
+    if (le)
+    {
+      w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
+      w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
+    }
     w2 = ((w2 & 0x3fff0000) >> 2) | (w2 & 0x00003fff) | (w1 << 28);
     w1 = ((w1 & 0x3fff0000) << 2) | ((w1 & 0x00003fff) << 4);
     (*(uint32_t *)(dst + 0)) = int2be32(w1);
@@ -332,6 +385,11 @@ size_t bs_conv_14be_8(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
 
     uint32_t w1 = be2int32(*(uint32_t *)(dst + 0));
     uint32_t w2 = be2int32(*(uint32_t *)(dst + 4));
+    if (le)
+    {
+      w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
+      w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
+    }
     w2 = ((w2 & 0x3fff0000) >> 2) | (w2 & 0x00003fff) | (w1 << 28);
     w1 = ((w1 & 0x3fff0000) << 2) | ((w1 & 0x00003fff) << 4);
     (*(uint32_t *)(dst + 0)) = int2be32(w1);
@@ -341,150 +399,234 @@ size_t bs_conv_14be_8(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
   return size;
 }
 
+#ifdef VALIB_SSE2
+
 ///////////////////////////////////////////////////////////////////////////////
-//                               byte <-> 14le
-///////////////////////////////////////////////////////////////////////////////
+// SSE2 version
+//
+// pack_pair: 14 bytes at src -> 16 bytes at dst. Reads 16 bytes at src.
+// unpack_pair: 16 bytes at src -> 14 bytes at dst. Writes 16 bytes at dst.
+//
+// Each 64bit lane holds one group of 7 bytes as a big-endian number
+// (b0 b1 b2 b3 b4 b5 b6 0), 14bit words are cut from it with shifts.
+
+// Swap bytes in 16bit words
+static inline __m128i swab16_sse2(__m128i x)
+{
+  return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
 
+// Reverse 16bit words in 64bit lanes
+static inline __m128i rev_words_sse2(__m128i x)
+{
+  x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+  return _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+}
 
-size_t bs_conv_8_14le(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+template <bool swab_in, bool le>
+static inline void pack_pair(const uint8_t *src, uint8_t *dst)
 {
-  // We expand the buffer size so output buffer size MUST BE LARGER than
-  // input size specified.
+  const __m128i m0 = _mm_set_epi32(0x3fff0000, 0, 0x3fff0000, 0);
+  const __m128i m1 = _mm_set_epi32(0x00003fff, 0, 0x00003fff, 0);
+  const __m128i m2 = _mm_set_epi32(0, 0x3fff0000, 0, 0x3fff0000);
+  const __m128i m3 = _mm_set_epi32(0, 0x00003fff, 0, 0x00003fff);
+
+  __m128i x = _mm_loadu_si128((const __m128i *)src);
+  if (swab_in)
+    x = swab16_sse2(x);
+
+  x = _mm_unpacklo_epi64(x, _mm_srli_si128(x, 7));
+  x = rev_words_sse2(swab16_sse2(x));
+
+  x = _mm_or_si128(
+    _mm_or_si128(
+      _mm_and_si128(_mm_srli_epi64(x, 2), m0),
+      _mm_and_si128(_mm_srli_epi64(x, 4), m1)),
+    _mm_or_si128(
+      _mm_and_si128(_mm_srli_epi64(x, 6), m2),
+      _mm_and_si128(_mm_srli_epi64(x, 8), m3)));
+
+  x = rev_words_sse2(x);
+  if (!le)
+    x = swab16_sse2(x);
+
+  _mm_storeu_si128((__m128i *)dst, x);
+}
 
-  // We can do inplace conversion. You can specify the same input and output
-  // buffer pointers.
+template <bool le, bool swab_out>
+static inline void unpack_pair(const uint8_t *src, uint8_t *dst)
+{
+  const __m128i m0 = _mm_set_epi32(0x3fff0000, 0, 0x3fff0000, 0);
+  const __m128i m1 = _mm_set_epi32(0x00003fff, 0, 0x00003fff, 0);
+  const __m128i m2 = _mm_set_epi32(0, 0x3fff0000, 0, 0x3fff0000);
+  const __m128i m3 = _mm_set_epi32(0, 0x00003fff, 0, 0x00003fff);
+  const __m128i lo7 = _mm_set_epi32(0, 0, 0x00ffffff, -1);
+  const __m128i hi7 = _mm_set_epi32(0x0000ffff, -1, (int)0xff000000, 0);
+
+  __m128i x = _mm_loadu_si128((const __m128i *)src);
+  if (!le)
+    x = swab16_sse2(x);
+  x = rev_words_sse2(x);
+
+  x = _mm_or_si128(
+    _mm_or_si128(
+      _mm_slli_epi64(_mm_and_si128(x, m0), 2),
+      _mm_slli_epi64(_mm_and_si128(x, m1), 4)),
+    _mm_or_si128(
+      _mm_slli_epi64(_mm_and_si128(x, m2), 6),
+      _mm_slli_epi64(_mm_and_si128(x, m3), 8)));
+
+  // join 7-byte lanes
+  x = rev_words_sse2(swab16_sse2(x));
+  x = _mm_or_si128(_mm_and_si128(x, lo7), _mm_and_si128(_mm_srli_si128(x, 1), hi7));
+  if (swab_out)
+    x = swab16_sse2(x);
+
+  _mm_storeu_si128((__m128i *)dst, x);
+}
 
-  // We convert each 7 bytes into 4 16bit words with 14 data bits each.
-  // If input frame size is not multiply of 7 we add zeros to the end of the
-  // frame to form integral number of 16bit (14bit) words. So output frame
-  // size is always even. But in this case exact backward conversion is not
-  // possible!
+template <bool swab_in, bool le>
+static size_t pack(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+{
+  // Output is larger than input, so convert from the end. pack_pair reads
+  // 2 bytes after the pair, so pairs must end 2 bytes before the end.
+  size_t pairs = size >= 2? (size - 2) / 14: 0;
+  size_t pos = pairs * 14;
+
+  // Rest of the stream
+  uint8_t buf[16];
+  size_t rest = size - pos;
+  assert(rest < sizeof(buf));
+  if (swab_in)
+    bs_conv_swab16(in_buf + pos, rest, buf);
+  else
+    memcpy(buf, in_buf + pos, rest);
+  size = pairs * 16 + pack_14<le>(buf, rest, out_buf + pairs * 16);
 
-  static const int inc[7] = { 0, 2, 4, 4, 6, 6, 8 };
+  // Main part
+  while (pairs--)
+    pack_pair<swab_in, le>(in_buf + pairs * 14, out_buf + pairs * 16);
 
-  size_t n = size / 7;
-  size_t r = size % 7;
-  const uint8_t *src = in_buf + n * 7;
-  uint8_t *dst = out_buf + n * 8;
+  return size;
+}
 
-  size = n * 8 + inc[r];
+template <bool le, bool swab_out>
+static size_t unpack(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+{
+  // Input frame size MUST BE EVEN!!!
+  assert((size & 1) == 0);
 
-  if (r)
-  {
-    // copy frame's tail and zero the rest
-    size_t i = 0;
-    for (; i < r; i++) dst[i] = src[i];
-    for (; i < 7; i++) dst[i] = 0;
+  // unpack_pair writes 2 bytes after the pair, so at least 2 bytes of
+  // input must stay for the rest to overwrite them.
+  size_t pairs = size >= 2? (size - 2) / 16: 0;
+  size_t pos = pairs * 16;
 
-    // convert frame's tail
-    uint32_t w1 = be2int32(*(uint32_t *)(dst + 0));
-    uint32_t w2 = be2int32(*(uint32_t *)(dst + 3));
-    w1 = ((w1 >> 2) & 0x3fff0000) | ((w1 >> 4) & 0x00003fff);
-    w2 = ((w2 << 2) & 0x3fff0000) | (w2 & 0x00003fff);
-    w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
-    w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
-    (*(uint32_t *)(dst + 0)) = int2be32(w1);
-    (*(uint32_t *)(dst + 4)) = int2be32(w2);
-  }
+  // Main part
+  for (size_t i = 0; i < pairs; i++)
+    unpack_pair<le, swab_out>(in_buf + i * 16, out_buf + i * 14);
 
-  src -= 7;
-  dst -= 8;
-  while (n--)
+  // Rest of the stream
+  uint8_t *dst = out_buf + pairs * 14;
+  size_t rest = unpack_14<le>(in_buf + pos, size - pos, dst);
+  if (swab_out)
+    bs_conv_swab16(dst, rest, dst);
+
+  return pairs * 14 + rest;
+}
+
+#else
+
+///////////////////////////////////////////////////////////////////////////////
+// Generic version
+//
+// Byte swaps are done by blocks through a small buffer, so the data is
+// swapped while it is in the cache.
+
+static const size_t pack_block = 7 * 64;
+static const size_t unpack_block = 8 * 64;
+
+template <bool swab_in, bool le>
+static size_t pack(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+{
+  if (!swab_in)
+    return pack_14<le>(in_buf, size, out_buf);
+
+  // Output is larger than input, so convert from the end.
+  uint8_t buf[pack_block + 1];
+  size_t blocks = size / pack_block;
+  size_t pos = blocks * pack_block;
+  uint8_t *dst = out_buf + blocks * (pack_block / 7 * 8);
+
+  bs_conv_swab16(in_buf + pos, size - pos, buf);
+  size = pack_14<le>(buf, size - pos, dst);
+  size += blocks * (pack_block / 7 * 8);
+
+  while (blocks--)
   {
-    uint32_t w1 = be2int32(*(uint32_t *)(src + 0));
-    uint32_t w2 = be2int32(*(uint32_t *)(src + 3));
-    w1 = ((w1 >> 2) & 0x3fff0000) | ((w1 >> 4) & 0x00003fff);
-    w2 = ((w2 << 2) & 0x3fff0000) | (w2 & 0x00003fff);
-    w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
-    w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
-    (*(uint32_t *)(dst + 0)) = int2be32(w1);
-    (*(uint32_t *)(dst + 4)) = int2be32(w2);
-    src -= 7;
-    dst -= 8;
+    pos -= pack_block;
+    dst -= pack_block / 7 * 8;
+    bs_conv_swab16(in_buf + pos, pack_block, buf);
+    pack_14<le>(buf, pack_block, dst);
   }
 
   return size;
 }
 
-size_t bs_conv_14le_8(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+template <bool le, bool swab_out>
+static size_t unpack(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
 {
-  // Input frame size MUST BE EVEN!!!
-  assert((size & 1) == 0);
+  if (!swab_out)
+    return unpack_14<le>(in_buf, size, out_buf);
 
-  // We convert each 4 16bit words with 14 data bits each into 7 bytes.
-  // If input frame size is not multiply of 8 we add zeros to the end of the
-  // frame to form integral number bytes. But in this case exact backward
-  // conversion is not possible!
+  size_t pos = 0;
+  size_t out_size = 0;
+  while (pos < size)
+  {
+    size_t block = MIN(unpack_block, size - pos);
+    uint8_t *dst = out_buf + out_size;
+    size_t out_block = unpack_14<le>(in_buf + pos, block, dst);
+    bs_conv_swab16(dst, out_block, dst);
+    pos += block;
+    out_size += out_block;
+  }
 
-  size_t n = size / 8;
-  size_t r = size % 8;
-  const uint8_t *src = in_buf;
-  uint8_t *dst = out_buf;
+  return out_size;
+}
 
-  size = n * 7 + r;
+#endif
 
-  while (n--)
-  {
-    uint32_t w1 = be2int32(*(uint32_t *)(src + 0));
-    uint32_t w2 = be2int32(*(uint32_t *)(src + 4));
-    w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
-    w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
-    w2 = ((w2 & 0x3fff0000) >> 2) | (w2 & 0x00003fff) | (w1 << 28);
-    w1 = ((w1 & 0x3fff0000) << 2) | ((w1 & 0x00003fff) << 4);
-    (*(uint32_t *)(dst + 0)) = int2be32(w1);
-    (*(uint32_t *)(dst + 3)) = int2be32(w2);
+///////////////////////////////////////////////////////////////////////////////
+//                               byte <-> 14be
+///////////////////////////////////////////////////////////////////////////////
 
-    src += 8;
-    dst += 7;
-  }
+size_t bs_conv_8_14be(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+{ return pack<false, false>(in_buf, size, out_buf); }
 
-  if (r)
-  {
-    size_t i = 0;
-    for (; i < r; i++) dst[i] = src[i];
-    for (; i < 8; i++) dst[i] = 0;
+size_t bs_conv_14be_8(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+{ return unpack<false, false>(in_buf, size, out_buf); }
 
-    uint32_t w1 = be2int32(*(uint32_t *)(dst + 0));
-    uint32_t w2 = be2int32(*(uint32_t *)(dst + 4));
-    w2 = ((w2 & 0xff00ff00) >> 8) | ((w2 & 0x00ff00ff) << 8);
-    w1 = ((w1 & 0xff00ff00) >> 8) | ((w1 & 0x00ff00ff) << 8);
-    w2 = ((w2 & 0x3fff0000) >> 2) | (w2 & 0x00003fff) | (w1 << 28);
-    w1 = ((w1 & 0x3fff0000) << 2) | ((w1 & 0x00003fff) << 4);
-    (*(uint32_t *)(dst + 0)) = int2be32(w1);
-    (*(uint32_t *)(dst + 3)) = int2be32(w2);
-  }
+///////////////////////////////////////////////////////////////////////////////
+//                               byte <-> 14le
+///////////////////////////////////////////////////////////////////////////////
 
-  return size;
-}
+size_t bs_conv_8_14le(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+{ return pack<false, true>(in_buf, size, out_buf); }
+
+size_t bs_conv_14le_8(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
+{ return unpack<true, false>(in_buf, size, out_buf); }
 
 ///////////////////////////////////////////////////////////////////////////////
 //                              16bit <-> 14bit
 ///////////////////////////////////////////////////////////////////////////////
 
 size_t bs_conv_16le_14be(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
-{
-  size = bs_conv_swab16(in_buf, size, out_buf);
-  size = bs_conv_8_14be(out_buf, size, out_buf);
-  return size; 
-}
+{ return pack<true, false>(in_buf, size, out_buf); }
 
 size_t bs_conv_16le_14le(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
-{
-  size = bs_conv_swab16(in_buf, size, out_buf);
-  size = bs_conv_8_14le(out_buf, size, out_buf);
-  return size; 
-}
+{ return pack<true, true>(in_buf, size, out_buf); }
 
 size_t bs_conv_14be_16le(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
-{
-  size = bs_conv_14be_8(in_buf, size, out_buf);
-  size = bs_conv_swab16(out_buf, size, out_buf);
-  return size; 
-}
+{ return unpack<false, true>(in_buf, size, out_buf); }
 
 size_t bs_conv_14le_16le(const uint8_t *in_buf, size_t size, uint8_t *out_buf)
-{
-  size = bs_conv_14le_8(in_buf, size, out_buf);
-  size = bs_conv_swab16(out_buf, size, out_buf);
-  return size; 
-}
+{ return unpack<true, true>(in_buf, size, out_buf); }
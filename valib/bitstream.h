@@ -6,12 +6,25 @@
 #ifndef VALIB_BITSTREAM_H              
 #define VALIB_BITSTREAM_H
 
+#include <string.h>
 #include "defs.h"
 
 /**************************************************************************//**
   \class ReadBS
   \brief Bitstream reader
 
+  Reader keeps a machine word of the stream in the cache: 64 bits on 64-bit
+  systems and 32 bits on 32-bit systems, where 64-bit shifts are slow library
+  calls. When less bits left than requested, the cache is reloaded with one
+  unaligned word load from the byte containing the current position, so a
+  refill happens once per several get() calls and does not depend on the
+  previous cache contents. Last bytes of the stream are loaded one by one, so
+  the reader never touches memory after the last byte of the stream. Bytes
+  after the end of the stream are read as zeros.
+
+  After a refill the 32-bit cache has at least 25 bits, so reads of more than
+  24 bits are split into two reads on 32-bit systems.
+
   \fn void ReadBS::set(const uint8_t *buf, size_t start_bit, size_t size_bits)
     \param buf       Input buffer
     \param start_bit Start position in bits
@@ -51,36 +64,69 @@
 
     Read one bit and interpret it as boolean value.
 
+  \fn uint32_t ReadBS::peek(unsigned num_bits)
+    \param num_bits Number of bits to look at (up to 32)
+    \return         Value from the bitstream
+
+    Return next 'num_bits' bits without moving the current position. Bytes
+    after the end of the stream are zeros, so it is safe to peek the longest
+    code of a variable-length code table near the end of the stream.
+
+    Variable-length code may be decoded with peek() and skip() instead of
+    reading bit by bit or reading and putting back:
+
+    \code
+      const vlc_t &code = table[bs.peek(max_code_bits)];
+      bs.skip(code.bits);
+    \endcode
+
+  \fn void ReadBS::skip(unsigned num_bits)
+    \param num_bits Number of bits to skip
+
+    Move the current position 'num_bits' ahead.
+
 ******************************************************************************/
 
+template <size_t ptr_size> struct BSCacheWord { typedef uint64_t type; };
+template <> struct BSCacheWord<4> { typedef uint32_t type; };
+
 class ReadBS
 {
 private:
+  typedef BSCacheWord<sizeof(void *)>::type cache_t;
+  static const unsigned cache_bits = sizeof(cache_t) * 8;
+  static const unsigned max_cache_read = cache_bits - 8;
+
   /////////////////////////////////////////////////////////
   // start
-  //   Aligned pointer to the start of the stream. May
-  //   point before the actual start of the stream.
+  //   Pointer to the buffer given.
   // start_bit
   //   start + start_bit points to the actual starting bit
   //   of the stream
-  // stream_size_bits
-  //   Stream size in bits;
+  // size_bits
+  //   Stream size in bits
   // pos
-  //   Pointer to the next word.
-  // current_word, bits_left
-  //   Current word of the stream and amount of the bits
-  //   left unread.
-
-  const uint32_t *start;
+  //   Offset of the first byte of the cache.
+  // end
+  //   Offset of the byte after the end of the stream.
+  // cache, bits_left
+  //   cache_bits of the stream starting at pos and amount of
+  //   the bits left unread (1..cache_bits).
+
+  const uint8_t *start;
   size_t start_bit;
   size_t size_bits;
 
-  const uint32_t *pos;
-  uint32_t current_word;
+  size_t pos;
+  size_t end;
+  cache_t cache;
   unsigned bits_left;
 
-  uint32_t get_next(unsigned num_bits);
-  int32_t  get_next_signed(unsigned num_bits);
+  inline void load();
+  inline void refill();
+  void load_tail();
+  uint32_t get_long(unsigned num_bits);
+  uint32_t peek_long(unsigned num_bits);
 
 public:
   ReadBS();
@@ -89,11 +135,14 @@ public:
   void set(const uint8_t *buf, size_t start_bit, size_t size_bits);
 
   void   set_pos_bits(size_t pos_bits);
-  size_t get_pos_bits() const { return (pos - start) * 32 - bits_left - start_bit; }
+  size_t get_pos_bits() const { return pos * 8 + cache_bits - bits_left - start_bit; }
 
   inline uint32_t get(unsigned num_bits);
   inline int32_t  get_signed(unsigned num_bits);
   inline bool     get_bool();
+
+  inline uint32_t peek(unsigned num_bits);
+  inline void     skip(unsigned num_bits);
 };
 
 
@@ -101,6 +150,9 @@ public:
   \class WriteBS
   \brief Bitstream writer
 
+  Writer collects bits in the 64-bit cache and stores it into the memory
+  (unaligned) when it is full.
+
   \fn void WriteBS::set(uint8_t *buf, size_t start_bit, size_t size_bits)
     \param buf       Output buffer
     \param start_bit Start position in bits
@@ -148,25 +200,24 @@ class WriteBS
 private:
   /////////////////////////////////////////////////////////
   // start
-  //   Aligned pointer to the start of the stream. May
-  //   point before the actual start of the stream.
+  //   Pointer to the buffer given.
   // start_bit
   //   start + start_bit points to the actual starting bit
   //   of the stream
-  // stream_size_bits
-  //   Stream size in bits;
+  // size_bits
+  //   Stream size in bits
   // pos
-  //   Pointer to the current word.
-  // current_word, bits_left
-  //   Current word of the stream and amount of the bits
-  //   left unread.
+  //   Offset of the byte to store the cache to.
+  // cache, bits_left
+  //   Bits not stored yet (left-aligned) and amount of
+  //   the bits left free in the cache (1..64).
 
-  uint32_t *start;
+  uint8_t *start;
   size_t start_bit;
   size_t size_bits;
 
-  uint32_t *pos;
-  uint32_t current_word;
+  size_t pos;
+  uint64_t cache;
   unsigned bits_left;
 
   void move(size_t pos_bits);
@@ -179,7 +230,7 @@ public:
   void set(uint8_t *buf, size_t start_bit, size_t size_bits);
 
   void   set_pos_bits(size_t pos_bits);
-  size_t get_pos_bits() const { return (pos - start + 1) * 32 - bits_left - start_bit; }
+  size_t get_pos_bits() const { return pos * 8 + 64 - bits_left - start_bit; }
 
   inline void put(unsigned num_bits, uint32_t value);
   inline void put_bool(bool value);
@@ -188,46 +239,67 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Unaligned big-endian loads
+inline void bs_load_be(uint32_t &word, const uint8_t *p)
+{
+  uint32_t w;
+  memcpy(&w, p, sizeof(w));
+  word = be2uint32(w);
+}
+
+inline void bs_load_be(uint64_t &word, const uint8_t *p)
+{
+  uint32_t w[2];
+  memcpy(w, p, sizeof(w));
+  word = (uint64_t(be2uint32(w[0])) << 32) | be2uint32(w[1]);
+}
+
+inline void
+ReadBS::load()
+{
+  if (pos + sizeof(cache_t) <= end)
+    bs_load_be(cache, start + pos);
+  else
+    load_tail();
+}
+
+inline void
+ReadBS::refill()
+{
+  // Move the cache to the byte of the current position
+  unsigned bits_read = cache_bits - bits_left;
+  pos += bits_read >> 3;
+  bits_left = cache_bits - (bits_read & 7);
+  load();
+}
+
 inline uint32_t
 ReadBS::get(unsigned num_bits)
 {
-  uint32_t result;
   assert(num_bits <= 32);
   assert(get_pos_bits() + num_bits <= size_bits);
-  assert(bits_left > 0);
-
-  if (num_bits == 0)
-    return 0;
 
-  if (num_bits < bits_left) 
+  if (num_bits >= bits_left)
   {
-    result = (current_word << (32 - bits_left)) >> (32 - num_bits);
-    bits_left -= num_bits;
-    return result;
+    if (num_bits > max_cache_read)
+      return get_long(num_bits);
+    refill();
   }
-  else
-    return get_next(num_bits);
+
+  // Double shift works for num_bits = 0
+  uint32_t result = uint32_t(((cache << (cache_bits - bits_left)) >> 1) >> (cache_bits - 1 - num_bits));
+  bits_left -= num_bits;
+  return result;
 }
 
 inline int32_t
 ReadBS::get_signed(unsigned num_bits)
 {
-  int32_t result;
-  assert(num_bits <= 32);
-  assert(get_pos_bits() + num_bits <= size_bits);
-  assert(bits_left > 0);
-
   if (num_bits == 0)
     return 0;
-        
-  if (num_bits < bits_left) 
-  {
-    result = int32_t(current_word << (32 - bits_left)) >> (32 - num_bits);
-    bits_left -= num_bits;
-    return result;
-  }
-  else
-    return get_next_signed(num_bits);
+
+  unsigned shift = 32 - num_bits;
+  return int32_t(get(num_bits) << shift) >> shift;
 }
 
 inline bool
@@ -236,6 +308,35 @@ ReadBS::get_bool()
   return get(1) != 0;
 }
 
+inline uint32_t
+ReadBS::peek(unsigned num_bits)
+{
+  assert(num_bits <= 32);
+
+  if (num_bits >= bits_left)
+  {
+    if (num_bits > max_cache_read)
+      return peek_long(num_bits);
+    refill();
+  }
+  return uint32_t(((cache << (cache_bits - bits_left)) >> 1) >> (cache_bits - 1 - num_bits));
+}
+
+inline void
+ReadBS::skip(unsigned num_bits)
+{
+  assert(get_pos_bits() + num_bits <= size_bits);
+
+  if (num_bits <= max_cache_read)
+  {
+    if (num_bits >= bits_left)
+      refill();
+    bits_left -= num_bits;
+  }
+  else
+    set_pos_bits(get_pos_bits() + num_bits);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 inline void
@@ -244,15 +345,11 @@ WriteBS::put(unsigned num_bits, uint32_t value)
   assert(num_bits <= 32);
   assert(num_bits == 32 || (value >> num_bits) == 0);
   assert(get_pos_bits() + num_bits <= size_bits);
-  assert(bits_left > 0);
-
-  if (num_bits == 0)
-    return;
 
-  if (num_bits < bits_left) 
+  if (num_bits < bits_left)
   {
     bits_left -= num_bits;
-    current_word = current_word | (value << bits_left);
+    cache |= uint64_t(value) << bits_left;
   }
   else
     put_next(num_bits, value);
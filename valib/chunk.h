@@ -7,8 +7,27 @@
 #define VALIB_CHUNK_H
 
 #include "spk.h"
+#include "exact_time.h"
+#include <string.h>
 #include <string>
 
+/**************************************************************************//**
+  \struct ChunkSegment
+  \brief A part of the segmented raw data chunk.
+
+  \var const uint8_t *ChunkSegment::data;
+    Pointer to the data. Null pointer means zero padding.
+
+  \var size_t ChunkSegment::size;
+    Size of the segment in bytes.
+******************************************************************************/
+
+struct ChunkSegment
+{
+  const uint8_t *data;
+  size_t size;
+};
+
 /**************************************************************************//**
   \class Chunk
   \brief A part of audio data
@@ -30,6 +49,16 @@
     buffer in bytes. When samples buffer is given it means number of samples
     per channel.
 
+  \var const ChunkSegment *Chunk::segments;
+    Raw data given as a list of segments (scatter/gather). In this case
+    rawdata is null and size is the total size of the segments. Only sinks
+    that write segments directly (RAWSink, WAVSink) accept such chunks, so
+    segmented output must be explicitly enabled at the producer (see
+    SPDIFWrapper::gather). Use gather() to make contiguous data.
+
+  \var size_t Chunk::nsegments;
+    Number of segments.
+
   \var bool Chunk::sync;
     When this flag is set, time stamp is set. Otherwise time should be ignored.
 
@@ -44,6 +73,11 @@
     head of a next frame, time should be applied to the first sample of the new
     frame.
 
+  \var ExactTime Chunk::exact_time;
+    Exact time stamp (see ExactTime), when the producer knows it. Carried
+    along with the time: when set, time equals to exact_time.seconds().
+    Setting a different time stamp with vtime_t drops the exact time.
+
   \fn Chunk::Chunk()
     Constructs a dummy chunk with no data and no timestamp.
 
@@ -88,11 +122,34 @@
 
     Fills the chunk with raw data.
 
+  \fn void Chunk::set_segments(const ChunkSegment *segments, size_t nsegments, bool sync = false, vtime_t time = 0)
+    \param segments  List of segments
+    \param nsegments Number of segments
+    \param sync      Sync flag
+    \param time      Time stamp
+
+    Fills the chunk with segmented raw data. Size of the chunk is the total
+    size of the segments.
+
+  \fn size_t Chunk::gather(uint8_t *buf) const
+    \param buf Buffer of at least 'size' bytes
+    \return    Number of bytes copied
+
+    Copy the data of a segmented chunk into a contiguous buffer.
+
   \fn void Chunk::set_sync(bool sync, vtime_t time)
     \param sync Sync flag
     \param time Time stamp
 
-    Set time stamp for the chunk.
+    Set time stamp for the chunk. Exact time stamp is kept when it equals to
+    the time given (the time stamp is set again) and dropped otherwise.
+
+  \fn void Chunk::set_sync(bool sync, ExactTime exact_time)
+    \param sync       Sync flag
+    \param exact_time Exact time stamp
+
+    Set exact time stamp for the chunk. The time is set to
+    exact_time.seconds().
 
   \fn bool Chunk::is_dummy() const
     Check for dummy chunk (chunk that does not contain data or time stamp).
@@ -123,8 +180,12 @@ public:
   samples_t samples;
   size_t    size;
 
+  const ChunkSegment *segments;
+  size_t    nsegments;
+
   bool      sync;
   vtime_t   time;
+  ExactTime exact_time;
 
   /////////////////////////////////////////////////////////
   // Utilities
@@ -133,6 +194,8 @@ public:
   Chunk():
     rawdata(0),
     size(0),
+    segments(0),
+    nsegments(0),
     sync(false),
     time(0)
   {}
@@ -141,6 +204,8 @@ public:
   Chunk(bool sync_, vtime_t time_):
     rawdata(0),
     size(0),
+    segments(0),
+    nsegments(0),
     sync(sync_),
     time(time_)
   {}
@@ -151,6 +216,8 @@ public:
     rawdata(0),
     samples(samples_),
     size(size_),
+    segments(0),
+    nsegments(0),
     sync(sync_),
     time(time_)
   {}
@@ -160,6 +227,8 @@ public:
     bool sync_ = false, vtime_t time_ = 0):
     rawdata(rawdata_),
     size(size_),
+    segments(0),
+    nsegments(0),
     sync(sync_),
     time(time_)
   {}
@@ -169,8 +238,11 @@ public:
     rawdata = 0;
     samples.zero();
     size = 0;
+    segments = 0;
+    nsegments = 0;
     sync = false;
     time = 0;
+    exact_time = ExactTime();
   }
 
   inline void set_linear(samples_t samples_, size_t size_,
@@ -179,8 +251,11 @@ public:
     rawdata = 0;
     samples = samples_;
     size = size_;
+    segments = 0;
+    nsegments = 0;
     sync = sync_;
     time = time_;
+    exact_time = ExactTime();
   }
 
   inline void set_rawdata(uint8_t *rawdata_, size_t size_,
@@ -189,14 +264,55 @@ public:
     samples.zero();
     rawdata = rawdata_;
     size = size_;
+    segments = 0;
+    nsegments = 0;
     sync = sync_;
     time = time_;
+    exact_time = ExactTime();
+  }
+
+  inline void set_segments(const ChunkSegment *segments_, size_t nsegments_,
+    bool sync_ = false, vtime_t time_ = 0)
+  {
+    rawdata = 0;
+    samples.zero();
+    size = 0;
+    for (size_t i = 0; i < nsegments_; i++)
+      size += segments_[i].size;
+    segments = segments_;
+    nsegments = nsegments_;
+    sync = sync_;
+    time = time_;
+    exact_time = ExactTime();
+  }
+
+  size_t gather(uint8_t *buf) const
+  {
+    size_t pos = 0;
+    for (size_t i = 0; i < nsegments; i++)
+    {
+      if (segments[i].data)
+        memcpy(buf + pos, segments[i].data, segments[i].size);
+      else
+        memset(buf + pos, 0, segments[i].size);
+      pos += segments[i].size;
+    }
+    return pos;
   }
 
   inline void set_sync(bool sync_, vtime_t time_)
   {
     sync = sync_;
     time = time_;
+    if (!sync || time != exact_time.seconds())
+      exact_time = ExactTime();
+  }
+
+  inline void set_sync(bool sync_, ExactTime exact_time_)
+  {
+    sync = sync_;
+    time = exact_time_.seconds();
+    exact_time = exact_time_;
   }
 
   inline bool is_dummy() const
@@ -212,6 +328,7 @@ public:
   inline void drop_rawdata(size_t drop_size)
   {
     assert(rawdata || drop_size == 0);
+    assert(!segments);
 
     if (drop_size > size)
       drop_size = size;
@@ -237,6 +354,8 @@ public:
       size == other.size &&
       rawdata == other.rawdata &&
       samples == other.samples &&
+      segments == other.segments &&
+      nsegments == other.nsegments &&
       sync == other.sync && (!sync || time == other.time);
   }
 
@@ -1,7 +1,27 @@
 /*
   Table CRC algorithm speed mainly depends on table access speed.
-  If we increase table size (and decrease table accesses) it increases cache
-  misses so 8bit table may be considered as optimal choise.
+
+  Slicing-by-8
+  ============
+  8 tables of 256 entries are used (8KB per polynomial). tbl[k][b] is the
+  CRC of byte b followed by k zero bytes, so 8 bytes of the message are
+  processed with 8 independent table lookups, instead of 8 dependent
+  lookups of the simple byte-at-a-time algorithm. 8KB tables fit into L1
+  cache of any modern core.
+
+  Carry-less multiply folding
+  ===========================
+  When PCLMULQDQ is available (checked at runtime) long messages are folded
+  by 128 bits with carry-less multiplication: a 128-bit value A followed by
+  128 bits of the message is replaced by
+  A_hi * (x^192 mod P) + A_lo * (x^128 mod P) + next 128 bits,
+  what has the same remainder modulo P. 4 independent accumulators are
+  folded by 512 bits in parallel to hide the multiplication latency. The
+  resulting 128-bit value is reduced with the tables.
+
+  Internally, the CRC is kept left-aligned at 32 bits, what is equivalent
+  to 32-bit CRC with polynomial x^(32-power) * P. So the same code works
+  for any polynomial of power up to 32.
 
   Some words about 32bit access
   =============================
@@ -20,19 +40,84 @@
 
 #include "crc.h"
 
+// Carry-less multiply version is compiled with SSE2 and selected at runtime
+// (PCLMULQDQ and SSSE3 are not guaranteed by SSE2).
+#ifdef VALIB_SSE2
+#define CRC_CLMUL 1
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CLMUL_TARGET
+#else
+#include <cpuid.h>
+#define CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+#endif
+#endif
+
+// Minimal message size to use carry-less multiply
+static const size_t clmul_min_size = 128;
+
 const CRC crc16(POLY_CRC16, 16);
 const CRC crc32(POLY_CRC32, 32);
 
 ///////////////////////////////////////////////////////////////////////////////
 // Init
 
+#ifdef CRC_CLMUL
+static bool has_clmul()
+{
+  // CPUID.1:ECX bit 1 = PCLMULQDQ, bit 9 = SSSE3
+  static const unsigned clmul_ssse3 = 0x202;
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & clmul_ssse3) == clmul_ssse3;
+#else
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (ecx & clmul_ssse3) == clmul_ssse3;
+#endif
+}
+#endif
+
 CRC::CRC(uint32_t poly_, unsigned power_)
 {
   assert(power_ <= 32);
   poly = poly_ << (32 - power_);
   power = power_;
-  for (unsigned byte = 0; byte < 256; byte++)
-    tbl[byte] = add_bits(0, byte, 8);
+
+  unsigned k, byte;
+  for (byte = 0; byte < 256; byte++)
+  {
+    uint32_t crc = byte << 24;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x80000000)? (crc << 1) ^ poly: crc << 1;
+    tbl[0][byte] = crc;
+  }
+
+  for (k = 1; k < 8; k++)
+    for (byte = 0; byte < 256; byte++)
+      tbl[k][byte] = (tbl[k-1][byte] << 8) ^ tbl[0][tbl[k-1][byte] >> 24];
+
+  // Folding constants: x^576, x^512, x^192, x^128 mod P
+  uint32_t xn = poly; // x^32 mod P
+  for (unsigned n = 33; n <= 576; n++)
+  {
+    xn = (xn & 0x80000000)? (xn << 1) ^ poly: xn << 1;
+    if (n == 576) fold[0] = xn;
+    if (n == 512) fold[1] = xn;
+    if (n == 192) fold[2] = xn;
+    if (n == 128) fold[3] = xn;
+  }
+
+#ifdef CRC_CLMUL
+  clmul = has_clmul();
+#else
+  clmul = false;
+#endif
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -41,31 +126,42 @@ CRC::CRC(uint32_t poly_, unsigned power_)
 uint32_t
 CRC::add_8(uint32_t crc, uint32_t data) const
 {
-  return (crc << 8) ^ tbl[(crc >> 24) ^ (data & 0xff)];
+  return (crc << 8) ^ tbl[0][(crc >> 24) ^ (data & 0xff)];
 }
 
 uint32_t
 CRC::add_32(uint32_t crc, uint32_t data) const
 {
   crc ^= data;
-  crc = (crc << 8) ^ tbl[crc >> 24];
-  crc = (crc << 8) ^ tbl[crc >> 24];
-  crc = (crc << 8) ^ tbl[crc >> 24];
-  crc = (crc << 8) ^ tbl[crc >> 24];
-  return crc;
+  return tbl[3][crc >> 24] ^ tbl[2][(crc >> 16) & 0xff] ^
+         tbl[1][(crc >> 8) & 0xff] ^ tbl[0][crc & 0xff];
+}
+
+uint32_t
+CRC::add_64(uint32_t crc, uint32_t data1, uint32_t data2) const
+{
+  crc ^= data1;
+  return tbl[7][crc >> 24]   ^ tbl[6][(crc >> 16) & 0xff] ^
+         tbl[5][(crc >> 8) & 0xff]   ^ tbl[4][crc & 0xff] ^
+         tbl[3][data2 >> 24] ^ tbl[2][(data2 >> 16) & 0xff] ^
+         tbl[1][(data2 >> 8) & 0xff] ^ tbl[0][data2 & 0xff];
 }
 
 uint32_t 
 CRC::add_bits(uint32_t crc, uint32_t data, size_t bits) const
 {
+  while (bits > 8)
+  {
+    bits -= 8;
+    crc = add_8(crc, data >> bits);
+  }
+
+  // Shift by less than 8 bits: bits shifted out of the crc are reduced
+  // with the table, because tbl[0][b] = b * x^32 mod P.
   if (bits)
   {
-    crc ^= (data << (32 - bits));
-    while (bits--)
-      if (crc & 0x80000000)
-        crc = (crc << 1) ^ poly;
-      else
-        crc <<= 1;
+    crc ^= data << (32 - bits);
+    crc = (crc << bits) ^ tbl[0][crc >> (32 - bits)];
   }
   return crc;
 }
@@ -73,6 +169,15 @@ CRC::add_bits(uint32_t crc, uint32_t data, size_t bits) const
 uint32_t 
 CRC::add_bytes(uint32_t crc, const uint8_t *data, size_t size) const
 {
+#ifdef CRC_CLMUL
+  if (clmul && size >= clmul_min_size)
+  {
+    crc = add_clmul(crc, data, size);
+    data += size & ~15;
+    size &= 15;
+  }
+#endif
+
   const uint8_t *end = data + size;
 
   /////////////////////////////////////////////////////
@@ -84,11 +189,16 @@ CRC::add_bytes(uint32_t crc, const uint8_t *data, size_t size) const
     crc = add_8(crc, *data++);
 
   /////////////////////////////////////////////////////
-  // Process main block (32bit)
+  // Process main block (64bit + 32bit)
 
   uint32_t *data32 = (uint32_t *)data;
   uint32_t *end32  = (uint32_t *)(end - align32(end));
-  while (data32 < end32)
+  while (end32 - data32 >= 2)
+  {
+    crc = add_64(crc, be2uint32(data32[0]), be2uint32(data32[1]));
+    data32 += 2;
+  }
+  if (data32 < end32)
   {
     crc = add_32(crc, be2uint32(*data32));
     data32++;
@@ -106,6 +216,77 @@ CRC::add_bytes(uint32_t crc, const uint8_t *data, size_t size) const
   return crc;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Carry-less multiply folding
+// Processes whole 16-byte blocks only (size & ~15 bytes), size >= 64.
+//
+// Bytes of each block are reversed, so bit i of the register is the
+// coefficient of x^i. _mm_clmulepi64_si128(a, k, 0x11) multiplies the high
+// halves, 0x00 multiplies the low halves.
+
+#ifdef CRC_CLMUL
+
+CLMUL_TARGET static inline __m128i clmul_fold(__m128i a, __m128i k, __m128i next)
+{
+  __m128i hi = _mm_clmulepi64_si128(a, k, 0x11);
+  __m128i lo = _mm_clmulepi64_si128(a, k, 0x00);
+  return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+CLMUL_TARGET uint32_t
+CRC::add_clmul(uint32_t crc, const uint8_t *data, size_t size) const
+{
+  assert(size >= 64);
+
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i k512 = _mm_set_epi32(0, (int)fold[0], 0, (int)fold[1]);
+  const __m128i k128 = _mm_set_epi32(0, (int)fold[2], 0, (int)fold[3]);
+  const uint8_t *end = data + (size & ~15);
+
+  #define LOAD(p) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p)), bswap)
+
+  __m128i x0 = _mm_xor_si128(LOAD(data), _mm_set_epi32((int)crc, 0, 0, 0));
+  __m128i x1 = LOAD(data + 16);
+  __m128i x2 = LOAD(data + 32);
+  __m128i x3 = LOAD(data + 48);
+  data += 64;
+
+  while (end - data >= 64)
+  {
+    x0 = clmul_fold(x0, k512, LOAD(data));
+    x1 = clmul_fold(x1, k512, LOAD(data + 16));
+    x2 = clmul_fold(x2, k512, LOAD(data + 32));
+    x3 = clmul_fold(x3, k512, LOAD(data + 48));
+    data += 64;
+  }
+
+  x0 = clmul_fold(x0, k128, x1);
+  x0 = clmul_fold(x0, k128, x2);
+  x0 = clmul_fold(x0, k128, x3);
+  while (data < end)
+  {
+    x0 = clmul_fold(x0, k128, LOAD(data));
+    data += 16;
+  }
+
+  #undef LOAD
+
+  // CRC of the folded value (most significant word first)
+  uint32_t w[4];
+  _mm_storeu_si128((__m128i *)w, x0);
+  return add_64(add_64(0, w[3], w[2]), w[1], w[0]);
+}
+
+#else
+
+uint32_t
+CRC::add_clmul(uint32_t crc, const uint8_t *data, size_t size) const
+{
+  return add_bytes(crc, data, size);
+}
+
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // Calc CRC
 
@@ -12,6 +12,11 @@
   \class CRC
   \brief CRC calculation class
 
+  Slicing-by-8 tables are used for the messages of any length. Long
+  messages are folded with carry-less multiplication (PCLMULQDQ) when the
+  CPU supports it (checked at runtime). Results are the same for all
+  implementations.
+
   \fn CRC::CRC(uint32_t poly, unsigned power);
     \param poly CRC polynomial
     \param power Polynomial power
@@ -58,7 +63,9 @@ class CRC
 protected:
   uint32_t poly;
   unsigned power;
-  uint32_t tbl[256];
+  uint32_t tbl[8][256];  // slicing-by-8 tables: tbl[k][b] = b * x^(32+8k) mod P
+  uint32_t fold[4];      // folding constants for carry-less multiply
+  bool     clmul;        // carry-less multiply (PCLMULQDQ) is available
 
   /////////////////////////////////////////////////////////////////////////////
   // CRC primitives
@@ -67,8 +74,10 @@ protected:
 
   __forceinline uint32_t add_8    (uint32_t crc, uint32_t data) const;
   __forceinline uint32_t add_32   (uint32_t crc, uint32_t data) const;
+  __forceinline uint32_t add_64   (uint32_t crc, uint32_t data1, uint32_t data2) const;
   __forceinline uint32_t add_bits (uint32_t crc, uint32_t data, size_t bits) const;
   uint32_t add_bytes(uint32_t crc, const uint8_t *data, size_t size) const;
+  uint32_t add_clmul(uint32_t crc, const uint8_t *data, size_t size) const;
 
   /////////////////////////////////////////////////////////////////////////////
   // Pre- and post- CRC shift
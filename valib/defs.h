@@ -44,6 +44,15 @@ const char *valib_revision();
 #  pragma warning(disable: 4786)
 #endif
 
+// VALIB_SSE2 is defined when the compiler generates SSE2 code: always at x64
+// and at x86 with /arch:SSE2 (set for Win32 configurations of valib.vcproj)
+// or -msse2. SIMD versions of the code are compiled with it.
+// Define VALIB_NO_SIMD to force scalar versions.
+
+#if !defined(VALIB_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define VALIB_SSE2 1
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 //                              Base constants
@@ -0,0 +1,209 @@
+/**************************************************************************//**
+  \file exact_time.h
+  \brief ExactTime: integer timestamp at a given clock rate
+******************************************************************************/
+
+#ifndef VALIB_EXACT_TIME_H
+#define VALIB_EXACT_TIME_H
+
+#include "defs.h"
+
+/**************************************************************************//**
+  \class ExactTime
+  \brief Exact timestamp: integer number of ticks at a clock rate.
+
+  vtime_t is a double, and the time calculated as a sum of many (size /
+  sample_rate) terms accumulates rounding errors over long streams. ExactTime
+  represents the time as a rational number ticks / rate, so sample counts and
+  clock ticks (90kHz for MPEG, 10MHz for DirectShow) are represented without
+  rounding.
+
+  Arithmetic is exact: when the rates differ, the result is calculated at the
+  least common multiple of the rates, and is reduced back to the rate of the
+  left operand when possible. So adding sample counts at the sample rate to
+  a 90kHz timestamp keeps the result exact:
+  \verbatim
+    90kHz and 48kHz -> 1440kHz
+    90kHz and 44.1kHz -> 4410kHz
+  \endverbatim
+
+  Rounding happens only at the API boundaries: at conversion to vtime_t
+  (seconds()), from vtime_t (from_seconds()) and at conversion to a rate that
+  cannot represent the time (to_rate()). When the common rate does not fit
+  into an int, the operand is rounded to the rate of the left operand.
+
+  Zero rate means that the exact time is not set.
+
+  \fn ExactTime::ExactTime()
+    Constructs the time that is not set.
+
+  \fn ExactTime::ExactTime(int64_t ticks, int rate)
+    \param ticks Number of ticks
+    \param rate  Ticks per second
+
+  \fn static ExactTime ExactTime::from_seconds(vtime_t time, int rate)
+    Convert the time in seconds to the nearest tick at the rate given.
+
+  \fn bool ExactTime::is_set() const
+    Returns true when the time is set.
+
+  \fn vtime_t ExactTime::seconds() const
+    Time in seconds.
+
+  \fn bool ExactTime::is_exact_at(int new_rate) const
+    Returns true when the time is a whole number of ticks at the rate given.
+
+  \fn ExactTime ExactTime::to_rate(int new_rate) const
+    Convert to the rate given. Rounds to the nearest tick when the time is
+    not exact at the new rate.
+
+  \fn ExactTime ExactTime::add(int64_t units, int unit_rate) const
+    \param units     Amount of time to add (may be negative)
+    \param unit_rate Units per second
+
+    Returns the time shifted by units / unit_rate seconds.
+
+  \fn ExactTime ExactTime::add(const ExactTime &t) const
+    Returns the sum of the times.
+
+  \fn static int ExactTime::common_rate(int rate1, int rate2)
+    Least common multiple of the rates, or zero when it does not fit into an
+    int.
+******************************************************************************/
+
+class ExactTime
+{
+public:
+  int64_t ticks; //!< Number of ticks
+  int     rate;  //!< Ticks per second (zero when not set)
+
+  ExactTime(): ticks(0), rate(0)
+  {}
+
+  ExactTime(int64_t ticks_, int rate_): ticks(ticks_), rate(rate_)
+  {}
+
+  static inline ExactTime from_seconds(vtime_t time, int rate);
+  static inline int common_rate(int rate1, int rate2);
+
+  inline bool    is_set()  const { return rate > 0; }
+  inline vtime_t seconds() const { return rate > 0? vtime_t(ticks) / rate: 0; }
+
+  inline bool is_exact_at(int new_rate) const;
+  inline ExactTime to_rate(int new_rate) const;
+
+  inline ExactTime add(int64_t units, int unit_rate) const;
+  inline ExactTime add(const ExactTime &t) const
+  { return add(t.ticks, t.rate); }
+
+  inline int compare(const ExactTime &t) const;
+
+  inline bool operator ==(const ExactTime &t) const { return compare(t) == 0; }
+  inline bool operator !=(const ExactTime &t) const { return compare(t) != 0; }
+  inline bool operator < (const ExactTime &t) const { return compare(t) <  0; }
+  inline bool operator > (const ExactTime &t) const { return compare(t) >  0; }
+  inline bool operator <=(const ExactTime &t) const { return compare(t) <= 0; }
+  inline bool operator >=(const ExactTime &t) const { return compare(t) >= 0; }
+
+protected:
+  static inline int64_t gcd(int64_t a, int64_t b);
+  static inline int64_t floor_div(int64_t a, int64_t b);
+  static inline int64_t scale(int64_t value, int64_t num, int64_t den);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+inline int64_t
+ExactTime::gcd(int64_t a, int64_t b)
+{
+  while (b)
+  {
+    int64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+inline int64_t
+ExactTime::floor_div(int64_t a, int64_t b)
+{
+  assert(b > 0);
+  int64_t q = a / b;
+  return (a % b < 0)? q - 1: q;
+}
+
+// value * num / den rounded to the nearest integer, without overflow of the
+// intermediate product for values much larger than den.
+inline int64_t
+ExactTime::scale(int64_t value, int64_t num, int64_t den)
+{
+  int64_t q = floor_div(value, den);
+  int64_t r = value - q * den;
+  return q * num + floor_div(2 * r * num + den, 2 * den);
+}
+
+inline int
+ExactTime::common_rate(int rate1, int rate2)
+{
+  assert(rate1 > 0 && rate2 > 0);
+  int64_t lcm = int64_t(rate1) / gcd(rate1, rate2) * rate2;
+  return lcm <= 0x7fffffff? int(lcm): 0;
+}
+
+inline ExactTime
+ExactTime::from_seconds(vtime_t time, int rate)
+{
+  vtime_t ticks = time * rate;
+  return ExactTime(int64_t(ticks < 0? ticks - 0.5: ticks + 0.5), rate);
+}
+
+inline bool
+ExactTime::is_exact_at(int new_rate) const
+{
+  if (!is_set() || new_rate <= 0)
+    return false;
+  int64_t den = rate / gcd(rate, new_rate);
+  return ticks % den == 0;
+}
+
+inline ExactTime
+ExactTime::to_rate(int new_rate) const
+{
+  if (!is_set() || new_rate == rate)
+    return *this;
+  int64_t g = gcd(rate, new_rate);
+  return ExactTime(scale(ticks, new_rate / g, rate / g), new_rate);
+}
+
+inline ExactTime
+ExactTime::add(int64_t units, int unit_rate) const
+{
+  if (!is_set() || unit_rate == rate)
+    return ExactTime(ticks + units, rate);
+
+  int lcm = common_rate(rate, unit_rate);
+  if (!lcm)
+    return ExactTime(ticks + ExactTime(units, unit_rate).to_rate(rate).ticks, rate);
+
+  int64_t k = lcm / rate;
+  int64_t sum = ticks * k + units * (lcm / unit_rate);
+  return sum % k == 0? ExactTime(sum / k, rate): ExactTime(sum, lcm);
+}
+
+inline int
+ExactTime::compare(const ExactTime &t) const
+{
+  int64_t diff;
+  int lcm = is_set() && t.is_set()? common_rate(rate, t.rate): 0;
+  if (lcm)
+    diff = ticks * (lcm / rate) - t.ticks * (lcm / t.rate);
+  else
+  {
+    vtime_t d = seconds() - t.seconds();
+    diff = d < 0? -1: d > 0? 1: 0;
+  }
+  return diff < 0? -1: diff > 0? 1: 0;
+}
+
+#endif
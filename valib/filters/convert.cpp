@@ -38,7 +38,12 @@ Converter::convert_pcm2linear(Chunk &in, Chunk &out)
   // the resulting timestamp to avoid jitter
 
   if (in.sync && part_size && spk.sample_rate)
-    in.time -= vtime_t(part_size) / double(sample_size * spk.sample_rate);
+  {
+    if (in.exact_time.is_set())
+      in.set_sync(true, in.exact_time.add(-(int64_t)part_size, int(sample_size) * spk.sample_rate));
+    else
+      in.time -= vtime_t(part_size) / double(sample_size * spk.sample_rate);
+  }
 
   /////////////////////////////////////////////////////////
   // Process part of a sample
@@ -67,12 +67,30 @@ Dejitter::Stat::size() const
 ///////////////////////////////////////////////////////////
 // Dejitter
 
+inline vtime_t
+Dejitter::continuous_time() const
+{
+  return continuous_base + continuous_pos * (1.0 / size_rate);
+}
+
+// Stamp the chunk with the continuous time. Exact time is kept when the
+// time scale is not transformed.
+void
+Dejitter::stamp(Chunk &chunk) const
+{
+  if (continuous_exact.is_set() && time_factor == 1.0 && time_shift == 0)
+    chunk.set_sync(continuous_sync, continuous_exact.add(continuous_pos, size_rate));
+  else
+    chunk.set_sync(continuous_sync, continuous_time() * time_factor + time_shift);
+}
+
 Dejitter::Dejitter()
 {
-  size2time = 1.0;
+  size_rate = 1;
 
   continuous_sync = false;
-  continuous_time = 0.0;
+  continuous_base = 0.0;
+  continuous_pos = 0;
 
   time_shift  = 0;
   time_factor = 1.0;
@@ -99,34 +117,34 @@ Dejitter::init()
   switch (spk.format)
   {
     case FORMAT_LINEAR:
-      size2time = 1.0 / spk.sample_rate;
+      size_rate = spk.sample_rate;
       break;
 
     case FORMAT_PCM16:
     case FORMAT_PCM16_BE:
-      size2time = 1.0 / 2.0 / spk.nch() / spk.sample_rate;
+      size_rate = 2 * spk.nch() * spk.sample_rate;
       break;
 
     case FORMAT_PCM24:
     case FORMAT_PCM24_BE:
-      size2time = 1.0 / 3.0 / spk.nch() / spk.sample_rate; 
+      size_rate = 3 * spk.nch() * spk.sample_rate;
       break;
 
     case FORMAT_PCM32:
     case FORMAT_PCM32_BE:
-      size2time = 1.0 / 4.0 / spk.nch() / spk.sample_rate;
+      size_rate = 4 * spk.nch() * spk.sample_rate;
       break;
 
     case FORMAT_PCMFLOAT:
-      size2time = 1.0 / sizeof(float)  / spk.nch() / spk.sample_rate;
+      size_rate = int(sizeof(float)) * spk.nch() * spk.sample_rate;
       break;
 
     case FORMAT_PCMDOUBLE:
-      size2time = 1.0 / sizeof(double) / spk.nch() / spk.sample_rate;
+      size_rate = int(sizeof(double)) * spk.nch() * spk.sample_rate;
       break;
 
     case FORMAT_SPDIF:
-      size2time = 1.0 / 4.0 / spk.sample_rate;
+      size_rate = 4 * spk.sample_rate;
       break;
 
     default:
@@ -140,7 +158,9 @@ Dejitter::reset()
 {
   valib_log(log_event, log_module, "reset()");
   continuous_sync = false;
-  continuous_time = 0.0;
+  continuous_base = 0.0;
+  continuous_exact = ExactTime();
+  continuous_pos = 0;
   istat.reset();
   ostat.reset();
 }
@@ -161,8 +181,8 @@ Dejitter::process(Chunk &in, Chunk &out)
     // Some players have problems with untimed chunks.
     // WMP freezes when it receives an unstamped chunk
     // immediately after pause.
-    out.set_sync(continuous_sync, continuous_time * time_factor + time_shift);
-    continuous_time += out.size * size2time;
+    stamp(out);
+    continuous_pos += out.size;
     return true;
   }
 
@@ -171,14 +191,17 @@ Dejitter::process(Chunk &in, Chunk &out)
   if (!continuous_sync)
   {
     valib_log(log_event, log_module, "sync catch: %ims", int(time * 1000));
-    out.set_sync(true, time * time_factor + time_shift);
     continuous_sync = true;
-    continuous_time = time + out.size * size2time;
+    continuous_base = time;
+    continuous_exact = out.exact_time;
+    continuous_pos = 0;
+    stamp(out);
+    continuous_pos += out.size;
     return true;
   }
 
   // do dejitter
-  vtime_t delta = time - continuous_time;
+  vtime_t delta = time - continuous_time();
 
   if (dejitter)
   {
@@ -195,7 +218,9 @@ Dejitter::process(Chunk &in, Chunk &out)
     {
       valib_log(log_event, log_module, "sync lost; resync: %ims", int(time * 1000));
       continuous_sync = true;
-      continuous_time = time;
+      continuous_base = time;
+      continuous_exact = out.exact_time;
+      continuous_pos = 0;
       istat.reset();
       ostat.reset();
       return true;
@@ -290,7 +315,8 @@ Dejitter::process(Chunk &in, Chunk &out)
     if (istat.size() > min_stat_size && fabs(mean) > stddev/2)
     {
       correction = istat.mean() * 2 / istat.size();
-      continuous_time += correction;
+      continuous_base += correction;
+      continuous_exact = ExactTime();
       istat.shift(-correction);
     }
 
@@ -298,9 +324,9 @@ Dejitter::process(Chunk &in, Chunk &out)
     ostat.push(correction);
 
     valib_log(log_trace, log_module, "input:  %-6.0f delta: %-6.0f stddev: %-6.0f mean: %-6.0f", time*1000, delta*1000, istat.stddev()*1000, istat.mean()*1000);
-    valib_log(log_trace, log_module, "output: %-6.0f correction: %-6.0f", continuous_time*1000, correction*1000);
+    valib_log(log_trace, log_module, "output: %-6.0f correction: %-6.0f", continuous_time()*1000, correction*1000);
 
-    out.set_sync(continuous_sync, continuous_time * time_factor + time_shift);
+    stamp(out);
   }
   else // no dejitter
   {
@@ -309,10 +335,11 @@ Dejitter::process(Chunk &in, Chunk &out)
 
     valib_log(log_trace, log_module, "input:  %-6.0f delta: %-6.0f stddev: %-6.0f mean: %-6.0f", time, delta, istat.stddev(), istat.mean());
 
-    out.set_sync(true, time * time_factor + time_shift);
+    if (!out.exact_time.is_set() || time_factor != 1.0 || time_shift != 0)
+      out.set_sync(true, time * time_factor + time_shift);
   }
 
-  continuous_time += out.size * size2time;
+  continuous_pos += out.size;
   return true;
 }
 
@@ -12,11 +12,19 @@
 class Dejitter : public SimpleFilter
 {
 protected:
-  double size2time;
+  int size_rate; // data size per second
 
   // continious time
-  bool    continuous_sync;
-  vtime_t continuous_time;
+  // Continuous time is the base time plus the amount of data passed since,
+  // counted exactly in data size units. So the time does not drift because
+  // of rounding errors accumulated over a long stream.
+  bool      continuous_sync;
+  vtime_t   continuous_base;
+  ExactTime continuous_exact; // exact base time (when known)
+  int64_t   continuous_pos;
+
+  inline vtime_t continuous_time() const;
+  void stamp(Chunk &chunk) const;
 
   // linear time transform
   vtime_t time_shift;
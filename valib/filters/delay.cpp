@@ -117,7 +117,12 @@ Delay::process(Chunk &in, Chunk &out)
     return true; 
 
   if (out.sync)
-    out.time += vtime_t(lag) / spk.sample_rate;
+  {
+    if (out.exact_time.is_set())
+      out.set_sync(true, out.exact_time.add(lag, spk.sample_rate));
+    else
+      out.time += vtime_t(lag) / spk.sample_rate;
+  }
 
   size_t delay;
   sample_t *ptr1;
@@ -4,6 +4,7 @@
   * ADTS
   * MPEG PES
   * SPDIF
+  * MPEG TS
 */
 
 #ifndef VALIB_DEMUX_H
@@ -16,6 +17,8 @@
 #include "../parsers/pes/pes_parser.h"
 #include "../parsers/spdif/spdif_header.h"
 #include "../parsers/spdif/spdif_parser.h"
+#include "../parsers/ts/ts_frame_parser.h"
+#include "../parsers/ts/ts_parser.h"
 
 class Demux : public ParserFilter
 {
@@ -23,10 +26,12 @@ protected:
   ADTSFrameParser  adts_frame;
   PESFrameParser   pes_frame;
   SPDIFFrameParser spdif_frame;
+  TSFrameParser    ts_frame;
 
   ADTSParser  adts_parser;
   PESParser   pes_parser;
   SPDIFParser spdif_parser;
+  TSParser    ts_parser;
 
 public:
   Demux()
@@ -34,6 +39,7 @@ public:
     add(&adts_frame,  &adts_parser);
     add(&pes_frame,   &pes_parser);
     add(&spdif_frame, &spdif_parser);
+    add(&ts_frame,    &ts_parser);
   }
 };
 
@@ -99,7 +99,7 @@ Detector::process(Chunk &in, Chunk &out)
 
         out.set_rawdata(stream.get_debris(), stream.get_debris_size());
         if (spk.format == FORMAT_PCM16)
-          sync.send_sync(out, 1.0/(4 * spk.sample_rate));
+          sync.send_sync_exact(out, 4 * spk.sample_rate);
         else
           sync.send_frame_sync(out);
         return true;
@@ -159,7 +159,7 @@ Detector::flush(Chunk &out)
 
         out.set_rawdata(stream.get_debris(), stream.get_debris_size());
         if (spk.format == FORMAT_PCM16)
-          sync.send_sync(out, 1.0/(4 * spk.sample_rate));
+          sync.send_sync_exact(out, 4 * spk.sample_rate);
         else
           sync.send_frame_sync(out);
         return true;
@@ -43,6 +43,9 @@ public:
   int        get_dts_conv()                  const { return spdif_wrapper.dts_conv;       }
   void       set_dts_conv(int dts_conv)            { spdif_wrapper.dts_conv = dts_conv;   }
 
+  bool       get_gather()                    const { return spdif_wrapper.gather;         }
+  void       set_gather(bool gather)               { spdif_wrapper.gather = gather;       }
+
   FrameInfo  frame_info()                    const { return spdif_wrapper.frame_info();   }
   string     info()                          const { return spdif_wrapper.info();         }
 };
@@ -0,0 +1,81 @@
+#include "io_ring.h"
+
+IORing::IORing():
+data_ready(false), space_ready(false),
+buf_size(0), depth(0), data_size(0),
+head(0), count(0),
+buffers(0), stalls(0), stall_time(0)
+{}
+
+IORing::~IORing()
+{
+  free();
+}
+
+bool
+IORing::allocate(size_t buf_size_, int depth_)
+{
+  free();
+  if (depth_ < 2 || buf_size_ == 0)
+    return false;
+
+  buf.allocate(buf_size_ * depth_);
+  data_size = new size_t[depth_];
+  buf_size = buf_size_;
+  depth = depth_;
+
+  clear();
+  reset_stats();
+  return true;
+}
+
+void
+IORing::free()
+{
+  if (data_size)
+    delete[] data_size;
+  data_size = 0;
+  buf.free();
+
+  buf_size = 0;
+  depth = 0;
+  head = 0;
+  count = 0;
+}
+
+void
+IORing::clear()
+{
+  head = 0;
+  count = 0;
+  data_ready.reset();
+  space_ready.reset();
+}
+
+void
+IORing::stall_wait(Event &event, vtime_t &stall_start)
+{
+  lock.unlock();
+  if (!stall_start)
+  {
+    stall_start = utc_time();
+    stalls++;
+  }
+  event.wait();
+  lock.lock();
+}
+
+void
+IORing::stall_end(vtime_t stall_start)
+{
+  if (stall_start)
+    stall_time += utc_time() - stall_start;
+}
+
+void
+IORing::reset_stats()
+{
+  buffers = 0;
+  stalls = 0;
+  stall_time = 0;
+}
@@ -0,0 +1,109 @@
+/**************************************************************************//**
+  \file io_ring.h
+  \brief IORing: ring of I/O buffers shared between a client and a thread
+******************************************************************************/
+
+#ifndef VALIB_IO_RING_H
+#define VALIB_IO_RING_H
+
+#include "buffer.h"
+#include "vtime.h"
+#include "win32/thread.h"
+
+/**************************************************************************//**
+  \class IORing
+  \brief Ring of I/O buffers shared between a client and an I/O thread.
+
+  Common part of WriteBehindFile and ReadAheadFile: \c depth buffers of
+  \c buf_size bytes each, the queue of filled buffers, events to wake up the
+  other side and stall statistics of the client.
+
+  Ring state (head, count, data_size[]) is protected by the lock. The side
+  that fills buffers sets data_ready, the side that releases buffers sets
+  space_ready.
+
+  The client waits for the other side with stall_wait(), called in a loop
+  with the lock held:
+
+  \code
+    vtime_t stall_start = 0;
+    ring.lock.lock();
+    while (!condition)
+      ring.stall_wait(ring.data_ready, stall_start);
+    ...
+    ring.lock.unlock();
+    ring.stall_end(stall_start);
+  \endcode
+
+  \fn bool IORing::allocate(size_t buf_size, int depth)
+    \param buf_size Size of each buffer
+    \param depth    Number of buffers
+    \return Returns false when parameters are wrong.
+
+    Allocate buffers, empty the ring and reset statistics.
+
+  \fn void IORing::free()
+    Free buffers.
+
+  \fn void IORing::clear()
+    Empty the ring and reset events.
+
+  \fn uint8_t *IORing::buffer(int slot) const
+    Returns the buffer of the slot given.
+
+  \fn void IORing::stall_wait(Event &event, vtime_t &stall_start)
+    \param event       Event to wait for
+    \param stall_start Start of the stall (zero before the first wait)
+
+    Release the lock, wait for the event and take the lock again. The first
+    wait of a stall counts the stall and starts the stall timer.
+
+  \fn void IORing::stall_end(vtime_t stall_start)
+    \param stall_start Start of the stall (zero for no stall)
+
+    Add the stall time. Call without the lock held.
+
+  \fn void IORing::reset_stats()
+    Reset statistics.
+******************************************************************************/
+
+class IORing
+{
+public:
+  CritSec lock;            //!< Protects the ring state below
+  Event data_ready;        //!< Buffer was filled
+  Event space_ready;       //!< Buffer was released
+
+  Rawdata  buf;            //!< Buffers memory
+  size_t   buf_size;       //!< Size of each buffer
+  int      depth;          //!< Number of buffers
+  size_t  *data_size;      //!< Data size in each buffer
+
+  int      head;           //!< First filled buffer
+  int      count;          //!< Number of filled buffers
+
+  int      buffers;        //!< Number of buffers passed by the client
+  int      stalls;         //!< Number of client stalls
+  vtime_t  stall_time;     //!< Total client stall time
+
+  IORing();
+  ~IORing();
+
+  bool allocate(size_t buf_size, int depth);
+  void free();
+  void clear();
+
+  inline uint8_t *buffer(int slot) const
+  { return buf.begin() + slot * buf_size; }
+
+  void stall_wait(Event &event, vtime_t &stall_start);
+  void stall_end(vtime_t stall_start);
+  void reset_stats();
+
+private:
+  // Non-copyable
+  IORing(const IORing &);
+  IORing &operator =(const IORing &);
+};
+
+#endif
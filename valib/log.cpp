@@ -15,6 +15,13 @@ static const size_t def_message_size(256);
 // See LogDispatcher::vlog()
 static const size_t max_message_size = 16384;
 
+// Async log record sizes (the record is 256 bytes on 32bit system)
+static const size_t record_module_size = 32;
+static const size_t record_message_size = 200;
+
+// Time to wait for the logger thread to pass all queued messages to sinks
+static const int logger_timeout = 10000;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 LogDispatcher valib_log_dispatcher;
@@ -46,6 +53,39 @@ LogEntry::print() const
   return string(buf, len) + module + string(": ") + message;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Async queue
+//
+// Bounded queue of fixed-size records with a sequence number at each record.
+// Record at the position pos is free for a writer when seq == pos and is
+// ready for the reader when seq == pos + 1. Writers take positions with
+// compare-and-swap of write_pos, so any number of threads may log without
+// locking. The only reader is the logger thread, it frees the record with
+// seq = pos + queue size.
+//
+// Positions wrap around, so they are compared by the sign of the difference.
+
+struct LogRecord
+{
+  volatile LONG seq;
+  int     level;
+  vtime_t timestamp;
+  size_t  module_len;
+  size_t  message_len;
+  char    module[record_module_size];
+  char    message[record_message_size];
+};
+
+static inline LONG pos_add(LONG pos, LONG n)
+{
+  return (LONG)((unsigned long)pos + (unsigned long)n);
+}
+
+static inline LONG pos_diff(LONG pos1, LONG pos2)
+{
+  return (LONG)((unsigned long)pos1 - (unsigned long)pos2);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // LogDispatcher
 
@@ -54,13 +94,134 @@ class LogDispatcher::Private
 public:
   std::vector<LogSink *> sinks;
   CritSec sink_lock;
+
+  Logger    *logger;
+  LogRecord *queue;
+  LONG       mask;
+  volatile LONG write_pos;
+  volatile LONG read_pos;
+  volatile LONG dropped;
+  volatile LONG sleeping; // logger thread waits for the wakeup event
+  Event wakeup;           // record is ready
+  Event idle;             // queue is empty
+
+  Private():
+  logger(0), queue(0), mask(0), write_pos(0), read_pos(0), dropped(0),
+  sleeping(0), wakeup(false), idle(false)
+  {}
+
+  LogRecord *acquire()
+  {
+    LONG pos = write_pos;
+    while (true)
+    {
+      LogRecord *rec = queue + (pos & mask);
+      LONG diff = pos_diff(rec->seq, pos);
+      if (diff == 0)
+      {
+        LONG prev = InterlockedCompareExchange(&write_pos, pos_add(pos, 1), pos);
+        if (prev == pos)
+          return rec;
+        pos = prev;
+      }
+      else if (diff < 0)
+      {
+        // Queue is full
+        InterlockedIncrement(&dropped);
+        return 0;
+      }
+      else
+        pos = write_pos;
+    }
+  }
+
+  void commit(LogRecord *rec)
+  {
+    InterlockedExchange(&rec->seq, pos_add(rec->seq, 1));
+    if (sleeping)
+      wakeup.set();
+  }
+
+  bool is_ready() const
+  {
+    return queue[read_pos & mask].seq == pos_add(read_pos, 1);
+  }
+
+  bool read(LogEntry &entry)
+  {
+    if (!is_ready())
+      return false;
+
+    LogRecord *rec = queue + (read_pos & mask);
+    entry.timestamp = rec->timestamp;
+    entry.level = rec->level;
+    entry.module.assign(rec->module, rec->module_len);
+    entry.message.assign(rec->message, rec->message_len);
+
+    InterlockedExchange(&rec->seq, pos_add(read_pos, mask + 1));
+    InterlockedExchange(&read_pos, pos_add(read_pos, 1));
+    return true;
+  }
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// Logger thread
+// Passes queued records to sinks. On termination, the queue is drained first.
+
+class LogDispatcher::Logger : public Thread
+{
+public:
+  LogDispatcher *dispatcher;
+
+  Logger(LogDispatcher *dispatcher_): dispatcher(dispatcher_)
+  {}
+
+  virtual void terminate(int timeout_ms = logger_timeout, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    dispatcher->p->wakeup.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+protected:
+  virtual DWORD process()
+  {
+    LogDispatcher::Private *p = dispatcher->p;
+    LogEntry entry;
+    while (true)
+    {
+      if (p->read(entry))
+      {
+        dispatcher->dispatch(entry);
+        continue;
+      }
+
+      p->idle.set();
+      if (f_terminate)
+        break;
+
+      // Writer checks the flag after the record is committed, so
+      // either we see the record or the writer sees the flag.
+      InterlockedExchange(&p->sleeping, 1);
+      if (!p->is_ready())
+        p->wakeup.wait();
+      InterlockedExchange(&p->sleeping, 0);
+    }
+    return 0;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// LogDispatcher
+
 LogDispatcher::LogDispatcher(): max_log_level(log_trace), p(new LogDispatcher::Private())
 {}
 
 LogDispatcher::~LogDispatcher()
 {
+  // Pass queued messages to sinks
+  stop_async();
+
   // Unsubscribe all listeners
   // Do not lock here! Critical section is to be deleted.
   // If destructor needs locking it's a bug of its lifetime.
@@ -71,6 +232,27 @@ LogDispatcher::~LogDispatcher()
 }
 
 void LogDispatcher::log_impl(const LogEntry &entry)
+{
+  if (p->logger)
+  {
+    LogRecord *rec = p->acquire();
+    if (rec)
+    {
+      rec->timestamp = entry.timestamp;
+      rec->level = entry.level;
+      rec->module_len = MIN(entry.module.size(), record_module_size);
+      rec->message_len = MIN(entry.message.size(), record_message_size);
+      memcpy(rec->module, entry.module.c_str(), rec->module_len);
+      memcpy(rec->message, entry.message.c_str(), rec->message_len);
+      p->commit(rec);
+    }
+    return;
+  }
+
+  dispatch(entry);
+}
+
+void LogDispatcher::dispatch(const LogEntry &entry)
 {
   AutoLock lock(&p->sink_lock);
   for (size_t i = 0; i < p->sinks.size(); i++)
@@ -80,6 +262,30 @@ void LogDispatcher::log_impl(const LogEntry &entry)
 
 void LogDispatcher::vlog_impl(int level, const std::string &module, const char *format, va_list args)
 {
+  if (p->logger)
+  {
+    // Format directly into the record
+    LogRecord *rec = p->acquire();
+    if (!rec)
+      return;
+
+    rec->timestamp = local_time();
+    rec->level = level;
+    rec->module_len = MIN(module.size(), record_module_size);
+    memcpy(rec->module, module.c_str(), rec->module_len);
+
+    // vsnprintf may return -1 on overflow
+    int len = vsnprintf(rec->message, record_message_size, format, args);
+    if (len < 0 || len >= (int)record_message_size)
+      len = record_message_size - 1;
+    while (len && (rec->message[len-1] == '\n' || rec->message[len-1] == '\r' || rec->message[len-1] == 0))
+      len--;
+    rec->message_len = len;
+
+    p->commit(rec);
+    return;
+  }
+
   AutoLock lock(&p->sink_lock);
 
   // Allocate message buffer only once
@@ -103,6 +309,74 @@ void LogDispatcher::vlog_impl(int level, const std::string &module, const char *
   log(LogEntry(local_time(), level, module, string(&buf.front(), len)));
 }
 
+bool LogDispatcher::start_async(size_t queue_size)
+{
+  stop_async();
+
+  LONG size = 2;
+  while ((size_t)size < queue_size && size < 0x10000000)
+    size *= 2;
+
+  p->queue = new LogRecord[size];
+  for (LONG i = 0; i < size; i++)
+    p->queue[i].seq = i;
+  p->mask = size - 1;
+  p->write_pos = 0;
+  p->read_pos = 0;
+  p->sleeping = 0;
+  p->wakeup.reset();
+  p->idle.reset();
+
+  p->logger = new Logger(this);
+  if (!p->logger->create(false))
+  {
+    safe_delete(p->logger);
+    delete[] p->queue;
+    p->queue = 0;
+    return false;
+  }
+  return true;
+}
+
+void LogDispatcher::stop_async()
+{
+  if (!p->logger)
+    return;
+
+  p->logger->terminate();
+  safe_delete(p->logger);
+  delete[] p->queue;
+  p->queue = 0;
+}
+
+bool LogDispatcher::is_async() const
+{
+  return p->logger != 0;
+}
+
+void LogDispatcher::flush()
+{
+  if (!p->logger)
+    return;
+
+  LONG pos = p->write_pos;
+  while (pos_diff(p->read_pos, pos) < 0)
+  {
+    p->wakeup.set();
+    p->idle.wait(10);
+  }
+}
+
+int LogDispatcher::get_dropped() const
+{
+  return p->dropped;
+}
+
+void LogDispatcher::reset_dropped()
+{
+  InterlockedExchange(&p->dropped, 0);
+}
+
 bool LogDispatcher::is_subscribed(LogSink *sink)
 {
   AutoLock lock(&p->sink_lock);
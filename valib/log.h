@@ -31,8 +31,18 @@
 // 
 // By default valib log is dispatched to Windows debug output.
 //
-// valib_log() functions do default valib logging. Define VALIB_NO_LOG globally
-// to disable logging in release builds.
+// valib_log() does default valib logging. It is a macro that checks the level
+// before the arguments are evaluated, so a call above the current log level
+// of valib_log_dispatcher costs a comparison only. Define VALIB_NO_LOG
+// globally to disable logging in release builds. Define VALIB_MAX_LOG_LEVEL
+// globally to remove valib_log() calls above this level at compile time. For
+// example, VALIB_MAX_LOG_LEVEL=log_event removes trace logging. The level
+// argument is evaluated more than once, so it must have no side effects.
+//
+// Dispatcher may work asynchronously (see LogDispatcher::start_async()). In
+// this mode the logging thread only puts a fixed-size record into a lock-free
+// queue, and the log entry is passed to the sinks by the logger thread. So a
+// slow sink (log file) does not block the logging thread.
 
 struct LogEntry;
 class LogDispatcher;
@@ -126,6 +136,19 @@ struct LogEntry
 // requested. When logging level is low the only overhead is level checking.
 //
 // Default log level is log_all (do not filter).
+//
+// Asynchronous mode
+// start_async() starts the logger thread. Each message is formatted into a
+// fixed-size record of a lock-free queue (any number of logging threads,
+// the only reader is the logger thread). The logger thread makes the log
+// entry and passes it to the sinks, so sinks are called at the logger thread
+// in this mode. When the queue is full the message is dropped and counted
+// (get_dropped()). Long messages and module names are truncated to fit the
+// record.
+//
+// flush() waits until all messages queued are passed to the sinks.
+// start_async() and stop_async() must not be called while other threads log
+// to this dispatcher.
 
 class LogDispatcher
 {
@@ -142,7 +165,17 @@ public:
   inline void vlog(int level, const std::string &module, const char *format, va_list args);
   bool is_subscribed(LogSink *sink);
 
+  bool start_async(size_t queue_size = 1024);
+  void stop_async();
+  bool is_async() const;
+  void flush();
+
+  int  get_dropped() const;
+  void reset_dropped();
+
 protected:
+  class Logger;
+  void dispatch(const LogEntry &entry);
   void log_impl(const LogEntry &entry);
   void vlog_impl(int level, const std::string &module, const char *format, va_list args);
 
@@ -327,35 +360,44 @@ public:
 
 extern LogDispatcher valib_log_dispatcher;
 
+#ifndef VALIB_MAX_LOG_LEVEL
+#define VALIB_MAX_LOG_LEVEL log_all
+#endif
+
 #ifndef VALIB_NO_LOG
 
-inline void valib_log(int level, const std::string &module, const std::string &message)
+inline void valib_log_impl(int level, const std::string &module, const std::string &message)
 {
-  if (level <= valib_log_dispatcher.get_max_log_level())
-    valib_log_dispatcher.log(level, module, message);
+  valib_log_dispatcher.log(level, module, message);
 }
 
-inline void valib_log(int level, const std::string &module, const char *format, ...)
+inline void valib_log_impl(int level, const std::string &module, const char *format, ...)
 {
-  if (level <= valib_log_dispatcher.get_max_log_level())
-  {
-    va_list args;
-    va_start(args, format);
-    valib_log_dispatcher.vlog(level, module, format, args);
-    va_end(args);
-  }
+  va_list args;
+  va_start(args, format);
+  valib_log_dispatcher.vlog(level, module, format, args);
+  va_end(args);
 }
 
+// The level is checked at the call site before the module and the format
+// arguments are evaluated. Level is usually a constant, so the compile-time
+// check removes the call.
+#define valib_log(level, ...)                                       \
+  do {                                                              \
+    if ((level) <= VALIB_MAX_LOG_LEVEL &&                           \
+        (level) <= valib_log_dispatcher.get_max_log_level())        \
+      valib_log_impl((level), __VA_ARGS__);                         \
+  } while (0)
+
 inline void valib_vlog(int level, const std::string &module, const char *format, va_list args)
 {
-  if (level <= valib_log_dispatcher.get_max_log_level())
+  if (level <= VALIB_MAX_LOG_LEVEL && level <= valib_log_dispatcher.get_max_log_level())
     valib_log_dispatcher.vlog(level, module, format, args);
 }
 
 #else
 
-inline void valib_log(int, const std::string &, const std::string &) {}
-inline void valib_log(int, const std::string &, const char *, ...) {}
+#define valib_log(level, ...) do {} while (0)
 inline void valib_vlog(int level, const std::string &module, const char *format, va_list args) {}
 
 #endif
@@ -0,0 +1,298 @@
+// 64-bit file offsets for mmap() and fstat() on 32-bit posix systems.
+// Must be defined before any system header.
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <string.h>
+#include "map_file.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include "utf8.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Windows implementation
+
+static size_t granularity()
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+}
+
+static HANDLE open_utf8(const char *filename)
+{
+  try
+  {
+    std::wstring wfilename = utf8_to_wstring(filename);
+    return CreateFileW(wfilename.c_str(), GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+  }
+  catch (const utf8::exception &)
+  {
+    // Bad file name
+    return INVALID_HANDLE_VALUE;
+  }
+}
+
+#else
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Posix implementation
+
+static size_t granularity()
+{
+  return (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// off_t must hold file positions above 2G (see _FILE_OFFSET_BITS above)
+typedef char off_t_is_64bit[sizeof(off_t) >= 8? 1: -1];
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Max view size. On 32-bit systems the view must fit the address space
+// fragmented by the application (and be remapped for large files). On 64-bit
+// systems the view is large to reduce the number of remaps.
+
+static const size_t max_view_size = sizeof(void *) > 4? 1 << 30: 16 << 20;
+static const size_t view_granularity = granularity();
+
+///////////////////////////////////////////////////////////////////////////////
+
+MapFile::MapFile():
+#ifdef _WIN32
+  file(0), mapping(0),
+#else
+  fd(-1),
+#endif
+  filesize(0), filepos(0), view(0), view_pos(0), view_size(0)
+{}
+
+MapFile::MapFile(const char *filename):
+#ifdef _WIN32
+  file(0), mapping(0),
+#else
+  fd(-1),
+#endif
+  filesize(0), filepos(0), view(0), view_pos(0), view_size(0)
+{
+  open(filename);
+}
+
+MapFile::~MapFile()
+{
+  close();
+}
+
+bool
+MapFile::open(const char *filename)
+{
+  if (is_open()) close();
+
+#ifdef _WIN32
+
+  HANDLE h = open_utf8(filename);
+  if (h == INVALID_HANDLE_VALUE)
+    return false;
+
+  // Pipes and devices cannot be mapped
+  if (GetFileType(h) != FILE_TYPE_DISK)
+  {
+    CloseHandle(h);
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(h, &file_size))
+  {
+    CloseHandle(h);
+    return false;
+  }
+
+  // Empty file cannot be mapped, but it is still a valid file
+  if (file_size.QuadPart > 0)
+  {
+    mapping = CreateFileMapping(h, 0, PAGE_WRITECOPY, 0, 0, 0);
+    if (!mapping)
+    {
+      CloseHandle(h);
+      return false;
+    }
+  }
+
+  file = h;
+  filesize = file_size.QuadPart;
+
+#else
+
+  // Pipes and devices cannot be mapped. Do not even open them: opening a pipe
+  // waits for the writer, and closing it drops the data written.
+  struct stat st;
+  if (stat(filename, &st) || !S_ISREG(st.st_mode))
+    return false;
+
+  fd = ::open(filename, O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+  {
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+
+  filesize = st.st_size;
+
+#endif
+
+  filepos = 0;
+
+  // Check that the file can actually be mapped
+  if (filesize > 0 && !map_view(0))
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void
+MapFile::close()
+{
+  unmap_view();
+
+#ifdef _WIN32
+  if (mapping)
+    CloseHandle(mapping);
+  if (file)
+    CloseHandle(file);
+  mapping = 0;
+  file = 0;
+#else
+  if (fd != -1)
+    ::close(fd);
+  fd = -1;
+#endif
+
+  filesize = 0;
+  filepos = 0;
+}
+
+bool
+MapFile::map_view(fsize_t pos)
+{
+  unmap_view();
+
+  fsize_t start = pos - pos % view_granularity;
+  size_t size = max_view_size;
+  if (filesize - start < (fsize_t)size)
+    size = (size_t)(filesize - start);
+
+#ifdef _WIN32
+  void *ptr = MapViewOfFile(mapping, FILE_MAP_COPY,
+    (DWORD)(start >> 32), (DWORD)start, size);
+  if (!ptr)
+    return false;
+#else
+  void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)start);
+  if (ptr == MAP_FAILED)
+    return false;
+# ifdef MADV_SEQUENTIAL
+  madvise(ptr, size, MADV_SEQUENTIAL);
+# endif
+#endif
+
+  view = (uint8_t *)ptr;
+  view_pos = start;
+  view_size = size;
+  return true;
+}
+
+void
+MapFile::unmap_view()
+{
+  if (view)
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(view);
+#else
+    munmap(view, view_size);
+#endif
+  }
+
+  view = 0;
+  view_pos = 0;
+  view_size = 0;
+}
+
+size_t
+MapFile::map(uint8_t **data, size_t size, size_t block)
+{
+  if (!is_open() || filepos >= filesize)
+    return 0;
+
+  // Move the view when the current position is out of the view, or when the
+  // data requested does not fit the view, and moving helps.
+  fsize_t view_end = view_pos + view_size;
+  if (!view || filepos < view_pos || filepos >= view_end ||
+      (filepos + (fsize_t)size > view_end && view_end < filesize &&
+       filepos - view_pos >= (fsize_t)view_granularity))
+    if (!map_view(filepos))
+      return 0;
+
+  size_t offset = (size_t)(filepos - view_pos);
+  if (size > view_size - offset)
+    size = view_size - offset;
+
+  // Whole blocks only, except of the end of the file
+  if (block > 1 && size >= block && filepos + (fsize_t)size < filesize)
+    size -= size % block;
+
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+  size_t page_offset = offset % view_granularity;
+  madvise(view + offset - page_offset, size + page_offset, MADV_WILLNEED);
+#endif
+
+  *data = view + offset;
+  filepos += size;
+  return size;
+}
+
+size_t
+MapFile::read(void *buf, size_t size)
+{
+  uint8_t *ptr = (uint8_t *)buf;
+  while (size)
+  {
+    uint8_t *data;
+    size_t data_size = map(&data, size);
+    if (!data_size)
+      break;
+
+    memcpy(ptr, data, data_size);
+    ptr += data_size;
+    size -= data_size;
+  }
+  return ptr - (uint8_t *)buf;
+}
+
+int
+MapFile::seek(fsize_t pos)
+{
+  if (!is_open() || pos < 0)
+    return -1;
+
+  filepos = pos;
+  return 0;
+}
@@ -0,0 +1,152 @@
+/**************************************************************************//**
+  \file map_file.h
+  \brief MapFile: memory-mapped input file
+******************************************************************************/
+
+#ifndef VALIB_MAP_FILE_H
+#define VALIB_MAP_FILE_H
+
+#include "auto_file.h"
+
+/**************************************************************************//**
+  \class MapFile
+  \brief Read-only memory-mapped file. Supports large files and UTF-8 names.
+
+  Interface is similar to AutoFile opened for reading, but the file is not
+  read through the C runtime buffer. Instead, the file is mapped into memory
+  and map() gives direct access to the file data without copying.
+
+  The file is mapped with a sliding view (window). The view is moved when the
+  data requested is out of the current view. On 32-bit systems the view is
+  small enough to fit the address space, so files of any size (>4G) may be
+  mapped. On 64-bit systems the view is large and usually covers the whole
+  file.
+
+  The mapping is copy-on-write. The data returned by map() may be modified
+  in-place (i.e. by downstream filters) and these modifications never reach
+  the file.
+
+  The system is hinted that the file is read sequentially (FILE_FLAG_SEQUENTIAL_SCAN
+  on Windows, MADV_SEQUENTIAL on posix systems). Also, on posix systems the data
+  returned by map() is marked with MADV_WILLNEED to start the read-ahead early.
+
+  \fn MapFile::MapFile()
+    Create file object without opening a file.
+
+  \fn MapFile::MapFile(const char *filename)
+    \param filename File name to open
+
+    Create and open a file. In case of failure, is_open() reports false.
+
+  \fn MapFile::~MapFile()
+    Automatically closes the file.
+
+  \fn bool MapFile::open(const char *filename)
+    \param filename File name to open
+    \return Returns true on success and false otherwise.
+
+    Open and map the file. Fails when the file cannot be mapped (pipes, some
+    devices, etc). Use AutoFile for such files.
+
+  \fn void MapFile::close()
+    Unmap and close the file.
+
+  \fn size_t MapFile::map(uint8_t **data, size_t size, size_t block = 1)
+    \param data  Receives the pointer to the file data at the current position.
+    \param size  Size of the data requested.
+    \param block Size of the data block (i.e. PCM sample size).
+    \return Number of bytes available at \c *data.
+
+    Map up to \c size bytes at the current file position and move the file
+    position forward by the number of bytes returned.
+
+    Returns less than \c size at the end of the file. Also, it may return
+    less when the size requested does not fit the view. Zero is returned only
+    at the end of the file or on mapping error.
+
+    The size returned is a multiple of \c block, so data does not end in the
+    middle of a block. Only the last part of the file may be an exception,
+    when the file size is not a multiple of the block size.
+
+    The pointer returned is valid until the next map(), read(), seek() or
+    close() call.
+
+  \fn size_t MapFile::read(void *buf, size_t size)
+    \param buf  Buffer to read to.
+    \param size Size fo data to read.
+    \return     Number of bytes actually read.
+
+    Copy 'size' bytes into the buffer 'buf'. Invalidates the pointer returned
+    by map().
+
+  \fn bool MapFile::is_open() const
+    \return Returns true when file is open and false otherwise.
+
+  \fn bool MapFile::eof() const
+    \return Returns true when we reach the end of the file and false otherwise.
+
+  \fn fsize_t MapFile::size() const
+    \return Returns size of the file.
+
+  \fn int MapFile::seek(fsize_t pos);
+    \param pos File position to move to.
+    \return Returns 0 on success and non-zero otherwise (same as fseek command).
+
+    Move to the file position 'pos'. It is possible to seek beyond the end of
+    the file, in this case eof() reports true.
+
+  \fn fsize_t MapFile::pos() const;
+    \return Returns current file position.
+******************************************************************************/
+
+class MapFile
+{
+public:
+  typedef AutoFile::fsize_t fsize_t;
+
+protected:
+#ifdef _WIN32
+  void *file;         //!< File handle
+  void *mapping;      //!< File mapping object handle
+#else
+  int fd;             //!< File descriptor
+#endif
+
+  fsize_t filesize;   //!< File size
+  fsize_t filepos;    //!< Current file position
+
+  uint8_t *view;      //!< Current view pointer
+  fsize_t view_pos;   //!< File position of the view
+  size_t  view_size;  //!< Size of the view
+
+  bool map_view(fsize_t pos);
+  void unmap_view();
+
+  // Non-copyable
+  MapFile(const MapFile &);
+  MapFile &operator =(const MapFile &);
+
+public:
+  MapFile();
+  MapFile(const char *filename);
+  ~MapFile();
+
+  bool open(const char *filename);
+  void close();
+
+  size_t map(uint8_t **data, size_t size, size_t block = 1);
+  size_t read(void *buf, size_t size);
+
+#ifdef _WIN32
+  inline bool    is_open() const { return file != 0; }
+#else
+  inline bool    is_open() const { return fd != -1; }
+#endif
+  inline bool    eof()     const { return filepos >= filesize; }
+  inline fsize_t size()    const { return filesize; }
+
+  int seek(fsize_t pos);
+  inline fsize_t pos() const { return filepos; }
+};
+
+#endif
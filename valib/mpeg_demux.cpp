@@ -88,6 +88,9 @@ PSParser::reset()
 
   stream = 0;
   substream = 0;
+
+  has_pts = false;
+  pts = 0;
 }
 
 bool
@@ -195,6 +198,8 @@ PSParser::parse(uint8_t **buf, uint8_t *end)
 
   header_size = 0;
   payload_size = 0;
+  has_pts = false;
+  pts = 0;
 
   while (1)
   {
@@ -320,6 +325,7 @@ PSParser::parse(uint8_t **buf, uint8_t *end)
 
         REQUIRE(7);
         size_t pos = 6;
+        size_t pts_pos = 0;
         if (header[3] != 0xbf) // Private Stream 2 has no following flags
         {
           if ((header[pos] & 0xc0) == 0x80)
@@ -328,6 +334,8 @@ PSParser::parse(uint8_t **buf, uint8_t *end)
             REQUIRE(9);
             pos = header[8] + 9;
             REQUIRE(pos);
+            if ((header[7] & 0x80) && header[8] >= 5)
+              pts_pos = 9;
           } 
           else 
           {
@@ -354,9 +362,15 @@ PSParser::parse(uint8_t **buf, uint8_t *end)
             }
 
             if ((header[pos] & 0xf0) == 0x20)
+            {
+              pts_pos = pos;
               pos += 5;
+            }
             else if ((header[pos] & 0xf0) == 0x30)
+            {
+              pts_pos = pos;
               pos += 10;
+            }
             else if (header[pos] == 0x0f)
               pos++;
             else
@@ -399,6 +413,15 @@ PSParser::parse(uint8_t **buf, uint8_t *end)
           // Incorrect data size
           RESYNC(1);
 
+        if (pts_pos)
+        {
+          // 33-bit timestamp with marker bits
+          const uint8_t *p = header + pts_pos;
+          has_pts = true;
+          pts = (int64_t(p[0] & 0x0e) << 29) | (int64_t(p[1]) << 22) |
+                (int64_t(p[2] & 0xfe) << 14) | (int64_t(p[3]) << 7) | (p[4] >> 1);
+        }
+
         packets++;
         header_size = data_size;
         payload_size = 6 + (header[4] << 8) + header[5] - data_size;
@@ -2,7 +2,7 @@
   \file mpeg_demux.h
   \brief MPEG parser&demuxer
 ******************************************************************************/
-// TODO: Transport Stream parser
+// Transport Stream parser: see parsers/ts/ts_parser.h
 
 #ifndef VALIB_MPEG_DEMUX_H
 #define VALIB_MPEG_DEMUX_H
@@ -37,7 +37,8 @@
 
     When packet is found parser sets 'buf' to the start of the payload and
     returns the size of the payload. header, subheader, header_size,
-    payload_size, stream, substream contain current frame info.
+    payload_size, stream, substream, has_pts and pts contain current frame
+    info.
 
     When all data processed and no packet was found, it returns zero.
     header_size and payload_size are set to zero.
@@ -67,6 +68,9 @@ public:
   int stream;           //!< Program stream number (stream_id).
   int substream;        //!< Substream number (0 for no substream)
 
+  bool has_pts;         //!< Packet header has a presentation timestamp.
+  int64_t pts;          //!< Presentation timestamp (90kHz units).
+
   int packets;          //!< Number of packets processed.
   int errors;           //!< Number of parser errors.
 
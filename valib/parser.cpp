@@ -125,9 +125,11 @@ StreamBuffer::StreamBuffer()
 
   frame = 0;
   frame_size = 0;
+  ext_frame = false;
 
   in_sync = false;
   new_stream = false;
+  zero_copy = false;
 
   frames = 0;
 }
@@ -147,9 +149,11 @@ StreamBuffer::StreamBuffer(FrameParser *parser_)
 
   frame = 0;
   frame_size = 0;
+  ext_frame = false;
 
   in_sync = false;
   new_stream = false;
+  zero_copy = false;
 
   frames = 0;
 
@@ -202,6 +206,7 @@ StreamBuffer::release_parser()
 
   frame = 0;
   frame_size = 0;
+  ext_frame = false;
 
   in_sync = false;
   new_stream = false;
@@ -245,6 +250,18 @@ StreamBuffer::drop_buffer(size_t size)
   memmove(sync_buf, sync_buf + size, sync_data);
 }
 
+// Drop the frame and debris loaded. Frame at the input buffer was not
+// buffered, so only debris is dropped in this case (if any).
+void
+StreamBuffer::drop_frame()
+{
+  if (ext_frame)
+    drop_buffer(debris_size);
+  else
+    drop_buffer(debris_size + frame_size);
+  ext_frame = false;
+}
+
 #define LOAD(required_size) if (!load_buffer(data, end, required_size)) return false;
 #define DROP(size) drop_buffer(size);
 
@@ -282,6 +299,7 @@ StreamBuffer::resync()
 
   frame = 0;
   frame_size = 0;
+  ext_frame = false;
 
   debris = 0;
   debris_size = 0;
@@ -521,13 +539,51 @@ StreamBuffer::load(uint8_t **data, uint8_t *end)
 
   if (frame_size || debris_size)
   {
-    DROP(debris_size + frame_size);
+    drop_frame();
     debris_size = 0;
     frame_size = 0;
   }
 
   new_stream = false;
 
+  /////////////////////////////////////////////////////////////////////////////
+  // Zero-copy: nothing is buffered and the whole frame is at the input
+  // buffer. Frames of unknown size and frames that do not fit into the input
+  // buffer are loaded as usual below. Errors are handled the same way as
+  // below (sync() buffers the input data).
+
+  if (zero_copy && sync_data == 0)
+  {
+    size_t data_size = end - *data;
+    size_t ext_size = const_frame_size;
+    if (!ext_size && data_size >= header_size)
+    {
+      FrameInfo temp_finfo;
+      if (!parser->parse_header(*data, &temp_finfo))
+      {
+        resync();
+        return sync(data, end);
+      }
+      ext_size = temp_finfo.frame_size;
+    }
+
+    if (ext_size && ext_size <= data_size)
+    {
+      if (!parser->next_frame(*data, ext_size))
+      {
+        resync();
+        return sync(data, end);
+      }
+      finfo = parser->frame_info();
+      frame = *data;
+      frame_size = ext_size;
+      ext_frame = true;
+      *data += ext_size;
+      frames++;
+      return true;
+    }
+  }
+
   /////////////////////////////////////////////////////////////////////////////
   // Const frame size
 
@@ -623,10 +679,10 @@ StreamBuffer::load_frame(uint8_t **data, uint8_t *end)
 bool
 StreamBuffer::flush()
 {
-  if (!sync_data)
+  if (!sync_data && !ext_frame)
     return false;
 
-  DROP(debris_size + frame_size);
+  drop_frame();
 
   debris = 0;
   debris_size = 0;
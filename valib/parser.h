@@ -664,6 +664,24 @@ protected:
   \fn void StreamBuffer::release_parser()
     Forgets the parser set with set_parser().
 
+  \fn void StreamBuffer::set_zero_copy(bool zero_copy)
+    \param zero_copy Enable zero-copy frame loading
+
+    In zero-copy mode, when StreamBuffer is in sync and the frame size is
+    known, frames that lie entirely within the input buffer are not copied
+    into the internal buffer. get_frame() points into the input buffer in this
+    case. Frames that straddle input buffer boundaries are copied as usual.
+    State flags behave exactly the same way in both modes.
+
+    Note, that the frame returned may be in the caller's buffer, so the
+    buffer must stay valid (and unchanged) until the next load() call.
+    In-place frame processing modifies the caller's buffer.
+
+    Disabled by default.
+
+  \fn bool StreamBuffer::get_zero_copy() const
+    Returns true when zero-copy mode is enabled.
+
   \name Processing
 
   \fn void StreamBuffer::reset()
@@ -876,15 +894,18 @@ protected:
 
   uint8_t   *frame;              //!< pointer to the start of the frame
   size_t     frame_size;         //!< size of the frame loaded
+  bool       ext_frame;          //!< frame is at the input buffer (not buffered)
 
   // Flags
 
   bool in_sync;                  //!< we're in sync with the stream
   bool new_stream;               //!< frame loaded belongs to a new stream
+  bool zero_copy;                //!< zero-copy frame loading mode
   int  frames;                   //!< number of frames loaded
 
   inline bool load_buffer(uint8_t **data, uint8_t *end, size_t required_size);
   inline void drop_buffer(size_t size);
+  inline void drop_frame();
 
   void resync();
   bool sync(uint8_t **data, uint8_t *data_end);
@@ -901,6 +922,9 @@ public:
   const FrameParser *get_parser() const { return parser; }
   void release_parser();
 
+  void set_zero_copy(bool zero_copy_) { zero_copy = zero_copy_; }
+  bool get_zero_copy() const { return zero_copy; }
+
   /////////////////////////////////////////////////////////
   // Processing
 
@@ -33,13 +33,29 @@ void bit_alloc(
   int dbknee, int floor, 
   int fastleak, int slowleak, 
   int snroffset)
+{
+  int mask[50];
+  bit_alloc_mask(mask, exp, deltbae, deltba, start, end, fscod, halfratecod,
+    sdecay, fdecay, sgain, fgain, dbknee, fastleak, slowleak);
+  bit_alloc_bap(bap, exp, mask, start, end, floor, snroffset);
+}
 
+void bit_alloc_mask(
+  int *mask,      // [50]
+  int8_t *exp,    // [256]
+  int deltbae,
+  int8_t *deltba, // [50]
+  int start, int end, 
+  int fscod, int halfratecod,
+  int sdecay, int fdecay, 
+  int sgain, int fgain, 
+  int dbknee,
+  int fastleak, int slowleak)
 {
   int bin, lastbin, i, j, k, begin, bndstrt, bndend, lowcomp;
   int psd[256];   // PSD
   int bndpsd[50]; // integrated PSD
   int excite[50]; // excitation
-  int mask[50];   // masking value
 
   // Step 1: Exponent mapping into PSD
 
@@ -142,6 +158,16 @@ void bit_alloc(
   if (deltbae == DELTA_BIT_NEW || deltbae == DELTA_BIT_REUSE)
     for (i = 0; i < 50; i++)
       mask[i] += deltba[i];
+}
+
+void bit_alloc_bap(
+  int8_t *bap,    // [256]
+  int8_t *exp,    // [256]
+  const int *mask,// [50]
+  int start, int end, 
+  int floor, int snroffset)
+{
+  int i, j, k, lastbin, m;
 
   // Step 6: Compute bit allocation
 
@@ -151,18 +177,19 @@ void bit_alloc(
   do
   {
     lastbin = min(bndtab[j] + bndsz[j], end);
-    mask[j] -= snroffset;
+    m = mask[j] - snroffset;
 
-    mask[j] -= floor;
-    if (mask[j] < 0)
-      mask[j] = 0;
+    m -= floor;
+    if (m < 0)
+      m = 0;
 
-    mask[j] &= 0x1fe0; // 0001 1111 1110 0000
-    mask[j] += floor;
+    m &= 0x1fe0; // 0001 1111 1110 0000
+    m += floor;
 
     for (k = i; k < lastbin; k++)
     {
-      int address = (psd[i] - mask[j]) >> 5;
+      // psd = 3072 - (exp << 7)
+      int address = (3072 - (exp[i] << 7) - m) >> 5;
       address = min(63, max(0, address));
       bap[i] = baptab[address];
       i++;
@@ -170,7 +197,40 @@ void bit_alloc(
     j++;
   }
   while (end > lastbin);
+}
 
+int bap_bits(const int8_t *bap, int start, int end)
+{
+  // Bits per mantissa for each bap. Grouped mantissas (bap = 1, 2, 4)
+  // are counted separately.
+  static const int bits_tbl[16] = 
+  { 0, 0, 0, 3, 0, 4, 5, 6, 7, 8, 9, 10, 11, 12, 14, 16 };
+
+  // Separate counters for odd and even positions break the dependency
+  // between adjacent increments of the same counter.
+  int cnt0[16] = { 0 };
+  int cnt1[16] = { 0 };
+  int i = start;
+
+  for (; i + 1 < end; i += 2)
+  {
+    cnt0[bap[i]]++;
+    cnt1[bap[i+1]]++;
+  }
+  if (i < end)
+    cnt0[bap[i]]++;
+
+  int bits = 0;
+  for (i = 0; i < 16; i++)
+    bits += (cnt0[i] + cnt1[i]) * bits_tbl[i];
+
+  // 3-levels 3 values in 5 bits
+  // 5-levels 3 values in 7 bits
+  // 11-levels 2 values in 7 bits
+  bits += (cnt0[1] + cnt1[1] + 2) / 3 * 5;
+  bits += (cnt0[2] + cnt1[2] + 2) / 3 * 7;
+  bits += (cnt0[4] + cnt1[4] + 1) / 2 * 7;
+  return bits;
 }
 
 
@@ -20,6 +20,35 @@ void bit_alloc(
   int fastleak, int slowleak, 
   int snroffset);
 
+// Bit allocation split into two stages. The masking curve does not depend
+// on snroffset, so an encoder searching for the best snroffset may compute
+// it once with bit_alloc_mask() and then call bit_alloc_bap() for each
+// candidate offset. bit_alloc() is equivalent to these two calls.
+
+void bit_alloc_mask(
+  int *mask,      // [50]
+  int8_t *exp,    // [256]
+  int deltbae,
+  int8_t *deltba, // [50]
+  int start, int end, 
+  int fscod, int halfratecod,
+  int sdecay, int fdecay, 
+  int sgain, int fgain, 
+  int dbknee,
+  int fastleak, int slowleak);
+
+void bit_alloc_bap(
+  int8_t *bap,    // [256]
+  int8_t *exp,    // [256]
+  const int *mask,// [50]
+  int start, int end, 
+  int floor, int snroffset);
+
+// Number of mantissa bits for the range of baps. Equivalent to
+// BAP_BitCount::add_bap() over the range with a fresh counter, but counts
+// bap values first and then applies the bits-per-bap table.
+int bap_bits(const int8_t *bap, int start, int end);
+
 class BAP_BitCount
 {
 protected:
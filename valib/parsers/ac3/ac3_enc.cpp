@@ -1,6 +1,8 @@
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include "../../crc.h"
+#include "../../win32/thread.h"
 #include "ac3_bitalloc.h"
 #include "ac3_enc.h"
 
@@ -25,9 +27,20 @@
 
 
 
+#ifdef VALIB_SSE2
+#include <emmintrin.h>
+#endif
+
 #define min(a, b) ((a) < (b)? (a): (b))
 #define max(a, b) ((a) > (b)? (a): (b))
 inline int bits_left(int32_t v);
+
+// vector kernels
+static inline void fixed_exp(int8_t *exp, int32_t *mant, int exp_norm, int n);
+static inline void float_exp(int8_t *exp, const sample_t *coef, int n);
+static inline int  exp_diff(const int8_t *exp1, const int8_t *exp2, int n);
+static inline void exp_min(int8_t *exp, const int8_t *exp1, int n);
+static inline void quant_mant(uint16_t *q, const int32_t *mant, const int8_t *bap, int n);
 inline unsigned int mul_poly(unsigned int a, unsigned int b, unsigned int poly);
 inline unsigned int pow_poly(unsigned int a, unsigned int n, unsigned int poly);
 
@@ -90,17 +103,91 @@ const uint16_t floor_tbl[8]  = { 0x02f0, 0x02b0, 0x0270, 0x0230, 0x01f0, 0x0170,
 const uint16_t fgain_tbl[8]  = { 0x0080, 0x0100, 0x0180, 0x0200, 0x0280, 0x0300, 0x0380, 0x0400 };
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Multithreaded encoding
+//
+// Frames are independent except of:
+// * MDCT overlap. Input buffer of each frame contains the last block of the
+//   previous frame, so MDCT and exponents are computed independently.
+// * Bit allocation search starts from the snr offset of the previous frame.
+//   Each worker waits for the offset found by the previous worker and passes
+//   its own offset to the next worker. So bit allocation is done in order,
+//   but analysis and output are done in parallel with it.
+//
+// Frame k is always encoded by the worker k % threads, and the worker is not
+// reused until its frame is output. Therefore the worker encoding the next
+// frame always consumes the snr offset before it may be passed once again
+// and auto-reset event is enough to pass it.
+
+class AC3Enc::Worker : public Thread
+{
+public:
+  const AC3Enc *enc;
+  Worker       *next;             // worker encoding the next frame
+
+  SampleBuf     samples;          // input samples (with history)
+  AC3EncFrame   frame;            // encoded frame
+  int           start_snroffset;  // snr offset of the previous frame
+
+  Event job;                      // new frame was submitted
+  Event snr_ready;                // start_snroffset was set
+  Event done;                     // frame is encoded
+
+  Worker(const AC3Enc *enc_):
+  enc(enc_), next(0), start_snroffset(0),
+  job(false), snr_ready(false), done(true, true)
+  {
+    samples.allocate(AC3_NCHANNELS, AC3_BLOCK_SAMPLES + AC3_FRAME_SAMPLES);
+  }
+
+  virtual void terminate(int timeout_ms = 1000, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    job.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+protected:
+  virtual DWORD process()
+  {
+    while (true)
+    {
+      job.wait();
+      if (f_terminate)
+        return 0;
+
+      enc->analyze_frame(frame, samples);
+
+      snr_ready.wait();
+      bool ok = enc->alloc_frame(frame, start_snroffset);
+
+      // keep the chain alive on error, the error is reported on output
+      next->start_snroffset = frame.snroffset;
+      next->snr_ready.set();
+
+      frame.frame_size = 0;
+      if (ok)
+        enc->output_frame(frame);
+      done.set();
+    }
+  }
+};
+
 AC3Enc::AC3Enc()
-:mdct(7)
+:fixed_point(true), mdct(7), threads(0), workers(0), submit_pos(0), output_pos(0), in_flight(0)
 {
   frames = 0;
   bitrate = 640000;
-  frame_samples.allocate(AC3_NCHANNELS, AC3_FRAME_SAMPLES);
-  frame_buf.allocate(AC3_MAX_FRAME_SIZE);
+  frame_samples.allocate(AC3_NCHANNELS, AC3_BLOCK_SAMPLES + AC3_FRAME_SAMPLES);
   window.allocate(1, AC3_BLOCK_SAMPLES);
   reset();
 }
 
+AC3Enc::~AC3Enc()
+{
+  stop_workers();
+}
+
 int  
 AC3Enc::get_bitrate() const
 {
@@ -124,6 +211,41 @@ AC3Enc::set_bitrate(int _bitrate)
 }
 
 
+int
+AC3Enc::get_threads() const
+{
+  return threads;
+}
+
+void
+AC3Enc::set_threads(int _threads)
+{
+  if (_threads < 2)
+    _threads = 0;
+
+  if (_threads == threads)
+    return;
+
+  stop_workers();
+  if (_threads)
+    start_workers(_threads);
+  reset();
+}
+
+bool
+AC3Enc::get_fixed_point() const
+{
+  return fixed_point;
+}
+
+void
+AC3Enc::set_fixed_point(bool _fixed_point)
+{
+  // drain workers before the switch
+  reset();
+  fixed_point = _fixed_point;
+}
+
 bool 
 AC3Enc::fill_buffer(Chunk &in)
 {
@@ -131,7 +253,7 @@ AC3Enc::fill_buffer(Chunk &in)
   if (in.size < n)
   {
     for (int ch = 0; ch < spk.nch(); ch++)
-      memcpy(frame_samples[ch] + sample, in.samples[ch], in.size * sizeof(sample_t));
+      memcpy(frame_samples[ch] + AC3_BLOCK_SAMPLES + sample, in.samples[ch], in.size * sizeof(sample_t));
 
     sample += in.size;
     in.drop_samples(in.size);
@@ -140,7 +262,7 @@ AC3Enc::fill_buffer(Chunk &in)
   else
   {
     for (int ch = 0; ch < spk.nch(); ch++)
-      memcpy(frame_samples[ch] + sample, in.samples[ch], n * sizeof(sample_t));
+      memcpy(frame_samples[ch] + AC3_BLOCK_SAMPLES + sample, in.samples[ch], n * sizeof(sample_t));
 
     sample = 0;
     in.drop_samples(n);
@@ -148,14 +270,29 @@ AC3Enc::fill_buffer(Chunk &in)
   }
 }
 
+void
+AC3Enc::next_frame()
+{
+  // keep the last block of the frame for MDCT overlap
+  for (int ch = 0; ch < spk.nch(); ch++)
+    memcpy(frame_samples[ch], frame_samples[ch] + AC3_FRAME_SAMPLES, AC3_BLOCK_SAMPLES * sizeof(sample_t));
+}
+
 void 
 AC3Enc::reset()
 {
+  // finish frames being encoded and restart the snr offset chain
+  drain();
+  for (int i = 0; i < threads; i++)
+    workers[i]->snr_ready.reset();
+  submit_pos = 0;
+  output_pos = 0;
+  chain_start = true;
+
   sample = 0;
 
-  memset(delay, 0, sizeof(delay));
-  for (int ch = 0; ch < AC3_NCHANNELS; ch++)
-    delay_exp[ch] = 15; // indicate that we have 0 bits in delay array
+  // zero history means that we have 0 bits in delay array
+  frame_samples.zero();
 
   // reset bit allocation
   sdcycod   = 2;
@@ -211,6 +348,10 @@ AC3Enc::can_open(Speakers _spk) const
 bool 
 AC3Enc::init()
 {
+  // workers read the encoder state, so finish frames being encoded before
+  // the state changes
+  drain();
+
   // sample rate
   fscod = 0;
   for (fscod = 0; fscod < sizeof(freq_tbl) / sizeof(freq_tbl[0]); fscod++)
@@ -259,6 +400,10 @@ AC3Enc::init()
   for (int s = 0; s < AC3_BLOCK_SAMPLES; s++)
     window[0][s] = ac3_window[s] * factor;
 
+#if AC3ENC_PERF
+  reset_cpu_time();
+#endif
+
   reset();
 
   return true;
@@ -275,40 +420,201 @@ AC3Enc::process(Chunk &in, Chunk &out)
 
   // todo: output partially filled frame on flushing
 
-  if (fill_buffer(in))
+  if (!workers)
   {
-    // encode frame
-    if (!encode_frame())
-      THROW(EncodingError());
-
-    out.set_rawdata(frame_buf, frame_size);
-    out.set_sync(sync, time);
-    sync = false;
-    time = 0.0;
-    return true;
+    if (fill_buffer(in))
+    {
+      // encode frame
+      if (!encode_frame())
+        THROW(EncodingError());
+      next_frame();
+
+      out.set_rawdata(frame.frame_buf, frame_size);
+      out.set_sync(sync, time);
+      sync = false;
+      time = 0.0;
+      return true;
+    }
+    return false;
   }
+
+  // Keep all workers busy. Output a frame only when the pipeline is full.
+  while (in_flight < threads && fill_buffer(in))
+    submit_frame();
+
+  if (in_flight < threads)
+    return false;
+
+  return pop_frame(out);
+}
+
+bool
+AC3Enc::flush(Chunk &out)
+{
+  if (in_flight)
+    return pop_frame(out);
   return false;
 }
 
+void
+AC3Enc::start_workers(int _threads)
+{
+  assert(!workers && _threads > 1);
+
+  workers = new Worker *[_threads];
+  for (int i = 0; i < _threads; i++)
+    workers[i] = new Worker(this);
+
+  for (int i = 0; i < _threads; i++)
+  {
+    workers[i]->next = workers[(i + 1) % _threads];
+    workers[i]->create(false);
+  }
+
+  threads = _threads;
+  submit_pos = 0;
+  output_pos = 0;
+  in_flight = 0;
+  chain_start = true;
+}
+
+void
+AC3Enc::stop_workers()
+{
+  if (!workers)
+    return;
+
+  drain();
+  for (int i = 0; i < threads; i++)
+  {
+    workers[i]->terminate();
+    delete workers[i];
+  }
+  delete[] workers;
+
+  workers = 0;
+  threads = 0;
+}
+
+void
+AC3Enc::submit_frame()
+{
+  Worker *w = workers[submit_pos];
+  assert(in_flight < threads && w->done.is_set());
+
+  for (int ch = 0; ch < spk.nch(); ch++)
+    memcpy(w->samples[ch], frame_samples[ch], (AC3_BLOCK_SAMPLES + AC3_FRAME_SAMPLES) * sizeof(sample_t));
+  next_frame();
+
+  w->frame.sync = sync;
+  w->frame.time = time;
+  sync = false;
+  time = 0.0;
+
+  if (chain_start)
+  {
+    w->start_snroffset = (((csnroffst - 15) << 4) + fsnroffst) << 2;
+    w->snr_ready.set();
+    chain_start = false;
+  }
+
+  w->done.reset();
+  w->job.set();
+
+  submit_pos = (submit_pos + 1) % threads;
+  in_flight++;
+}
+
+bool
+AC3Enc::pop_frame(Chunk &out)
+{
+  assert(in_flight > 0);
+  Worker *w = workers[output_pos];
+  w->done.wait();
+
+  output_pos = (output_pos + 1) % threads;
+  in_flight--;
+
+  if (!w->frame.frame_size)
+    THROW(EncodingError());
+
+  csnroffst = (w->frame.snroffset >> 6) + 15;
+  fsnroffst = (w->frame.snroffset >> 2) - ((csnroffst - 15) << 4);
+  frames++;
+
+  out.set_rawdata(w->frame.frame_buf, w->frame.frame_size, w->frame.sync, w->frame.time);
+  return true;
+}
+
+void
+AC3Enc::drain()
+{
+  while (in_flight)
+  {
+    workers[output_pos]->done.wait();
+    output_pos = (output_pos + 1) % threads;
+    in_flight--;
+  }
+}
+
+#if AC3ENC_PERF
+vtime_t
+AC3Enc::get_cpu_time(CPUMeter AC3EncFrame::*meter)
+{
+  vtime_t time = (frame.*meter).get_thread_time();
+  for (int i = 0; i < threads; i++)
+    time += (workers[i]->frame.*meter).get_thread_time();
+  return time;
+}
+
+void
+AC3Enc::reset_cpu_time()
+{
+  CPUMeter AC3EncFrame::*meters[] =
+  { &AC3EncFrame::cpu_mdct, &AC3EncFrame::cpu_exp, &AC3EncFrame::cpu_bitalloc, &AC3EncFrame::cpu_output };
+
+  for (int m = 0; m < array_size(meters); m++)
+  {
+    (frame.*meters[m]).reset();
+    for (int i = 0; i < threads; i++)
+      (workers[i]->frame.*meters[m]).reset();
+  }
+}
+#endif
+
 int 
 AC3Enc::encode_frame()
+{
+  analyze_frame(frame, frame_samples);
+
+  int snroffset = (((csnroffst - 15) << 4) + fsnroffst) << 2;
+  if (!alloc_frame(frame, snroffset))
+    return 0;
+
+  //  snroffset = (((csnroffst - 15) << 4) + fsnroffst) << 2;
+  csnroffst = (frame.snroffset >> 6) + 15;
+  fsnroffst = (frame.snroffset >> 2) - ((csnroffst - 15) << 4);
+
+  frames++;
+  return output_frame(frame);
+}
+
+void
+AC3Enc::analyze_frame(AC3EncFrame &f, const SampleBuf &samples) const
 {
   // todo: support non-standart channel ordering given with spk
-  // todo: support for 24/32/float input sample formats
   // todo: support coupling (basic encoder)
 
   int ch, b, s; // channel, block, sample indexes
   int endmant;
   int nch = spk.nch();
 
-  // frame-wide data
-
+  int exp_norm[AC3_NBLOCKS];                     // normalization (fixed-point)
+  sample_t coef[AC3_NBLOCKS][AC3_BLOCK_SAMPLES]; // mdct coeffitients (floating-point)
 
-  // channel-wide data
-  int exp_norm[AC3_NBLOCKS]; // normalization
-
-  // block-wide data
-  int16_t mdct_buf[AC3_BLOCK_SAMPLES * 2];
+  // per-frame references
+  int32_t (*mant)[AC3_NBLOCKS][AC3_BLOCK_SAMPLES] = f.mant;
+  int8_t  (*exp)[AC3_NBLOCKS][AC3_BLOCK_SAMPLES] = f.exp;
 
   for (ch = 0; ch < nch; ch++)
   {
@@ -318,120 +624,206 @@ AC3Enc::encode_frame()
     else
     {
       // fbw channels
-      chbwcod[ch] = 50;
-      endmant = ((chbwcod[ch] + 12) * 3) + 37;
+      f.chbwcod[ch] = 50;
+      endmant = ((f.chbwcod[ch] + 12) * 3) + 37;
     }
-    nmant[ch] = endmant;
+    f.nmant[ch] = endmant;
 
-    /////////////////////////////////////////////////////////////////
-    // Compute exponents and mdct coeffitients
-    // for all blocks from input data
-    //
+#if AC3ENC_PERF
+    f.cpu_mdct.start();
+#endif
+
+    if (fixed_point)
+      mdct_fixed(mant[ch], exp[ch], exp_norm, samples[ch]);
+    else
+      mdct_float(coef, exp[ch], samples[ch]);
+
+#if AC3ENC_PERF
+    f.cpu_mdct.stop();
+    f.cpu_exp.start();
+#endif
+
+    compute_expstr(f.expstr[ch], exp[ch], endmant);
+    restrict_exp(f.expcod[ch], f.ngrps[ch], exp[ch], f.expstr[ch], endmant);
+
+    // normalize mdct coefs
+    int b1;
     for (b = 0; b < AC3_NBLOCKS; b++)
     {
-      // todo: silence threshold at absolute level of 128
-      int exp_norm1 = 0;  // normalization for this block
-      int exp_norm2 = 0;  // normalization for next block delay
-
-      memcpy(mdct_buf, delay[ch], sizeof(delay[ch]));
-
-      ///////////////////////////////////////////////////////////////
-      // Form input for MDCT
-      //
-
-      sample_t v;
-      sample_t *sptr = frame_samples[ch];
-      sptr += b * AC3_BLOCK_SAMPLES;
-
-      // * copy samples from input buffer to mdct and delay 
-      // * apply ac3 window to both mdct and delay halves
-      // * compute the normalization for mdct (using 
-      //   delay normalization computed at previous block) 
-      //   and delay
-      // optimize: unroll cycle
-      for (s = 0; s < AC3_BLOCK_SAMPLES; s++)
+      if (f.expstr[ch][b] != EXP_REUSE)  b1 = b;
+      if (fixed_point)
       {
-        v = *sptr++;
-        mdct_buf[s + 256] = int32_t(v * window[0][AC3_BLOCK_SAMPLES - s - 1]);
-        delay[ch][s] = int32_t(v * window[0][s]);
-        exp_norm1 |= abs(mdct_buf[s + 256]);
-        exp_norm2 |= abs(delay[ch][s]);
+        for (s = 0; s < endmant; s++)
+          // note: it is possible that exp[ch][b1][s] < exp_norm[b]
+          //       exponent may be decreased because of differential 
+          //       restricttions
+          if (exp[ch][b1][s] - exp_norm[b] >= 0)
+            mant[ch][b][s] <<= exp[ch][b1][s] - exp_norm[b];
+          else
+            mant[ch][b][s] >>= exp_norm[b] - exp[ch][b1][s];
       }
-
-      // compute normalization
-      exp_norm1 = 15 - bits_left(exp_norm1);
-      exp_norm2 = 15 - bits_left(exp_norm2);
-
-      exp_norm1     = min(exp_norm1, delay_exp[ch]);
-
-      exp_norm[b]   = exp_norm1;
-      delay_exp[ch] = exp_norm2;
-
-      // normalize
-      for (s = 0; s < AC3_BLOCK_SAMPLES * 2; s++)
-        mdct_buf[s] <<= exp_norm1;
-
-      // finished with input
-      // now we have normalized mdct_buf[] buffer
-      // and noramlization exponent 'exp'
-      ///////////////////////////////////////////////////////////////
-      
-      ///////////////////////////////////////////////////////////////
-      // MDCT and exponents computation
-      // todo: mdct 256/512 switch 
-
-      mdct.mdct512(mant[ch][b], mdct_buf);
-      
-      // compute exponents
-      // normalize mdct coeffitients
-      // we take into account the normalization
-      for (s = 0; s < AC3_BLOCK_SAMPLES; s++)
+      else
       {
-        exp_norm2 = 15 - bits_left(abs(mant[ch][b][s]));
-        if (exp_norm2 == 15)
-          exp[ch][b][s] = 24;
-        else 
+        for (s = 0; s < endmant; s++)
         {
-          if (exp_norm1 + exp_norm2 > 24)
-          {
-            exp[ch][b][s] = 24;
-            mant[ch][b][s] >>= exp_norm1 + exp_norm2 - 24;  
-          }
-          else
-            exp[ch][b][s] = exp_norm1 + exp_norm2;
+          // mantissa is 16bit fixed-point number in range [-1..1)
+          double m = ldexp(coef[b][s], exp[ch][b1][s] + 15);
+          if (m >= 32767) mant[ch][b][s] = 32767;
+          else if (m <= -32768) mant[ch][b][s] = -32768;
+          else mant[ch][b][s] = (int32_t)floor(m);
         }
       }
+    }
 
-      // finished with MDCT and exponents
-      ///////////////////////////////////////////////////////////////
-    } // for (b = 0; b < AC3_NBLOCKS; b++)
+#if AC3ENC_PERF
+    f.cpu_exp.stop();
+#endif
 
+  } // for (ch = 0; ch < nch; ch++)
 
-    compute_expstr(expstr[ch], exp[ch], endmant);
-    restrict_exp(expcod[ch], ngrps[ch], exp[ch], expstr[ch], endmant);
+  // now we have computed exponents at exp[ch][b][s]
+  // and mantissas at mant[ch][b][s]
+  // mantissas are now in normalized form
+  ///////////////////////////////////////////////////////////////////
+}
 
-    // normalize mdct coefs
-    int b1;
-    for (b = 0; b < AC3_NBLOCKS; b++)
+void
+AC3Enc::mdct_fixed(int32_t mant[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int exp_norm[AC3_NBLOCKS], const sample_t *samples) const
+{
+  int b, s; // block, sample indexes
+
+  // channel-wide data
+  int16_t  delay[AC3_BLOCK_SAMPLES]; // delay buffer (not normalized)
+  int      delay_exp;                // delay buffer normalization
+
+  // block-wide data
+  int16_t mdct_buf[AC3_BLOCK_SAMPLES * 2];
+
+  /////////////////////////////////////////////////////////////////
+  // Restore the delay buffer from the last block of the previous
+  // frame (kept at the beginning of the input buffer)
+  //
+  const sample_t *hptr = samples;
+  delay_exp = 0;
+  for (s = 0; s < AC3_BLOCK_SAMPLES; s++)
+  {
+    delay[s] = int32_t(hptr[s] * window[0][s]);
+    delay_exp |= abs(delay[s]);
+  }
+  delay_exp = 15 - bits_left(delay_exp);
+
+  /////////////////////////////////////////////////////////////////
+  // Compute exponents and mdct coeffitients
+  // for all blocks from input data
+  //
+  for (b = 0; b < AC3_NBLOCKS; b++)
+  {
+    // todo: silence threshold at absolute level of 128
+    int exp_norm1 = 0;  // normalization for this block
+    int exp_norm2 = 0;  // normalization for next block delay
+
+    memcpy(mdct_buf, delay, sizeof(delay));
+
+    ///////////////////////////////////////////////////////////////
+    // Form input for MDCT
+    //
+
+    sample_t v;
+    const sample_t *sptr = samples + (b + 1) * AC3_BLOCK_SAMPLES;
+
+    // * copy samples from input buffer to mdct and delay 
+    // * apply ac3 window to both mdct and delay halves
+    // * compute the normalization for mdct (using 
+    //   delay normalization computed at previous block) 
+    //   and delay
+    // optimize: unroll cycle
+    for (s = 0; s < AC3_BLOCK_SAMPLES; s++)
     {
-      if (expstr[ch][b] != EXP_REUSE)  b1 = b;
-      for (s = 0; s < endmant; s++)
-        // note: it is possible that exp[ch][b1][s] < exp_norm[b]
-        //       exponent may be decreased because of differential 
-        //       restricttions
-        if (exp[ch][b1][s] - exp_norm[b] >= 0)
-          mant[ch][b][s] <<= exp[ch][b1][s] - exp_norm[b];
-        else
-          mant[ch][b][s] >>= exp_norm[b] - exp[ch][b1][s];
+      v = *sptr++;
+      mdct_buf[s + 256] = int32_t(v * window[0][AC3_BLOCK_SAMPLES - s - 1]);
+      delay[s] = int32_t(v * window[0][s]);
+      exp_norm1 |= abs(mdct_buf[s + 256]);
+      exp_norm2 |= abs(delay[s]);
     }
 
-  } // for (ch = 0; ch < nch; ch++)
+    // compute normalization
+    exp_norm1 = 15 - bits_left(exp_norm1);
+    exp_norm2 = 15 - bits_left(exp_norm2);
+
+    exp_norm1     = min(exp_norm1, delay_exp);
+
+    exp_norm[b]   = exp_norm1;
+    delay_exp     = exp_norm2;
+
+    // normalize
+    for (s = 0; s < AC3_BLOCK_SAMPLES * 2; s++)
+      mdct_buf[s] <<= exp_norm1;
+
+    // finished with input
+    // now we have normalized mdct_buf[] buffer
+    // and noramlization exponent 'exp'
+    ///////////////////////////////////////////////////////////////
+    
+    ///////////////////////////////////////////////////////////////
+    // MDCT and exponents computation
+    // todo: mdct 256/512 switch 
+
+    mdct.mdct512(mant[b], mdct_buf);
+    
+    // compute exponents
+    // normalize mdct coeffitients
+    // we take into account the normalization
+    fixed_exp(exp[b], mant[b], exp_norm1, AC3_BLOCK_SAMPLES);
+
+    // finished with MDCT and exponents
+    ///////////////////////////////////////////////////////////////
+  } // for (b = 0; b < AC3_NBLOCKS; b++)
+}
 
+void
+AC3Enc::mdct_float(sample_t coef[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], const sample_t *samples) const
+{
+  int b, s; // block, sample indexes
+  sample_t mdct_buf[AC3_BLOCK_SAMPLES * 2];
 
-  // now we have computed exponents at exp[ch][b][s]
-  // and mantissas at mant[ch][b][s]
-  // mantissas are now in normalized form
-  ///////////////////////////////////////////////////////////////////
+  // Input buffer starts with the last block of the previous frame,
+  // so each block is formed from the continuous range of samples.
+  for (b = 0; b < AC3_NBLOCKS; b++)
+  {
+    const sample_t *sptr = samples + b * AC3_BLOCK_SAMPLES;
+    for (s = 0; s < AC3_BLOCK_SAMPLES; s++)
+    {
+      mdct_buf[s] = sptr[s] * window[0][s];
+      mdct_buf[s + 256] = sptr[s + 256] * window[0][AC3_BLOCK_SAMPLES - s - 1];
+    }
+
+    fmdct.mdct512(coef[b], mdct_buf);
+
+    // Convert coeffitients to [-1..1) range and compute exponents.
+    for (s = 0; s < AC3_BLOCK_SAMPLES; s++)
+      coef[b][s] *= sample_t(1.0 / 32768);
+    float_exp(exp[b], coef[b], AC3_BLOCK_SAMPLES);
+  }
+}
+
+bool
+AC3Enc::alloc_frame(AC3EncFrame &f, int snroffset) const
+{
+  int ch, b;
+  int nch = spk.nch();
+
+#if AC3ENC_PERF
+  f.cpu_bitalloc.start();
+#endif
+
+  // per-frame references
+  int8_t (*exp)[AC3_NBLOCKS][AC3_BLOCK_SAMPLES] = f.exp;
+  int8_t (*bap)[AC3_NBLOCKS][AC3_BLOCK_SAMPLES] = f.bap;
+  int    (*expstr)[AC3_NBLOCKS] = f.expstr;
+  int    (*ngrps)[AC3_NBLOCKS] = f.ngrps;
+  int    *nmant = f.nmant;
+
+  f.snroffset = snroffset;
 
   ///////////////////////////////////////////////////////////////////
   // Compute bits left for mantissas
@@ -489,44 +881,29 @@ AC3Enc::encode_frame()
   int fdecay    = fdecay_tbl[fdcycod];
   int sgain     = sgain_tbl[sgaincod];
   int dbknee    = dbknee_tbl[dbpbcod];
-  int floor     = floor_tbl[floorcod];
   int fgain     = fgain_tbl[fgaincod];
 
   const int snroffset_max = (((63 - 15) << 4) + 15) << 2;
   const int snroffset_min = (((0 - 15) << 4) + 0) << 2;
-  int snroffset = (((csnroffst - 15) << 4) + fsnroffst) << 2;
   int ba_bits;
-  int ba_block;
   int high, low; // bisection bounds
 
-  BAP_BitCount block_bits;
-  ba_bits = 0;
-  ba_block = 0;
-
+  // Masking curve does not depend on snroffset, so compute it once.
+  // Each bisection step only derives baps from the cached curve.
   for (ch = 0; ch < nch; ch++)
     for (b = 0; b < AC3_NBLOCKS; b++)
       if (expstr[ch][b] != EXP_REUSE)
-      {
-        bit_alloc(
-          bap[ch][b], exp[ch][b], 
+        bit_alloc_mask(
+          f.mask[ch][b], exp[ch][b], 
           DELTA_BIT_NONE, 0, 
           0, nmant[ch], 
           fscod, halfratecod, 
           sdecay, fdecay, 
           sgain, fgain, 
-          dbknee, floor, 
-          0, 0, 
-          snroffset);
-        block_bits.reset();
-        block_bits.add_bap(bap[ch][b], 0, nmant[ch]);
-        ba_bits += block_bits.bits;
-        ba_block = b;
-      }
-      else
-      {
-        memcpy(bap[ch][b], bap[ch][ba_block], sizeof(bap[0][0][0]) * nmant[ch]);
-        ba_bits += block_bits.bits;
-      }
+          dbknee, 
+          0, 0);
+
+  ba_bits = alloc_bits(f, snroffset);
 
   // bisection init
   if (ba_bits > bits_left)
@@ -544,32 +921,7 @@ AC3Enc::encode_frame()
   while (high - low > 4)
   {
     snroffset = ((high + low) >> 1) & ~3;
-
-    ba_bits = 0;
-    for (ch = 0; ch < nch; ch++)
-      for (b = 0; b < AC3_NBLOCKS; b++)
-        if (expstr[ch][b] != EXP_REUSE)
-        {
-          bit_alloc(
-            bap[ch][b], exp[ch][b], 
-            DELTA_BIT_NONE, 0, 
-            0, nmant[ch], 
-            fscod, halfratecod, 
-            sdecay, fdecay, 
-            sgain, fgain, 
-            dbknee, floor, 
-            0, 0, 
-            snroffset);
-          block_bits.reset();
-          block_bits.add_bap(bap[ch][b], 0, nmant[ch]);
-          ba_bits += block_bits.bits;
-          ba_block = b;
-        }
-        else
-        {
-          memcpy(bap[ch][b], bap[ch][ba_block], sizeof(bap[0][0][0]) * nmant[ch]);
-          ba_bits += block_bits.bits;
-        }
+    ba_bits = alloc_bits(f, snroffset);
 
     if (ba_bits > bits_left)
       high = snroffset;
@@ -579,45 +931,83 @@ AC3Enc::encode_frame()
 
   // do bit allocation
   snroffset = low & ~3; // clear 2 last bits
-  ba_bits = 0;
+  ba_bits = alloc_bits(f, snroffset);
+
+  // copy reused baps
+  int ba_block = 0;
   for (ch = 0; ch < nch; ch++)
     for (b = 0; b < AC3_NBLOCKS; b++)
       if (expstr[ch][b] != EXP_REUSE)
-      {
-        bit_alloc(
-          bap[ch][b], exp[ch][b], 
-          DELTA_BIT_NONE, 0, 
-          0, nmant[ch], 
-          fscod, halfratecod, 
-          sdecay, fdecay, 
-          sgain, fgain, 
-          dbknee, floor, 
-          0, 0, 
-          snroffset);
-        block_bits.reset();
-        block_bits.add_bap(bap[ch][b], 0, nmant[ch]);
-        ba_bits += block_bits.bits;
         ba_block = b;
-      }
       else
-      {
         memcpy(bap[ch][b], bap[ch][ba_block], sizeof(bap[0][0][0]) * nmant[ch]);
-        ba_bits += block_bits.bits;
-      }
+
+#if AC3ENC_PERF
+  f.cpu_bitalloc.stop();
+#endif
 
   if (ba_bits > bits_left)
     // some error happen!!!
-    return 0;
+    return false;
 
-  //  snroffset = (((csnroffst - 15) << 4) + fsnroffst) << 2;
-  csnroffst = (snroffset >> 6) + 15;
-  fsnroffst = (snroffset >> 2) - ((csnroffst - 15) << 4);
+  f.snroffset = snroffset;
+  return true;
 
-  // debug:
-  assert(((((csnroffst - 15) << 4) + fsnroffst) << 2) == snroffset);
-  
   // Finished with bit allocation
   ///////////////////////////////////////////////////////////////////
+}
+
+int
+AC3Enc::alloc_bits(AC3EncFrame &f, int snroffset) const
+{
+  // Derive baps from the cached masking curve and count mantissa bits.
+  // Baps of reused blocks are not copied here, but the bits are counted.
+  int floor = floor_tbl[floorcod];
+  int ba_bits = 0;
+  int block_bits = 0;
+
+  for (int ch = 0; ch < spk.nch(); ch++)
+    for (int b = 0; b < AC3_NBLOCKS; b++)
+    {
+      if (f.expstr[ch][b] != EXP_REUSE)
+      {
+        bit_alloc_bap(f.bap[ch][b], f.exp[ch][b], f.mask[ch][b], 0, f.nmant[ch], floor, snroffset);
+        block_bits = bap_bits(f.bap[ch][b], 0, f.nmant[ch]);
+      }
+      ba_bits += block_bits;
+    }
+
+  return ba_bits;
+}
+
+int
+AC3Enc::output_frame(AC3EncFrame &f) const
+{
+  int ch, b, s;
+  int nch = spk.nch();
+
+  // per-frame references
+  int32_t (*mant)[AC3_NBLOCKS][AC3_BLOCK_SAMPLES] = f.mant;
+  int8_t  (*expcod)[AC3_NBLOCKS][AC3_BLOCK_SAMPLES] = f.expcod;
+  int8_t  (*bap)[AC3_NBLOCKS][AC3_BLOCK_SAMPLES] = f.bap;
+  int     (*expstr)[AC3_NBLOCKS] = f.expstr;
+  int     (*ngrps)[AC3_NBLOCKS] = f.ngrps;
+  int     *nmant = f.nmant;
+  int     *chbwcod = f.chbwcod;
+  uint8_t *frame_buf = f.frame_buf;
+  uint16_t qmant[AC3_NCHANNELS][AC3_BLOCK_SAMPLES]; // quantized mantissas of a block
+  WriteBS bs;
+
+  //  snroffset = (((csnroffst - 15) << 4) + fsnroffst) << 2;
+  int csnroffst = (f.snroffset >> 6) + 15;
+  int fsnroffst = (f.snroffset >> 2) - ((csnroffst - 15) << 4);
+
+  // debug:
+  assert(((((csnroffst - 15) << 4) + fsnroffst) << 2) == f.snroffset);
+
+#if AC3ENC_PERF
+  f.cpu_output.start();
+#endif
 
 
   ///////////////////////////////////////////////////////////////////
@@ -767,6 +1157,10 @@ AC3Enc::encode_frame()
     int qs4 = 0; int qch4 = 0;
     int v;
 
+    // quantize mantissas of the block
+    for (ch = 0; ch < nch; ch++)
+      quant_mant(qmant[ch], mant[ch][b], bap[ch][b], nmant[ch]);
+
     for (ch = 0; ch < nch; ch++)
       for (s = 0; s < nmant[ch]; s++)
         #define GROUP_NEXT(q, value, levels, mul)                        \
@@ -779,7 +1173,7 @@ AC3Enc::encode_frame()
           }                                                              \
           if (qs##q < nmant[qch##q] && qch##q < nch)                     \
           {                                                              \
-            value += mul * sym_quant(mant[qch##q][b][qs##q], levels);    \
+            value += mul * qmant[qch##q][qs##q];                         \
             qs##q++;                                                     \
           }
 
@@ -791,7 +1185,7 @@ AC3Enc::encode_frame()
             // 5 bits 3 groups 3 q-levels
             if ((qch1 > ch) || (qch1 == ch && qs1 > s)) break;
 
-            v = 9 * sym_quant(mant[ch][b][s], 3);
+            v = 9 * qmant[ch][s];
 
             // seek for next value to group
             // we start seeking from current position
@@ -808,7 +1202,7 @@ AC3Enc::encode_frame()
             // group value if found
             if (qs1 < nmant[qch1] && qch1 < nch)
             {
-              v += 3 * sym_quant(mant[qch1][b][qs1], 3);
+              v += 3 * qmant[qch1][qs1];
               qs1++;
             }
 
@@ -824,7 +1218,7 @@ AC3Enc::encode_frame()
             if ((qch2 > ch) || (qch2 == ch && qs2 > s)) break;
             // note: ch >= qch2 && s >= qs2;
 
-            v = 25 * sym_quant(mant[ch][b][s], 5);
+            v = 25 * qmant[ch][s];
 
             qch2 = ch;
             qs2 = s + 1;
@@ -836,7 +1230,7 @@ AC3Enc::encode_frame()
             break;
 
           case 3:
-            bs.put(3, sym_quant(mant[ch][b][s], 7));
+            bs.put(3, qmant[ch][s]);
             COUNT_BITS(0, 3);
             break;
 
@@ -844,7 +1238,7 @@ AC3Enc::encode_frame()
             // 7 bits 2 groups 11 q-levels
             if ((qch4 > ch) || (qch4 == ch && qs4 > s)) break;
 
-            v = 11 * sym_quant(mant[ch][b][s], 11);
+            v = 11 * qmant[ch][s];
             qch4 = ch;
             qs4 = s + 1;
             GROUP_NEXT(4, v, 11, 1);
@@ -854,22 +1248,22 @@ AC3Enc::encode_frame()
             break;
 
           case 5:
-            bs.put(4, sym_quant(mant[ch][b][s], 15));
+            bs.put(4, qmant[ch][s]);
             COUNT_BITS(0, 4);
             break;
 
           case 14:
-            bs.put(14, asym_quant(mant[ch][b][s], 14));
+            bs.put(14, qmant[ch][s]);
             COUNT_BITS(0, 14);
             break;
 
           case 15:
-            bs.put(16, asym_quant(mant[ch][b][s], 16));
+            bs.put(16, qmant[ch][s]);
             COUNT_BITS(0, 16);
             break;
 
           default:
-            bs.put(bap[ch][b][s] - 1, asym_quant(mant[ch][b][s], bap[ch][b][s] - 1));
+            bs.put(bap[ch][b][s] - 1, qmant[ch][s]);
             COUNT_BITS(0, bap[ch][b][s] - 1);
             break;      
         } // switch (bap[s])
@@ -891,8 +1285,11 @@ AC3Enc::encode_frame()
   frame_buf[frame_size - 2] = crc >> 8;
   frame_buf[frame_size - 1] = crc & 0xff;
 
+#if AC3ENC_PERF
+  f.cpu_output.stop();
+#endif
 
-  frames++;
+  f.frame_size = frame_size;
   return frame_size;
 }
 
@@ -900,19 +1297,14 @@ AC3Enc::encode_frame()
 inline void 
 AC3Enc::compute_expstr(int expstr[AC3_NBLOCKS], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int endmant) const
 {
-  int b, b1, s;
-  int exp_diff;
+  int b, b1;
 
   // compute variation of exponents over time and reuse 
   // old exponents if variation is too small
   expstr[0] = EXP_D15;
   for (b = 1; b < AC3_NBLOCKS; b++) 
   {
-    exp_diff = 0;
-    for (s = 0; s < endmant; s++)
-      exp_diff += abs(exp[b][s] - exp[b-1][s]);
-
-    if (exp_diff > EXP_DIFF_THRESHOLD)
+    if (exp_diff(exp[b], exp[b-1], endmant) > EXP_DIFF_THRESHOLD)
       expstr[b] = EXP_D15;
     else
       expstr[b] = EXP_REUSE;
@@ -951,16 +1343,14 @@ AC3Enc::compute_expstr(int expstr[AC3_NBLOCKS], int8_t exp[AC3_NBLOCKS][AC3_BLOC
 inline void 
 AC3Enc::restrict_exp(int8_t expcod[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int ngrps[AC3_NBLOCKS], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int expstr[AC3_NBLOCKS], int endmant) const
 {
-  int s, b, b1;
+  int b, b1;
 
   b = 0;
   while (b < AC3_NBLOCKS) 
   {
     // Find minimum of reused exponents
     for (b1 = b + 1; b1 < AC3_NBLOCKS && expstr[b1] == EXP_REUSE; b1++)
-      for (s = 0; s < endmant; s++)
-        if (exp[b][s] > exp[b1][s])
-          exp[b][s] = exp[b1][s];
+      exp_min(exp[b], exp[b1], endmant);
 
     // compute encoded exponents
     // and update exponents as decoder will see them
@@ -1107,6 +1497,260 @@ AC3Enc::encode_exp(int8_t expcod[AC3_BLOCK_SAMPLES], int8_t exp[AC3_BLOCK_SAMPLE
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Vector kernels
+//
+// Each kernel has a scalar version (*_c) and may have an SSE2 version
+// (*_sse2). SSE2 versions process the bulk of data and use scalar versions
+// for the tail. Both versions give exactly the same result. Kernels are
+// declared at ac3_enc.h to be tested.
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Quantizer parameters for each bap: q = ((mant + off) * mul >> 16) | ((mant + off) & full)
+// Symmetric:  q = (mant + 32768) * levels >> 16
+// Asymmetric: q = mant >> (16 - bits) & ((1 << bits) - 1) = uint16(mant) * (1 << bits) >> 16
+static const uint16_t quant_off[16]  = { 0, 0x8000, 0x8000, 0x8000, 0x8000, 0x8000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+static const uint16_t quant_mul[16]  = { 0, 3, 5, 7, 11, 15, 1 << 5, 1 << 6, 1 << 7, 1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 14, 0 };
+static const uint16_t quant_full[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xffff };
+
+// Exponents of fixed-point mdct coefficients. Coefficients that do not
+// fit into 24 exponents are shifted.
+void fixed_exp_c(int8_t *exp, int32_t *mant, int exp_norm, int n)
+{
+  for (int s = 0; s < n; s++)
+  {
+    int e = 15 - bits_left(abs(mant[s]));
+    if (e == 15)
+      exp[s] = 24;
+    else if (exp_norm + e > 24)
+    {
+      exp[s] = 24;
+      mant[s] >>= exp_norm + e - 24;
+    }
+    else
+      exp[s] = exp_norm + e;
+  }
+}
+
+// Exponents of floating-point mdct coefficients in [-1..1) range.
+// Exponent is the number of leading zeros of the 16bit mantissa.
+void float_exp_c(int8_t *exp, const sample_t *coef, int n)
+{
+  for (int s = 0; s < n; s++)
+  {
+    int e;
+    if (frexp(coef[s], &e) == 0 || e < -24)
+      exp[s] = 24;
+    else
+      exp[s] = e > 0? 0: -e;
+  }
+}
+
+// Sum of absolute differences between two exponent sets
+int exp_diff_c(const int8_t *exp1, const int8_t *exp2, int n)
+{
+  int diff = 0;
+  for (int s = 0; s < n; s++)
+    diff += abs(exp1[s] - exp2[s]);
+  return diff;
+}
+
+// Minimum of two exponent sets
+void exp_min_c(int8_t *exp, const int8_t *exp1, int n)
+{
+  for (int s = 0; s < n; s++)
+    if (exp[s] > exp1[s])
+      exp[s] = exp1[s];
+}
+
+// Mantissa quantization
+void quant_mant_c(uint16_t *q, const int32_t *mant, const int8_t *bap, int n)
+{
+  for (int s = 0; s < n; s++)
+  {
+    int b = bap[s];
+    if (b == 0)
+      q[s] = 0;
+    else if (b < 6)
+      q[s] = sym_quant(mant[s], quant_mul[b]);
+    else if (b < 14)
+      q[s] = asym_quant(mant[s], b - 1);
+    else if (b == 14)
+      q[s] = asym_quant(mant[s], 14);
+    else
+      q[s] = asym_quant(mant[s], 16);
+  }
+}
+
+#ifdef VALIB_SSE2
+
+void fixed_exp_sse2(int8_t *exp, int32_t *mant, int exp_norm, int n)
+{
+  // bits_left(v) for 0 < v < 2^24 is the exponent of float(v) plus one
+  const __m128i max_exact = _mm_set1_epi32((1 << 24) - 1);
+  const __m128i exp_bias = _mm_set1_epi32(127 - 1 + 15 + exp_norm);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i e24 = _mm_set1_epi16(24);
+
+  int s;
+  for (s = 0; s + 8 <= n; s += 8)
+  {
+    __m128i m0 = _mm_loadu_si128((const __m128i *)(mant + s));
+    __m128i m1 = _mm_loadu_si128((const __m128i *)(mant + s + 4));
+    __m128i sign0 = _mm_srai_epi32(m0, 31);
+    __m128i sign1 = _mm_srai_epi32(m1, 31);
+    __m128i a0 = _mm_sub_epi32(_mm_xor_si128(m0, sign0), sign0);
+    __m128i a1 = _mm_sub_epi32(_mm_xor_si128(m1, sign1), sign1);
+
+    // large values (and abs(INT_MIN) < 0) are not exact in float
+    __m128i big = _mm_or_si128(_mm_cmpgt_epi32(a0, max_exact), _mm_cmplt_epi32(a0, zero));
+    big = _mm_or_si128(big, _mm_or_si128(_mm_cmpgt_epi32(a1, max_exact), _mm_cmplt_epi32(a1, zero)));
+    if (_mm_movemask_epi8(big))
+    {
+      fixed_exp_c(exp + s, mant + s, exp_norm, 8);
+      continue;
+    }
+
+    // e = exp_norm + 15 - bits_left(a)
+    // zero gives float exponent 0 and e > 24
+    __m128i f0 = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(a0)), 23);
+    __m128i f1 = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(a1)), 23);
+    __m128i e = _mm_packs_epi32(_mm_sub_epi32(exp_bias, f0), _mm_sub_epi32(exp_bias, f1));
+
+    // non-zero mantissas with e > 24 must be shifted
+    __m128i nz = _mm_packs_epi32(_mm_cmpgt_epi32(a0, zero), _mm_cmpgt_epi32(a1, zero));
+    if (_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi16(e, e24), nz)))
+    {
+      fixed_exp_c(exp + s, mant + s, exp_norm, 8);
+      continue;
+    }
+
+    e = _mm_min_epi16(e, e24);
+    _mm_storel_epi64((__m128i *)(exp + s), _mm_packs_epi16(e, e));
+  }
+  fixed_exp_c(exp + s, mant + s, exp_norm, n - s);
+}
+
+void float_exp_sse2(int8_t *exp, const sample_t *coef, int n)
+{
+  // Exponent of frexp() is taken from the binary representation:
+  // e = biased_exp - (bias - 1). Zero and denormals give large
+  // negative e and exponent is limited to 24.
+  const __m128i e0 = _mm_setzero_si128();
+  const __m128i e24 = _mm_set1_epi16(24);
+
+  int s;
+  for (s = 0; s + 8 <= n; s += 8)
+  {
+    __m128i e;
+#ifdef FLOAT_SAMPLE
+    const __m128i bias = _mm_set1_epi32(126);
+    const __m128i mask = _mm_set1_epi32(0xff);
+    __m128i x0 = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i *)(coef + s)), 23), mask);
+    __m128i x1 = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i *)(coef + s + 4)), 23), mask);
+    e = _mm_packs_epi32(_mm_sub_epi32(bias, x0), _mm_sub_epi32(bias, x1));
+#else
+    const __m128i bias = _mm_set1_epi32(1022);
+    const __m128i mask = _mm_set1_epi32(0x7ff);
+    __m128i x0 = _mm_srli_epi64(_mm_loadu_si128((const __m128i *)(coef + s)), 52);
+    __m128i x1 = _mm_srli_epi64(_mm_loadu_si128((const __m128i *)(coef + s + 2)), 52);
+    __m128i x2 = _mm_srli_epi64(_mm_loadu_si128((const __m128i *)(coef + s + 4)), 52);
+    __m128i x3 = _mm_srli_epi64(_mm_loadu_si128((const __m128i *)(coef + s + 6)), 52);
+    // gather low dwords of 64bit lanes
+    x0 = _mm_unpacklo_epi64(_mm_shuffle_epi32(x0, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(x1, _MM_SHUFFLE(3, 1, 2, 0)));
+    x2 = _mm_unpacklo_epi64(_mm_shuffle_epi32(x2, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(x3, _MM_SHUFFLE(3, 1, 2, 0)));
+    x0 = _mm_and_si128(x0, mask);
+    x2 = _mm_and_si128(x2, mask);
+    e = _mm_packs_epi32(_mm_sub_epi32(bias, x0), _mm_sub_epi32(bias, x2));
+#endif
+    e = _mm_min_epi16(_mm_max_epi16(e, e0), e24);
+    _mm_storel_epi64((__m128i *)(exp + s), _mm_packs_epi16(e, e));
+  }
+  float_exp_c(exp + s, coef + s, n - s);
+}
+
+int exp_diff_sse2(const int8_t *exp1, const int8_t *exp2, int n)
+{
+  // exponents are non-negative, so unsigned sad works
+  __m128i sum = _mm_setzero_si128();
+  int s;
+  for (s = 0; s + 16 <= n; s += 16)
+  {
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(exp1 + s));
+    __m128i x2 = _mm_loadu_si128((const __m128i *)(exp2 + s));
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(x1, x2));
+  }
+  int diff = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+  return diff + exp_diff_c(exp1 + s, exp2 + s, n - s);
+}
+
+void exp_min_sse2(int8_t *exp, const int8_t *exp1, int n)
+{
+  // exponents are non-negative, so unsigned min works
+  int s;
+  for (s = 0; s + 16 <= n; s += 16)
+  {
+    __m128i x  = _mm_loadu_si128((const __m128i *)(exp + s));
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(exp1 + s));
+    _mm_storeu_si128((__m128i *)(exp + s), _mm_min_epu8(x, x1));
+  }
+  exp_min_c(exp + s, exp1 + s, n - s);
+}
+
+void quant_mant_sse2(uint16_t *q, const int32_t *mant, const int8_t *bap, int n)
+{
+  // Mantissas are 16bit numbers, so 8 of them are quantized at once
+  // with 16bit multiplication. Quantizer parameters are gathered
+  // from tables by bap.
+  int s;
+  for (s = 0; s + 8 <= n; s += 8)
+  {
+    __m128i m = _mm_packs_epi32(
+      _mm_loadu_si128((const __m128i *)(mant + s)),
+      _mm_loadu_si128((const __m128i *)(mant + s + 4)));
+
+    const int8_t *b = bap + s;
+    __m128i off  = _mm_setr_epi16(quant_off[b[0]],  quant_off[b[1]],  quant_off[b[2]],  quant_off[b[3]],  quant_off[b[4]],  quant_off[b[5]],  quant_off[b[6]],  quant_off[b[7]]);
+    __m128i mul  = _mm_setr_epi16(quant_mul[b[0]],  quant_mul[b[1]],  quant_mul[b[2]],  quant_mul[b[3]],  quant_mul[b[4]],  quant_mul[b[5]],  quant_mul[b[6]],  quant_mul[b[7]]);
+    __m128i full = _mm_setr_epi16(quant_full[b[0]], quant_full[b[1]], quant_full[b[2]], quant_full[b[3]], quant_full[b[4]], quant_full[b[5]], quant_full[b[6]], quant_full[b[7]]);
+
+    m = _mm_add_epi16(m, off);
+    m = _mm_or_si128(_mm_mulhi_epu16(m, mul), _mm_and_si128(m, full));
+    _mm_storeu_si128((__m128i *)(q + s), m);
+  }
+  quant_mant_c(q + s, mant + s, bap + s, n - s);
+}
+
+static inline void fixed_exp(int8_t *exp, int32_t *mant, int exp_norm, int n)
+{ fixed_exp_sse2(exp, mant, exp_norm, n); }
+static inline void float_exp(int8_t *exp, const sample_t *coef, int n)
+{ float_exp_sse2(exp, coef, n); }
+static inline int exp_diff(const int8_t *exp1, const int8_t *exp2, int n)
+{ return exp_diff_sse2(exp1, exp2, n); }
+static inline void exp_min(int8_t *exp, const int8_t *exp1, int n)
+{ exp_min_sse2(exp, exp1, n); }
+static inline void quant_mant(uint16_t *q, const int32_t *mant, const int8_t *bap, int n)
+{ quant_mant_sse2(q, mant, bap, n); }
+
+#else
+
+static inline void fixed_exp(int8_t *exp, int32_t *mant, int exp_norm, int n)
+{ fixed_exp_c(exp, mant, exp_norm, n); }
+static inline void float_exp(int8_t *exp, const sample_t *coef, int n)
+{ float_exp_c(exp, coef, n); }
+static inline int exp_diff(const int8_t *exp1, const int8_t *exp2, int n)
+{ return exp_diff_c(exp1, exp2, n); }
+static inline void exp_min(int8_t *exp, const int8_t *exp1, int n)
+{ exp_min_c(exp, exp1, n); }
+static inline void quant_mant(uint16_t *q, const int32_t *mant, const int8_t *bap, int n)
+{ quant_mant_c(q, mant, bap, n); }
+
+#endif
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Math utils
@@ -6,17 +6,60 @@
 #include "../../buffer.h"
 #include "ac3_defs.h"
 #include "ac3_mdct.h"
+#if AC3ENC_PERF
+#include "../../win32/cpu.h"
+#endif
 
 inline int sym_quant(int m, int levels);
 inline int asym_quant(int m, int bits);
 
+///////////////////////////////////////////////////////////////////////////////
+// AC3EncFrame
+// Working set of one frame being encoded. All data computed from one frame of
+// input lives here, so several frames may be encoded at the same time.
+
+struct AC3EncFrame
+{
+  Rawdata   frame_buf;                 // encoded frame
+  size_t    frame_size;                // size of the encoded frame (0 on error)
+
+  bool      sync;                      // timestamp of the frame
+  vtime_t   time;
+
+  int       snroffset;                 // snr offset found by bit allocation
+
+  int32_t  mant[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];    // mdct coeffitients
+  int8_t   exp[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];     // exponents
+  int8_t   expcod[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];  // encoded exponents
+  int8_t   bap[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];     // bit allocation pointers
+  int      mask[AC3_NCHANNELS][AC3_NBLOCKS][50];                   // masking curve (independent of snroffset)
+
+  int      chbwcod[AC3_NCHANNELS-1];                      // 'chbwcod' - channel bandwidth code (fbw only)
+  int      nmant[AC3_NCHANNELS];                          // number of mantissas
+  int      expstr[AC3_NCHANNELS][AC3_NBLOCKS];            // 'expstr'/'lfeexpstr' - exponent strategy
+  int      ngrps[AC3_NCHANNELS][AC3_NBLOCKS];             // number of exponent groups
+
+#if AC3ENC_PERF
+  // Per-stage cpu usage. Each encoding thread has its own frame, so stages
+  // are always measured at the thread that runs them.
+  CPUMeter cpu_mdct;                   // mdct and exponent extraction
+  CPUMeter cpu_exp;                    // exponent strategy, restriction and mantissa normalization
+  CPUMeter cpu_bitalloc;               // bit allocation
+  CPUMeter cpu_output;                 // mantissa quantization and frame output
+#endif
+
+  AC3EncFrame(): frame_size(0), sync(false), time(0), snroffset(0)
+  { frame_buf.allocate(AC3_MAX_FRAME_SIZE); }
+};
+
 class AC3Enc : public SimpleFilter
 {
 public:
   // filter data
+  // Input buffer holds the last block of the previous frame (required for
+  // MDCT overlap) followed by the frame itself.
   size_t    sample;
   SampleBuf frame_samples;
-  Rawdata   frame_buf;
   SampleBuf window;
 
   bool    sync;
@@ -28,8 +71,10 @@ public:
   int frame_size;
   int frames;
 
-  MDCT mdct;
-  WriteBS bs;
+  bool fixed_point;                    // use fixed-point MDCT
+  MDCT mdct;                           // fixed-point MDCT
+  FloatMDCT fmdct;                     // floating-point MDCT
+  AC3EncFrame frame;                   // single-threaded encoding
 
   // stream-level data
   int  acmod;
@@ -52,36 +97,74 @@ public:
   int csnroffst;                       // 'csnroffst' - coarse SNR offset
   int fsnroffst;                       // 'fsnroffst' - fine SNR offset
 
-  int16_t  delay[AC3_NCHANNELS][AC3_BLOCK_SAMPLES]; // delay buffer (not normalized)
-  int      delay_exp[AC3_NCHANNELS];                // delay buffer normalization
-                                           
-  int32_t  mant[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];    // mdct coeffitients
-  int8_t   exp[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];     // exponents
-  int8_t   expcod[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];  // encoded exponents
-  int8_t   bap[AC3_NCHANNELS][AC3_NBLOCKS][AC3_BLOCK_SAMPLES];     // bit allocation pointers
-
-  int      chbwcod[AC3_NCHANNELS-1];                      // 'chbwcod' - channel bandwidth code (fbw only)
-  int      nmant[AC3_NCHANNELS];                          // number of mantissas
-  int      expstr[AC3_NCHANNELS][AC3_NBLOCKS];            // 'expstr'/'lfeexpstr' - exponent strategy
-  int      ngrps[AC3_NCHANNELS][AC3_NBLOCKS];             // number of exponent groups
-
   inline void output_mant(WriteBS &pb, int8_t bap[AC3_BLOCK_SAMPLES], int32_t mant[AC3_BLOCK_SAMPLES], int8_t exp[AC3_BLOCK_SAMPLES], int start, int end) const;
   inline void compute_expstr(int expstr[AC3_NBLOCKS], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int endmant) const;
   inline void restrict_exp(int8_t expcod[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int ngrps[AC3_NBLOCKS], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int expstr[AC3_NBLOCKS], int endmant) const;
   inline int  encode_exp(int8_t expcod[AC3_BLOCK_SAMPLES], int8_t exp[AC3_BLOCK_SAMPLES], int expstr, int endmant) const;
 
   bool fill_buffer(Chunk &in);
+  void next_frame();
   int  encode_frame();
 
+  // Frame encoding stages. These functions do not change the encoder state,
+  // so different frames may be processed in parallel. The only dependency
+  // between frames is the snr offset: bit allocation search starts from the
+  // offset found for the previous frame.
+  void analyze_frame(AC3EncFrame &f, const SampleBuf &samples) const;
+  void mdct_fixed(int32_t mant[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int exp_norm[AC3_NBLOCKS], const sample_t *samples) const;
+  void mdct_float(sample_t coef[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], int8_t exp[AC3_NBLOCKS][AC3_BLOCK_SAMPLES], const sample_t *samples) const;
+  bool alloc_frame(AC3EncFrame &f, int snroffset) const;
+  int  alloc_bits(AC3EncFrame &f, int snroffset) const;
+  int  output_frame(AC3EncFrame &f) const;
+
+  /////////////////////////////////////////////////////////
+  // Multithreaded encoding
+  // Frame k is encoded by the worker k % threads. Frames are output in order.
+
+  class Worker;
+  int      threads;                    // number of worker threads (0 - single-threaded)
+  Worker **workers;
+  int      submit_pos;                 // next worker to submit a frame to
+  int      output_pos;                 // next worker to output a frame from
+  int      in_flight;                  // number of frames being encoded
+  bool     chain_start;                // next frame starts the snr offset chain
+
+  void start_workers(int threads);
+  void stop_workers();
+  void submit_frame();
+  bool pop_frame(Chunk &out);
+  void drain();
+
+#if AC3ENC_PERF
+public:
+  // Cpu time of a stage summed over all encoding threads, i.e.
+  // get_cpu_time(&AC3EncFrame::cpu_mdct)
+  vtime_t get_cpu_time(CPUMeter AC3EncFrame::*meter);
+  void reset_cpu_time();
+#endif
+
 public:
   //! Encoding error exception
   struct EncodingError : public Filter::Error {};
 
   AC3Enc();
+  ~AC3Enc();
 
   int  get_bitrate() const;
   bool set_bitrate(int bitrate);
 
+  // Number of frames encoded in parallel. 0 or 1 means single-threaded
+  // encoding. Output is bit-identical in all modes.
+  int  get_threads() const;
+  void set_threads(int threads);
+
+  // Fixed-point MDCT (default) converts input to 16bit and normalizes it
+  // blockwise, and is bit-exact with the older versions of the encoder.
+  // Floating-point MDCT works with input samples directly and does not
+  // overflow at full scale, but its output differs from the fixed-point one.
+  bool get_fixed_point() const;
+  void set_fixed_point(bool fixed_point);
+
   /////////////////////////////////////////////////////////
   // Filter interface
 
@@ -90,12 +173,37 @@ public:
 
   virtual void reset();
   virtual bool process(Chunk &in, Chunk &out);
+  virtual bool flush(Chunk &out);
 
   virtual Speakers get_output() const
   { return Speakers(FORMAT_AC3, spk.mask, spk.sample_rate, 1.0, spk.relation); }
 };
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Vector kernels
+// Scalar (*_c) and SSE2 (*_sse2) versions give exactly the same result.
+//
+// fixed_exp:  exponents of fixed-point mdct coefficients; coefficients that
+//             do not fit into 24 exponents are shifted
+// float_exp:  exponents of floating-point mdct coefficients in [-1..1) range
+// exp_diff:   sum of absolute differences between two exponent sets
+// exp_min:    minimum of two exponent sets (exponents are 0..24)
+// quant_mant: mantissa quantization (mantissas are in 16bit range)
+
+void fixed_exp_c(int8_t *exp, int32_t *mant, int exp_norm, int n);
+void float_exp_c(int8_t *exp, const sample_t *coef, int n);
+int  exp_diff_c(const int8_t *exp1, const int8_t *exp2, int n);
+void exp_min_c(int8_t *exp, const int8_t *exp1, int n);
+void quant_mant_c(uint16_t *q, const int32_t *mant, const int8_t *bap, int n);
+
+#ifdef VALIB_SSE2
+void fixed_exp_sse2(int8_t *exp, int32_t *mant, int exp_norm, int n);
+void float_exp_sse2(int8_t *exp, const sample_t *coef, int n);
+int  exp_diff_sse2(const int8_t *exp1, const int8_t *exp2, int n);
+void exp_min_sse2(int8_t *exp, const int8_t *exp1, int n);
+void quant_mant_sse2(uint16_t *q, const int32_t *mant, const int8_t *bap, int n);
+#endif
 
 // symmetric quantization
 inline int sym_quant(int c, int levels)
@@ -1,6 +1,8 @@
 #include <math.h>
+#include <string.h>
 #include "ac3_defs.h"
 #include "ac3_mdct.h"
+#include "../../dsp/fftsg.h"
 
 #define N (AC3_BLOCK_SAMPLES * 2)
 #define MDCT_NBITS 9
@@ -75,7 +77,7 @@ MDCT::MDCT(int ln)
 
 
 /* do a 2^n point complex fft on 2^ln points. */
-void MDCT::fft(IComplex *z, int ln)
+void MDCT::fft(IComplex *z, int ln) const
 {
   int j, l, np, np2;
   int nblocks, nloops;
@@ -149,7 +151,7 @@ void MDCT::fft(IComplex *z, int ln)
 }
 
 /* do a 512 point mdct */
-void MDCT::mdct512(int32_t *out, int16_t *in)
+void MDCT::mdct512(int32_t *out, int16_t *in) const
 {
   int i, re, im, re1, im1;
   int16_t rot[N]; 
@@ -179,3 +181,63 @@ void MDCT::mdct512(int32_t *out, int16_t *in)
     out[N/2-1-2*i] = re1;
   }
 }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// FloatMDCT
+
+FloatMDCT::FloatMDCT()
+{
+  int i;
+  double alpha;
+
+  // Pre-rotation includes the scale of the fixed-point version:
+  // 1/2 at the pre-rotation and 1/2 at each of 7 fft passes.
+  for(i = 0; i < N/4; i++) 
+  {
+    alpha = 2 * M_PI * (i + 1.0 / 8.0) / N;
+    pre_cos[i]  = sample_t(cos(alpha) / 256);
+    pre_sin[i]  = sample_t(-sin(alpha) / 256);
+    post_cos[i] = sample_t(-cos(alpha));
+    post_sin[i] = sample_t(-sin(alpha));
+  }
+
+  // initialize fft tables
+  sample_t x[N/2];
+  memset(x, 0, sizeof(x));
+  fft_ip[0] = 0;
+  cdft(N/2, -1, x, fft_ip, fft_w);
+}
+
+/* do a 512 point mdct */
+void FloatMDCT::mdct512(sample_t *out, const sample_t *in) const
+{
+  int i;
+  sample_t re, im;
+  sample_t rot[N]; 
+  sample_t x[N/2];
+  
+  /* shift to simplify computations */
+  for(i=0;i<N/4;i++)
+    rot[i] = -in[i + 3*N/4];
+  for(i=N/4;i<N;i++)
+    rot[i] = in[i - N/4];
+  
+  /* pre rotation */
+  for(i=0;i<N/4;i++) {
+    re = rot[2*i] - rot[N-1-2*i];
+    im = rot[N/2-1-2*i] - rot[N/2+2*i];
+    x[2*i]   = re * pre_cos[i] - im * pre_sin[i];
+    x[2*i+1] = re * pre_sin[i] + im * pre_cos[i];
+  }
+  
+  cdft(N/2, -1, x, fft_ip, fft_w);
+  
+  /* post rotation */
+  for(i=0;i<N/4;i++) {
+    re = x[2*i];
+    im = x[2*i+1];
+    out[2*i] = re * post_cos[i] + im * post_sin[i];
+    out[N/2-1-2*i] = re * post_sin[i] - im * post_cos[i];
+  }
+}
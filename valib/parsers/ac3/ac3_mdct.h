@@ -17,12 +17,36 @@ protected:
     short re,im;
   };
 
-  void fft(IComplex *z, int ln);
+  void fft(IComplex *z, int ln) const;
 
 public:
   MDCT(int ln);
 
-  void mdct512(int32_t *out, int16_t *in);
+  void mdct512(int32_t *out, int16_t *in) const;
+};
+
+// Floating-point MDCT based on the complex FFT. Works with sample_t
+// directly and does not need input normalization. Output has the same
+// scale as the fixed-point MDCT above: 16bit input range gives 16bit
+// output range.
+
+class FloatMDCT
+{
+protected:
+  sample_t pre_cos[128];
+  sample_t pre_sin[128];
+  sample_t post_cos[128];
+  sample_t post_sin[128];
+
+  // FFT tables are initialized at the constructor and
+  // are read-only after that.
+  mutable int fft_ip[16];
+  mutable sample_t fft_w[128];
+
+public:
+  FloatMDCT();
+
+  void mdct512(sample_t *out, const sample_t *in) const;
 };
 
 #endif
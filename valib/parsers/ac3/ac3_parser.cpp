@@ -205,7 +205,7 @@ AC3Parser::parse_header()
   /////////////////////////////////////////////////////////////
   // Skip syncword
 
-  bs.get(32);
+  bs.skip(32);
 
   /////////////////////////////////////////////////////////////
   // Parse bit stream information (BSI)
@@ -321,8 +321,7 @@ AC3Parser::parse_header()
   if (bs.get_bool())                 // 'addbsie' - additional bitstream information exists
   {
     int addbsil = bs.get(6);         // 'addbsil' - additioanl bitstream information length
-    while (addbsil--)
-      bs.get(8);                     // 'addbsi' - additional bitstream information
+    bs.skip(addbsil * 8);            // 'addbsi' - additional bitstream information
   }
 
   /////////////////////////////////////////////////////////////
@@ -700,8 +699,7 @@ AC3Parser::parse_block()
   if (bs.get_bool())
   {
     int skipl = bs.get(9);
-    while (skipl--)
-      bs.get(8);
+    bs.skip(skipl * 8);
   }
 
   /////////////////////////////////////////////////////////
@@ -70,6 +70,13 @@ static bool is_planar(AVSampleFormat sample_format)
   return false;
 }
 
+// Planar format that may be output without conversion
+#ifdef FLOAT_SAMPLE
+static const AVSampleFormat direct_format = AV_SAMPLE_FMT_FLTP;
+#else
+static const AVSampleFormat direct_format = AV_SAMPLE_FMT_DBLP;
+#endif
+
 static const Speakers get_format(AVCodecContext *avctx)
 {
   int format = FORMAT_UNKNOWN;
@@ -125,6 +132,12 @@ FfmpegDecoder::FfmpegDecoder(CodecID ffmpeg_codec_id_, int format_)
   format  = format_;
   avcodec = 0;
   avctx   = 0;
+  avframe = 0;
+  zero_copy = true;
+  direct  = false;
+  packet_pos = 0;
+  packet_src = 0;
+  packet_rest = 0;
 }
 
 FfmpegDecoder::~FfmpegDecoder()
@@ -221,18 +234,28 @@ FfmpegDecoder::init()
     return false;
   }
 
-  buf.allocate(AVCODEC_MAX_AUDIO_FRAME_SIZE);
+  avframe = avcodec_alloc_frame();
+  if (!avframe)
+  {
+    valib_log(log_error, module, "avcodec_alloc_frame() failed");
+    uninit();
+    return false;
+  }
+
   return true;
 }
 
 void
 FfmpegDecoder::uninit()
 {
+  if (avframe)
+    avcodec_free_frame(&avframe);
   if (avctx)
   {
     avcodec_close(avctx);
     av_free(avctx);
   }
+  avframe = 0;
   avctx = 0;
 }
 
@@ -242,6 +265,9 @@ FfmpegDecoder::reset()
   ffmpeg_spk = Speakers();
   out_spk = Speakers();
   new_stream_flag = false;
+  packet_pos = 0;
+  packet_src = 0;
+  packet_rest = 0;
   avcodec_flush_buffers(avctx);
 }
 
@@ -252,19 +278,40 @@ FfmpegDecoder::process(Chunk &in, Chunk &out)
   vtime_t time = in.time;
   in.set_sync(false, 0);
 
+  if (!in.size)
+    return false;
+
+  // Copy the input to the padded buffer. The rest of the chunk left by the
+  // previous call is already there.
+  if (in.rawdata != packet_src || in.size != packet_rest)
+  {
+    size_t packet_size = in.size + FF_INPUT_BUFFER_PADDING_SIZE;
+    if (packet_buf.size() < packet_size)
+      packet_buf.allocate(packet_size);
+    memcpy(packet_buf, in.rawdata, in.size);
+    memset(packet_buf + in.size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    packet_pos = packet_buf;
+  }
+  packet_src = 0;
+  packet_rest = 0;
+
+  // Packet does not own the data, so it does not require allocation.
   AVPacket avpkt;
+  av_init_packet(&avpkt);
+  avpkt.data = packet_pos;
+
   while (in.size)
   {
-    av_init_packet(&avpkt);
-    avpkt.data = in.rawdata;
     avpkt.size = (int)in.size;
-    int data_size = (int)buf.size();
-    int gone = avcodec_decode_audio3(avctx, (int16_t *)buf.begin(), &data_size, &avpkt);
+    int got_frame = 0;
+    avcodec_get_frame_defaults(avframe);
+    int gone = avcodec_decode_audio4(avctx, avframe, &got_frame, &avpkt);
     if (gone < 0 || gone == 0)
       return false;
 
+    avpkt.data += gone;
     in.drop_rawdata(gone);
-    if (!data_size)
+    if (!got_frame || avframe->nb_samples <= 0)
       continue;
 
     Speakers new_spk = get_format(avctx);
@@ -278,6 +325,7 @@ FfmpegDecoder::process(Chunk &in, Chunk &out)
       out_spk = new_spk;
       out_spk.format = FORMAT_LINEAR;
 
+      direct = (avctx->sample_fmt == direct_format);
       if (is_planar(avctx->sample_fmt))
         convert_func = find_pcm2linear(ffmpeg_spk.format, 1);
       else
@@ -288,42 +336,56 @@ FfmpegDecoder::process(Chunk &in, Chunk &out)
 
     samples_t out_samples;
     size_t out_nsamples;
-    convert_to_linear(buf.begin(), data_size, out_samples, out_nsamples);
+    convert_to_linear(avframe, out_samples, out_nsamples);
     out.set_linear(out_samples, out_nsamples, sync, time);
 
+    if (in.size)
+    {
+      packet_pos = avpkt.data;
+      packet_src = in.rawdata;
+      packet_rest = in.size;
+    }
     return true;
   }
   return false;
 }
 
 void
-FfmpegDecoder::convert_to_linear(uint8_t *data, int data_size, samples_t &out_samples, size_t &out_nsamples)
+FfmpegDecoder::convert_to_linear(AVFrame *frame, samples_t &out_samples, size_t &out_nsamples)
 {
-  assert(data && data_size > 0);
-  assert(convert_func);
+  assert(frame && frame->nb_samples > 0);
 
   int nch = out_spk.nch();
-  size_t sample_size = ffmpeg_spk.sample_size();
-  size_t nsamples = (size_t)data_size / nch / sample_size;
-  assert(nsamples * nch * sample_size == (size_t)data_size);
-
-  if ((int)samples.nch() < nch || samples.nsamples() < nsamples)
-    samples.allocate(nch, nsamples);
+  size_t nsamples = (size_t)frame->nb_samples;
+  uint8_t **planes = frame->extended_data;
 
-  if (is_planar(avctx->sample_fmt))
+  if (zero_copy && direct)
   {
-    samples_t temp_samples;
-    size_t plane_size = nsamples * sample_size;
+    // Zero-copy: point to the frame planes
     for (int ch = 0; ch < nch; ch++)
+      out_samples[ch] = (sample_t *)planes[ch];
+  }
+  else
+  {
+    assert(convert_func);
+    if ((int)samples.nch() < nch || samples.nsamples() < nsamples)
+      samples.allocate(nch, nsamples);
+
+    if (is_planar(avctx->sample_fmt))
     {
-      temp_samples[0] = samples[ch];
-      convert_func(data + plane_size * ch, temp_samples, nsamples);
+      samples_t temp_samples;
+      for (int ch = 0; ch < nch; ch++)
+      {
+        temp_samples[0] = samples[ch];
+        convert_func(planes[ch], temp_samples, nsamples);
+      }
     }
+    else
+      convert_func(planes[0], samples, nsamples);
+
+    out_samples = samples;
   }
-  else
-    convert_func(data, samples, nsamples);
 
-  out_samples = samples;
   out_samples.reorder_to_std(out_spk, win_order);
   out_nsamples = nsamples;
 }
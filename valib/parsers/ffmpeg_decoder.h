@@ -6,6 +6,7 @@
 
 struct AVCodec;
 struct AVCodecContext;
+struct AVFrame;
 enum AVCodecID;
 
 class FfmpegDecoder : public SimpleFilter
@@ -31,13 +32,21 @@ public:
   bool new_stream() const
   { return new_stream_flag; }
 
+  // Zero-copy output (default): when ffmpeg produces planar data of sample_t
+  // type, output chunks point directly to the frame planes. Otherwise data is
+  // always converted to the internal buffer.
+  bool get_zero_copy() const
+  { return zero_copy; }
+
+  void set_zero_copy(bool zero_copy_)
+  { zero_copy = zero_copy_; }
+
   Speakers get_output() const
   { return out_spk; }
 
 protected:
   virtual bool init_context(AVCodecContext *avctx);
 
-  Rawdata buf;         // output buffer for ffmpeg
   Speakers ffmpeg_spk; // ffmpeg data format
   Speakers out_spk;    // output format
   bool new_stream_flag;
@@ -47,10 +56,27 @@ protected:
 
   AVCodec *avcodec;
   AVCodecContext *avctx;
+  AVFrame *avframe;    // decoded frame, reused for all frames
+
+  // When ffmpeg produces planar data of sample_t type, output chunks point
+  // directly to the frame planes (no conversion). Decoder keeps the frame
+  // data until the next decode call, i.e. until the next process() call.
+  bool zero_copy;
+  bool direct;
+
+  // ffmpeg may read past the end of the packet, so the packet must be
+  // followed by zero padding. Input chunk may end at the end of a buffer or a
+  // file mapping, so input is decoded from this buffer. The input chunk is
+  // copied once: when process() returns a frame before the end of the chunk,
+  // the rest of the chunk is decoded from the buffer on the next call.
+  Rawdata packet_buf;
+  uint8_t *packet_pos;  // rest of the chunk at packet_buf
+  uint8_t *packet_src;  // rest of the chunk at the input chunk
+  size_t packet_rest;   // size of the rest of the chunk
 
   SampleBuf samples;
   void (*convert_func)(uint8_t *, samples_t, size_t);
-  void convert_to_linear(uint8_t *data, int data_size, samples_t &out_samples, size_t &out_nsamples);
+  void convert_to_linear(AVFrame *frame, samples_t &out_samples, size_t &out_nsamples);
 };
 
 #endif
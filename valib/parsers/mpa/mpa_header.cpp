@@ -87,13 +87,17 @@ static const int slots_tbl[4][3] =
 
 // see codegen/makesync.cpp
 const SyncTrie MPAFrameParser::sync_trie(
-"iiii**ixiiiiiiii***xROxRO*xROxRO**xROxRO*xROxROxxiiiiiiii***xROxRO*xROxRO**"
-"xROxRO*xROxRO*ixiiiiiiii***xROxRO*xROxRO**xROxRO*xROxRO*xiiiiiiii***xROxRO*"
-"xROxRO**xROxRO*xROxRO*iiiiiiii***xROxRO*xROxRO**xROxRO*xROxROiii*o*ix***xRO"
-"xRO*xROxRO**xROxRO*xROxROxx***xROxRO*xROxRO**xROxRO*xROxRO**ix***xROxRO*xRO"
-"xRO**xROxRO*xROxROxx***xROxRO*xROxRO**xROxRO*xROxRO*ix***xROxRO*xROxRO**xRO"
-"xRO*xROxRO*x***xROxRO*xROxRO**xROxRO*xROxRO****xROxRO*xROxRO**xROxRO*xROxRO"
-"***xROxRO*xROxRO**xROxRO*xROxRO");
+"iiii**ixiiiiiiiixxxxxxxx***xROxRO*xROxRO**xROxRO*xROxROxxiiiiiiiixxxxxxxx**"
+"*xROxRO*xROxRO**xROxRO*xROxRO*ixiiiiiiiixxxxxxxx***xROxRO*xROxRO**xROxRO*xR"
+"OxRO*xiiiiiiiixxxxxxxx***xROxRO*xROxRO**xROxRO*xROxRO*iiiiiiiixxxxxxxx***xR"
+"OxRO*xROxRO**xROxRO*xROxROiii*o*ix***xROxRO*xROxRO**xROxRO*xROxROxx***xROxR"
+"O*xROxRO**xROxRO*xROxRO**ix***xROxRO*xROxRO**xROxRO*xROxROxx***xROxRO*xROxR"
+"O**xROxRO*xROxRO*ix***xROxRO*xROxRO**xROxRO*xROxRO*x***xROxRO*xROxRO**xROxR"
+"O*xROxRO****xROxRO*xROxRO**xROxRO*xROxRO***xRRxx***xROxRO*xROxRO**xROxRO*xR"
+"OxROxRRxx***xROxRO*xROxRO**xROxRO*xROxRO*xRRxx***xROxRO*xROxRO**xROxRO*xROx"
+"ROxRRxx***xROxRO*xROxRO**xROxRO*xROxRO**xRRxx***xROxRO*xROxRO**xROxRO*xROxR"
+"OxRRxx***xROxRO*xROxRO**xROxRO*xROxRO*xRRxx***xROxRO*xROxRO**xROxRO*xROxROx"
+"RRxx***xROxRO*xROxRO**xROxRO*xROxRO");
 
 bool
 MPAFrameParser::parse_header(const uint8_t *hdr, FrameInfo *finfo) const
@@ -26,6 +26,7 @@ MultiFrameParser::update()
   size_t i;
 
   sinfo.clear();
+  sync_scan.clear();
   max_header_size = 0;
   p = 0;
   n = 0;
@@ -49,6 +50,15 @@ MultiFrameParser::update()
   }
 
   sinfo.sync_trie.optimize();
+
+  // Too many parsers: sync_scan stays empty and all parsers are tried
+  if (parsers.size() > 1 && parsers.size() <= MultiSyncScan::max_tries)
+  {
+    std::vector<SyncTrie> tries(parsers.size());
+    for (i = 0; i < parsers.size(); i++)
+      tries[i] = parsers[i]->sync_info().sync_trie;
+    sync_scan.set_tries(&tries[0], tries.size());
+  }
 }
 
 void
@@ -100,6 +110,7 @@ MultiFrameParser::release_parsers()
   n = 0;
 
   sinfo.clear();
+  sync_scan.clear();
   max_header_size = 0;
 }
 
@@ -136,8 +147,9 @@ bool
 MultiFrameParser::parse_header(const uint8_t *hdr, FrameInfo *finfo) const
 {
   if (!n || hdr == 0) return false;
+  uint32_t set = find_parsers(hdr);
   for (size_t i = 0; i < n; i++)
-    if (p[i]->parse_header(hdr, finfo))
+    if (is_candidate(set, i) && p[i]->parse_header(hdr, finfo))
       return true;
   return false;
 }
@@ -145,9 +157,10 @@ MultiFrameParser::parse_header(const uint8_t *hdr, FrameInfo *finfo) const
 bool
 MultiFrameParser::compare_headers(const uint8_t *hdr1, const uint8_t *hdr2) const
 {
-  if (!n) return false;
+  if (!n || hdr1 == 0) return false;
+  uint32_t set = find_parsers(hdr1);
   for (size_t i = 0; i < n; i++)
-    if (p[i]->compare_headers(hdr1, hdr2))
+    if (is_candidate(set, i) && p[i]->compare_headers(hdr1, hdr2))
       return true;
   return false;
 }
@@ -158,8 +171,9 @@ MultiFrameParser::first_frame(const uint8_t *frame, size_t size)
   if (!n) return false;
 
   reset();
+  uint32_t set = size < sync_scan.sync_size()? 0xffffffff: find_parsers(frame);
   for (size_t i = 0; i < n; i++)
-    if (p[i]->first_frame(frame, size))
+    if (is_candidate(set, i) && p[i]->first_frame(frame, size))
     {
       parser = p[i];
       return true;
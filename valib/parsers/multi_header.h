@@ -8,6 +8,7 @@
 
 #include <vector>
 #include "../parser.h"
+#include "../syncscan.h"
 
 /**************************************************************************//**
   \class MultiFrameParser
@@ -56,6 +57,10 @@
   \fn list_t MultiFrameParser::get_parsers() const
     Returns the list of parsers
 
+  Sync tries of all parsers are combined into MultiSyncScan, so one pass over
+  the header tells which parsers may accept it. parse_header(),
+  compare_headers() and first_frame() call only these parsers.
+
 ******************************************************************************/
 
 class MultiFrameParser : public FrameParser
@@ -104,9 +109,19 @@ protected:
   SyncInfo sinfo;
   size_t   max_header_size;
 
+  MultiSyncScan sync_scan; //!< finds parsers matching the sync
+
   FrameParser *parser;
 
   void update();
+
+  // Set of parsers to try for the header: bit i is set for the parser p[i].
+  // Parsers beyond MultiSyncScan::max_tries are always tried.
+  inline uint32_t find_parsers(const uint8_t *hdr) const
+  { return sync_scan.is_empty()? 0xffffffff: sync_scan.find_sync(hdr); }
+
+  inline static bool is_candidate(uint32_t set, size_t i)
+  { return i >= MultiSyncScan::max_tries || (set & (1 << i)) != 0; }
 };
 
 #endif
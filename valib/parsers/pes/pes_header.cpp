@@ -139,6 +139,25 @@ PESHeader::parse(const uint8_t *hdr, size_t size)
     }
   }
 
+  // Transport streams carry AC3/EAC3 and DTS at private stream 1 without
+  // the substream header.
+  if (stream == PRIVATE_STREAM_1 && pos + 6 <= size)
+  {
+    const uint8_t *payload = hdr + pos;
+    if (payload[0] == 0x0b && payload[1] == 0x77)
+      spk = Speakers((payload[5] >> 3) > 10? FORMAT_EAC3: FORMAT_AC3, 0, 0);
+    else if (payload[0] == 0x7f && payload[1] == 0xfe && payload[2] == 0x80 && payload[3] == 0x01)
+      spk = Speakers(FORMAT_DTS, 0, 0);
+
+    if (!spk.is_unknown())
+    {
+      if (pos >= packet_size) return false;
+      payload_pos = pos;
+      payload_size = packet_size - pos;
+      return true;
+    }
+  }
+
   if (stream == PRIVATE_STREAM_1)
   {
     if (pos >= size) return false;
@@ -18,7 +18,7 @@ const size_t SPDIFWrapper::header_size = sizeof(SPDIFWrapper::spdif_header_s);
 
 
 SPDIFWrapper::SPDIFWrapper(int _dts_mode, int _dts_conv)
-:dts_mode(_dts_mode), dts_conv(_dts_conv)
+:dts_mode(_dts_mode), dts_conv(_dts_conv), gather(false)
 {
   buf.allocate(max_spdif_frame_size);
 }
@@ -227,38 +227,66 @@ SPDIFWrapper::process(Chunk &in, Chunk &out)
   /////////////////////////////////////////////////////////
   // Fill payload, convert bitstream type and init header
 
+  size_t payload_pos = use_header? header_size: 0;
+  const uint8_t *payload = buf + payload_pos;
   size_t payload_size;
-  if (use_header)
-  {
-    payload_size = bs_convert(frame, size, finfo.bs_type, buf + header_size, spdif_bs);
-    assert(payload_size < max_spdif_frame_size - header_size);
-    memset(buf + header_size + payload_size, 0, spdif_frame_size - header_size - payload_size);
 
-    // We must correct DTS synword when converting to 14bit
-    if (spdif_bs == BITSTREAM_14LE)
-      buf[header_size + 3] = 0xe8;
-
-    spdif_header_s *header = (spdif_header_s *)buf.begin();
-    header->set(finfo.spdif_type, (uint16_t)payload_size * 8);
+  if (gather && finfo.bs_type == spdif_bs)
+  {
+    // No conversion required, send the payload from the input frame
+    payload = frame;
+    payload_size = size;
   }
   else
   {
-    payload_size = bs_convert(frame, size, finfo.bs_type, buf, spdif_bs);
-    assert(payload_size < max_spdif_frame_size);
-    memset(buf + payload_size, 0, spdif_frame_size - payload_size);
+    payload_size = bs_convert(frame, size, finfo.bs_type, buf + payload_pos, spdif_bs);
+    assert(payload_size < max_spdif_frame_size - payload_pos);
 
     // We must correct DTS synword when converting to 14bit
     if (spdif_bs == BITSTREAM_14LE)
-      buf[3] = 0xe8;
+      buf[payload_pos + 3] = 0xe8;
   }
 
   if (!payload_size)
     // cannot convert bitstream
     return false;
 
+  if (use_header)
+  {
+    spdif_header_s *header = (spdif_header_s *)buf.begin();
+    header->set(finfo.spdif_type, (uint16_t)payload_size * 8);
+  }
+
   /////////////////////////////////////////////////////////
   // Send spdif frame
 
+  size_t padding = spdif_frame_size - payload_pos - payload_size;
+  if (gather)
+  {
+    size_t nsegments = 0;
+    if (use_header)
+    {
+      segments[nsegments].data = buf;
+      segments[nsegments].size = header_size;
+      nsegments++;
+    }
+
+    segments[nsegments].data = payload;
+    segments[nsegments].size = payload_size;
+    nsegments++;
+
+    if (padding)
+    {
+      segments[nsegments].data = 0;
+      segments[nsegments].size = padding;
+      nsegments++;
+    }
+
+    out.set_segments(segments, nsegments, out.sync, out.time);
+    return true;
+  }
+
+  memset(buf + payload_pos + payload_size, 0, padding);
   out.set_rawdata(buf.begin(), spdif_frame_size, out.sync, out.time);
   return true;
 }
@@ -67,6 +67,14 @@
     size may grow and exceed the frame size requirements. Conversion is not
     done in this case.
 
+  \c gather option enables segmented output (see Chunk::segments). SPDIF
+  frame is sent as a list of segments: the header, the payload and zero
+  padding. When no bitstream conversion is required, the payload segment
+  points to the input frame, so neither the payload copy nor the padding fill
+  is done. Input frame must stay valid until the output chunk is processed.
+  Segmented output is accepted only by sinks that write segments directly
+  (RAWSink, WAVSink), so it is disabled by default.
+
 ******************************************************************************/
 
 class SPDIFWrapper : public SimpleFilter
@@ -74,6 +82,7 @@ class SPDIFWrapper : public SimpleFilter
 public:
   int  dts_mode;
   int  dts_conv;
+  bool gather;
 
   SPDIFWrapper(int dts_mode = DTS_MODE_AUTO, int dts_conv = DTS_CONV_NONE);
 
@@ -101,6 +110,7 @@ protected:
   FrameInfo finfo;
 
   Rawdata     buf;          // output frame buffer
+  ChunkSegment segments[3]; // output frame segments (gather mode)
   Speakers    out_spk;      // output format
   bool        passthrough;  // passthrough mode
   bool        new_stream_flag;
@@ -0,0 +1,47 @@
+#include "ts_frame_parser.h"
+#include "ts_header.h"
+
+const SyncTrie TSFrameParser::sync_trie(TS_SYNC, 8);
+
+///////////////////////////////////////////////////////////////////////////////
+// TSFrameParser
+
+bool
+TSFrameParser::parse_header(const uint8_t *hdr, FrameInfo *finfo) const
+{
+  // Sync byte and non-reserved adaptation_field_control
+  if (hdr[0] != TS_SYNC || (hdr[3] & 0x30) == 0)
+    return false;
+
+  if (finfo)
+  {
+    finfo->spk = Speakers(FORMAT_MPEGTS, 0, 0);
+    finfo->frame_size = 0;
+    finfo->nsamples = 0;
+    finfo->bs_type = BITSTREAM_8;
+    finfo->spdif_type = 0;
+  }
+
+  return true;
+}
+
+bool
+TSFrameParser::compare_headers(const uint8_t *hdr1, const uint8_t *hdr2) const
+{
+  return parse_header(hdr1) && parse_header(hdr2);
+}
+
+bool
+TSFrameParser::first_frame(const uint8_t *frame, size_t size)
+{
+  if (size != 188 && size != 192 && size != 204)
+    return false;
+  return BasicFrameParser::first_frame(frame, size);
+}
+
+SyncInfo
+TSFrameParser::build_syncinfo(const uint8_t *frame, size_t size, const FrameInfo &finfo) const
+{
+  // Packet size is constant
+  return SyncInfo(sync_trie, size, size);
+}
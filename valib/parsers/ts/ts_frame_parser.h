@@ -0,0 +1,44 @@
+#ifndef TS_FRAME_PARSER_H
+#define TS_FRAME_PARSER_H
+
+#include "../../parser.h"
+
+// MPEG2 Transport Stream frame parser. Frame is one transport packet.
+//
+// Packet size is not known from the header. It is detected at
+// synchronization as a distance between sync bytes and must be one of:
+// * 188 bytes - plain transport stream
+// * 192 bytes - BDAV/M2TS stream (4-byte timecode before each packet)
+// * 204 bytes - DVB stream with 16 bytes of Reed-Solomon parity after each
+//   packet
+//
+// Frame always starts with the sync byte, so 192-byte frames end with the
+// timecode of the next packet (the timecode of the first packet is debris).
+// In any case, the transport packet is the first 188 bytes of the frame.
+//
+// Frame parser accepts packets of all PIDs. PID filtering is done by
+// TSParser.
+
+class TSFrameParser : public BasicFrameParser
+{
+public:
+  static const SyncTrie sync_trie;
+
+  TSFrameParser() {}
+
+  virtual bool      can_parse(int format) const { return format == FORMAT_MPEGTS; }
+  virtual SyncInfo  sync_info() const { return SyncInfo(sync_trie, 188, 204); }
+
+  // Frame header operations
+  virtual size_t    header_size() const { return 4; }
+  virtual bool      parse_header(const uint8_t *hdr, FrameInfo *finfo = 0) const;
+  virtual bool      compare_headers(const uint8_t *hdr1, const uint8_t *hdr2) const;
+
+  // Frame operations
+  virtual bool      first_frame(const uint8_t *frame, size_t size);
+
+protected:
+  virtual SyncInfo build_syncinfo(const uint8_t *frame, size_t size, const FrameInfo &finfo) const;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "ts_header.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// TSHeader
+
+bool
+TSHeader::parse(const uint8_t *packet)
+{
+  if (packet[0] != TS_SYNC)
+    return false;
+
+  pid = ts_pid(packet);
+  error = (packet[1] & 0x80) != 0;
+  payload_start = (packet[1] & 0x40) != 0;
+  scrambled = (packet[3] & 0xc0) != 0;
+  continuity = packet[3] & 0x0f;
+  payload_pos = 0;
+  payload_size = 0;
+
+  size_t pos = 4;
+  int adaptation_field_control = (packet[3] >> 4) & 3;
+
+  // Reserved value
+  if (adaptation_field_control == 0)
+    return false;
+
+  // Adaptation field
+  if (adaptation_field_control & 2)
+  {
+    pos += packet[4] + 1;
+    if (pos > TS_PACKET_SIZE)
+      return false;
+  }
+
+  // Payload
+  if (adaptation_field_control & 1)
+  {
+    payload_pos = pos;
+    payload_size = TS_PACKET_SIZE - pos;
+  }
+
+  return true;
+}
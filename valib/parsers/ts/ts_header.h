@@ -0,0 +1,37 @@
+#ifndef TS_HEADER_H
+#define TS_HEADER_H
+
+#include "../../defs.h"
+
+#define TS_SYNC        0x47
+#define TS_PACKET_SIZE 188
+#define TS_NULL_PID    0x1fff
+
+///////////////////////////////////////////////////////////////////////////////
+// MPEG2 Transport Stream packet header.
+//
+// Packet must start with the sync byte and contain at least TS_PACKET_SIZE
+// bytes. Payload position and size are known only for packets with payload
+// (payload_size == 0 otherwise).
+//
+// ts_pid() reads only the first 4 bytes of the packet, so it may be used to
+// skip packets of other streams without parsing.
+
+inline int ts_pid(const uint8_t *packet)
+{ return ((packet[1] & 0x1f) << 8) | packet[2]; }
+
+struct TSHeader
+{
+  int    pid;
+  bool   error;         // transport_error_indicator
+  bool   payload_start; // payload_unit_start_indicator
+  bool   scrambled;     // transport_scrambling_control != 0
+  int    continuity;    // continuity_counter
+
+  size_t payload_pos;
+  size_t payload_size;
+
+  bool parse(const uint8_t *packet);
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include <sstream>
+#include "../../log.h"
+#include "../pes/pes_header.h"
+#include "ts_parser.h"
+#include "ts_header.h"
+
+static const string log_module = "TSParser";
+
+// Maximum size of PES packet (PES packet length field is 16 bit)
+static const size_t max_pes_size = 65535 + 6;
+
+///////////////////////////////////////////////////////////////////////////////
+// TSParser
+
+TSParser::TSParser(int pid_): pid(pid_)
+{
+  buf.allocate(max_pes_size);
+  reset();
+}
+
+void
+TSParser::set_pid(int pid_)
+{
+  pid = pid_;
+  reset();
+}
+
+bool
+TSParser::is_audio_pes(const uint8_t *payload, size_t payload_size) const
+{
+  if (payload_size < 9 || payload_size > TS_PACKET_SIZE)
+    return false;
+
+  // PES packet of unknown size cannot be parsed as is
+  uint8_t pes_header[TS_PACKET_SIZE];
+  memcpy(pes_header, payload, payload_size);
+  if (pes_header[4] == 0 && pes_header[5] == 0)
+    pes_header[4] = pes_header[5] = 0xff;
+
+  PESHeader header;
+  return header.parse(pes_header, payload_size) && PESHeader::is_audio_stream(header.stream);
+}
+
+bool
+TSParser::unwrap(Chunk &out)
+{
+  size_t pes_size = packet_size? MIN(size, packet_size): size;
+  size = 0;
+
+  // PES packet of unknown size: set the actual size for PESParser
+  if (!packet_size)
+  {
+    buf[4] = uint8_t((pes_size - 6) >> 8);
+    buf[5] = uint8_t((pes_size - 6) & 0xff);
+  }
+
+  Chunk chunk(buf, pes_size, sync, time);
+  sync = false;
+  time = 0;
+
+  if (!pes.process(chunk, out))
+    return false;
+
+  new_stream_flag = pes.new_stream();
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SimpleFilter overrides
+
+bool
+TSParser::can_open(Speakers spk) const
+{
+  return spk.format == FORMAT_MPEGTS;
+}
+
+bool
+TSParser::init()
+{
+  reset();
+  return pes.open(Speakers(FORMAT_PES, 0, 0));
+}
+
+void 
+TSParser::reset()
+{
+  stream_pid = pid;
+  continuity = -1;
+  size = 0;
+  packet_size = 0;
+  sync = false;
+  time = 0;
+  new_stream_flag = false;
+  pes.reset();
+}
+
+bool
+TSParser::process(Chunk &in, Chunk &out)
+{
+  if (in.sync)
+  {
+    sync = true;
+    time = in.time;
+    in.sync = false;
+  }
+  new_stream_flag = false;
+
+  if (in.size < TS_PACKET_SIZE)
+  {
+    in.clear();
+    return false;
+  }
+
+  // Fast path: drop packets of other streams
+  const uint8_t *packet = in.rawdata;
+  int packet_pid = ts_pid(packet);
+  if (packet_pid == TS_NULL_PID || (stream_pid && packet_pid != stream_pid))
+  {
+    in.clear();
+    return false;
+  }
+
+  TSHeader header;
+  if (!header.parse(packet) || header.error || header.scrambled)
+  {
+    size = 0;
+    in.clear();
+    return false;
+  }
+
+  // No payload (continuity counter is not incremented)
+  if (!header.payload_size)
+  {
+    in.clear();
+    return false;
+  }
+
+  const uint8_t *payload = packet + header.payload_pos;
+  bool next_packet = (header.continuity == ((continuity + 1) & 15));
+
+  // Search for the stream
+  if (!stream_pid)
+  {
+    if (!header.payload_start || !is_audio_pes(payload, header.payload_size))
+    {
+      in.clear();
+      return false;
+    }
+    stream_pid = packet_pid;
+    continuity = -1;
+  }
+
+  // PES packet of unknown size ends at the start of the next one. Input
+  // packet is processed at the next call.
+  if (header.payload_start && size && !packet_size && next_packet)
+    if (unwrap(out))
+      return true;
+
+  // Continuity check (continuity is unknown after the reset)
+  if (continuity >= 0)
+  {
+    if (header.continuity == continuity)
+    {
+      // Duplicate packet
+      in.clear();
+      return false;
+    }
+
+    if (!next_packet && size)
+    {
+      valib_log(log_event, log_module, "Packet lost at PID 0x%x", stream_pid);
+      size = 0;
+    }
+  }
+  continuity = header.continuity;
+
+  if (header.payload_start)
+  {
+    if (header.payload_size < 6 || payload[0] != 0 || payload[1] != 0 || payload[2] != 1)
+    {
+      size = 0;
+      in.clear();
+      return false;
+    }
+    size = 0;
+    packet_size = (payload[4] << 8) | payload[5];
+    if (packet_size)
+      packet_size += 6;
+  }
+  else if (!size)
+  {
+    // Wait for the start of PES packet
+    in.clear();
+    return false;
+  }
+
+  if (size + header.payload_size > max_pes_size)
+  {
+    valib_log(log_error, log_module, "PES packet is too large");
+    size = 0;
+    in.clear();
+    return false;
+  }
+
+  memcpy(buf + size, payload, header.payload_size);
+  size += header.payload_size;
+  in.clear();
+
+  if (packet_size && size >= packet_size)
+    return unwrap(out);
+  return false;
+}
+
+bool
+TSParser::flush(Chunk &out)
+{
+  // Only a packet of unknown size may be completed at the end of the stream
+  if (size && !packet_size)
+    return unwrap(out);
+
+  size = 0;
+  return false;
+}
+
+string
+TSParser::info() const 
+{
+  std::stringstream s;
+  if (stream_pid)
+  {
+    s << std::hex;
+    s << "PID: 0x" << stream_pid << nl;
+    s << pes.info();
+  }
+  else
+    s << "No sync";
+  return s.str();
+}
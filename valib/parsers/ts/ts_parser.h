@@ -0,0 +1,70 @@
+#ifndef TS_PARSER_H
+#define TS_PARSER_H
+
+#include "../../buffer.h"
+#include "../../filter.h"
+#include "../pes/pes_parser.h"
+
+// MPEG2 Transport Stream demuxer. Accepts transport packets (one packet per
+// chunk, as returned by TSFrameParser), selects packets of one PID,
+// reassembles PES packets and unwraps them with PESParser. So output is the
+// same as PESParser's output.
+//
+// Packets of other PIDs are dropped after reading of the PID only, without
+// parsing the rest of the packet.
+//
+// PID may be set explicitly with set_pid(). Zero PID (default) means the
+// first PID that carries a PES stream of a known audio format. PAT/PMT tables
+// are not parsed.
+//
+// Packet errors (transport error indicator, scrambling or lost packets
+// detected with continuity counter) drop the current PES packet, and the
+// demuxer waits for the start of the next one.
+
+class TSParser : public SimpleFilter
+{
+public:
+  TSParser(int pid = 0);
+
+  void set_pid(int pid);
+  int  get_pid() const { return pid; }
+  int  get_stream_pid() const { return stream_pid; }
+
+  /////////////////////////////////////////////////////////
+  // SimpleFilter overrides
+
+  bool can_open(Speakers spk) const;
+  bool init();
+
+  void reset();
+  bool process(Chunk &in, Chunk &out);
+  bool flush(Chunk &out);
+
+  bool new_stream() const
+  { return new_stream_flag; }
+
+  Speakers get_output() const
+  { return pes.get_output(); }
+
+  string info() const;
+
+protected:
+  int pid;        // PID requested
+  int stream_pid; // PID demuxed (0 when not found yet)
+  int continuity; // continuity counter of the last packet
+
+  Rawdata buf;    // PES packet buffer
+  size_t  size;   // PES packet size at the buffer (0 when no packet started)
+  size_t  packet_size; // PES packet size from the header (0 when unknown)
+
+  bool    sync;
+  vtime_t time;
+  bool    new_stream_flag;
+
+  PESParser pes;
+
+  bool is_audio_pes(const uint8_t *payload, size_t payload_size) const;
+  bool unwrap(Chunk &out);
+};
+
+#endif
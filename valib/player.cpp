@@ -0,0 +1,783 @@
+#include "player.h"
+#include "log.h"
+
+static const string log_module = "Player";
+
+// Number of markers at the markers ring (power of 2)
+static const LONG max_markers = 256;
+
+// Ring size when the rate of the format is unknown (bytes per second)
+static const double default_byte_rate = 1048576;
+
+// Max size of the chunk passed to the sink (ms)
+static const int max_chunk_ms = 20;
+
+// Time to wait for the threads to stop
+static const int thread_timeout = 10000;
+
+enum marker_type { marker_format, marker_sync, marker_eos };
+
+struct Player::Marker
+{
+  int      type;
+  LONG     pos;
+  Speakers spk;
+  vtime_t  time;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Producer thread
+//
+// Pulls chunks from the source and writes them into the ring. The current
+// chunk and the format change in progress are kept between stop() and
+// start().
+
+class Player::Producer : public Thread
+{
+public:
+  Player   *player;
+  Chunk     chunk;        // chunk being written
+  size_t    chunk_pos;    // data of the chunk written
+  size_t    segment;      // segment being written
+  Speakers  out_spk;      // format of the data written
+  Speakers  format_spk;   // new format of the chunk
+  bool      format_change;// format marker must be put before the chunk
+  bool      format_wait;  // format marker was put, waiting for the consumer
+  bool      full;         // the ring was full at the last write
+
+  Producer(Player *player_): player(player_)
+  { reset(); }
+
+  void reset()
+  {
+    chunk.clear();
+    chunk_pos = 0;
+    segment = 0;
+    out_spk = spk_unknown;
+    format_spk = spk_unknown;
+    format_change = false;
+    format_wait = false;
+    full = false;
+  }
+
+  // Take back the format marker the consumer has not reached yet, so it is
+  // put again on restart. The marker is the last one at the ring because the
+  // producer waits after it. Both threads must be stopped.
+  void retract_format()
+  {
+    if (format_wait && player->marker_write != player->marker_read)
+    {
+      player->marker_write--;
+      format_wait = false;
+    }
+  }
+
+  virtual void terminate(int timeout_ms = thread_timeout, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    player->space_ready.set();
+    player->format_done.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+protected:
+  bool put_marker(int type, Speakers spk = spk_unknown, vtime_t time = 0);
+  bool write(const uint8_t *data, size_t size, size_t &pos);
+  bool write_chunk();
+
+  virtual DWORD process()
+  {
+    try
+    {
+      while (!f_terminate)
+      {
+        if (!format_change && (chunk.size == 0 || chunk_pos >= chunk.size))
+        {
+          chunk_pos = 0;
+          segment = 0;
+          if (!player->src.get_chunk(chunk))
+          {
+            chunk.clear();
+            put_marker(marker_eos);
+            return 0;
+          }
+
+          Speakers new_spk = player->src.get_output();
+          if (player->src.new_stream() || new_spk != out_spk)
+          {
+            if (new_spk.is_linear())
+            {
+              valib_log(log_error, log_module, "Linear format cannot be buffered");
+              player->set_error();
+              put_marker(marker_eos);
+              return 0;
+            }
+
+            format_spk = new_spk;
+            format_change = true;
+          }
+        }
+
+        if (format_change)
+        {
+          // Consumer reallocates the ring, wait for it
+          if (!format_wait)
+          {
+            player->format_done.reset();
+            if (!put_marker(marker_format, format_spk))
+              return 0;
+            format_wait = true;
+          }
+          while (!f_terminate && !player->format_done.is_set())
+            player->format_done.wait();
+          if (f_terminate)
+            return 0;
+          out_spk = format_spk;
+          format_change = false;
+          format_wait = false;
+        }
+
+        if (chunk.sync)
+        {
+          if (!put_marker(marker_sync, spk_unknown, chunk.time))
+            return 0;
+          chunk.sync = false;
+        }
+
+        if (!write_chunk())
+          return 0;
+      }
+    }
+    catch (...)
+    {
+      valib_log(log_error, log_module, "Source failed");
+      player->set_error();
+      put_marker(marker_eos);
+    }
+    return 0;
+  }
+};
+
+bool
+Player::Producer::put_marker(int type, Speakers spk, vtime_t time)
+{
+  while (player->marker_write - player->marker_read >= max_markers)
+  {
+    if (f_terminate)
+      return false;
+    player->space_ready.wait();
+  }
+
+  Marker *m = player->markers + (player->marker_write & (max_markers - 1));
+  m->type = type;
+  m->pos = player->write_pos;
+  m->spk = spk;
+  m->time = time;
+  if (type == marker_eos)
+  {
+    AutoLock auto_lock(&player->lock);
+    player->eof = true;
+  }
+  InterlockedExchange(&player->marker_write, player->marker_write + 1);
+  player->data_ready.set();
+  return true;
+}
+
+// Write the data into the ring. pos is the size of the data written, it is
+// kept when the thread is terminated.
+bool
+Player::Producer::write(const uint8_t *data, size_t size, size_t &pos)
+{
+  Player *p = player;
+  while (pos < size)
+  {
+    size_t free = p->buf_size - p->data_size();
+    if (free == 0)
+    {
+      if (!full)
+      {
+        AutoLock auto_lock(&p->lock);
+        p->overruns++;
+      }
+      full = true;
+      if (f_terminate)
+        return false;
+      p->space_ready.wait();
+      continue;
+    }
+    full = false;
+
+    LONG wpos = p->write_pos;
+    size_t index = wpos < (LONG)p->buf_size? wpos: wpos - p->buf_size;
+    size_t len = MIN(size - pos, MIN(free, p->buf_size - index));
+    if (data)
+      memcpy(p->buf + index, data + pos, len);
+    else
+      memset(p->buf + index, 0, len);
+
+    wpos += (LONG)len;
+    if (wpos >= 2 * (LONG)p->buf_size)
+      wpos -= 2 * (LONG)p->buf_size;
+    InterlockedExchange(&p->write_pos, wpos);
+    p->data_ready.set();
+    pos += len;
+  }
+  return true;
+}
+
+bool
+Player::Producer::write_chunk()
+{
+  if (!chunk.segments)
+    return write(chunk.rawdata, chunk.size, chunk_pos);
+
+  // Segmented chunk: chunk_pos counts the data of the segments written
+  size_t seg_start = 0;
+  for (size_t i = 0; i < segment; i++)
+    seg_start += chunk.segments[i].size;
+
+  while (segment < chunk.nsegments)
+  {
+    const ChunkSegment &seg = chunk.segments[segment];
+    size_t pos = chunk_pos - seg_start;
+    bool ok = write(seg.data, seg.size, pos);
+    chunk_pos = seg_start + pos;
+    if (!ok)
+      return false;
+    seg_start += seg.size;
+    segment++;
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Consumer thread
+//
+// Reads the ring and passes the data to the sink.
+
+class Player::Consumer : public Thread
+{
+public:
+  Player  *player;
+  bool     started;      // playback was started
+  bool     empty;        // the ring was empty at the last read
+  bool     sync;         // timestamp for the next chunk
+  vtime_t  sync_time;
+
+  Consumer(Player *player_): player(player_)
+  { reset(); }
+
+  void reset()
+  {
+    started = false;
+    empty = false;
+    sync = false;
+    sync_time = 0;
+  }
+
+  virtual void terminate(int timeout_ms = thread_timeout, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    player->data_ready.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+protected:
+  // Apply the marker. Returns false at the end of the stream.
+  bool apply_marker(const Marker &m)
+  {
+    Player *p = player;
+    switch (m.type)
+    {
+      case marker_format:
+        if (p->sink->is_open() && p->sink->get_input() == m.spk)
+          p->set_format(m.spk);
+        else
+        {
+          if (p->sink->is_open())
+            p->sink->flush();
+          p->set_format(m.spk);
+          p->sink->open_throw(m.spk);
+        }
+        started = false;
+        p->format_done.set();
+        return true;
+
+      case marker_sync:
+        sync = true;
+        sync_time = m.time;
+        return true;
+
+      case marker_eos:
+        if (p->sink->is_open())
+          p->sink->flush();
+        return false;
+    }
+    return true;
+  }
+
+  virtual DWORD process()
+  {
+    Player *p = player;
+    try
+    {
+      while (!f_terminate)
+      {
+        // Format and timestamp markers are applied while paused, so the
+        // ring may be filled.
+        bool paused = p->is_paused();
+
+        LONG rpos = p->read_pos;
+        size_t avail = p->data_size();
+
+        // Marker at the current position or data up to the next marker
+        bool has_marker = p->marker_write != p->marker_read;
+        if (has_marker)
+        {
+          const Marker &m = p->markers[p->marker_read & (max_markers - 1)];
+          LONG dist = m.pos - rpos;
+          if (dist < 0)
+            dist += 2 * (LONG)p->buf_size;
+
+          if (dist == 0 && !(paused && m.type == marker_eos))
+          {
+            bool eos = !apply_marker(m);
+            InterlockedExchange(&p->marker_read, p->marker_read + 1);
+            p->space_ready.set();
+            if (eos)
+            {
+              AutoLock auto_lock(&p->lock);
+              p->finished = true;
+              p->done.set();
+              return 0;
+            }
+            continue;
+          }
+          avail = MIN(avail, (size_t)dist);
+        }
+
+        // unpause() sets data_ready also
+        if (paused)
+        {
+          p->data_ready.wait();
+          continue;
+        }
+
+        // Preload. Start earlier when the producer cannot write more (the
+        // ring is full or the producer waits for the format change).
+        if (!started && p->data_size() < p->buf_size / 2 && !p->is_eof() &&
+            p->marker_write - p->marker_read < max_markers &&
+            p->format_done.is_set())
+        {
+          p->data_ready.wait();
+          continue;
+        }
+
+        if (avail < p->block_size && !(has_marker && avail))
+        {
+          if (started && !empty)
+          {
+            AutoLock auto_lock(&p->lock);
+            p->underruns++;
+          }
+          empty = true;
+          p->data_ready.wait();
+          continue;
+        }
+        started = true;
+        empty = false;
+
+        size_t index = rpos < (LONG)p->buf_size? rpos: rpos - p->buf_size;
+        size_t max_chunk = size_t(p->byte_rate * max_chunk_ms / 1000);
+        size_t len = MIN(avail, MIN(max_chunk, p->buf_size - index));
+        if (len >= p->block_size)
+          len -= len % p->block_size;
+
+        Chunk chunk(p->buf + index, len, sync, sync_time);
+        p->sink->process(chunk);
+
+        {
+          AutoLock auto_lock(&p->lock);
+          if (sync)
+            p->time = sync_time;
+          p->time += len / p->byte_rate;
+        }
+        sync = false;
+
+        rpos += (LONG)len;
+        if (rpos >= 2 * (LONG)p->buf_size)
+          rpos -= 2 * (LONG)p->buf_size;
+        InterlockedExchange(&p->read_pos, rpos);
+        p->space_ready.set();
+      }
+    }
+    catch (...)
+    {
+      valib_log(log_error, log_module, "Sink failed");
+      p->set_error();
+      AutoLock auto_lock(&p->lock);
+      p->finished = true;
+      p->done.set();
+    }
+    return 0;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Player
+
+Player::Player():
+producer(0), consumer(0), sink(0), control(0), buf_ms(0),
+buf_size(0), write_pos(0), read_pos(0),
+markers(0), marker_write(0), marker_read(0),
+data_ready(false), space_ready(false), format_done(true),
+done(true), byte_rate(default_byte_rate), block_size(1),
+paused(false), finished(false), error(false), eof(false),
+underruns(0), overruns(0), time(0)
+{
+  markers = new Marker[max_markers];
+}
+
+Player::~Player()
+{
+  close();
+  delete[] markers;
+}
+
+bool
+Player::open(Source *source_, Filter *filter_, Sink *sink_, PlaybackControl *control_, int buf_ms_)
+{
+  close();
+  if (!source_ || !sink_ || buf_ms_ <= 0)
+    return false;
+
+  try
+  {
+    src.set(source_, filter_);
+  }
+  catch (...)
+  {
+    return false;
+  }
+
+  sink = sink_;
+  control = control_;
+  buf_ms = buf_ms_;
+
+  producer = new Producer(this);
+  consumer = new Consumer(this);
+
+  reset_buffer();
+  set_format(spk_unknown);
+  paused = false;
+  finished = false;
+  error = false;
+  underruns = 0;
+  overruns = 0;
+  time = 0;
+  return true;
+}
+
+void
+Player::close()
+{
+  stop();
+  safe_delete(producer);
+  safe_delete(consumer);
+  src.release();
+  sink = 0;
+  control = 0;
+  buf.free();
+  buf_size = 0;
+}
+
+bool
+Player::start()
+{
+  if (!sink || is_running() || is_finished())
+    return false;
+
+  done.reset();
+  if (!producer->thread_exists() && !producer->create(false))
+    return false;
+  if (!consumer->thread_exists() && !consumer->create(false))
+  {
+    producer->terminate();
+    return false;
+  }
+  return true;
+}
+
+void
+Player::stop()
+{
+  if (!sink)
+    return;
+
+  // The sink may block at process() while paused
+  bool control_paused = control && control->is_paused();
+  if (control_paused)
+    control->unpause();
+
+  producer->terminate();
+  consumer->terminate();
+  producer->retract_format();
+
+  if (control_paused)
+    control->pause();
+}
+
+bool
+Player::is_running() const
+{
+  // The consumer thread exits after it finishes the playback, so a finished
+  // playback may still have the thread for a while
+  return producer && consumer && !is_finished() &&
+    (producer->thread_exists() || consumer->thread_exists());
+}
+
+bool
+Player::is_finished() const
+{
+  AutoLock auto_lock(&lock);
+  return finished;
+}
+
+bool
+Player::is_error() const
+{
+  AutoLock auto_lock(&lock);
+  return error;
+}
+
+bool
+Player::wait(int timeout_ms)
+{
+  if (!sink)
+    return true;
+  return done.wait(timeout_ms);
+}
+
+bool
+Player::seek(vtime_t new_time)
+{
+  if (!sink)
+    return false;
+
+  bool running = is_running();
+  stop();
+  bool result = seek_source(new_time);
+  if (result)
+  {
+    reset_buffer();
+    if (src.get_filter())
+      src.get_filter()->reset();
+    src.set(src.get_source(), src.get_filter());
+    sink->reset();
+    AutoLock auto_lock(&lock);
+    finished = false;
+    time = new_time;
+  }
+  if (running)
+    start();
+  return result;
+}
+
+void
+Player::flush()
+{
+  if (!sink)
+    return;
+
+  bool running = is_running();
+  stop();
+  reset_buffer();
+  if (src.get_filter())
+    src.get_filter()->reset();
+  src.set(src.get_source(), src.get_filter());
+  sink->reset();
+  if (running)
+    start();
+}
+
+int
+Player::get_underruns() const
+{
+  AutoLock auto_lock(&lock);
+  return underruns;
+}
+
+int
+Player::get_overruns() const
+{
+  AutoLock auto_lock(&lock);
+  return overruns;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal
+
+size_t
+Player::data_size() const
+{
+  LONG size = write_pos - read_pos;
+  if (size < 0)
+    size += 2 * (LONG)buf_size;
+  return (size_t)size;
+}
+
+void
+Player::set_format(Speakers new_spk)
+{
+  AutoLock auto_lock(&lock);
+  spk = new_spk;
+  if (spk.is_pcm() && spk.nch() > 0)
+    block_size = spk.nch() * spk.sample_size();
+  else if (spk.is_spdif())
+    block_size = 4;
+  else
+    block_size = 1;
+
+  byte_rate = default_byte_rate;
+  if (spk.sample_rate && (spk.is_pcm() || spk.is_spdif()))
+    byte_rate = double(block_size) * spk.sample_rate;
+
+  // The ring is empty when the format changes
+  size_t new_size = size_t(byte_rate * buf_ms / 1000);
+  new_size -= new_size % block_size;
+  if (new_size < 2 * block_size)
+    new_size = 2 * block_size;
+
+  if (new_size != buf_size)
+  {
+    buf.allocate(new_size);
+    buf_size = new_size;
+  }
+  write_pos = 0;
+  read_pos = 0;
+}
+
+void
+Player::reset_buffer()
+{
+  write_pos = 0;
+  read_pos = 0;
+  marker_write = 0;
+  marker_read = 0;
+  eof = false;
+  producer->reset();
+  consumer->reset();
+  data_ready.reset();
+  space_ready.reset();
+  format_done.set();
+}
+
+bool
+Player::is_eof() const
+{
+  AutoLock auto_lock(&lock);
+  return eof;
+}
+
+void
+Player::set_error()
+{
+  AutoLock auto_lock(&lock);
+  error = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Playback control
+
+void
+Player::pause()
+{
+  {
+    AutoLock auto_lock(&lock);
+    paused = true;
+  }
+  if (control)
+    control->pause();
+}
+
+void
+Player::unpause()
+{
+  {
+    AutoLock auto_lock(&lock);
+    paused = false;
+  }
+  data_ready.set();
+  if (control)
+    control->unpause();
+}
+
+bool
+Player::is_paused() const
+{
+  AutoLock auto_lock(&lock);
+  return paused;
+}
+
+vtime_t
+Player::get_playback_time() const
+{
+  if (control)
+    return control->get_playback_time();
+  AutoLock auto_lock(&lock);
+  return time;
+}
+
+size_t
+Player::get_buffer_size() const
+{
+  AutoLock auto_lock(&lock);
+  return buf_size;
+}
+
+vtime_t
+Player::get_buffer_time() const
+{
+  AutoLock auto_lock(&lock);
+  return buf_size / byte_rate;
+}
+
+size_t
+Player::get_data_size() const
+{
+  AutoLock auto_lock(&lock);
+  return data_size();
+}
+
+vtime_t
+Player::get_data_time() const
+{
+  AutoLock auto_lock(&lock);
+  return data_size() / byte_rate;
+}
+
+double
+Player::get_vol() const
+{
+  return control? control->get_vol(): 0;
+}
+
+void
+Player::set_vol(double vol)
+{
+  if (control)
+    control->set_vol(vol);
+}
+
+double
+Player::get_pan() const
+{
+  return control? control->get_pan(): 0;
+}
+
+void
+Player::set_pan(double pan)
+{
+  if (control)
+    control->set_pan(pan);
+}
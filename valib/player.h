@@ -0,0 +1,200 @@
+/**************************************************************************//**
+  \file player.h
+  \brief Player: threaded playback and transcode engine
+******************************************************************************/
+
+#ifndef VALIB_PLAYER_H
+#define VALIB_PLAYER_H
+
+#include "buffer.h"
+#include "renderer.h"
+#include "sink.h"
+#include "source/source_filter.h"
+#include "win32/thread.h"
+
+/**************************************************************************//**
+  \class Player
+  \brief Runs Source -> Filter -> Sink at two threads with a buffer between.
+
+  The producer thread pulls chunks from the source through the filter and
+  writes the data into a ring buffer. The consumer thread reads the ring and
+  passes the data to the sink. So the sink (audio device, file) does not
+  wait for the decoding, and the decoding does not wait for the sink until
+  the buffer is full.
+
+  The ring has one writer and one reader, so the data is passed without
+  locking. Timestamps, format changes and the end of the stream are passed
+  with markers, bound to positions in the ring.
+
+  The ring is sized in milliseconds of the output format. Format change
+  waits until the ring is drained, because the ring is reallocated for the
+  new format. The output of the filter must be raw data (PCM, SPDIF, etc):
+  linear format cannot be buffered, convert it to PCM.
+
+  Playback starts when the ring is half full or the stream ends. Playback
+  control may be given to forward pause and timing to the audio device
+  (DSoundSink, NullRenderer).
+
+  \li Underrun is counted when the sink waits for the data after playback
+  was started (the producer is too slow).
+  \li Overrun is counted when the producer waits for the space at the ring.
+  It is normal for real-time playback, but indicates a slow sink when
+  transcoding.
+
+  Errors (exceptions) at both threads stop the playback and are reported
+  with is_error(). The data buffered before a source error is played.
+
+  \code
+    FileParser file;
+    DecoderGraph dec;
+    NullRenderer renderer;
+    Player player;
+
+    file.open_probe(filename, &any_parser);
+    player.open(&file, &dec, &renderer, &renderer);
+    player.start();
+    player.wait();
+  \endcode
+
+  \fn bool Player::open(Source *source, Filter *filter, Sink *sink, PlaybackControl *control = 0, int buf_ms = 500)
+    \param source  Source to play
+    \param filter  Filter to process the data (may be null)
+    \param sink    Sink to pass the data to
+    \param control Playback control of the sink (may be null)
+    \param buf_ms  Ring size in milliseconds
+    \return Returns true on success and false otherwise.
+
+    Set up the playback. Does not start it.
+
+  \fn void Player::close()
+    Stop the playback and release the source, filter and sink.
+
+  \fn bool Player::start()
+    Start the playback threads. Does nothing when the playback runs.
+
+  \fn void Player::stop()
+    Stop the threads. The data buffered is kept, so start() continues
+    the playback.
+
+  \fn bool Player::wait(int timeout_ms = INFINITE)
+    Wait until the playback is finished (the stream is played and the sink
+    is flushed). Returns false on timeout.
+
+  \fn bool Player::seek(vtime_t time)
+    Drop the data buffered and seek the source with seek_source(). Returns
+    false when the source cannot seek.
+
+  \fn void Player::flush()
+    Drop the data buffered and reset the filter and the sink. The playback
+    continues from the current position of the source.
+
+  \fn int Player::get_underruns() const
+    Number of underruns since open().
+
+  \fn int Player::get_overruns() const
+    Number of overruns since open().
+
+  \fn virtual bool Player::seek_source(vtime_t time)
+    Override this to seek the source. Called when the playback threads are
+    stopped.
+******************************************************************************/
+
+class Player : public PlaybackControl
+{
+public:
+  Player();
+  virtual ~Player();
+
+  bool open(Source *source, Filter *filter, Sink *sink, PlaybackControl *control = 0, int buf_ms = 500);
+  void close();
+  bool is_open() const { return sink != 0; }
+
+  bool start();
+  void stop();
+  bool is_running() const;
+  bool is_finished() const;
+  bool is_error() const;
+  bool wait(int timeout_ms = INFINITE);
+
+  bool seek(vtime_t time);
+  void flush();
+
+  int  get_underruns() const;
+  int  get_overruns() const;
+
+  /////////////////////////////////////////////////////////
+  // Playback control
+
+  virtual void pause();
+  virtual void unpause();
+  virtual bool is_paused() const;
+
+  virtual vtime_t get_playback_time() const;
+
+  virtual size_t  get_buffer_size()   const;
+  virtual vtime_t get_buffer_time()   const;
+  virtual size_t  get_data_size()     const;
+  virtual vtime_t get_data_time()     const;
+
+  virtual double get_vol()            const;
+  virtual void   set_vol(double vol);
+  virtual double get_pan()            const;
+  virtual void   set_pan(double pan);
+
+protected:
+  class Producer;
+  class Consumer;
+  struct Marker;
+
+  Producer *producer;
+  Consumer *consumer;
+
+  SourceFilter src;
+  Sink *sink;
+  PlaybackControl *control;
+  int buf_ms;
+
+  // Ring buffer. Positions are in range [0, 2*buf_size), so the full ring
+  // differs from the empty one. Each position is written by one thread only.
+  // The ring is reallocated by set_format() under the lock.
+  Rawdata buf;
+  size_t  buf_size;
+  volatile LONG write_pos;
+  volatile LONG read_pos;
+
+  // Markers ring (position of the marker is at the data ring)
+  Marker *markers;
+  volatile LONG marker_write;
+  volatile LONG marker_read;
+
+  Event data_ready;       // data or marker was written
+  Event space_ready;      // data or marker was read
+  Event format_done;      // consumer has switched to the new format
+  Event done;             // playback is finished
+
+  mutable CritSec lock;   // protects the state below
+
+  // Output format. Changed by the consumer under the lock when the producer
+  // waits, so the threads read it without the lock.
+  Speakers spk;
+  double   byte_rate;
+  size_t   block_size;
+
+  bool     paused;
+  bool     finished;
+  bool     error;
+  bool     eof;           // producer has finished
+  int      underruns;
+  int      overruns;
+  vtime_t  time;          // time of the data passed to the sink
+
+  size_t data_size() const;
+  void   set_format(Speakers spk);
+  void   reset_buffer();
+  bool   is_eof() const;
+  void   set_error();
+
+  virtual bool seek_source(vtime_t time) { return false; }
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include "read_ahead.h"
+
+// Time to wait for the reader to finish the read in flight on close
+static const int reader_timeout = 10000;
+
+///////////////////////////////////////////////////////////////////////////////
+// Reader thread
+//
+// The reader owns the file. It fills the buffer next to the last filled one
+// and commits it only if no seek was done during the read. One buffer is
+// always left for the consumer, so the buffer being filled is never the one
+// held by the consumer.
+
+class ReadAheadFile::Reader : public Thread
+{
+public:
+  ReadAheadFile *file;
+  AutoFile f;
+
+  Reader(ReadAheadFile *file_): file(file_)
+  {}
+
+  virtual void terminate(int timeout_ms = reader_timeout, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    file->ring.space_ready.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+protected:
+  virtual DWORD process()
+  {
+    IORing &ring = file->ring;
+    int file_generation = -1;
+    while (!f_terminate)
+    {
+      int generation = 0;
+      int slot = 0;
+      fsize_t pos = 0;
+      bool full;
+
+      {
+        AutoLock auto_lock(&ring.lock);
+        full = file->read_eof || ring.count >= ring.depth - 1;
+        if (!full)
+        {
+          generation = file->generation;
+          pos = file->read_pos;
+          slot = (ring.head + ring.count) % ring.depth;
+        }
+      }
+
+      if (full)
+      {
+        ring.space_ready.wait();
+        continue;
+      }
+
+      if (generation != file_generation)
+      {
+        f.seek(pos);
+        file_generation = generation;
+      }
+
+      size_t data_size = f.read(ring.buffer(slot), ring.buf_size);
+
+      {
+        AutoLock auto_lock(&ring.lock);
+        if (generation == file->generation)
+        {
+          ring.data_size[slot] = data_size;
+          file->read_pos += data_size;
+          if (data_size < ring.buf_size)
+            file->read_eof = true;
+          if (data_size)
+            ring.count++;
+        }
+      }
+      ring.data_ready.set();
+    }
+    return 0;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+ReadAheadFile::ReadAheadFile():
+reader(0), generation(0), read_pos(0), read_eof(false),
+filesize(0), filepos(0), cur(-1), cur_pos(0)
+{}
+
+ReadAheadFile::~ReadAheadFile()
+{
+  close();
+}
+
+bool
+ReadAheadFile::open(const char *filename, size_t buf_size_, int depth_)
+{
+  close();
+  if (!ring.allocate(buf_size_, depth_))
+    return false;
+
+  reader = new Reader(this);
+  if (!reader->f.open(filename))
+  {
+    safe_delete(reader);
+    ring.free();
+    return false;
+  }
+
+  read_pos = 0;
+  read_eof = false;
+
+  filesize = reader->f.size();
+  filepos = 0;
+  cur = -1;
+  cur_pos = 0;
+
+  if (!reader->create(false))
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void
+ReadAheadFile::close()
+{
+  if (reader)
+  {
+    reader->terminate();
+    delete reader;
+    reader = 0;
+  }
+
+  ring.free();
+  filesize = 0;
+  filepos = 0;
+  cur = -1;
+  cur_pos = 0;
+}
+
+size_t
+ReadAheadFile::map(uint8_t **data, size_t size)
+{
+  if (!reader)
+    return 0;
+
+  if (cur < 0 || cur_pos >= ring.data_size[cur])
+  {
+    vtime_t stall_start = 0;
+
+    ring.lock.lock();
+    if (cur >= 0)
+    {
+      cur = -1;
+      ring.space_ready.set();
+    }
+
+    while (!ring.count && !read_eof)
+      ring.stall_wait(ring.data_ready, stall_start);
+
+    bool have_data = ring.count > 0;
+    if (have_data)
+    {
+      cur = ring.head;
+      cur_pos = 0;
+      ring.head = (ring.head + 1) % ring.depth;
+      ring.count--;
+    }
+    ring.lock.unlock();
+
+    ring.stall_end(stall_start);
+    if (!have_data)
+      return 0;
+    ring.buffers++;
+  }
+
+  if (size > ring.data_size[cur] - cur_pos)
+    size = ring.data_size[cur] - cur_pos;
+
+  *data = ring.buffer(cur) + cur_pos;
+  cur_pos += size;
+  filepos += size;
+  return size;
+}
+
+int
+ReadAheadFile::seek(fsize_t pos)
+{
+  if (!reader || pos < 0)
+    return -1;
+
+  {
+    // Drop all buffers and let the reader restart at the new position.
+    // The read in flight is dropped by the reader because of the new
+    // generation.
+    AutoLock auto_lock(&ring.lock);
+    generation++;
+    read_pos = pos;
+    read_eof = false;
+    ring.count = 0;
+    cur = -1;
+    cur_pos = 0;
+  }
+
+  filepos = pos;
+  ring.space_ready.set();
+  return 0;
+}
+
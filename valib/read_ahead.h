@@ -0,0 +1,120 @@
+/**************************************************************************//**
+  \file read_ahead.h
+  \brief ReadAheadFile: input file with asynchronous read-ahead
+******************************************************************************/
+
+#ifndef VALIB_READ_AHEAD_H
+#define VALIB_READ_AHEAD_H
+
+#include "auto_file.h"
+#include "io_ring.h"
+
+/**************************************************************************//**
+  \class ReadAheadFile
+  \brief Input file read by a background thread ahead of the consumer.
+
+  The reader thread fills a ring of \c depth buffers of \c buf_size bytes
+  each (see IORing), so the consumer processes the data while the next buffers are being
+  read. It is useful for slow media (network filesystems, cold disks), where
+  the consumer would alternately wait for the I/O and for the CPU otherwise.
+
+  The interface is similar to MapFile: map() returns a pointer directly into
+  the ring buffer. One buffer is always held by the consumer, so up to
+  depth - 1 buffers are read ahead.
+
+  seek() cancels reads in flight: the data read for the old position is
+  dropped and the reader restarts at the new position.
+
+  Stall statistics show how often the consumer had to wait for the data. A
+  significant number of stalls means that the read-ahead is not deep enough
+  (or the media is just too slow).
+
+  \fn bool ReadAheadFile::open(const char *filename, size_t buf_size, int depth)
+    \param filename File name to open
+    \param buf_size Size of each buffer
+    \param depth    Number of buffers (at least 2)
+    \return Returns true on success and false otherwise.
+
+    Open the file and start the reader thread.
+
+  \fn void ReadAheadFile::close()
+    Stop the reader thread and close the file.
+
+  \fn size_t ReadAheadFile::map(uint8_t **data, size_t size)
+    \param data Receives the pointer to the data at the current position.
+    \param size Size of the data requested.
+    \return Number of bytes available at \c *data.
+
+    Returns up to \c size bytes at the current file position and moves the
+    position forward. Returns less than \c size at the end of the current
+    buffer. Waits for the reader when no data is available. Zero is returned
+    only at the end of the file.
+
+    The pointer returned is valid until the next map(), seek() or close() call.
+
+  \fn int ReadAheadFile::seek(fsize_t pos)
+    \param pos File position to move to.
+    \return Returns 0 on success and non-zero otherwise.
+
+  \fn int ReadAheadFile::get_buffers() const
+    Number of buffers consumed since open() or reset_stats().
+
+  \fn int ReadAheadFile::get_stalls() const
+    Number of times the consumer had to wait for the reader.
+
+  \fn vtime_t ReadAheadFile::get_stall_time() const
+    Total time the consumer waited for the reader.
+******************************************************************************/
+
+class ReadAheadFile
+{
+public:
+  typedef AutoFile::fsize_t fsize_t;
+
+protected:
+  class Reader;
+  Reader *reader;          //!< Reader thread
+
+  // Reader fills buffers and sets data_ready, consumer releases a buffer or
+  // requests a seek and sets space_ready. Fields below up to read_eof are
+  // protected by the ring lock.
+  IORing   ring;           //!< Read buffers
+  int      generation;     //!< Incremented on each seek
+  fsize_t  read_pos;       //!< Position of the next buffer to read
+  bool     read_eof;       //!< Reader has reached the end of the file
+
+  fsize_t  filesize;       //!< File size
+  fsize_t  filepos;        //!< Consumer position
+  int      cur;            //!< Buffer held by the consumer (-1 for none)
+  size_t   cur_pos;        //!< Consumer position at the current buffer
+
+  // Non-copyable
+  ReadAheadFile(const ReadAheadFile &);
+  ReadAheadFile &operator =(const ReadAheadFile &);
+
+public:
+  ReadAheadFile();
+  ~ReadAheadFile();
+
+  bool open(const char *filename, size_t buf_size, int depth);
+  void close();
+
+  size_t map(uint8_t **data, size_t size);
+
+  inline bool    is_open() const { return reader != 0; }
+  inline bool    eof()     const { return filepos >= filesize; }
+  inline fsize_t size()    const { return filesize; }
+
+  int seek(fsize_t pos);
+  inline fsize_t pos() const { return filepos; }
+
+  size_t get_buf_size() const { return ring.buf_size; }
+  int    get_depth()    const { return ring.depth; }
+
+  int     get_buffers()    const { return ring.buffers; }
+  int     get_stalls()     const { return ring.stalls; }
+  vtime_t get_stall_time() const { return ring.stall_time; }
+  void    reset_stats()          { ring.reset_stats(); }
+};
+
+#endif
@@ -353,4 +353,29 @@ protected:
   Sink *sink;
 };
 
+
+/**************************************************************************//**
+  \fn template <class File> void write_chunk(File &file, const Chunk &chunk)
+    \param file  File to write to (AutoFile, WriteBehindFile)
+    \param chunk Raw data chunk to write
+
+    Write the raw data of the chunk. Segments of a segmented chunk are written
+    one by one without gathering, zero padding is written with write_zeros().
+******************************************************************************/
+
+template <class File> void
+write_chunk(File &file, const Chunk &chunk)
+{
+  if (chunk.segments)
+  {
+    for (size_t i = 0; i < chunk.nsegments; i++)
+      if (chunk.segments[i].data)
+        file.write(chunk.segments[i].data, chunk.segments[i].size);
+      else
+        file.write_zeros(chunk.segments[i].size);
+  }
+  else
+    file.write(chunk.rawdata, chunk.size);
+}
+
 #endif
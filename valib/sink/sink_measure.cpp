@@ -0,0 +1,249 @@
+#include <math.h>
+#include <sstream>
+#include "sink_measure.h"
+
+MeasureSink::MeasureSink():
+tolerance(0.001), latency(false), unit_size(0)
+{
+  reset_stats();
+}
+
+void
+MeasureSink::reset_stats()
+{
+  has_ref = false;
+  ref_time = 0;
+  ref_samples = 0;
+
+  chunks = 0;
+  bytes = 0;
+  samples = 0;
+  duration = 0;
+
+  for (int i = 0; i < size_classes; i++)
+    size_hist[i] = 0;
+  min_chunk = 0;
+  max_chunk = 0;
+
+  timestamps = 0;
+  gaps = 0;
+  overlaps = 0;
+  gap_time = 0;
+  overlap_time = 0;
+  max_jitter = 0;
+  jitter_sum2 = 0;
+  jitter_count = 0;
+
+  first_arrival = 0;
+  last_arrival = 0;
+  max_interval = 0;
+
+  latency_count = 0;
+  min_latency = 0;
+  max_latency = 0;
+  latency_sum = 0;
+}
+
+int
+MeasureSink::get_size_class(size_t size)
+{
+  int size_class = 0;
+  while (size)
+  {
+    size >>= 1;
+    size_class++;
+  }
+  // Sizes above the histogram range go to the last class
+  return size_class < size_classes? size_class: size_classes - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Derived statistics
+
+vtime_t
+MeasureSink::get_jitter() const
+{
+  return jitter_count? sqrt(jitter_sum2 / jitter_count): 0;
+}
+
+vtime_t
+MeasureSink::get_elapsed() const
+{
+  return chunks? last_arrival - first_arrival: 0;
+}
+
+double
+MeasureSink::get_speed() const
+{
+  vtime_t elapsed = get_elapsed();
+  return elapsed > 0? duration / elapsed: 0;
+}
+
+vtime_t
+MeasureSink::get_mean_latency() const
+{
+  return latency_count? latency_sum / latency_count: 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sink interface
+
+bool
+MeasureSink::init()
+{
+  // Size of a sample in bytes, when the sample count is known
+  unit_size = 0;
+  if (spk.sample_rate)
+  {
+    if (spk.is_linear())
+      unit_size = 1;
+    else if (spk.is_pcm())
+      unit_size = spk.nch() * spk.sample_size();
+    else if (spk.is_spdif())
+      unit_size = 4;
+  }
+
+  has_ref = false;
+  return true;
+}
+
+void
+MeasureSink::reset()
+{
+  has_ref = false;
+}
+
+void
+MeasureSink::process(const Chunk &in)
+{
+  vtime_t now = utc_time();
+
+  /////////////////////////////////////////////////////////
+  // Arrival
+
+  if (chunks == 0)
+    first_arrival = now;
+  else if (now - last_arrival > max_interval)
+    max_interval = now - last_arrival;
+  last_arrival = now;
+
+  /////////////////////////////////////////////////////////
+  // Timestamps (apply to the beginning of the chunk)
+
+  if (in.sync)
+  {
+    timestamps++;
+    if (latency)
+    {
+      vtime_t chunk_latency = now - in.time;
+      if (latency_count == 0 || chunk_latency < min_latency)
+        min_latency = chunk_latency;
+      if (latency_count == 0 || chunk_latency > max_latency)
+        max_latency = chunk_latency;
+      latency_sum += chunk_latency;
+      latency_count++;
+    }
+    else if (unit_size)
+    {
+      if (has_ref)
+      {
+        vtime_t expected = ref_time + vtime_t(samples - ref_samples) / spk.sample_rate;
+        vtime_t diff = in.time - expected;
+
+        if (diff > tolerance)
+        {
+          gaps++;
+          gap_time += diff;
+        }
+        else if (diff < -tolerance)
+        {
+          overlaps++;
+          overlap_time -= diff;
+        }
+
+        if (fabs(diff) > max_jitter)
+          max_jitter = fabs(diff);
+        jitter_sum2 += diff * diff;
+        jitter_count++;
+      }
+
+      has_ref = true;
+      ref_time = in.time;
+      ref_samples = samples;
+    }
+  }
+
+  /////////////////////////////////////////////////////////
+  // Amount of data
+
+  chunks++;
+  size_hist[get_size_class(in.size)]++;
+  if (chunks == 1 || in.size < min_chunk)
+    min_chunk = in.size;
+  if (in.size > max_chunk)
+    max_chunk = in.size;
+
+  if (!spk.is_linear())
+    bytes += in.size;
+
+  if (unit_size)
+  {
+    size_t chunk_samples = in.size / unit_size;
+    samples += chunk_samples;
+    duration += vtime_t(chunk_samples) / spk.sample_rate;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Report
+
+string
+MeasureSink::report() const
+{
+  std::stringstream s;
+  vtime_t elapsed = get_elapsed();
+
+  s << "Chunks: " << chunks << nl;
+  s << "Bytes: " << bytes << nl;
+  s << "Samples: " << samples << nl;
+  s << "Duration: " << duration << "s" << nl;
+  s << "Elapsed: " << elapsed << "s" << nl;
+  if (elapsed > 0)
+  {
+    s << "Throughput: " << bytes / elapsed << " bytes/s, "
+      << samples / elapsed << " samples/s" << nl;
+    if (duration > 0)
+      s << "Speed: " << get_speed() << "x real time" << nl;
+  }
+  s << "Max interval: " << max_interval * 1000 << "ms" << nl;
+
+  s << "Chunk size: " << min_chunk << " - " << max_chunk << nl;
+  for (int i = 0; i < size_classes; i++)
+    if (size_hist[i])
+    {
+      if (i == 0)
+        s << "  0: ";
+      else if (i == size_classes - 1)
+        s << "  " << (size_t(1) << (i - 1)) << "+: ";
+      else
+        s << "  " << (size_t(1) << (i - 1)) << "-" << (size_t(1) << i) - 1 << ": ";
+      s << size_hist[i] << nl;
+    }
+
+  s << "Timestamps: " << timestamps << nl;
+  if (latency)
+  {
+    if (latency_count)
+      s << "Latency: " << min_latency * 1000 << "ms min, "
+        << get_mean_latency() * 1000 << "ms mean, "
+        << max_latency * 1000 << "ms max" << nl;
+  }
+  else
+  {
+    s << "Gaps: " << gaps << " (" << gap_time * 1000 << "ms)" << nl;
+    s << "Overlaps: " << overlaps << " (" << overlap_time * 1000 << "ms)" << nl;
+    s << "Jitter: " << get_jitter() * 1000 << "ms rms, "
+      << max_jitter * 1000 << "ms max" << nl;
+  }
+  return s.str();
+}
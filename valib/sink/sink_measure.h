@@ -0,0 +1,221 @@
+/**************************************************************************//**
+  \file sink_measure.h
+  \brief MeasureSink: sink collecting stream statistics for benchmarks
+******************************************************************************/
+
+#ifndef VALIB_SINK_MEASURE_H
+#define VALIB_SINK_MEASURE_H
+
+#include "../sink.h"
+#include "../source.h"
+#include "../vtime.h"
+
+/**************************************************************************//**
+  \class MeasureSink
+  \brief Drops all data like NullSink, but measures the stream.
+
+  Collects the following statistics:
+  \li Amount of data: number of chunks, bytes (rawdata formats) and samples.
+    Samples are counted for linear, PCM and SPDIF formats.
+  \li Chunk size distribution: histogram of chunk sizes by powers of 2, min
+    and max chunk size.
+  \li Timestamp continuity: each timestamp is compared with the time expected
+    from the previous timestamp and the number of samples received since.
+    The difference is the timestamp jitter. Difference larger than the
+    tolerance is counted as a gap (timestamp is ahead of the data) or an
+    overlap (timestamp is behind the data). Continuity is checked only for
+    formats with the known sample rate. reset() and the format change start
+    a new reference.
+  \li Wall-clock arrival: time of the first and the last chunk, max interval
+    between chunks, throughput and the speed relative to the real time.
+  \li Latency: when latency measurement is on (set_latency()), timestamps
+    are wall-clock times (utc_time()) of the data production, set by the
+    source (see StampSource). Latency is the difference between the arrival
+    time and the timestamp. Continuity is not checked in this mode.
+
+  Statistics are accumulated over open(), reset() and format changes and
+  cleared only with reset_stats().
+
+  \code
+    RAWSource  src(spk, filename);
+    StampSource stamp(&src);
+    DVDGraph   dvd;
+    MeasureSink sink;
+    sink.set_latency(true);
+
+    Chunk chunk;
+    SourceFilter source(&stamp, &dvd);
+    sink.open_throw(source.get_output());
+    while (source.get_chunk(chunk))
+    {
+      if (source.new_stream())
+        sink.flush_open_throw(source.get_output());
+      sink.process(chunk);
+    }
+    sink.flush();
+    printf("%s", sink.report().c_str());
+  \endcode
+
+  \fn void MeasureSink::set_tolerance(vtime_t tolerance)
+    Max timestamp difference not counted as a gap or overlap. 1ms by default.
+
+  \fn void MeasureSink::set_latency(bool latency)
+    Treat timestamps as wall-clock production times and measure latency.
+
+  \fn void MeasureSink::reset_stats()
+    Clear all statistics.
+
+  \fn int MeasureSink::get_size_class(size_t size)
+    Histogram bucket for the chunk size: 0 for empty chunks, n + 1 for
+    sizes in [2^n, 2^(n+1)). The last class also counts all larger sizes.
+
+  \fn int64_t MeasureSink::get_size_hist(int size_class) const
+    Number of chunks of the size class given.
+
+  \fn vtime_t MeasureSink::get_duration() const
+    Duration of the audio received (known for formats with the sample rate).
+
+  \fn vtime_t MeasureSink::get_elapsed() const
+    Wall-clock time between the first and the last chunk.
+
+  \fn double MeasureSink::get_speed() const
+    Duration of the audio received divided by the elapsed time (0 when
+    unknown).
+
+  \fn vtime_t MeasureSink::get_jitter() const
+    RMS of the timestamp differences.
+
+  \fn string MeasureSink::report() const
+    Summary report of the statistics (multiline text).
+******************************************************************************/
+
+class MeasureSink : public SimpleSink
+{
+public:
+  enum { size_classes = 33 };
+
+  MeasureSink();
+
+  void    set_tolerance(vtime_t tolerance_) { tolerance = tolerance_; }
+  vtime_t get_tolerance() const             { return tolerance;       }
+  void    set_latency(bool latency_)        { latency = latency_;     }
+  bool    get_latency() const               { return latency;         }
+
+  void reset_stats();
+  string report() const;
+
+  static int get_size_class(size_t size);
+
+  // Amount of data
+  int64_t get_chunks()  const { return chunks;  }
+  int64_t get_bytes()   const { return bytes;   }
+  int64_t get_samples() const { return samples; }
+  vtime_t get_duration() const { return duration; }
+
+  // Chunk sizes
+  int64_t get_size_hist(int size_class) const
+  { return size_class >= 0 && size_class < size_classes? size_hist[size_class]: 0; }
+  size_t  get_min_chunk() const { return min_chunk; }
+  size_t  get_max_chunk() const { return max_chunk; }
+
+  // Timestamp continuity
+  int64_t get_timestamps() const { return timestamps; }
+  int64_t get_gaps()       const { return gaps;       }
+  int64_t get_overlaps()   const { return overlaps;   }
+  vtime_t get_gap_time()     const { return gap_time;     }
+  vtime_t get_overlap_time() const { return overlap_time; }
+  vtime_t get_max_jitter()   const { return max_jitter;   }
+  vtime_t get_jitter() const;
+
+  // Wall-clock arrival
+  vtime_t get_first_arrival() const { return first_arrival; }
+  vtime_t get_last_arrival()  const { return last_arrival;  }
+  vtime_t get_max_interval()  const { return max_interval;  }
+  vtime_t get_elapsed() const;
+  double  get_speed() const;
+
+  // Latency
+  int64_t get_latency_count() const { return latency_count; }
+  vtime_t get_min_latency()   const { return min_latency;   }
+  vtime_t get_max_latency()   const { return max_latency;   }
+  vtime_t get_mean_latency() const;
+
+  /////////////////////////////////////////////////////////
+  // Sink interface
+
+  virtual bool can_open(Speakers spk) const
+  { return true; }
+
+  virtual bool init();
+  virtual void reset();
+  virtual void process(const Chunk &in);
+
+protected:
+  vtime_t tolerance;
+  bool    latency;
+
+  int     unit_size;     //!< Bytes per sample (0 when unknown)
+  bool    has_ref;       //!< Reference timestamp is set
+  vtime_t ref_time;      //!< Reference timestamp
+  int64_t ref_samples;   //!< Samples received at the reference timestamp
+
+  int64_t chunks;
+  int64_t bytes;
+  int64_t samples;
+  vtime_t duration;
+
+  int64_t size_hist[size_classes];
+  size_t  min_chunk;
+  size_t  max_chunk;
+
+  int64_t timestamps;
+  int64_t gaps;
+  int64_t overlaps;
+  vtime_t gap_time;
+  vtime_t overlap_time;
+  vtime_t max_jitter;
+  double  jitter_sum2;
+  int64_t jitter_count;
+
+  vtime_t first_arrival;
+  vtime_t last_arrival;
+  vtime_t max_interval;
+
+  int64_t latency_count;
+  vtime_t min_latency;
+  vtime_t max_latency;
+  vtime_t latency_sum;
+};
+
+/**************************************************************************//**
+  \class StampSource
+  \brief Source wrapper stamping each chunk with the wall-clock time.
+
+  Each chunk of the source is marked with sync and utc_time() of the moment
+  it was produced, so MeasureSink at the other end of the processing chain
+  can measure the latency (MeasureSink::set_latency()). Original timestamps
+  are replaced.
+******************************************************************************/
+
+class StampSource : public SourceWrapper
+{
+public:
+  StampSource()
+  {}
+
+  StampSource(Source *source): SourceWrapper(source)
+  {}
+
+  void set(Source *source_)
+  { source = source_; }
+
+  virtual bool get_chunk(Chunk &out)
+  {
+    if (!SourceWrapper::get_chunk(out))
+      return false;
+    out.set_sync(true, utc_time());
+    return true;
+  }
+};
+
+#endif
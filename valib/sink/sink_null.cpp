@@ -0,0 +1,234 @@
+#include <math.h>
+#include "sink_null.h"
+#include "../vtime.h"
+
+NullRenderer::NullRenderer(int buf_ms_, double speed_):
+buf_ms(buf_ms_), speed(speed_), rate(0), buf_size(0), block_size(1),
+paused(false), wakeup(false)
+{
+  reset_clock();
+}
+
+void
+NullRenderer::reset_clock()
+{
+  playing = false;
+  clock_start = 0;
+  pause_start = 0;
+  written = 0;
+  stream_time = 0;
+  underruns = 0;
+}
+
+// Time of the clock (in stream units of time)
+vtime_t
+NullRenderer::clock() const
+{
+  if (!playing)
+    return 0;
+  vtime_t now = paused? pause_start: utc_time();
+  return (now - clock_start) * speed;
+}
+
+// Number of units played
+double
+NullRenderer::played() const
+{
+  double pos = clock() * rate;
+  return pos < (double)written? pos: (double)written;
+}
+
+// Time to play the data size given (ms). The clock does not run while
+// paused, so wait for the state change only.
+DWORD
+NullRenderer::play_ms(double size) const
+{
+  if (paused || rate <= 0 || speed <= 0)
+    return INFINITE;
+  double ms = ceil(size / rate / speed * 1000);
+  return ms > 1? (DWORD)ms: 1;
+}
+
+int
+NullRenderer::get_underruns() const
+{
+  AutoLock auto_lock(&lock);
+  return underruns;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Playback control
+
+void
+NullRenderer::pause()
+{
+  {
+    AutoLock auto_lock(&lock);
+    if (!paused)
+    {
+      pause_start = utc_time();
+      paused = true;
+    }
+  }
+  wakeup.set();
+}
+
+void
+NullRenderer::unpause()
+{
+  {
+    AutoLock auto_lock(&lock);
+    if (paused)
+    {
+      clock_start += utc_time() - pause_start;
+      paused = false;
+    }
+  }
+  wakeup.set();
+}
+
+bool
+NullRenderer::is_paused() const
+{
+  AutoLock auto_lock(&lock);
+  return paused;
+}
+
+vtime_t
+NullRenderer::get_playback_time() const
+{
+  AutoLock auto_lock(&lock);
+  if (rate <= 0)
+    return 0;
+  return stream_time + played() / rate;
+}
+
+size_t
+NullRenderer::get_buffer_size() const
+{
+  AutoLock auto_lock(&lock);
+  return buf_size;
+}
+
+vtime_t
+NullRenderer::get_buffer_time() const
+{
+  AutoLock auto_lock(&lock);
+  return rate > 0? buf_size / rate: 0;
+}
+
+size_t
+NullRenderer::get_data_size() const
+{
+  AutoLock auto_lock(&lock);
+  return (size_t)(written - (uint64_t)played());
+}
+
+vtime_t
+NullRenderer::get_data_time() const
+{
+  AutoLock auto_lock(&lock);
+  return rate > 0? (written - played()) / rate: 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sink interface
+
+bool
+NullRenderer::can_open(Speakers new_spk) const
+{
+  if (new_spk.sample_rate == 0)
+    return false;
+  return new_spk.is_linear() || new_spk.is_spdif() ||
+    (new_spk.is_pcm() && new_spk.nch() > 0);
+}
+
+bool
+NullRenderer::init()
+{
+  AutoLock auto_lock(&lock);
+  wakeup.set();
+  if (spk.is_linear())
+    block_size = 1;
+  else if (spk.is_spdif())
+    block_size = 4;
+  else
+    block_size = spk.nch() * spk.sample_size();
+
+  rate = double(block_size) * spk.sample_rate;
+  buf_size = size_t(rate * buf_ms / 1000);
+  buf_size -= buf_size % block_size;
+  if (buf_size < block_size)
+    buf_size = block_size;
+
+  reset_clock();
+  return true;
+}
+
+void
+NullRenderer::process(const Chunk &chunk)
+{
+  {
+    AutoLock auto_lock(&lock);
+    if (chunk.sync)
+      stream_time = chunk.time - written / rate;
+
+    if (!playing)
+    {
+      // Start the device with the first data
+      clock_start = paused? pause_start: utc_time();
+      playing = true;
+    }
+    else if (!paused && written > 0 && played() >= (double)written)
+    {
+      // Buffer ran empty, restart the clock at the end of the data
+      underruns++;
+      clock_start = utc_time() - written / rate / speed;
+    }
+  }
+
+  // Wait for the space in the buffer. Data larger than the buffer is
+  // accepted when the buffer is empty.
+  while (true)
+  {
+    DWORD timeout_ms;
+    {
+      AutoLock auto_lock(&lock);
+      double data = written - played();
+      if (data + chunk.size <= buf_size || data <= 0)
+      {
+        written += chunk.size;
+        return;
+      }
+      timeout_ms = play_ms(MIN(data + chunk.size - buf_size, data));
+    }
+    wakeup.wait(timeout_ms);
+  }
+}
+
+void
+NullRenderer::reset()
+{
+  {
+    AutoLock auto_lock(&lock);
+    reset_clock();
+  }
+  wakeup.set();
+}
+
+void
+NullRenderer::flush()
+{
+  while (true)
+  {
+    DWORD timeout_ms;
+    {
+      AutoLock auto_lock(&lock);
+      double data = written - played();
+      if (!playing || paused || data <= 0)
+        break;
+      timeout_ms = play_ms(data);
+    }
+    wakeup.wait(timeout_ms);
+  }
+}
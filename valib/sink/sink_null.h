@@ -1,12 +1,17 @@
 /*
   NullSink
   Just drop all data
+
+  NullRenderer
+  Drop all data at the rate of a real audio device
 */
 
 #ifndef VALIB_SINK_NULL_H
 #define VALIB_SINK_NULL_H
 
 #include "../sink.h"
+#include "../renderer.h"
+#include "../win32/thread.h"
 
 class NullSink : public SimpleSink
 {
@@ -21,4 +26,92 @@ public:
   {}
 };
 
+/**************************************************************************//**
+  \class NullRenderer
+  \brief NullSink with a simulated playback clock.
+
+  Acts like an audio device with a buffer of buf_ms milliseconds, but drops
+  the data. The device starts playing when the first data is received, and
+  process() blocks while the buffer is full, just like a real device does.
+  So the renderer may be used to test the latency and the jitter of the
+  playback on machines without audio hardware.
+
+  The clock is the system clock multiplied by the speed factor, so the tests
+  may run faster than real time.
+
+  When the device buffer runs empty (the data arrives too late), the underrun
+  is counted and the clock restarts with the next data.
+
+  Linear, PCM and SPDIF formats are accepted (formats with the known rate).
+
+  \fn NullRenderer::NullRenderer(int buf_ms = 100, double speed = 1.0)
+    \param buf_ms Device buffer size in milliseconds.
+    \param speed  Clock speed factor.
+
+  \fn int NullRenderer::get_underruns() const
+    Number of times the device buffer ran empty since open() or reset().
+
+  \fn void NullRenderer::flush()
+    Wait until all data is played. Does not wait when paused.
+******************************************************************************/
+
+class NullRenderer : public SimpleSink, public PlaybackControl
+{
+protected:
+  int      buf_ms;        // buffer size in ms
+  double   speed;         // clock speed factor
+
+  double   rate;          // units (bytes or samples) per second
+  size_t   buf_size;      // buffer size in units
+  size_t   block_size;    // size of a sample in units
+
+  mutable CritSec lock;
+  bool     paused;
+  bool     playing;       // clock is running
+  vtime_t  clock_start;   // system time when the clock was at zero
+  vtime_t  pause_start;   // system time when paused
+  uint64_t written;       // units received
+  vtime_t  stream_time;   // stream time at zero units
+  int      underruns;
+  Event    wakeup;        // state changed (pause, reset, etc)
+
+  vtime_t clock() const;
+  double  played() const;
+  DWORD   play_ms(double size) const;
+  void    reset_clock();
+
+public:
+  NullRenderer(int buf_ms = 100, double speed = 1.0);
+
+  void   set_buffer(int buf_ms_)   { buf_ms = buf_ms_;  }
+  int    get_buffer() const        { return buf_ms;     }
+  void   set_speed(double speed_)  { speed = speed_;    }
+  double get_speed() const         { return speed;      }
+
+  int get_underruns() const;
+
+  /////////////////////////////////////////////////////////
+  // Playback control
+
+  virtual void pause();
+  virtual void unpause();
+  virtual bool is_paused() const;
+
+  virtual vtime_t get_playback_time() const;
+
+  virtual size_t  get_buffer_size()   const;
+  virtual vtime_t get_buffer_time()   const;
+  virtual size_t  get_data_size()     const;
+  virtual vtime_t get_data_time()     const;
+
+  /////////////////////////////////////////////////////////
+  // Sink interface
+
+  virtual bool can_open(Speakers spk) const;
+  virtual bool init();
+  virtual void process(const Chunk &in);
+  virtual void reset();
+  virtual void flush();
+};
+
 #endif
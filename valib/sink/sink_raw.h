@@ -7,43 +7,83 @@
 
 #include "../sink.h"
 #include "../auto_file.h"
+#include "../write_behind.h"
 
 class RAWSink : public SimpleSink
 {
 protected:
   AutoFile f;
+  WriteBehindFile wb;
+  int    wb_depth;
+  size_t wb_buf_size;
+  int    wb_flags;
+
+  bool open_write_behind()
+  {
+    if (!wb_depth || !f.is_open())
+      return f.is_open();
+
+    // Do not change buffering of the caller's file
+    int flags = wb_flags;
+    if (!f.is_own())
+      flags &= ~WRITE_BEHIND_DIRECT;
+    return wb.open(&f, wb_buf_size, wb_depth, flags);
+  }
 
 public:
-  RAWSink() 
+  RAWSink():
+  wb_depth(0), wb_buf_size(0), wb_flags(0)
   {}
 
   RAWSink(const char *_filename): 
-  f(_filename, "wb") 
+  f(_filename, "wb"), wb_depth(0), wb_buf_size(0), wb_flags(0)
   {}
 
   RAWSink(FILE *_f): 
-  f(_f) 
+  f(_f), wb_depth(0), wb_buf_size(0), wb_flags(0)
   {}
 
+  ~RAWSink()
+  {
+    wb.close();
+  }
+
   /////////////////////////////////////////////////////////
   // RAWSink interface
 
   bool open_file(const char *_filename)
   {
-    return f.open(_filename, "wb");
+    wb.close();
+    return f.open(_filename, "wb") && open_write_behind();
   }
 
   bool open_file(FILE *_f)
   {
-    return f.open(_f);
+    wb.close();
+    return f.open(_f) && open_write_behind();
   }
 
   void close_file()
   {
+    wb.close();
     f.close();
     close();
   }
 
+  // Write-behind (see WriteBehindFile). Takes effect at the next
+  // open_file(). Depth less than 2 disables the write-behind.
+  // WRITE_BEHIND_DIRECT is ignored for a file opened by the caller.
+  void set_write_behind(int depth, size_t buf_size = 1048576, int flags = 0)
+  {
+    wb_depth = depth < 2? 0: depth;
+    wb_buf_size = buf_size;
+    wb_flags = flags;
+  }
+
+  int     get_write_behind()  const { return wb_depth; }
+  int     get_io_stalls()     const { return wb.get_stalls(); }
+  vtime_t get_io_stall_time() const { return wb.get_stall_time(); }
+
   bool is_file_open() const
   {
     return f.is_open();
@@ -60,7 +100,17 @@ public:
 
   virtual void process(const Chunk &chunk)               
   {
-    f.write(chunk.rawdata, chunk.size);
+    if (wb.is_open())
+      write_chunk(wb, chunk);
+    else
+      write_chunk(f, chunk);
+  }
+
+  virtual void flush()
+  {
+    if (wb.is_open())
+      wb.flush();
+    SimpleSink::flush();
   }
 };
 
@@ -12,6 +12,9 @@ WAVSink::WAVSink()
   header_size = 0;
   data_size = 0;
   file_format = 0;
+  wb_depth = 0;
+  wb_buf_size = 0;
+  wb_flags = 0;
 }
 
 WAVSink::WAVSink(const char *_file_name)
@@ -20,6 +23,9 @@ WAVSink::WAVSink(const char *_file_name)
   header_size = 0;
   data_size = 0;
   file_format = 0;
+  wb_depth = 0;
+  wb_buf_size = 0;
+  wb_flags = 0;
 
   open_file(_file_name);
 }
@@ -35,6 +41,10 @@ WAVSink::init_riff()
 {
   WAVEFORMATEX *wfe = (WAVEFORMATEX *)file_format;
   uint32_t format_size = sizeof(WAVEFORMATEX) + wfe->cbSize;
+
+  // The header is written directly, so write all queued data first
+  if (wb.is_open())
+    wb.flush();
   f.seek(0);
 
   // RIFF header
@@ -57,12 +67,16 @@ WAVSink::init_riff()
   f.write("data\0\0\0\0", 8);
 
   header_size = (uint32_t) f.pos();
+  if (wb.is_open())
+    wb.seek(header_size);
 }
 
 void
 WAVSink::close_riff()
 {
   uint64_t riff_size = header_size + data_size - 8;
+  if (wb.is_open())
+    wb.flush();
 
   if (riff_size <= 0xffffffff)
   {
@@ -112,6 +126,12 @@ WAVSink::open_file(const char *new_file_name)
   if (!f.open(new_file_name, "wb"))
     return false;
 
+  if (wb_depth && !wb.open(&f, wb_buf_size, wb_depth, wb_flags))
+  {
+    f.close();
+    return false;
+  }
+
   fname = new_file_name;
   data_size = 0;
   safe_delete(file_format);
@@ -129,6 +149,7 @@ WAVSink::close_file()
     close_riff();
     close();
   }
+  wb.close();
   f.close();
   fname.clear();
 
@@ -149,6 +170,14 @@ WAVSink::filename() const
   return fname;
 }
 
+void
+WAVSink::set_write_behind(int depth, size_t buf_size, int flags)
+{
+  wb_depth = depth < 2? 0: depth;
+  wb_buf_size = buf_size;
+  wb_flags = flags;
+}
+
 
 ///////////////////////////////////////////////////////////
 // Sink interface
@@ -191,7 +220,18 @@ WAVSink::process(const Chunk &chunk)
 {
   if (f.is_open())
   {
-    f.write(chunk.rawdata, chunk.size);
+    if (wb.is_open())
+      write_chunk(wb, chunk);
+    else
+      write_chunk(f, chunk);
     data_size += chunk.size;
   }
 }
+
+void
+WAVSink::flush()
+{
+  if (wb.is_open())
+    wb.flush();
+  SimpleSink::flush();
+}
@@ -8,6 +8,7 @@
 
 #include "../sink.h"
 #include "../auto_file.h"
+#include "../write_behind.h"
 
 /**************************************************************************//**
   \class WAVSink
@@ -24,6 +25,11 @@
   correctly on destruction. But the resulting wav file becomes valid only after
   closing the file.
 
+  Data may be written by a background thread (see WriteBehindFile and
+  set_write_behind()), so the graph does not wait for the disk on each
+  chunk. The RIFF header is written directly after all queued data is
+  written, so the file is the same as without the write-behind.
+
   Usage example:
   \code
   WAVSink sink;
@@ -73,6 +79,26 @@
   \fn string WAVSink::filename() const;
     Returns the name of the file currently open.
 
+  \fn void WAVSink::set_write_behind(int depth, size_t buf_size = 1048576, int flags = 0)
+    \param depth    Number of write-behind buffers. Zero disables the
+                    write-behind.
+    \param buf_size Size of each buffer.
+    \param flags    Write policy (see WriteBehindFile).
+
+    Enable the asynchronous write-behind. Takes effect at the next
+    open_file(). The write-behind requires at least 2 buffers, smaller depth
+    disables it.
+
+  \fn int WAVSink::get_write_behind() const
+    Returns the number of write-behind buffers (zero when disabled).
+
+  \fn int WAVSink::get_io_stalls() const
+    Returns the number of times the sink waited for the disk since
+    open_file() (back-pressure). Zero when the write-behind is disabled.
+
+  \fn vtime_t WAVSink::get_io_stall_time() const
+    Returns the total time the sink waited for the disk since open_file().
+
 ******************************************************************************/
 
 class WAVSink : public SimpleSink
@@ -84,6 +110,11 @@ protected:
   uint64_t data_size;    //!< data size written to the file
   void *file_format;     //!< WAVEFORMAT * of the open file
 
+  WriteBehindFile wb;    //!< write-behind for the data
+  int    wb_depth;       //!< number of write-behind buffers
+  size_t wb_buf_size;    //!< size of each write-behind buffer
+  int    wb_flags;       //!< write-behind policy
+
   void init_riff();      //!< Writes dummy RIFF header
   void close_riff();     //!< Updates the RIFF header before closing the file
 
@@ -97,12 +128,19 @@ public:
   bool is_file_open() const;
   string filename() const;
 
+  void set_write_behind(int depth, size_t buf_size = 1048576, int flags = 0);
+  int  get_write_behind() const { return wb_depth; }
+
+  int     get_io_stalls()     const { return wb.get_stalls(); }
+  vtime_t get_io_stall_time() const { return wb.get_stall_time(); }
+
   /////////////////////////////////////////////////////////
   // Sink interface
 
   virtual bool can_open(Speakers new_spk) const;
   virtual bool init();
   virtual void process(const Chunk &chunk); 
+  virtual void flush();
 };
 
 #endif
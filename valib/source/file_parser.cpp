@@ -2,7 +2,10 @@
 #include <sstream>
 #include "file_parser.h"
 
-static const size_t buf_size = 65536;
+// Amount of data mapped at once. Frames are returned directly from the
+// mapping, so it only limits the amount of data scanned between max_scan
+// checks.
+static const size_t map_size = 1024 * 1024;
 
 int compact_size(AutoFile::fsize_t size)
 {
@@ -28,20 +31,34 @@ const char *compact_suffix(AutoFile::fsize_t size)
   return suffixes[iter];
 }
 
+static inline vtime_t frame_duration(const FrameInfo &finfo)
+{
+  return finfo.spk.sample_rate? vtime_t(finfo.nsamples) / finfo.spk.sample_rate: 0;
+}
+
 FileParser::FileParser()
 {
   has_probe = false;
   is_new_stream = false;
 
-  buf.allocate(buf_size);
-  buf_pos = buf.begin();
-  buf_end = buf.begin();
+  buf_pos = 0;
+  buf_end = 0;
+
+  // New data is mapped only when all data is processed, so frames may point
+  // directly into the mapping.
+  stream.set_zero_copy(true);
+
+  scan_headers = false;
+  scan_next = 0;
 
   stat_size = 0;
   avg_frame_size = 0;
   avg_bitrate = 0;
 
   max_scan = 0;
+
+  ra_depth = 0;
+  ra_buf_size = 0;
 }
 
 FileParser::~FileParser()
@@ -59,8 +76,19 @@ FileParser::open(const string &new_filename, FrameParser *new_parser, size_t new
   if (!new_parser)
     return false;
 
-  if (!f.open(new_filename.c_str()))
-    return false;
+  if (ra_depth)
+  {
+    if (!ra.open(new_filename.c_str(), ra_buf_size, ra_depth))
+      return false;
+  }
+  else if (!f.open(new_filename.c_str()))
+  {
+    // Pipes, devices and other files that cannot be mapped are read through
+    // a buffer.
+    if (!af.open(new_filename.c_str()))
+      return false;
+    af_buf.allocate(map_size);
+  }
 
   stream.set_parser(new_parser);
   max_scan = new_max_scan;
@@ -88,6 +116,9 @@ FileParser::close()
 {
   stream.release_parser();
   f.close();
+  ra.close();
+  af.close();
+  index.clear();
 
   has_probe = false;
   is_new_stream = false;
@@ -102,7 +133,7 @@ FileParser::close()
 bool 
 FileParser::probe()
 {
-  if (!f) return false;
+  if (!is_open()) return false;
 
   if (has_probe)
     return true;
@@ -116,9 +147,9 @@ FileParser::probe()
 bool
 FileParser::stats(vtime_t precision, unsigned min_measurements, unsigned max_measurements)
 {
-  if (!f) return false;
+  if (!is_open()) return false;
 
-  fsize_t old_pos = f.pos();
+  fsize_t old_pos = file_pos();
 
   // Do not measure if we cannot load a frame.
   // (If file format is unknown measurments may take much of time)
@@ -136,8 +167,8 @@ FileParser::stats(vtime_t precision, unsigned min_measurements, unsigned max_mea
   std::vector<double> bitrate_stat;
   for (unsigned i = 0; i < max_measurements; i++)
   {
-    fsize_t file_pos = fsize_t((double)rand() * f.size() / RAND_MAX);
-    seek(file_pos);
+    fsize_t rand_pos = fsize_t((double)rand() * get_size() / RAND_MAX);
+    seek(rand_pos);
     if (!load_frame())
       continue;
 
@@ -183,7 +214,7 @@ FileParser::stats(vtime_t precision, unsigned min_measurements, unsigned max_mea
       for (size_t j = 0; j < stat_size; j++)
         error_squared += (bitrate - bitrate_stat[j])*(bitrate - bitrate_stat[j]);
       error_squared /= stat_size * (stat_size - 1);
-      error_squared *= f.size()*f.size()*64 / (bitrate*bitrate*bitrate*bitrate);
+      error_squared *= get_size()*get_size()*64 / (bitrate*bitrate*bitrate*bitrate);
       if (error_squared < precision_squared)
         break;
     }
@@ -199,14 +230,62 @@ FileParser::stats(vtime_t precision, unsigned min_measurements, unsigned max_mea
   return stat_size > 0;
 }
 
+bool
+FileParser::build_index(int interval)
+{
+  if (!is_open()) return false;
+
+  fsize_t old_pos = get_pos();
+
+  index.init(interval, get_size());
+  seek(0);
+
+  FrameInfo finfo;
+  fsize_t frame_pos;
+  while (scan_frame(finfo, frame_pos))
+    index.add_frame(frame_pos, frame_duration(finfo));
+
+  seek(old_pos);
+  if (index.is_empty())
+  {
+    index.clear();
+    return false;
+  }
+  return true;
+}
+
+bool
+FileParser::load_index(const string &index_filename)
+{
+  if (!is_open()) return false;
+
+  if (!index.load(index_filename.c_str()))
+    return false;
+
+  if (index.get_file_size() != get_size())
+  {
+    index.clear();
+    return false;
+  }
+  return true;
+}
+
+bool
+FileParser::save_index(const string &index_filename) const
+{
+  if (index.is_empty())
+    return false;
+  return index.save(index_filename.c_str());
+}
+
 string
 FileParser::file_info() const
 {
   std::stringstream result;
 
   result << "File: " << filename << nl;
-  result << "Size: " << f.size()
-         << " (" << compact_size(f.size()) << " " << compact_suffix(f.size()) << "B)" << nl;
+  result << "Size: " << get_size()
+         << " (" << compact_size(get_size()) << " " << compact_suffix(get_size()) << "B)" << nl;
 
   if (stat_size)
   {
@@ -222,6 +301,13 @@ FileParser::file_info() const
   return result.str();
 }
 
+void
+FileParser::set_read_ahead(int depth, size_t buf_size)
+{
+  ra_depth = depth < 2? 0: depth;
+  ra_buf_size = buf_size;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Positioning
 
@@ -231,9 +317,16 @@ FileParser::units_factor(units_t units) const
   switch (units)
   {
     case bytes:    return 1.0;
-    case relative: return 1.0 / f.size();
+    case relative: return 1.0 / get_size();
   }
 
+  if (!index.is_empty())
+    switch (units)
+    {
+      case frames:  return double(index.get_frames()) / get_size();
+      case time:    return index.get_duration() / get_size();
+    }
+
   if (stat_size)
     switch (units)
     {
@@ -247,7 +340,24 @@ FileParser::units_factor(units_t units) const
 FileParser::fsize_t
 FileParser::get_pos() const
 {
-  return f.is_open()? fsize_t(f.pos() - (buf_end - buf_pos)): 0;
+  return is_open()? fsize_t(file_pos() - (buf_end - buf_pos)): 0;
+}
+
+FileParser::fsize_t
+FileParser::get_frame_pos() const
+{
+  // The frame is either at the input (mapped) data right before the current
+  // position, or at the beginning of the stream buffer. The stream buffer
+  // holds the data loaded right before the current position.
+  if (!stream.has_frame())
+    return get_pos();
+
+  const uint8_t *frame = stream.get_frame();
+  const uint8_t *sync_buf = stream.get_buffer();
+  size_t sync_data = stream.get_buffer_size();
+  if (sync_buf && frame >= sync_buf && frame < sync_buf + sync_data)
+    return get_pos() - fsize_t(sync_buf + sync_data - frame);
+  return get_pos() - stream.get_frame_size();
 }
 
 double 
@@ -259,19 +369,19 @@ FileParser::get_pos(units_t units) const
 FileParser::fsize_t
 FileParser::get_size() const
 {
-  return f.size();
+  return ra.is_open()? ra.size(): af.is_open()? af.size(): f.size();
 }
 
 double 
 FileParser::get_size(units_t units) const
 {
-  return f.size() * units_factor(units);
+  return get_size() * units_factor(units);
 }
 
 int
 FileParser::seek(fsize_t pos)
 {
-  int result = f.seek(pos);
+  int result = file_seek(pos);
   stream_reset();
   return result;
 }
@@ -279,6 +389,15 @@ FileParser::seek(fsize_t pos)
 int
 FileParser::seek(double pos, units_t units)
 { 
+  if (!index.is_empty() && units == frames)
+  {
+    int64_t frame = int64_t(pos + 0.5);
+    return seek_index(index.find_frame(frame), frame, 0);
+  }
+
+  if (!index.is_empty() && units == time)
+    return seek_index(index.find_time(pos), 0, pos);
+
   double factor = units_factor(units);
   if (factor > 0)
     return seek(fsize_t(pos / factor + 0.5));
@@ -291,11 +410,42 @@ FileParser::seek(double pos, units_t units)
 void
 FileParser::stream_reset()
 {
-  buf_pos = buf.begin();
-  buf_end = buf.begin();
+  buf_pos = 0;
+  buf_end = 0;
   stream.reset();
   has_probe = false;
   is_new_stream = false;
+  scan_headers = false;
+}
+
+int
+FileParser::seek_index(size_t entry, int64_t frame, vtime_t time)
+{
+  // Walk frames from the index entry to the first frame that is not before
+  // the frame number and the time given. This frame is returned by the next
+  // get_chunk() call. It is a new stream as after any other seek.
+
+  int result = seek(index[entry].pos);
+  if (result)
+    return result;
+
+  int64_t frame_number = index.entry_frame(entry);
+  vtime_t frame_time = index[entry].time;
+  while (load_frame())
+  {
+    vtime_t duration = frame_duration(stream.frame_info());
+    if (frame_number >= frame && (frame_time + duration > time || duration == 0))
+    {
+      has_probe = true;
+      is_new_stream = true;
+      return 0;
+    }
+    frame_number++;
+    frame_time += duration;
+  }
+
+  // Position is after the end of the file
+  return 0;
 }
 
 bool
@@ -303,13 +453,14 @@ FileParser::load_frame()
 {
   size_t scan_size = 0;
 
-  while (!f.eof() || buf_pos < buf_end)
+  while (!file_eof() || buf_pos < buf_end)
   {
     if (buf_pos >= buf_end)
     {
-      size_t read_size = f.read(buf.begin(), buf.size());
-      buf_pos = buf.begin();
-      buf_end = buf.begin() + read_size;
+      size_t map_data = file_map(&buf_pos, map_size);
+      buf_end = buf_pos + map_data;
+      if (!map_data)
+        break;
     }
 
     size_t data_size = buf_end - buf_pos;
@@ -330,6 +481,90 @@ FileParser::load_frame()
   return false;
 }
 
+bool
+FileParser::read_header(fsize_t pos, uint8_t *hdr, size_t size)
+{
+  // Skip the frame data. Read-ahead is skipped by mapping because seek()
+  // cancels the reads in flight.
+  fsize_t cur_pos = file_pos();
+  if (!ra.is_open() || pos < cur_pos)
+  {
+    if (file_seek(pos))
+      return false;
+  }
+  else
+    while (cur_pos < pos)
+    {
+      uint8_t *data;
+      size_t skip = pos - cur_pos < fsize_t(map_size)? size_t(pos - cur_pos): map_size;
+      size_t data_size = file_map(&data, skip);
+      if (!data_size)
+        return false;
+      cur_pos += data_size;
+    }
+
+  while (size)
+  {
+    uint8_t *data;
+    size_t data_size = file_map(&data, size);
+    if (!data_size)
+      return false;
+    memcpy(hdr, data, data_size);
+    hdr += data_size;
+    size -= data_size;
+  }
+  return true;
+}
+
+bool
+FileParser::scan_frame(FrameInfo &finfo, fsize_t &frame_pos)
+{
+  const FrameParser *parser = stream.get_parser();
+  if (!is_open() || !parser)
+    return false;
+
+  size_t header_size = parser->header_size();
+  if (scan_headers)
+  {
+    // The next frame must follow the previous one. The last frame must be
+    // complete.
+    scan_hdr.allocate(header_size);
+    if (read_header(scan_next, scan_hdr, header_size) &&
+        parser->parse_header(scan_hdr, &finfo) &&
+        finfo.frame_size > 0 &&
+        scan_next + fsize_t(finfo.frame_size) <= get_size())
+    {
+      frame_pos = scan_next;
+      scan_next += finfo.frame_size;
+      return true;
+    }
+
+    // Search the sync from the position expected
+    if (scan_next >= get_size() || seek(scan_next))
+      return false;
+  }
+
+  if (!load_frame())
+    return false;
+
+  finfo = stream.frame_info();
+  finfo.frame_size = stream.get_frame_size();
+  frame_pos = get_frame_pos();
+
+  // Walk headers when the frame size is known from the header
+  FrameInfo hinfo;
+  if (stream.get_frame_size() >= header_size &&
+      parser->parse_header(stream.get_frame(), &hinfo) &&
+      hinfo.frame_size == stream.get_frame_size())
+  {
+    scan_headers = true;
+    scan_next = frame_pos + stream.get_frame_size();
+    buf_pos = 0;
+    buf_end = 0;
+  }
+  return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Source interface
 
@@ -7,8 +7,9 @@
 #define VALIB_FILE_PARSER_H
 
 #include <stdio.h>
-#include "../auto_file.h"
-#include "../buffer.h"
+#include "../map_file.h"
+#include "../read_ahead.h"
+#include "frame_index.h"
 #include "../parser.h"
 #include "../source.h"
 
@@ -19,6 +20,14 @@
   Uses StreamBuffer to sychronize and read frames. Allows seeking and provides
   extended info about the file.
 
+  The file is memory-mapped (see MapFile) and frames are returned directly
+  from the mapping when possible, without copying. Files that cannot be
+  mapped (pipes, devices, etc) are read through a buffer (see AutoFile).
+
+  Optionally, the file may be read by a background thread ahead of parsing
+  (see ReadAheadFile and set_read_ahead()). This is useful for slow media,
+  where the I/O and the parsing would block each other otherwise.
+
   This source has data-driven output format. I.e. it does not report the
   format immediately after file open. To actually detect the data format use
   probe().
@@ -99,6 +108,22 @@
     }
   \endcode
 
+  Navigation in frames and time units is approximate by default: it is based
+  on the average bitrate measured by stats(). The frame index (see
+  build_index() and FrameIndex) makes it exact: seek() in frames and time
+  units finds the nearest index entry and walks frames from it to the frame
+  requested. The index may be saved into a sidecar file and loaded on the next
+  open instead of scanning the file once again:
+  \code
+    FileParser f(file_name);
+    if (!f.load_index(index_name))
+    {
+      f.build_index();
+      f.save_index(index_name);
+    }
+    f.seek(1000, FileParser::frames); // Seek exactly to the 1000th frame
+  \endcode
+
   \name File operations
 
   \fn bool FileParser::open(const string &filename, FrameParser *parser, size_t max_scan = 0)
@@ -176,6 +201,58 @@
   \fn const FrameParser *FileParser::get_parser() const
     Returns header parser used.
 
+  \fn void FileParser::set_read_ahead(int depth, size_t buf_size = 1048576)
+    \param depth    Number of read-ahead buffers. Zero disables the read-ahead.
+    \param buf_size Size of each buffer.
+
+    Enable the asynchronous read-ahead. Takes effect at the next open(). The
+    read-ahead requires at least 2 buffers, smaller depth disables it.
+
+  \fn int FileParser::get_read_ahead() const
+    Returns the number of read-ahead buffers (zero when disabled).
+
+  \fn int FileParser::get_io_stalls() const
+    Returns the number of times the parser waited for the read-ahead since
+    open(). Zero when the read-ahead is disabled.
+
+  \fn vtime_t FileParser::get_io_stall_time() const
+    Returns the total time the parser waited for the read-ahead since open().
+
+  \fn bool FileParser::scan_frame(FrameInfo &finfo, fsize_t &frame_pos)
+    \param finfo     Receives the frame info
+    \param frame_pos Receives the file position of the frame
+    \return Returns false at the end of the file.
+
+    Walk frames parsing only frame headers. When the frame size is known from
+    the header, the next frame is expected right after the frame and the
+    frame data is skipped. Otherwise (no frame size at the header or no
+    header found where expected) the next frame is loaded with the sync
+    search as get_chunk() does.
+
+    Frame info is filled from the header, so it may be less complete than
+    frame_info() after get_chunk(). Do not mix with get_chunk(): seek() after
+    the scan.
+
+  \fn bool FileParser::build_index(int interval = 16)
+    \param interval Index interval (index every Nth frame)
+
+    Scan the whole file with scan_frame() and build the frame index. Current
+    position is not changed. Returns false when no frames were found.
+
+  \fn bool FileParser::load_index(const string &filename)
+    \param filename Name of the index file
+
+    Load the index saved with save_index(). Fails when the index was built
+    for a file of other size.
+
+  \fn bool FileParser::save_index(const string &filename) const
+    \param filename Name of the index file
+
+    Save the index into a file.
+
+  \fn const FrameIndex &FileParser::get_index() const
+    Returns the frame index (empty when the index was not built or loaded).
+
   \name Positioning
 
   \fn fsize_t FileParser::get_pos() const
@@ -189,6 +266,9 @@
     To use FileParser::frames and FileParser::time units, stat() must be
     called before.
 
+  \fn fsize_t FileParser::get_frame_pos() const
+    Returns the file position of the frame loaded.
+
   \fn fsize_t FileParser::get_size() const
     Returns the file size in bytes.
 
@@ -212,7 +292,8 @@
     Moves the current file position to the position \c pos in units specified.
 
     To use FileParser::frames and FileParser::time units, stat() must be
-    called before.
+    called or the index must be built before. With the index, the position
+    is exact: the next get_chunk() call returns the frame requested.
 
   \name Info
 
@@ -242,22 +323,40 @@ class FileParser : public Source
 protected:
   StreamBuffer stream;
 
-  AutoFile f;                //!< File we operate on
+  MapFile f;                 //!< File we operate on
+  ReadAheadFile ra;          //!< File we operate on with read-ahead enabled
+  AutoFile af;               //!< File we operate on when it cannot be mapped
+  Rawdata af_buf;            //!< Read buffer for the file that cannot be mapped
   string filename;           //!< File name
 
+  int ra_depth;              //!< Number of read-ahead buffers
+  size_t ra_buf_size;        //!< Size of read-ahead buffers
+
   bool has_probe;            //!< probe() was done
   bool is_new_stream;        //!< new_stream flag
 
-  Rawdata buf;               //!< Data buffer
-  uint8_t *buf_pos;          //!< Current buffer position pointer
-  uint8_t *buf_end;          //!< End of buffer data pointer
+  uint8_t *buf_pos;          //!< Current position at the mapped data
+  uint8_t *buf_end;          //!< End of the mapped data
+
+  FrameIndex index;          //!< Frame index
+
+  bool scan_headers;         //!< scan_frame() walks frame headers
+  AutoFile::fsize_t scan_next; //!< Expected position of the next frame header
+  Rawdata scan_hdr;          //!< Frame header buffer
 
   size_t stat_size;          //!< Number of measurments done by stat() call
   double avg_frame_size;     //!< Average frame size
   double avg_bitrate;        //!< Average bitrate
 
   bool load_frame();
+  bool read_header(AutoFile::fsize_t pos, uint8_t *hdr, size_t size);
   void stream_reset();
+  int  seek_index(size_t entry, int64_t frame, vtime_t time);
+
+  inline bool   file_eof() const;
+  inline AutoFile::fsize_t file_pos() const;
+  inline int    file_seek(AutoFile::fsize_t pos);
+  inline size_t file_map(uint8_t **data, size_t size);
 
 public:
   typedef AutoFile::fsize_t fsize_t;
@@ -279,8 +378,20 @@ public:
   bool probe();
   bool stats(vtime_t precision = 0.5, unsigned min_measurements = 10, unsigned max_measurements = 100);
 
-  bool is_open() const { return f != 0; }
-  bool eof() const { return f.eof() && (buf_pos >= buf_end) && !stream.has_frame(); }
+  bool is_open() const { return f.is_open() || ra.is_open() || af.is_open(); }
+  bool eof() const { return file_eof() && (buf_pos >= buf_end) && !stream.has_frame(); }
+
+  void set_read_ahead(int depth, size_t buf_size = 1048576);
+  int  get_read_ahead() const { return ra_depth; }
+
+  int     get_io_stalls()     const { return ra.get_stalls(); }
+  vtime_t get_io_stall_time() const { return ra.get_stall_time(); }
+
+  bool scan_frame(FrameInfo &finfo, fsize_t &frame_pos);
+  bool build_index(int interval = 16);
+  bool load_index(const string &filename);
+  bool save_index(const string &filename) const;
+  const FrameIndex &get_index() const { return index; }
 
   const string get_filename() const { return filename; }
   const FrameParser *get_parser() const { return stream.get_parser(); }
@@ -290,6 +401,7 @@ public:
 
   fsize_t get_pos() const;
   double  get_pos(units_t units) const;
+  fsize_t get_frame_pos() const;
 
   fsize_t get_size() const;
   double  get_size(units_t units) const;
@@ -318,4 +430,31 @@ public:
   virtual Speakers get_output() const;
 };
 
+inline bool
+FileParser::file_eof() const
+{ return ra.is_open()? ra.eof(): af.is_open()? af.eof(): f.eof(); }
+
+inline FileParser::fsize_t
+FileParser::file_pos() const
+{ return ra.is_open()? ra.pos(): af.is_open()? af.pos(): f.pos(); }
+
+inline int
+FileParser::file_seek(fsize_t pos)
+{ return ra.is_open()? ra.seek(pos): af.is_open()? af.seek(pos): f.seek(pos); }
+
+inline size_t
+FileParser::file_map(uint8_t **data, size_t size)
+{
+  if (ra.is_open())
+    return ra.map(data, size);
+
+  if (af.is_open())
+  {
+    *data = af_buf;
+    return af.read(af_buf, MIN(size, af_buf.size()));
+  }
+
+  return f.map(data, size);
+}
+
 #endif
@@ -0,0 +1,211 @@
+#include <sstream>
+#include "file_scan.h"
+#include "../win32/thread.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// ScanInfo
+
+void
+ScanInfo::clear()
+{
+  ok = false;
+  file_size = 0;
+  frames = 0;
+  duration = 0;
+  frame_bytes = 0;
+  min_bitrate = 0;
+  max_bitrate = 0;
+  streams.clear();
+}
+
+string
+ScanInfo::print() const
+{
+  std::stringstream result;
+  if (!ok)
+  {
+    result << "No sync" << nl;
+    return result.str();
+  }
+
+  result << "Frames: " << frames << nl;
+  result << "Length: "
+    << int(duration) / 3600 << ":"
+    << int(duration) % 3600 / 60 << ":"
+    << int(duration) % 60 << nl;
+  result << "Bitrate: " << int(avg_bitrate() / 1000) << "kbps"
+    << " (" << min_bitrate / 1000 << "-" << max_bitrate / 1000 << "kbps)" << nl;
+
+  if (streams.size() > 1)
+    for (size_t i = 0; i < streams.size(); i++)
+      result << "Stream " << i + 1 << ": " << streams[i].spk.print()
+        << ", " << streams[i].frames << " frames at " << streams[i].pos << nl;
+  else
+    result << "Stream format: " << streams[0].spk.print() << nl;
+
+  return result.str();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Single file scan
+
+static void add_frame(ScanStream &stream, size_t frame_size, size_t bitrate, vtime_t duration)
+{
+  if (!stream.frames || bitrate < stream.min_bitrate)
+    stream.min_bitrate = bitrate;
+  if (!stream.frames || bitrate > stream.max_bitrate)
+    stream.max_bitrate = bitrate;
+
+  stream.frames++;
+  stream.frame_bytes += frame_size;
+  stream.duration += duration;
+}
+
+bool
+FileScanner::scan_file(const string &filename, FrameParser *parser, ScanInfo &info, size_t max_scan)
+{
+  info.clear();
+
+  FileParser f;
+  if (!f.open(filename, parser, max_scan))
+    return false;
+
+  info.file_size = f.get_size();
+
+  FrameInfo finfo;
+  FileParser::fsize_t frame_pos;
+  ScanStream total;
+  while (f.scan_frame(finfo, frame_pos))
+  {
+    vtime_t duration = finfo.spk.sample_rate? vtime_t(finfo.nsamples) / finfo.spk.sample_rate: 0;
+
+    if (info.streams.empty() || info.streams.back().spk != finfo.spk)
+    {
+      info.streams.push_back(ScanStream());
+      info.streams.back().spk = finfo.spk;
+      info.streams.back().pos = frame_pos;
+    }
+
+    add_frame(info.streams.back(), finfo.frame_size, finfo.bitrate(), duration);
+    add_frame(total, finfo.frame_size, finfo.bitrate(), duration);
+  }
+
+  info.ok = total.frames > 0;
+  info.frames = total.frames;
+  info.duration = total.duration;
+  info.frame_bytes = total.frame_bytes;
+  info.min_bitrate = total.min_bitrate;
+  info.max_bitrate = total.max_bitrate;
+  return info.ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Multiple files scan
+//
+// Workers take files from the shared list one by one, so a long file does
+// not delay the files after it.
+
+class FileScanner::Worker : public Thread
+{
+public:
+  struct Jobs
+  {
+    CritSec lock;
+    size_t  next;
+    size_t  max_scan;
+    const std::vector<string> *filenames;
+    std::vector<ScanInfo> *info;
+  };
+
+  Jobs *jobs;
+  FrameParser *parser;
+
+  Event job;   // scan was started
+  Event done;  // no more files to scan
+
+  Worker(Jobs *jobs_, FrameParser *parser_):
+  jobs(jobs_), parser(parser_), job(false), done(true, false)
+  {}
+
+  virtual void terminate(int timeout_ms = 1000, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    job.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+protected:
+  virtual DWORD process()
+  {
+    while (true)
+    {
+      job.wait();
+      if (f_terminate)
+        return 0;
+
+      while (!f_terminate)
+      {
+        size_t i;
+        {
+          AutoLock auto_lock(&jobs->lock);
+          i = jobs->next;
+          if (i >= jobs->filenames->size())
+            break;
+          jobs->next++;
+        }
+        FileScanner::scan_file((*jobs->filenames)[i], parser, (*jobs->info)[i], jobs->max_scan);
+      }
+      done.set();
+    }
+  }
+};
+
+void
+FileScanner::scan_files(const std::vector<string> &filenames, FrameParser **parsers, int nparsers, std::vector<ScanInfo> &info, size_t max_scan)
+{
+  info.clear();
+  info.resize(filenames.size());
+  if (nparsers < 1 || filenames.empty())
+    return;
+
+  if (nparsers == 1 || filenames.size() == 1)
+  {
+    for (size_t i = 0; i < filenames.size(); i++)
+      scan_file(filenames[i], parsers[0], info[i], max_scan);
+    return;
+  }
+
+  if (size_t(nparsers) > filenames.size())
+    nparsers = (int)filenames.size();
+
+  Worker::Jobs jobs;
+  jobs.next = 0;
+  jobs.max_scan = max_scan;
+  jobs.filenames = &filenames;
+  jobs.info = &info;
+
+  std::vector<Worker *> workers;
+  for (int i = 0; i < nparsers; i++)
+  {
+    Worker *worker = new Worker(&jobs, parsers[i]);
+    if (!worker->create(false))
+    {
+      delete worker;
+      break;
+    }
+    workers.push_back(worker);
+    worker->job.set();
+  }
+
+  // Scan the rest in this thread when threads cannot be created
+  if (workers.empty())
+    for (size_t i = 0; i < filenames.size(); i++)
+      scan_file(filenames[i], parsers[0], info[i], max_scan);
+
+  for (size_t i = 0; i < workers.size(); i++)
+  {
+    workers[i]->done.wait();
+    workers[i]->terminate();
+    delete workers[i];
+  }
+}
@@ -0,0 +1,166 @@
+/**************************************************************************//**
+  \file file_scan.h
+  \brief FileScanner: header-only scan of files for duration and statistics.
+******************************************************************************/
+
+#ifndef VALIB_FILE_SCAN_H
+#define VALIB_FILE_SCAN_H
+
+#include <vector>
+#include "file_parser.h"
+
+/**************************************************************************//**
+  \struct ScanStream
+  \brief Statistics of a stream of the file scanned.
+
+  A new stream starts at the start of the file and at each format change.
+
+  \var Speakers ScanStream::spk;
+    Stream format.
+
+  \var fsize_t ScanStream::pos;
+    File position of the first frame of the stream.
+
+  \var int64_t ScanStream::frames;
+    Number of frames.
+
+  \var vtime_t ScanStream::duration;
+    Stream duration in seconds.
+
+  \var uint64_t ScanStream::frame_bytes;
+    Total size of frames.
+
+  \var size_t ScanStream::min_bitrate;
+    Minimum bitrate of a frame.
+
+  \var size_t ScanStream::max_bitrate;
+    Maximum bitrate of a frame.
+
+  \fn double ScanStream::avg_bitrate() const
+    Average bitrate.
+******************************************************************************/
+
+struct ScanStream
+{
+  Speakers spk;
+  AutoFile::fsize_t pos;
+  int64_t  frames;
+  vtime_t  duration;
+  uint64_t frame_bytes;
+  size_t   min_bitrate;
+  size_t   max_bitrate;
+
+  ScanStream():
+    pos(0), frames(0), duration(0), frame_bytes(0), min_bitrate(0), max_bitrate(0)
+  {}
+
+  double avg_bitrate() const
+  { return duration > 0? frame_bytes * 8 / duration: 0; }
+};
+
+/**************************************************************************//**
+  \struct ScanInfo
+  \brief Result of the file scan.
+
+  Totals of the file and statistics of each stream (format change). Format
+  changes are detected as changes of the stream format (Speakers). Loss of
+  sync without format change does not start a new stream.
+
+  \var bool ScanInfo::ok;
+    File was opened and at least one frame was found.
+
+  \var fsize_t ScanInfo::file_size;
+    Size of the file.
+
+  \var std::vector<ScanStream> ScanInfo::streams;
+    Streams of the file in order.
+
+  \var int64_t ScanInfo::frames;
+  \var vtime_t ScanInfo::duration;
+  \var uint64_t ScanInfo::frame_bytes;
+  \var size_t ScanInfo::min_bitrate;
+  \var size_t ScanInfo::max_bitrate;
+    Totals for the whole file.
+
+  \fn double ScanInfo::avg_bitrate() const
+    Average bitrate of the file.
+
+  \fn string ScanInfo::print() const
+    Print the scan result.
+******************************************************************************/
+
+struct ScanInfo
+{
+  bool     ok;
+  AutoFile::fsize_t file_size;
+  int64_t  frames;
+  vtime_t  duration;
+  uint64_t frame_bytes;
+  size_t   min_bitrate;
+  size_t   max_bitrate;
+  std::vector<ScanStream> streams;
+
+  ScanInfo()
+  { clear(); }
+
+  void clear();
+  string print() const;
+
+  double avg_bitrate() const
+  { return duration > 0? frame_bytes * 8 / duration: 0; }
+};
+
+/**************************************************************************//**
+  \class FileScanner
+  \brief Header-only scan of files for duration and statistics.
+
+  Walks all frames of a file with FileParser::scan_frame(). Only frame
+  headers are parsed and frame data is skipped by the frame size from the
+  header, so only pages with headers are read from the mapped file. The sync
+  search is used only when the frame size is unknown (zero) or the next
+  header is not found right after the frame. So the scan is much faster than
+  decoding and gives exact number of frames, duration and bitrates.
+
+  Many files may be scanned concurrently with scan_files(). Each thread needs
+  its own parser, so the number of parsers given defines the number of
+  threads.
+
+  \code
+    const int threads = 4;
+    UniFrameParser parser[threads];
+    FrameParser *parsers[threads] = { parser, parser + 1, parser + 2, parser + 3 };
+
+    std::vector<string> files = ...;
+    std::vector<ScanInfo> info;
+    FileScanner::scan_files(files, parsers, threads, info);
+  \endcode
+
+  \fn static bool FileScanner::scan_file(const string &filename, FrameParser *parser, ScanInfo &info, size_t max_scan = 0)
+    \param filename File to scan
+    \param parser   Parser to use
+    \param info     Scan result
+    \param max_scan Limit amount of data for synchronization (see FileParser::open())
+    \return Returns info.ok
+
+  \fn static void FileScanner::scan_files(const std::vector<string> &filenames, FrameParser **parsers, int nparsers, std::vector<ScanInfo> &info, size_t max_scan = 0)
+    \param filenames Files to scan
+    \param parsers   Parsers to use, one per thread
+    \param nparsers  Number of parsers (and threads)
+    \param info      Scan results (in order of files)
+    \param max_scan  Limit amount of data for synchronization (see FileParser::open())
+
+    Scan files concurrently. With one parser files are scanned in the calling
+    thread.
+******************************************************************************/
+
+class FileScanner
+{
+protected:
+  class Worker;
+
+public:
+  static bool scan_file(const string &filename, FrameParser *parser, ScanInfo &info, size_t max_scan = 0);
+  static void scan_files(const std::vector<string> &filenames, FrameParser **parsers, int nparsers, std::vector<ScanInfo> &info, size_t max_scan = 0);
+};
+
+#endif
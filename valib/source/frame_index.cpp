@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <string.h>
+#include "frame_index.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Index file format (native byte order, the version word checks it):
+//
+// Header:
+//   uint8_t  magic[4]    'V', 'I', 'D', 'X'
+//   uint32_t version     index_version
+//   int32_t  interval    index interval
+//   uint32_t count       number of entries
+//   int64_t  file_size   size of the file indexed
+//   int64_t  frames      number of frames at the file
+//   double   duration    duration of the file
+//
+// Followed by 'count' entries:
+//   int64_t  pos         file position of the frame
+//   double   time        timestamp of the frame
+
+static const uint8_t index_magic[4] = { 'V', 'I', 'D', 'X' };
+static const uint32_t index_version = 1;
+
+struct IndexHeader
+{
+  uint8_t  magic[4];
+  uint32_t version;
+  int32_t  interval;
+  uint32_t count;
+  int64_t  file_size;
+  int64_t  frames;
+  double   duration;
+};
+
+struct IndexEntry
+{
+  int64_t pos;
+  double  time;
+};
+
+// Both overloads are required by debug versions of the standard library
+struct EntryTimeLess
+{
+  bool operator()(vtime_t time, const FrameIndex::Entry &entry) const
+  { return time < entry.time; }
+  bool operator()(const FrameIndex::Entry &entry, vtime_t time) const
+  { return entry.time < time; }
+  bool operator()(const FrameIndex::Entry &e1, const FrameIndex::Entry &e2) const
+  { return e1.time < e2.time; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+void
+FrameIndex::clear()
+{
+  entries.clear();
+  interval = 0;
+  file_size = 0;
+  frames = 0;
+  duration = 0;
+}
+
+void
+FrameIndex::init(int interval_, fsize_t file_size_)
+{
+  clear();
+  interval = interval_ > 0? interval_: 1;
+  file_size = file_size_;
+}
+
+void
+FrameIndex::add_frame(fsize_t pos, vtime_t frame_duration)
+{
+  if (frames % interval == 0)
+  {
+    Entry entry;
+    entry.pos = pos;
+    entry.time = duration;
+    entries.push_back(entry);
+  }
+
+  frames++;
+  duration += frame_duration;
+}
+
+size_t
+FrameIndex::find_frame(int64_t frame) const
+{
+  if (entries.empty() || frame <= 0)
+    return 0;
+
+  int64_t i = frame / interval;
+  if (i >= (int64_t)entries.size())
+    return entries.size() - 1;
+  return (size_t)i;
+}
+
+size_t
+FrameIndex::find_time(vtime_t time) const
+{
+  std::vector<Entry>::const_iterator it =
+    std::upper_bound(entries.begin(), entries.end(), time, EntryTimeLess());
+
+  if (it == entries.begin())
+    return 0;
+  return (it - entries.begin()) - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Save/load
+
+bool
+FrameIndex::save(const char *filename) const
+{
+  AutoFile f(filename, "wb");
+  if (!f.is_open())
+    return false;
+
+  IndexHeader header;
+  memcpy(header.magic, index_magic, sizeof(index_magic));
+  header.version = index_version;
+  header.interval = interval;
+  header.count = (uint32_t)entries.size();
+  header.file_size = file_size;
+  header.frames = frames;
+  header.duration = duration;
+  if (f.write(&header, sizeof(header)) != sizeof(header))
+    return false;
+
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    IndexEntry entry;
+    entry.pos = entries[i].pos;
+    entry.time = entries[i].time;
+    if (f.write(&entry, sizeof(entry)) != sizeof(entry))
+      return false;
+  }
+  return true;
+}
+
+bool
+FrameIndex::load(const char *filename)
+{
+  clear();
+
+  AutoFile f(filename, "rb");
+  if (!f.is_open())
+    return false;
+
+  IndexHeader header;
+  if (f.read(&header, sizeof(header)) != sizeof(header) ||
+      memcmp(header.magic, index_magic, sizeof(index_magic)) ||
+      header.version != index_version ||
+      header.interval <= 0 ||
+      f.size() != fsize_t(sizeof(IndexHeader)) + fsize_t(header.count) * fsize_t(sizeof(IndexEntry)))
+    return false;
+
+  entries.resize(header.count);
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    IndexEntry entry;
+    if (f.read(&entry, sizeof(entry)) != sizeof(entry))
+    {
+      clear();
+      return false;
+    }
+    entries[i].pos = entry.pos;
+    entries[i].time = entry.time;
+  }
+
+  interval = header.interval;
+  file_size = header.file_size;
+  frames = header.frames;
+  duration = header.duration;
+  return true;
+}
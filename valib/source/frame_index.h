@@ -0,0 +1,104 @@
+/**************************************************************************//**
+  \file frame_index.h
+  \brief FrameIndex: positions of frames in a file for exact seeking.
+******************************************************************************/
+
+#ifndef VALIB_FRAME_INDEX_H
+#define VALIB_FRAME_INDEX_H
+
+#include <vector>
+#include "../auto_file.h"
+
+/**************************************************************************//**
+  \class FrameIndex
+  \brief Positions of frames in a file for exact seeking.
+
+  Index holds the file position and the timestamp of every Nth frame of the
+  file (N is the index interval). So frame number of the entry is implicit:
+  entry i describes the frame i * interval.
+
+  Entry for a frame may be found with find_frame() in O(1) and entry for a
+  timestamp may be found with find_time() with binary search. The frame
+  itself is found by walking frames from the entry position (interval - 1
+  frames at most).
+
+  Index may be saved into a file (sidecar) and loaded back. The index
+  remembers the size of the indexed file, so the caller can check that the
+  index still describes the file.
+
+  FileParser::build_index() builds the index.
+
+  \fn void FrameIndex::init(int interval, fsize_t file_size)
+    \param interval  Index interval (add an entry for every Nth frame)
+    \param file_size Size of the file indexed
+
+    Drop the index and start building the new one.
+
+  \fn void FrameIndex::add_frame(fsize_t pos, vtime_t duration)
+    \param pos      File position of the frame
+    \param duration Frame duration in seconds
+
+    Add the next frame of the file. Frames must be added in order.
+
+  \fn size_t FrameIndex::find_frame(int64_t frame) const
+    Returns the entry for the last indexed frame not greater than \c frame.
+
+  \fn size_t FrameIndex::find_time(vtime_t time) const
+    Returns the entry of the last indexed frame that starts not later than
+    \c time.
+
+  \fn int64_t FrameIndex::entry_frame(size_t i) const
+    Returns the frame number of the entry \c i.
+
+  \fn bool FrameIndex::save(const char *filename) const
+    Save the index into a file. Returns false on error.
+
+  \fn bool FrameIndex::load(const char *filename)
+    Load the index from a file. Returns false when the file cannot be read or
+    it is not a correct index file. The index is empty in this case.
+******************************************************************************/
+
+class FrameIndex
+{
+public:
+  typedef AutoFile::fsize_t fsize_t;
+
+  struct Entry
+  {
+    fsize_t pos;   //!< File position of the frame
+    vtime_t time;  //!< Timestamp of the frame
+  };
+
+protected:
+  std::vector<Entry> entries;
+  int     interval;     //!< Index interval
+  fsize_t file_size;    //!< Size of the file indexed
+  int64_t frames;       //!< Number of frames at the file
+  vtime_t duration;     //!< Duration of the file
+
+public:
+  FrameIndex(): interval(0), file_size(0), frames(0), duration(0)
+  {}
+
+  void clear();
+  void init(int interval, fsize_t file_size);
+  void add_frame(fsize_t pos, vtime_t duration);
+
+  bool save(const char *filename) const;
+  bool load(const char *filename);
+
+  bool    is_empty()      const { return entries.empty(); }
+  size_t  size()          const { return entries.size();  }
+  int     get_interval()  const { return interval;        }
+  fsize_t get_file_size() const { return file_size;       }
+  int64_t get_frames()    const { return frames;          }
+  vtime_t get_duration()  const { return duration;        }
+
+  const Entry &operator[](size_t i) const { return entries[i]; }
+  int64_t entry_frame(size_t i) const { return int64_t(i) * interval; }
+
+  size_t find_frame(int64_t frame) const;
+  size_t find_time(vtime_t time) const;
+};
+
+#endif
@@ -6,14 +6,19 @@ RAWSource::open(Speakers spk_, const char *filename_, size_t block_size_)
   if (spk.format == FORMAT_LINEAR)
     return false;
 
-  if (!f.open(filename_))
-    return false;
+  close();
+  if (!m.open(filename_))
+  {
+    if (!f.open(filename_))
+      return false;
 
-  if (!buf.allocate(block_size_))
-    return false;
+    if (!buf.allocate(block_size_))
+      return false;
+  }
 
   spk = spk_;
   block_size = block_size_;
+  sync = true;
   return true;
 }
 
@@ -23,6 +28,7 @@ RAWSource::open(Speakers spk_, FILE *f_, size_t block_size_)
   if (spk.format == FORMAT_LINEAR)
     return false;
 
+  close();
   if (!f.open(f_))
     return false;
 
@@ -31,6 +37,7 @@ RAWSource::open(Speakers spk_, FILE *f_, size_t block_size_)
 
   spk = spk_;
   block_size = block_size_;
+  sync = true;
   return true;
 }
 
@@ -38,16 +45,37 @@ void
 RAWSource::close()
 { 
   spk = spk_unknown;
+  m.close();
   f.close();
 }
 
 bool
 RAWSource::get_chunk(Chunk &chunk)
 {
-  if (!f.is_open() || f.eof())
+  if (!is_open() || eof())
     return false;
 
-  size_t read_size = f.read(buf, block_size);
-  chunk.set_rawdata(buf, read_size);
+  fsize_t chunk_pos = pos();
+  size_t sample_size = spk.is_pcm()? spk.nch() * spk.sample_size(): 1;
+  if (m.is_open())
+  {
+    // Whole PCM samples
+    uint8_t *data;
+    size_t map_size = m.map(&data, block_size, sample_size);
+    if (!map_size)
+      return false;
+
+    chunk.set_rawdata(data, map_size);
+  }
+  else
+  {
+    size_t read_size = f.read(buf, block_size);
+    chunk.set_rawdata(buf, read_size);
+  }
+
+  // Exact time of PCM data after open or seek is the sample count
+  if (sync && spk.is_pcm() && sample_size && spk.sample_rate)
+    chunk.set_sync(true, ExactTime(chunk_pos / sample_size, spk.sample_rate));
+  sync = false;
   return true;
 };
@@ -7,26 +7,37 @@
 
 #include "../buffer.h"
 #include "../auto_file.h"
+#include "../map_file.h"
 #include "../source.h"
 
+/*
+  File opened by name is memory-mapped and chunks point directly into the
+  mapping. Files that cannot be mapped (pipes, etc) and files opened with
+  FILE * are read with AutoFile.
+*/
+
 class RAWSource: public Source
 {
 protected:
+  MapFile  m;
   AutoFile f;
   Speakers spk;
   Rawdata  buf;
   size_t   block_size;
+  bool     sync;       // timestamp the next chunk
 
 public:
   typedef AutoFile::fsize_t fsize_t;
 
-  RAWSource()
+  RAWSource(): block_size(0), sync(false)
   {}
  
-  RAWSource(Speakers spk_, const char *filename_, size_t block_size_ = 65536)
+  RAWSource(Speakers spk_, const char *filename_, size_t block_size_ = 65536):
+  block_size(0), sync(false)
   { open(spk_, filename_, block_size_); }
 
-  RAWSource(Speakers spk_, FILE *_f, size_t block_size_ = 65536)
+  RAWSource(Speakers spk_, FILE *_f, size_t block_size_ = 65536):
+  block_size(0), sync(false)
   { open(spk_, _f, block_size_); }
 
   /////////////////////////////////////////////////////////
@@ -36,13 +47,13 @@ public:
   bool open(Speakers spk_, FILE *_f, size_t block_size_ = 65536);
   void close();
 
-  inline bool    is_open() const { return f.is_open(); }
-  inline bool    eof()     const { return f.eof();     }
-  inline fsize_t size()    const { return f.size();    }
-  inline FILE   *fh()      const { return f.fh();      }
+  inline bool    is_open() const { return m.is_open() || f.is_open();   }
+  inline bool    eof()     const { return m.is_open()? m.eof():  f.eof();  }
+  inline fsize_t size()    const { return m.is_open()? m.size(): f.size(); }
+  inline FILE   *fh()      const { return f.fh(); }
 
-  inline int seek(fsize_t _pos) { return f.seek(_pos); }
-  inline fsize_t pos() const    { return f.pos();      }
+  inline int seek(fsize_t _pos) { sync = true; return m.is_open()? m.seek(_pos): f.seek(_pos); }
+  inline fsize_t pos() const    { return m.is_open()? m.pos():      f.pos();      }
 
   /////////////////////////////////////////////////////////
   // Source interface
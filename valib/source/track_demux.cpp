@@ -0,0 +1,384 @@
+#include "track_demux.h"
+#include "../buffer.h"
+#include "../filters/decoder_graph.h"
+#include "../sink/sink_filter.h"
+#include "../win32/thread.h"
+#include "../log.h"
+#include "../map_file.h"
+#include "../mpeg_demux.h"
+
+static const string log_module = "TrackDemux";
+
+// Size of the file data to map at once
+static const size_t map_size = 1024 * 1024;
+
+// Number of packets queued for each track thread
+static const int queue_size = 32;
+
+///////////////////////////////////////////////////////////////////////////////
+// Track
+//
+// Packet payload may be split between file mappings. In this case the pieces
+// are collected at the packet buffer, otherwise the payload is passed
+// directly from the file mapping. PTS of the packet is passed with the
+// payload as the chunk timestamp.
+//
+// At threaded mode the packets are copied into the queue and processed by
+// the track's thread. The queue is a ring of queue_size buffers, protected
+// by the lock.
+
+class TrackDemux::Track : public Thread
+{
+public:
+  TrackInfo info;
+  Sink     *sink;
+  bool      threaded;
+
+  Speakers  spk;         // format of the current packet
+  bool      sync;        // current packet has a timestamp
+  vtime_t   time;        // timestamp of the current packet
+  Speakers  output_spk;  // format the output was opened with
+  Rawdata   packet;      // current packet collected from pieces
+  size_t    packet_size; // size of the data at the packet buffer
+
+  DecoderGraph dec;
+  SinkFilter   output;
+
+  CritSec  lock;
+  Event    data_ready;   // packet was queued or eof was set
+  Event    space_ready;  // packet was processed
+  Event    done;         // all packets are processed and output is flushed
+  Rawdata  queue_buf[queue_size];
+  size_t   queue_data[queue_size];
+  Speakers queue_spk[queue_size];
+  bool     queue_sync[queue_size];
+  vtime_t  queue_time[queue_size];
+  int      head;
+  int      count;
+  bool     eof;
+
+  Track(const TrackInfo &info_):
+  info(info_), sink(0), threaded(false), sync(false), time(0), packet_size(0),
+  data_ready(false), space_ready(false), done(true, false),
+  head(0), count(0), eof(false)
+  {}
+
+  ~Track()
+  {
+    if (thread_exists())
+      terminate();
+  }
+
+  void open(Sink *sink_, bool decode, bool threaded_)
+  {
+    sink = sink_;
+    if (!sink)
+      return;
+
+    output.set(sink, decode? &dec: 0);
+    threaded = threaded_ && create(false);
+  }
+
+  virtual void terminate(int timeout_ms = 1000, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    data_ready.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+  void put(uint8_t *data, size_t size, bool last)
+  {
+    if (!sink)
+      return;
+
+    if (!last || packet_size)
+    {
+      if (packet.size() < packet_size + size)
+        packet.reallocate(packet_size + size);
+      memcpy(packet + packet_size, data, size);
+      packet_size += size;
+      if (!last)
+        return;
+
+      data = packet;
+      size = packet_size;
+      packet_size = 0;
+    }
+
+    send(data, size);
+  }
+
+  // Send the part of the packet collected (file ends in the middle of the
+  // packet).
+  void put_partial()
+  {
+    if (!sink || !packet_size)
+      return;
+
+    valib_log(log_warning, log_module, "Track %i (stream 0x%x, substream 0x%x): packet truncated at the end of the file",
+      info.index, info.stream, info.substream);
+    size_t size = packet_size;
+    packet_size = 0;
+    send(packet, size);
+  }
+
+  void finish()
+  {
+    if (!sink)
+      return;
+
+    if (threaded)
+    {
+      {
+        AutoLock auto_lock(&lock);
+        eof = true;
+      }
+      data_ready.set();
+      done.wait();
+      terminate();
+    }
+    else
+      flush();
+  }
+
+protected:
+  void send(uint8_t *data, size_t size)
+  {
+    info.packets++;
+    info.size += size;
+
+    if (threaded)
+      queue(data, size);
+    else
+      process_packet(data, size, spk, sync, time);
+  }
+
+  void queue(const uint8_t *data, size_t size)
+  {
+    int slot;
+    while (true)
+    {
+      {
+        AutoLock auto_lock(&lock);
+        if (count < queue_size)
+        {
+          slot = (head + count) % queue_size;
+          break;
+        }
+      }
+      space_ready.wait();
+    }
+
+    if (queue_buf[slot].size() < size)
+      queue_buf[slot].allocate(size);
+    memcpy(queue_buf[slot], data, size);
+    queue_data[slot] = size;
+    queue_spk[slot] = spk;
+    queue_sync[slot] = sync;
+    queue_time[slot] = time;
+
+    {
+      AutoLock auto_lock(&lock);
+      count++;
+    }
+    data_ready.set();
+  }
+
+  void process_packet(uint8_t *data, size_t size, Speakers packet_spk, bool packet_sync, vtime_t packet_time)
+  {
+    if (info.error)
+      return;
+
+    try
+    {
+      // Output of the decoder is unknown until the first frame is decoded,
+      // so output.is_open() cannot be used here.
+      if (output_spk.is_unknown())
+        output.open_throw(packet_spk);
+      else if (output_spk != packet_spk)
+        output.flush_open_throw(packet_spk);
+      output_spk = packet_spk;
+
+      output.process(Chunk(data, size, packet_sync, packet_time));
+    }
+    catch (...)
+    {
+      valib_log(log_error, log_module, "Track %i (stream 0x%x, substream 0x%x) failed",
+        info.index, info.stream, info.substream);
+      info.error = true;
+    }
+  }
+
+  void flush()
+  {
+    if (info.error || output_spk.is_unknown())
+      return;
+
+    try
+    {
+      output.flush();
+    }
+    catch (...)
+    {
+      valib_log(log_error, log_module, "Track %i (stream 0x%x, substream 0x%x) failed",
+        info.index, info.stream, info.substream);
+      info.error = true;
+    }
+  }
+
+  virtual DWORD process()
+  {
+    while (!f_terminate)
+    {
+      int slot = 0;
+      bool has_packet;
+      bool finished;
+      {
+        AutoLock auto_lock(&lock);
+        has_packet = count > 0;
+        finished = !has_packet && eof;
+        slot = head;
+      }
+
+      if (finished)
+      {
+        flush();
+        done.set();
+        return 0;
+      }
+
+      if (!has_packet)
+      {
+        data_ready.wait();
+        continue;
+      }
+
+      process_packet(queue_buf[slot], queue_data[slot], queue_spk[slot], queue_sync[slot], queue_time[slot]);
+
+      {
+        AutoLock auto_lock(&lock);
+        head = (head + 1) % queue_size;
+        count--;
+      }
+      space_ready.set();
+    }
+    return 0;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// TrackDemux
+
+TrackDemux::TrackDemux():
+decode(false), threads(false)
+{}
+
+TrackDemux::~TrackDemux()
+{
+  release_tracks();
+}
+
+size_t
+TrackDemux::get_tracks() const
+{
+  return tracks.size();
+}
+
+const TrackInfo &
+TrackDemux::get_track(size_t i) const
+{
+  assert(i < tracks.size());
+  return tracks[i]->info;
+}
+
+void
+TrackDemux::release_tracks()
+{
+  for (size_t i = 0; i < tracks.size(); i++)
+    delete tracks[i];
+  tracks.clear();
+}
+
+TrackDemux::Track *
+TrackDemux::find_track(int stream, int substream, Speakers spk, bool sync, vtime_t time)
+{
+  Track *track = 0;
+  for (size_t i = 0; i < tracks.size(); i++)
+    if (tracks[i]->info.stream == stream && tracks[i]->info.substream == substream)
+    {
+      track = tracks[i];
+      break;
+    }
+
+  if (!track)
+  {
+    TrackInfo info;
+    info.index = (int)tracks.size();
+    info.stream = stream;
+    info.substream = substream;
+    info.spk = spk;
+
+    track = new Track(info);
+    tracks.push_back(track);
+    track->open(open_track(track->info), decode, threads);
+  }
+
+  track->spk = spk;
+  track->sync = sync;
+  track->time = time;
+  return track;
+}
+
+bool
+TrackDemux::demux(const string &filename)
+{
+  release_tracks();
+
+  MapFile f;
+  if (!f.open(filename.c_str()))
+    return false;
+
+  PSParser parser;
+  Track *track = 0;
+
+  uint8_t *data;
+  size_t size;
+  while ((size = f.map(&data, map_size)) > 0)
+  {
+    uint8_t *end = data + size;
+    while (data < end)
+    {
+      if (parser.payload_size)
+      {
+        size_t len = MIN(parser.payload_size, size_t(end - data));
+        parser.payload_size -= len;
+        if (track)
+          track->put(data, len, parser.payload_size == 0);
+        data += len;
+      }
+      else if (parser.parse(&data, end))
+      {
+        track = 0;
+        if (parser.is_audio())
+        {
+          Speakers spk = parser.spk();
+          if (!spk.is_unknown())
+            track = find_track(parser.stream, parser.substream, spk,
+              parser.has_pts, vtime_t(parser.pts) / 90000);
+        }
+      }
+    }
+  }
+
+  // File ends in the middle of a packet
+  if (track && parser.payload_size)
+    track->put_partial();
+
+  for (size_t i = 0; i < tracks.size(); i++)
+  {
+    tracks[i]->finish();
+    if (tracks[i]->sink)
+      close_track(tracks[i]->info);
+  }
+  return true;
+}
@@ -0,0 +1,159 @@
+/**************************************************************************//**
+  \file track_demux.h
+  \brief TrackDemux: single-pass demux of all audio tracks of a program stream
+******************************************************************************/
+
+#ifndef VALIB_TRACK_DEMUX_H
+#define VALIB_TRACK_DEMUX_H
+
+#include <vector>
+#include "../sink.h"
+
+/**************************************************************************//**
+  \struct TrackInfo
+  \brief Audio track of a program stream.
+
+  \var int TrackInfo::index;
+    Track number (in order of appearance).
+
+  \var int TrackInfo::stream;
+    Program stream number (stream_id).
+
+  \var int TrackInfo::substream;
+    Substream number (0 for no substream).
+
+  \var Speakers TrackInfo::spk;
+    Format of the first packet of the track.
+
+  \var int64_t TrackInfo::packets;
+    Number of packets of the track.
+
+  \var uint64_t TrackInfo::size;
+    Total payload size.
+
+  \var bool TrackInfo::error;
+    Processing of the track has failed. Track data after the error is
+    dropped.
+******************************************************************************/
+
+struct TrackInfo
+{
+  int      index;
+  int      stream;
+  int      substream;
+  Speakers spk;
+  int64_t  packets;
+  uint64_t size;
+  bool     error;
+
+  TrackInfo():
+  index(0), stream(0), substream(0), packets(0), size(0), error(false)
+  {}
+};
+
+/**************************************************************************//**
+  \class TrackDemux
+  \brief Single-pass demux of all audio tracks of a program stream.
+
+  PSDemux extracts only one stream, so the file must be read once per track
+  to extract all tracks. TrackDemux reads the file once and routes each
+  audio stream/substream to its own sink.
+
+  Sinks are provided by open_track() when a new track is found. Sinks must
+  stay valid until close_track() call. Track may be skipped by returning a
+  null sink.
+
+  Each track may be decoded with its own DecoderGraph (set_decode()), so the
+  sink receives PCM. Otherwise, the sink receives the elementary stream.
+  PTS of a packet is passed as the timestamp of the packet payload. A packet
+  truncated at the end of the file is passed as is (with a warning logged).
+
+  Tracks may be processed at separate threads (set_threads()). Each track
+  has its own queue of packets, so a slow track delays the file read only
+  when its queue is full. open_track() and close_track() are always called
+  at the calling thread, but the sink is used at the track's thread.
+
+  A track error (exception) does not stop the demux: the track is marked
+  as failed and its data is dropped after the error.
+
+  \code
+    class WAVTracks : public TrackDemux
+    {
+    protected:
+      WAVSink sinks[8];
+
+      virtual Sink *open_track(const TrackInfo &track)
+      {
+        if (track.index >= array_size(sinks))
+          return 0;
+        sinks[track.index].open_file(...);
+        return sinks + track.index;
+      }
+    };
+
+    WAVTracks demux;
+    demux.set_decode(true);
+    demux.set_threads(true);
+    demux.demux("video_ts.vob");
+  \endcode
+
+  \fn bool TrackDemux::demux(const string &filename)
+    \param filename File to demux
+    \return Returns false when the file cannot be opened.
+
+    Demux the file. Track list of the previous demux is dropped.
+
+  \fn void TrackDemux::set_decode(bool decode)
+    Decode tracks with DecoderGraph. Takes effect at the next demux() call.
+
+  \fn void TrackDemux::set_threads(bool threads)
+    Process each track at a separate thread. Takes effect at the next
+    demux() call.
+
+  \fn size_t TrackDemux::get_tracks() const
+    Number of tracks found by the last demux() call (including skipped).
+
+  \fn const TrackInfo &TrackDemux::get_track(size_t i) const
+    Track info.
+
+  \fn virtual Sink *TrackDemux::open_track(const TrackInfo &track)
+    \param track New track
+    \return Sink for the track output or null to skip the track.
+
+  \fn virtual void TrackDemux::close_track(const TrackInfo &track)
+    \param track Track finished
+
+    Called when all data of the track is processed and the sink is flushed.
+******************************************************************************/
+
+class TrackDemux
+{
+public:
+  TrackDemux();
+  virtual ~TrackDemux();
+
+  bool demux(const string &filename);
+
+  void set_decode(bool decode_)   { decode = decode_;   }
+  bool get_decode() const         { return decode;      }
+  void set_threads(bool threads_) { threads = threads_; }
+  bool get_threads() const        { return threads;     }
+
+  size_t get_tracks() const;
+  const TrackInfo &get_track(size_t i) const;
+
+protected:
+  class Track;
+
+  bool decode;
+  bool threads;
+  std::vector<Track *> tracks;
+
+  Track *find_track(int stream, int substream, Speakers spk, bool sync, vtime_t time);
+  void release_tracks();
+
+  virtual Sink *open_track(const TrackInfo &track) = 0;
+  virtual void close_track(const TrackInfo &track) {}
+};
+
+#endif
@@ -45,6 +45,7 @@ WAVSource::WAVSource()
   data_start = 0;
   data_size  = 0;
   data_remains = 0;
+  sync = false;
 }
 
 WAVSource::WAVSource(const char *filename_, size_t chunk_size_)
@@ -53,6 +54,7 @@ WAVSource::WAVSource(const char *filename_, size_t chunk_size_)
   data_start = 0;
   data_size  = 0;
   data_remains = 0;
+  sync = false;
 
   format.allocate(sizeof(WAVEFORMATEX));
   format.zero();
@@ -75,10 +77,9 @@ WAVSource::open(const char *filename_, size_t chunk_size_)
   }
 
   chunk_size = chunk_size_;
-  buf.allocate(chunk_size);
-
   f.seek(data_start);
   data_remains = data_size;
+  sync = true;
 
   return true;
 }
@@ -202,8 +203,6 @@ void
 WAVSource::set_chunk_size(size_t chunk_size_)
 {
   chunk_size = chunk_size_;
-  if (is_open())
-    buf.allocate(chunk_size);
 }
 
 size_t
@@ -234,6 +233,7 @@ WAVSource::seek(AutoFile::fsize_t _pos)
 
   int result = f.seek(_pos + data_start);
   data_remains = data_size - _pos;
+  sync = true;
   return result;
 }
 
@@ -251,6 +251,7 @@ WAVSource::reset()
   {
     f.seek(data_start);
     data_remains = data_size;
+    sync = true;
   }
 }
 
@@ -262,15 +263,26 @@ WAVSource::get_chunk(Chunk &chunk)
 
   size_t len = chunk_size;
   if (data_remains < chunk_size)
-    len = f.size_cast(data_remains);
+    len = AutoFile::size_cast(data_remains);
 
-  size_t data_read = f.read(buf, len);
+  // Chunk points directly into the file mapping and holds whole samples
+  uint8_t *data;
+  size_t block = wave_format()->nBlockAlign;
+  AutoFile::fsize_t chunk_pos = pos();
+  size_t data_read = f.map(&data, len, block? block: 1);
 
-  if (data_read < len) // eof
+  if (!data_read) // eof
+  {
     data_remains = 0;
-  else
-    data_remains -= len;
+    return false;
+  }
+
+  data_remains -= data_read;
+  chunk.set_rawdata(data, data_read);
 
-  chunk.set_rawdata(buf, data_read);
+  // Exact time of PCM data after open or seek is the sample count
+  if (sync && spk.is_pcm() && block && spk.sample_rate)
+    chunk.set_sync(true, ExactTime(chunk_pos / block, spk.sample_rate));
+  sync = false;
   return true;
 }
@@ -6,15 +6,14 @@
 #define WAV_SOURCE_H
 
 #include "../buffer.h"
-#include "../auto_file.h"
+#include "../map_file.h"
 #include "../source.h"
 #include "../win32/winspk.h"
 
 class WAVSource : public Source
 {
 protected:
-  AutoFile f;
-  Rawdata  buf;
+  MapFile  f;
   Speakers spk;
   Rawdata format;
   
@@ -23,6 +22,7 @@ protected:
   AutoFile::fsize_t data_start;
   uint64_t          data_size;
   uint64_t          data_remains;
+  bool              sync;         // timestamp the next chunk
 
   bool open_riff();
 
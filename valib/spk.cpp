@@ -107,6 +107,7 @@ int sample_size(int format)
     // Container formats
     case FORMAT_PES:
     case FORMAT_SPDIF:
+    case FORMAT_MPEGTS:
     case FORMAT_AAC_ADTS:
       return 1;
 
@@ -157,6 +158,7 @@ format_text(int format)
 
     case FORMAT_PES:         return "MPEG Program Stream";
     case FORMAT_SPDIF:       return "SPDIF";
+    case FORMAT_MPEGTS:      return "MPEG Transport Stream";
 
     case FORMAT_AAC_FRAME:   return "AAC";
     case FORMAT_AC3:         return "AC3";
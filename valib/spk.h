@@ -276,6 +276,8 @@ using std::string;
 #define FORMAT_MLP        23
 #define FORMAT_TRUEHD     24
 
+#define FORMAT_MPEGTS     25 // MPEG2 Transport Stream
+
 ///////////////////////////////////////////////////////////////////////////////
 // Format masks
 ///////////////////////////////////////////////////////////////////////////////
@@ -304,6 +306,7 @@ using std::string;
 // container format masks
 #define FORMAT_MASK_PES          FORMAT_MASK(FORMAT_PES)
 #define FORMAT_MASK_SPDIF        FORMAT_MASK(FORMAT_SPDIF)
+#define FORMAT_MASK_MPEGTS       FORMAT_MASK(FORMAT_MPEGTS)
 
 // compressed format masks
 #define FORMAT_MASK_AC3          FORMAT_MASK(FORMAT_AC3)
@@ -332,7 +335,7 @@ using std::string;
 #define FORMAT_CLASS_PCM_FP      (FORMAT_MASK_PCMFLOAT | FORMAT_MASK_PCMDOUBLE)
 #define FORMAT_CLASS_PCM         (FORMAT_CLASS_PCM_LE  | FORMAT_CLASS_PCM_BE  | FORMAT_CLASS_PCM_FP)
 #define FORMAT_CLASS_LPCM        (FORMAT_MASK_LPCM20   | FORMAT_MASK_LPCM24)
-#define FORMAT_CLASS_CONTAINER   (FORMAT_MASK_PES | FORMAT_MASK_SPDIF)
+#define FORMAT_CLASS_CONTAINER   (FORMAT_MASK_PES | FORMAT_MASK_SPDIF | FORMAT_MASK_MPEGTS)
 #define FORMAT_CLASS_SPDIFABLE   (FORMAT_MASK_MPA | FORMAT_MASK_AC3 | FORMAT_MASK_DTS)
 #define FORMAT_CLASS_COMPRESSED  (FORMAT_MASK_MPA | FORMAT_MASK_AC3 | FORMAT_MASK_DTS)
 
@@ -6,7 +6,6 @@
 #ifndef VALIB_SYNC_H
 #define VALIB_SYNC_H
 
-#include <deque>
 #include "filter.h"
 
 /**************************************************************************//**
@@ -205,6 +204,19 @@
     the amount of data between the timestamp received and the chunk's start.
     Applicable for linear and PCM data.
 
+    Exact time stamp is passed only when the time stamp is not shifted.
+    Use send_sync_exact() to keep exact time stamps.
+
+  \fn void SyncHelper::send_sync_exact(Chunk &chunk, int size_rate)
+    \param chunk Output chunk
+    \param size_rate Amount of data per second (samples per second for
+      linear format, bytes per second for PCM)
+
+    Same as send_sync(chunk, 1.0 / size_rate), but when the timestamp has the
+    exact time (see Chunk::exact_time), the shift is calculated exactly and
+    the output chunk receives the exact time too. So the exact time passes
+    through the buffering filter without rounding.
+
   \fn void SyncHelper::send_sync_linear(Chunk &chunk, int sample_rate)
     \param chunk Output chunk
     \param sample_rate Sampling rate
@@ -220,7 +232,7 @@
 
     This function if equivalent to the following:
     \code
-    sync_helper.send_sync(chunk, 1.0/spk.sample_rate);
+    sync_helper.send_sync_exact(chunk, spk.sample_rate);
     sync_helper.drop(chunk.size);
     \endcode
 
@@ -237,6 +249,17 @@
   \fn void SyncHelper::reset()
     Drop all timing information.
 
+  \b Timestamp queue
+
+  Timestamps are kept at a small ring of fixed size (max_timestamps) inside
+  the helper, so the helper never allocates memory and may be used at the
+  audio path.
+
+  The queue overflows when the filter buffers more than max_timestamps
+  stamped chunks. In this case the two oldest timestamps are merged into
+  one: the second timestamp is dropped, unless it has already reached the
+  buffer start (then the oldest one is dropped, as drop() does). So on
+  overflow some timestamps are lost, but the timestamps sent stay correct.
 ******************************************************************************/
 
 class SyncHelper
@@ -248,23 +271,35 @@ public:
   inline void receive_sync(Chunk &chunk);
   inline void send_frame_sync(Chunk &chunk);
   inline void send_sync(Chunk &chunk, double size_to_time);
+  inline void send_sync_exact(Chunk &chunk, int size_rate);
   inline void send_sync_linear(Chunk &chunk, int sample_rate);
 
   inline void put(size_t size);
   inline void drop(size_t size);
   inline void reset();
 
+  enum { max_timestamps = 32 }; // must be a power of 2
+
 protected:
   struct timestamp {
     vtime_t time;
+    ExactTime exact_time;
     pos_t pos;
-
-    timestamp(vtime_t time_, pos_t pos_):
-    time(time_), pos(pos_) {}
   };
 
-  std::deque<timestamp> t; // timestamp queque
+  timestamp t[max_timestamps]; // timestamp queue (ring)
+  int first;      // first timestamp in the ring
+  int count;      // number of timestamps queued
   pos_t buf_size; // current buffer fullness
+
+  inline timestamp &ts(int i)
+  { return t[(first + i) & (max_timestamps - 1)]; }
+
+  inline void pop_front()
+  {
+    first = (first + 1) & (max_timestamps - 1);
+    count--;
+  }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -274,7 +309,22 @@ SyncHelper::receive_sync(Chunk &chunk)
 {
   if (chunk.sync)
   {
-    t.push_back(timestamp(chunk.time, buf_size));
+    if (count >= max_timestamps)
+    {
+      // Merge the oldest timestamps
+      if (ts(1).pos <= 0)
+        pop_front();
+      else
+      {
+        ts(1) = ts(0);
+        pop_front();
+      }
+    }
+
+    timestamp &new_ts = ts(count++);
+    new_ts.time = chunk.time;
+    new_ts.exact_time = chunk.exact_time;
+    new_ts.pos = buf_size;
     chunk.set_sync(false, 0);
   }
 }
@@ -288,18 +338,35 @@ SyncHelper::send_frame_sync(Chunk &chunk)
 inline void
 SyncHelper::send_sync(Chunk &chunk, double size_to_time)
 {
-  if (t.size() > 0 && t[0].pos <= 0)
+  if (count > 0 && ts(0).pos <= 0)
+  {
+    const timestamp &t0 = ts(0);
+    if (t0.exact_time.is_set() && (t0.pos == 0 || size_to_time == 0))
+      chunk.set_sync(true, t0.exact_time);
+    else
+      chunk.set_sync(true, t0.time - t0.pos * size_to_time);
+    pop_front();
+  }
+}
+
+inline void
+SyncHelper::send_sync_exact(Chunk &chunk, int size_rate)
+{
+  if (count > 0 && ts(0).pos <= 0)
   {
-    chunk.sync = true;
-    chunk.time = t[0].time - t[0].pos * size_to_time;
-    t.pop_front();
+    const timestamp &t0 = ts(0);
+    if (t0.exact_time.is_set())
+      chunk.set_sync(true, t0.exact_time.add(-t0.pos, size_rate));
+    else
+      chunk.set_sync(true, t0.time - t0.pos * (1.0 / size_rate));
+    pop_front();
   }
 }
 
 inline void
 SyncHelper::send_sync_linear(Chunk &chunk, int sample_rate)
 {
-  send_sync(chunk, 1.0 / sample_rate);
+  send_sync_exact(chunk, sample_rate);
   drop(chunk.size);
 }
 
@@ -312,17 +379,18 @@ SyncHelper::put(size_t size)
 inline void
 SyncHelper::drop(size_t size)
 {
-  for (size_t i = 0; i < t.size(); i++)
-    t[i].pos -= size;
-  while (t.size() > 1 && t[1].pos <= 0)
-    t.pop_front();
+  for (int i = 0; i < count; i++)
+    ts(i).pos -= size;
+  while (count > 1 && ts(1).pos <= 0)
+    pop_front();
   buf_size -= size;
 }
 
 inline void
 SyncHelper::reset()
 {
-  t.clear();
+  first = 0;
+  count = 0;
   buf_size = 0;
 }
 
@@ -1,6 +1,11 @@
 #include <iostream>
+#include <map>
 #include "syncscan.h"
 
+#ifdef VALIB_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 const SyncTrie SyncTrie::any(1);
@@ -272,6 +277,18 @@ SyncTrie::optimize()
   }
 }
 
+int
+SyncTrie::next_byte(int node, uint8_t byte) const
+{
+  for (int bit = 7; bit >= 0; bit--)
+  {
+    node = graph[node].children[(byte >> bit) & 1];
+    if (node == node_allow || node == node_deny)
+      break;
+  }
+  return node;
+}
+
 void
 SyncTrie::serialize(std::string &result, int node)
 {
@@ -421,14 +438,162 @@ SyncScan::build_booster(uint16_t word, int node, int depth)
   if (r != SyncTrie::node_deny) build_booster(word | (0x8000 >> depth), r, depth + 1);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Pre-filter is a short list of masked 2-byte prefixes that may start a sync
+// sequence: (buf[0] & mask[0]) == value[0] && (buf[1] & mask[1]) == value[1]
+//
+// We start with one prefix per possible first byte, where the second byte
+// mask holds bits equal for all possible second bytes. Then we merge prefixes
+// until the list is short enough, each time choosing the pair that keeps most
+// mask bits. Merged prefix may pass more words than the booster does, but it
+// never misses a sync.
+//
+// Examples:
+// AC3 (0x0b77 | 0x770b): mask {ff,ff} value {0b,77}; mask {ff,ff} value {77,0b}
+// MPA big endian (0xffe0 - 0xffff): mask {ff,e0} value {ff,e0}
+//
+// Tries starting with 'any value' produce too many prefixes, so the
+// pre-filter is not used.
+///////////////////////////////////////////////////////////////////////////////
+
+static inline int count_bits(unsigned v)
+{
+  int n = 0;
+  for (; v; v &= v - 1) n++;
+  return n;
+}
+
+static inline void merge_prefix(uint8_t mask[2], uint8_t value[2],
+  const uint8_t mask1[2], const uint8_t value1[2],
+  const uint8_t mask2[2], const uint8_t value2[2])
+{
+  for (int i = 0; i < 2; i++)
+  {
+    mask[i] = mask1[i] & mask2[i] & ~(value1[i] ^ value2[i]);
+    value[i] = value1[i] & mask[i];
+  }
+}
+
+void
+SyncScan::build_prefixes()
+{
+  // Too many first bytes means that the pre-filter is useless
+  static const int max_first_bytes = 64;
+
+  Prefix p[max_first_bytes];
+  int n = 0;
+
+  nprefixes = 0;
+  for (int b0 = 0; b0 < 256; b0++)
+  {
+    int and_all = 0xff, or_all = 0;
+    for (int b1 = 0; b1 < 256; b1++)
+    {
+      int word = (b0 << 8) | b1;
+      if (booster[word >> 5] & (0x80000000 >> (word & 0x1f)))
+      {
+        and_all &= b1;
+        or_all |= b1;
+      }
+    }
+
+    if (or_all == 0 && and_all == 0xff)
+      continue; // b0 never starts a sync sequence
+
+    if (n >= max_first_bytes)
+      return;
+
+    p[n].mask[0] = 0xff;
+    p[n].value[0] = (uint8_t)b0;
+    p[n].mask[1] = (uint8_t)(~(and_all ^ or_all) & 0xff);
+    p[n].value[1] = (uint8_t)(and_all & p[n].mask[1]);
+    n++;
+  }
+
+  while (n > max_prefixes)
+  {
+    int best_i = 0, best_j = 1, best_bits = -1;
+    for (int i = 0; i < n; i++)
+      for (int j = i + 1; j < n; j++)
+      {
+        Prefix m;
+        merge_prefix(m.mask, m.value, p[i].mask, p[i].value, p[j].mask, p[j].value);
+        int bits = count_bits(m.mask[0]) + count_bits(m.mask[1]);
+        if (bits > best_bits)
+        {
+          best_i = i;
+          best_j = j;
+          best_bits = bits;
+        }
+      }
+
+    merge_prefix(p[best_i].mask, p[best_i].value, p[best_i].mask, p[best_i].value, p[best_j].mask, p[best_j].value);
+    p[best_j] = p[n - 1];
+    n--;
+  }
+
+  // Prefix that passes everything makes the filter useless
+  for (int i = 0; i < n; i++)
+    if (p[i].mask[0] == 0 && p[i].mask[1] == 0)
+      return;
+
+  for (int i = 0; i < n; i++)
+    prefix[i] = p[i];
+  nprefixes = n;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DFA states are the trie nodes we can reach at byte boundaries. Trie is
+// deterministic, so each byte leads from a node to exactly one node (or
+// terminates), and we just walk 8 bits for each byte value to build a row.
+// Nodes are shared in the optimized trie, so the number of states is small.
+///////////////////////////////////////////////////////////////////////////////
+
+void
+SyncScan::build_dfa()
+{
+  dfa.clear();
+  if (graph.is_empty())
+    return;
+
+  std::vector<int> node_state(graph.get_size(), -1); // trie node -> dfa state
+  std::vector<int> state_node;                       // dfa state -> trie node
+
+  node_state[0] = 0;
+  state_node.push_back(0);
+  for (size_t state = 0; state < state_node.size(); state++)
+  {
+    dfa.resize((state + 1) * 256);
+    for (int byte = 0; byte < 256; byte++)
+    {
+      int node = graph.next_byte(state_node[state], (uint8_t)byte);
+      if (node != SyncTrie::node_allow && node != SyncTrie::node_deny)
+      {
+        if (node_state[node] < 0)
+        {
+          node_state[node] = (int)state_node.size();
+          state_node.push_back(node);
+        }
+        node = node_state[node] * 256;
+      }
+      dfa[state * 256 + byte] = node;
+    }
+  }
+}
+
 void
 SyncScan::set_trie(const SyncTrie &gr)
 {
   graph = gr;
   graph.optimize();
   memset(booster, 0, sizeof(booster));
+  nprefixes = 0;
   if (!graph.is_empty())
+  {
     build_booster(0, 0, 0);
+    build_prefixes();
+  }
+  build_dfa();
 }
 
 SyncTrie
@@ -450,6 +615,60 @@ SyncScan::scan_pos(const uint8_t *buf, size_t size, size_t &pos) const
     return false;
   }
 
+#ifdef VALIB_SSE2
+  ///////////////////////////////////////////////////////
+  // Scan 16 positions at once using the pre-filter.
+  // Candidates are checked with the booster and the trie.
+  // Loads touch buf[pos..pos+16], and positions checked
+  // must be less than the booster scan limit below, so
+  // we leave the rest to the booster scan.
+
+  if (nprefixes > 0)
+  {
+    const size_t end = sync_size > 4? size - sync_size + 1: (size >= 3? size - 3: 0);
+
+    __m128i m0[max_prefixes], v0[max_prefixes];
+    __m128i m1[max_prefixes], v1[max_prefixes];
+    for (int i = 0; i < nprefixes; i++)
+    {
+      m0[i] = _mm_set1_epi8((char)prefix[i].mask[0]);
+      v0[i] = _mm_set1_epi8((char)prefix[i].value[0]);
+      m1[i] = _mm_set1_epi8((char)prefix[i].mask[1]);
+      v1[i] = _mm_set1_epi8((char)prefix[i].value[1]);
+    }
+
+    while (pos + 16 <= end)
+    {
+      __m128i x0 = _mm_loadu_si128((const __m128i *)(buf + pos));
+      __m128i x1 = _mm_loadu_si128((const __m128i *)(buf + pos + 1));
+      __m128i match = _mm_setzero_si128();
+      for (int i = 0; i < nprefixes; i++)
+        match = _mm_or_si128(match, _mm_and_si128(
+          _mm_cmpeq_epi8(_mm_and_si128(x0, m0[i]), v0[i]),
+          _mm_cmpeq_epi8(_mm_and_si128(x1, m1[i]), v1[i])));
+
+      int candidates = _mm_movemask_epi8(match);
+      while (candidates)
+      {
+        int bit = 0;
+        while (((candidates >> bit) & 1) == 0)
+          bit++;
+        candidates &= ~(1 << bit);
+
+        const uint8_t *p = buf + pos + bit;
+        int word = (p[0] << 8) | p[1];
+        if (booster[word >> 5] & (0x80000000 >> (word & 0x1f)))
+          if (dfa_is_sync(p))
+          {
+            pos += bit;
+            return true;
+          }
+      }
+      pos += 16;
+    }
+  }
+#endif
+
   ///////////////////////////////////////////////////////
   // Scan using the booster
 
@@ -464,7 +683,7 @@ SyncScan::scan_pos(const uint8_t *buf, size_t size, size_t &pos) const
     {
       sync = (sync << 8) | buf[i];
       if (booster[sync >> 21] & (0x80000000 >> ((sync >> 16) & 0x1f)))
-        if (graph.is_sync(buf+i-3))
+        if (dfa_is_sync(buf+i-3))
         {
           pos = i - 3;
           return true;
@@ -477,7 +696,7 @@ SyncScan::scan_pos(const uint8_t *buf, size_t size, size_t &pos) const
   // Scan last bytes without the booster (if nessesary)
 
   while (size - pos >= sync_size)
-    if (graph.is_sync(buf + pos))
+    if (dfa_is_sync(buf + pos))
       return true;
     else
       pos++;
@@ -504,3 +723,97 @@ SyncScan::scan_shift(uint8_t *buf, size_t &size) const
   size -= pos;
   return result;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// MultiSyncScan
+// State of the automaton is a list of trie states: the node of each trie
+// or one of the terminal values (allowed/denied). So states are built the
+// same way as for the single trie, but for all tries at once. State becomes
+// terminal when all tries are terminated.
+///////////////////////////////////////////////////////////////////////////////
+
+bool
+MultiSyncScan::set_tries(const SyncTrie *tries, size_t ntries)
+{
+  static const int trie_allow = -1;
+  static const int trie_deny = -2;
+  typedef std::vector<int> TrieStates;
+
+  clear();
+  if (ntries > max_tries)
+    return false;
+
+  std::vector<SyncTrie> opt(tries, tries + ntries);
+  for (size_t i = 0; i < ntries; i++)
+  {
+    opt[i].optimize();
+    if (ssize < opt[i].sync_size())
+      ssize = opt[i].sync_size();
+  }
+
+  std::map<TrieStates, int> state_index;
+  std::vector<TrieStates> states;
+
+  TrieStates start(ntries);
+  for (size_t i = 0; i < ntries; i++)
+    start[i] = opt[i].is_empty()? trie_allow: 0;
+  states.push_back(start);
+  state_index[start] = 0;
+
+  for (size_t state = 0; state < states.size(); state++)
+  {
+    dfa.resize((state + 1) * 256);
+    for (int byte = 0; byte < 256; byte++)
+    {
+      TrieStates next(states[state]);
+      bool terminal = true;
+      uint32_t set = 0;
+
+      for (size_t i = 0; i < ntries; i++)
+      {
+        if (next[i] >= 0)
+        {
+          int node = opt[i].next_byte(next[i], (uint8_t)byte);
+          if (node == SyncTrie::node_allow)
+            next[i] = trie_allow;
+          else if (node == SyncTrie::node_deny)
+            next[i] = trie_deny;
+          else
+          {
+            next[i] = node;
+            terminal = false;
+          }
+        }
+
+        if (next[i] == trie_allow)
+          set |= 1 << i;
+      }
+
+      if (terminal)
+      {
+        dfa[state * 256 + byte] = ~(int)set;
+        continue;
+      }
+
+      std::map<TrieStates, int>::const_iterator it = state_index.find(next);
+      int next_state;
+      if (it != state_index.end())
+        next_state = it->second;
+      else
+      {
+        next_state = (int)states.size();
+        states.push_back(next);
+        state_index[next] = next_state;
+      }
+      dfa[state * 256 + byte] = next_state * 256;
+    }
+  }
+  return true;
+}
+
+void
+MultiSyncScan::clear()
+{
+  dfa.clear();
+  ssize = 0;
+}
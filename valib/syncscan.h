@@ -154,7 +154,12 @@ protected:
   void serialize(std::string &result, int node);
   int  deserialize(const std::string &s, size_t &pos, size_t &depth);
 
+  // Walk 8 bits of 'byte' starting from 'node'. Returns the node reached,
+  // node_allow or node_deny.
+  int next_byte(int node, uint8_t byte) const;
+
   friend class SyncScan;
+  friend class MultiSyncScan;
 
 public:
   struct EParseError {};
@@ -281,6 +286,15 @@ public:
     trie.sync_size() - 1 bytes may belong to a syncpoint, but we cannot check
     this because we need more data to continue scanning. Therefore, if you
     have more data to scan, you have to save these bytes.
+
+    When SSE2 is available, the scanner checks 16 positions at once against
+    a short list of masked 2-byte prefixes of sync sequences. Only positions
+    passed this pre-filter are checked with the booster and the trie.
+
+  \fn bool SyncScan::is_sync(const uint8_t *buf) const
+    Returns true when 'buf' contains a sync sequence. Same as
+    SyncTrie::is_sync(), but uses the byte-level automaton, so it takes at
+    most sync_size() table lookups instead of a step per bit.
 ******************************************************************************/
 
 class SyncScan
@@ -290,11 +304,42 @@ protected:
   uint32_t booster[2048];
   void build_booster(uint16_t word, int node, int depth);
 
+  // Pre-filter: a list of masked 2-byte prefixes of sync sequences.
+  // Position matches a prefix when (buf[i] & mask[i]) == value[i] for both
+  // bytes. Built from the booster; nprefixes = 0 when the filter is not used.
+  struct Prefix {
+    uint8_t mask[2];
+    uint8_t value[2];
+  };
+
+  enum { max_prefixes = 8 };
+  int nprefixes;
+  Prefix prefix[max_prefixes];
+  void build_prefixes();
+
+  // Byte-level DFA compiled from the trie. Each state is a row of 256
+  // transitions indexed by the next byte. Transition is either
+  // SyncTrie::node_allow, SyncTrie::node_deny or the offset of the next row
+  // (state * 256). Start state is at offset 0 and it is never a target of a
+  // transition, so zero means deny as in the trie.
+  std::vector<int> dfa;
+  void build_dfa();
+
+  inline bool dfa_is_sync(const uint8_t *buf) const
+  {
+    const int *d = &dfa[0];
+    int state = 0;
+    do {
+      state = d[state + *buf++];
+    } while (state > 0);
+    return state == SyncTrie::node_allow;
+  }
+
 public:
-  SyncScan()
+  SyncScan(): nprefixes(0)
   {}
 
-  explicit SyncScan(const SyncTrie &t)
+  explicit SyncScan(const SyncTrie &t): nprefixes(0)
   { set_trie(t); }
 
   void set_trie(const SyncTrie &t);
@@ -304,10 +349,78 @@ public:
   bool scan_shift(uint8_t *buf, size_t &size) const;
 
   bool is_sync(const uint8_t *buf) const
-  { return graph.is_sync(buf); }
+  { return dfa.size() && dfa_is_sync(buf); }
 
   size_t sync_size() const
   { return graph.sync_size(); }
 };
 
+/**************************************************************************//**
+  \class MultiSyncScan
+  \brief Finds which of several tries match a syncpoint in one pass.
+
+  Tries are combined into a single byte-level automaton. Each state of the
+  automaton tracks all tries at once, and a terminal state holds the set of
+  tries that allowed the sequence. So one walk over the data tells which
+  tries match, instead of a walk for each trie.
+
+  Up to max_tries tries are supported. Trie number i corresponds to the bit
+  (1 << i) of the set returned. Empty trie matches everything.
+
+  \fn void MultiSyncScan::set_tries(const SyncTrie *tries, size_t ntries)
+    Build the automaton for the tries given. Returns false when there're too
+    many tries; the scanner becomes empty in this case.
+
+  \fn void MultiSyncScan::clear()
+    Drop the automaton. find_sync() always returns zero.
+
+  \fn bool MultiSyncScan::is_empty() const
+    Returns true when the automaton is not built.
+
+  \fn size_t MultiSyncScan::sync_size() const
+    Length of the longest sync sequence of all tries in bytes.
+
+  \fn uint32_t MultiSyncScan::find_sync(const uint8_t *buf) const
+    Returns the set of tries that match the sync sequence at 'buf'.
+    'buf' must be at least sync_size() long.
+******************************************************************************/
+
+class MultiSyncScan
+{
+protected:
+  // Transition is either the offset of the next row (state * 256) or
+  // a terminal value ~set, where 'set' is the set of tries matched.
+  // Start state is never a target of a transition.
+  std::vector<int> dfa;
+  size_t ssize;
+
+public:
+  enum { max_tries = 31 };
+
+  MultiSyncScan(): ssize(0)
+  {}
+
+  bool set_tries(const SyncTrie *tries, size_t ntries);
+  void clear();
+
+  bool is_empty() const
+  { return dfa.size() == 0; }
+
+  size_t sync_size() const
+  { return ssize; }
+
+  inline uint32_t find_sync(const uint8_t *buf) const
+  {
+    if (dfa.size() == 0)
+      return 0;
+
+    const int *d = &dfa[0];
+    int state = 0;
+    do {
+      state = d[state + *buf++];
+    } while (state > 0);
+    return ~state;
+  }
+};
+
 #endif
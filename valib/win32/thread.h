@@ -4,6 +4,7 @@
   Thread   - abstract base for thread classes
   CritSec  - critical section
   AutoLock - automatic lock
+  Event    - event object to signal between threads
 */
 
 #ifndef VALIB_THREAD_H
@@ -82,4 +83,32 @@ public:
   };
 };
 
+
+class Event
+{
+protected:
+  // Disallow event object copy
+  Event(const Event &);
+  Event &operator=(const Event &);
+
+  HANDLE ev;
+
+public:
+  Event(bool manual_reset = true, bool state = false)
+  { ev = CreateEvent(0, manual_reset, state, 0); }
+  ~Event()
+  { CloseHandle(ev); }
+
+  inline void set()   { SetEvent(ev);   };
+  inline void reset() { ResetEvent(ev); };
+
+  inline bool wait(DWORD timeout_ms = INFINITE)
+  { return WaitForSingleObject(ev, timeout_ms) == WAIT_OBJECT_0; }
+
+  inline bool is_set() const
+  { return WaitForSingleObject(ev, 0) == WAIT_OBJECT_0; }
+
+  HANDLE handle() const { return ev; }
+};
+
 #endif
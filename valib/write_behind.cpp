@@ -0,0 +1,250 @@
+#include "write_behind.h"
+
+#ifdef _WIN32
+#include <io.h>
+static void sync_file(FILE *f) { _commit(_fileno(f)); }
+#else
+#include <unistd.h>
+static void sync_file(FILE *f) { fdatasync(fileno(f)); }
+#endif
+
+// Time to wait for the writer to finish the write in flight on close
+static const int writer_timeout = 10000;
+
+///////////////////////////////////////////////////////////////////////////////
+// Writer thread
+//
+// The writer writes queued buffers in order. The buffer is released only
+// after it is written, so the producer never fills a buffer being written.
+
+class WriteBehindFile::Writer : public Thread
+{
+public:
+  WriteBehindFile *file;
+
+  Writer(WriteBehindFile *file_): file(file_)
+  {}
+
+  virtual void terminate(int timeout_ms = writer_timeout, DWORD exit_code = 0)
+  {
+    f_terminate = true;
+    file->ring.data_ready.set();
+    Thread::terminate(timeout_ms, exit_code);
+  }
+
+protected:
+  virtual DWORD process()
+  {
+    IORing &ring = file->ring;
+    while (!f_terminate)
+    {
+      int slot = 0;
+      size_t size = 0;
+      bool empty;
+
+      {
+        AutoLock auto_lock(&ring.lock);
+        empty = ring.count == 0;
+        if (!empty)
+        {
+          slot = ring.head;
+          size = ring.data_size[slot];
+        }
+      }
+
+      if (empty)
+      {
+        ring.data_ready.wait();
+        continue;
+      }
+
+      size_t written = file->f->write(ring.buffer(slot), size);
+      if (written == size && (file->flags & WRITE_BEHIND_SYNC))
+      {
+        file->f->flush();
+        sync_file(file->f->fh());
+      }
+
+      {
+        AutoLock auto_lock(&ring.lock);
+        if (written < size)
+          file->error = true;
+        ring.head = (ring.head + 1) % ring.depth;
+        ring.count--;
+      }
+      ring.space_ready.set();
+    }
+    return 0;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+WriteBehindFile::WriteBehindFile():
+writer(0), f(0), flags(0), error(false),
+filepos(0), cur(-1), cur_pos(0)
+{}
+
+WriteBehindFile::~WriteBehindFile()
+{
+  close();
+}
+
+bool
+WriteBehindFile::open(AutoFile *f_, size_t buf_size_, int depth_, int flags_)
+{
+  close();
+  if (!f_ || !f_->is_open() || !ring.allocate(buf_size_, depth_))
+    return false;
+
+  if (flags_ & WRITE_BEHIND_DIRECT)
+    setvbuf(f_->fh(), 0, _IONBF, 0);
+
+  flags = flags_;
+  f = f_;
+  error = false;
+
+  filepos = f->pos();
+  cur = -1;
+  cur_pos = 0;
+
+  writer = new Writer(this);
+  if (!writer->create(false))
+  {
+    safe_delete(writer);
+    close();
+    return false;
+  }
+  return true;
+}
+
+void
+WriteBehindFile::close()
+{
+  if (writer)
+  {
+    flush();
+    writer->terminate();
+    delete writer;
+    writer = 0;
+  }
+
+  ring.free();
+  f = 0;
+  filepos = 0;
+  cur = -1;
+  cur_pos = 0;
+}
+
+bool
+WriteBehindFile::next_buffer()
+{
+  vtime_t stall_start = 0;
+
+  ring.lock.lock();
+  while (ring.count >= ring.depth && !error)
+    ring.stall_wait(ring.space_ready, stall_start);
+
+  bool ok = !error;
+  if (ok)
+  {
+    cur = (ring.head + ring.count) % ring.depth;
+    cur_pos = 0;
+  }
+  ring.lock.unlock();
+
+  ring.stall_end(stall_start);
+  return ok;
+}
+
+void
+WriteBehindFile::queue_buffer()
+{
+  {
+    AutoLock auto_lock(&ring.lock);
+    ring.data_size[cur] = cur_pos;
+    ring.count++;
+  }
+  cur = -1;
+  cur_pos = 0;
+  ring.buffers++;
+  ring.data_ready.set();
+}
+
+size_t
+WriteBehindFile::write_data(const uint8_t *data, size_t size)
+{
+  if (!writer || error)
+    return 0;
+
+  size_t written = 0;
+  while (written < size)
+  {
+    if (cur < 0 && !next_buffer())
+      break;
+
+    size_t len = MIN(size - written, ring.buf_size - cur_pos);
+    uint8_t *dst = ring.buffer(cur) + cur_pos;
+    if (data)
+      memcpy(dst, data + written, len);
+    else
+      memset(dst, 0, len);
+
+    cur_pos += len;
+    written += len;
+    if (cur_pos >= ring.buf_size)
+      queue_buffer();
+  }
+
+  filepos += written;
+  return written;
+}
+
+size_t
+WriteBehindFile::write(const void *data, size_t size)
+{
+  return write_data((const uint8_t *)data, size);
+}
+
+size_t
+WriteBehindFile::write_zeros(size_t size)
+{
+  return write_data(0, size);
+}
+
+int
+WriteBehindFile::flush()
+{
+  if (!writer)
+    return -1;
+
+  if (cur >= 0 && cur_pos > 0)
+    queue_buffer();
+
+  ring.lock.lock();
+  while (ring.count > 0)
+  {
+    ring.lock.unlock();
+    ring.space_ready.wait();
+    ring.lock.lock();
+  }
+  ring.lock.unlock();
+
+  // Writer is idle now, the file may be used directly
+  f->flush();
+  if (flags & WRITE_BEHIND_SYNC)
+    sync_file(f->fh());
+  return error? -1: 0;
+}
+
+int
+WriteBehindFile::seek(fsize_t pos)
+{
+  if (!writer || pos < 0)
+    return -1;
+
+  flush();
+  filepos = pos;
+  return f->seek(pos);
+}
+
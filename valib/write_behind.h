@@ -0,0 +1,146 @@
+/**************************************************************************//**
+  \file write_behind.h
+  \brief WriteBehindFile: output file with asynchronous write-behind
+******************************************************************************/
+
+#ifndef VALIB_WRITE_BEHIND_H
+#define VALIB_WRITE_BEHIND_H
+
+#include "auto_file.h"
+#include "io_ring.h"
+
+#define WRITE_BEHIND_DIRECT 1 // Disable stdio buffering
+#define WRITE_BEHIND_SYNC   2 // Commit each buffer to the disk
+
+/**************************************************************************//**
+  \class WriteBehindFile
+  \brief Output file written by a background thread behind the producer.
+
+  Small writes are collected into a ring of \c depth buffers of \c buf_size
+  bytes each (see IORing). A full buffer is passed to the writer thread, which writes it
+  with one call, so the producer does not wait for the disk and the disk
+  receives large sequential writes.
+
+  When all buffers are queued, write() waits for the writer (back-pressure),
+  so the producer never runs ahead of the disk by more than the ring size.
+  Stall statistics show how often the producer had to wait. A significant
+  number of stalls means that the disk is too slow for the stream.
+
+  The file is attached and is not owned. The writer thread uses the file
+  only while it has queued buffers, so after flush() the file may be used
+  directly (seek and rewrite a header for example) until the next write().
+
+  \c flags select the write policy:
+  \li \c WRITE_BEHIND_DIRECT Disable stdio buffering. Buffers are passed to
+    the system directly, without an extra copy. Must be set before any other
+    operation on the file.
+  \li \c WRITE_BEHIND_SYNC Commit each buffer to the disk (fdatasync() or
+    _commit()). Slow, but limits the amount of data lost on a crash.
+
+  \fn bool WriteBehindFile::open(AutoFile *f, size_t buf_size, int depth, int flags = 0)
+    \param f        File to write to
+    \param buf_size Size of each buffer
+    \param depth    Number of buffers (at least 2)
+    \param flags    Write policy flags
+    \return Returns true on success and false otherwise.
+
+    Attach the file open for writing and start the writer thread. Data is
+    written from the current position of the file.
+
+  \fn void WriteBehindFile::close()
+    Write all data, stop the writer thread and detach the file. The file is
+    not closed.
+
+  \fn size_t WriteBehindFile::write(const void *buf, size_t size)
+    \param buf  Buffer to write data from.
+    \param size Size of the data at the buffer.
+    \return     Number of bytes accepted.
+
+    Queue the data for writing. Waits for the writer when all buffers are
+    queued. Returns zero after a write error.
+
+  \fn size_t WriteBehindFile::write_zeros(size_t size)
+    \param size Number of zero bytes to write.
+    \return     Number of bytes accepted.
+
+  \fn int WriteBehindFile::flush()
+    \return Returns 0 on success and non-zero on a write error.
+
+    Write all queued data and wait for the writer to finish.
+
+  \fn int WriteBehindFile::seek(fsize_t pos)
+    \param pos File position to move to.
+    \return Returns 0 on success and non-zero otherwise.
+
+    Flush and move to the position given.
+
+  \fn fsize_t WriteBehindFile::pos() const
+    Current file position including the data queued.
+
+  \fn bool WriteBehindFile::is_error() const
+    Returns true when a write has failed.
+
+  \fn int WriteBehindFile::get_buffers() const
+    Number of buffers queued since open() or reset_stats().
+
+  \fn int WriteBehindFile::get_stalls() const
+    Number of times the producer had to wait for the writer.
+
+  \fn vtime_t WriteBehindFile::get_stall_time() const
+    Total time the producer waited for the writer.
+******************************************************************************/
+
+class WriteBehindFile
+{
+public:
+  typedef AutoFile::fsize_t fsize_t;
+
+protected:
+  class Writer;
+  Writer   *writer;        //!< Writer thread
+  AutoFile *f;             //!< File we write to
+  int       flags;         //!< Write policy
+
+  IORing   ring;           //!< Queued buffers
+  bool     error;          //!< Write error (protected by the ring lock)
+
+  fsize_t  filepos;        //!< Producer position
+  int      cur;            //!< Buffer filled by the producer (-1 for none)
+  size_t   cur_pos;        //!< Data size at the current buffer
+
+  bool   next_buffer();
+  void   queue_buffer();
+  size_t write_data(const uint8_t *data, size_t size);
+
+  // Non-copyable
+  WriteBehindFile(const WriteBehindFile &);
+  WriteBehindFile &operator =(const WriteBehindFile &);
+
+public:
+  WriteBehindFile();
+  ~WriteBehindFile();
+
+  bool open(AutoFile *f, size_t buf_size, int depth, int flags = 0);
+  void close();
+
+  size_t write(const void *buf, size_t size);
+  size_t write_zeros(size_t size);
+  int flush();
+
+  inline bool    is_open()  const { return writer != 0; }
+  inline bool    is_error() const { return error;       }
+
+  int seek(fsize_t pos);
+  inline fsize_t pos() const { return filepos; }
+
+  size_t get_buf_size() const { return ring.buf_size; }
+  int    get_depth()    const { return ring.depth;    }
+  int    get_flags()    const { return flags;         }
+
+  int     get_buffers()    const { return ring.buffers;    }
+  int     get_stalls()     const { return ring.stalls;     }
+  vtime_t get_stall_time() const { return ring.stall_time; }
+  void    reset_stats()          { ring.reset_stats();     }
+};
+
+#endif